@@ -54,6 +54,11 @@ static const GimpActionEntry debug_actions[] =
   { "debug-dump-attached-data", NULL,
     "Dump Attached Data", NULL, NULL,
     G_CALLBACK (debug_dump_attached_data_cmd_callback),
+    NULL },
+
+  { "debug-dump-tile-cache", NULL,
+    "Dump _Tile Cache Statistics", NULL, NULL,
+    G_CALLBACK (debug_dump_tile_cache_cmd_callback),
     NULL }
 };
 
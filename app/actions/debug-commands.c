@@ -26,6 +26,8 @@
 
 #include "actions-types.h"
 
+#include "base/tile-cache.h"
+
 #include "core/gimp.h"
 #include "core/gimpcontext.h"
 
@@ -146,6 +148,13 @@ debug_dump_attached_data_cmd_callback (GtkAction *action,
   debug_print_qdata (GIMP_OBJECT (user_context));
 }
 
+void
+debug_dump_tile_cache_cmd_callback (GtkAction *action,
+                                    gpointer   data)
+{
+  tile_cache_dump_stats ();
+}
+
 
 /*  private functions  */
 
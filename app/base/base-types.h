@@ -79,6 +79,10 @@ typedef struct _TilePyramid         TilePyramid;
 typedef void   (* TileValidateProc)  (TileManager *tm,
                                       Tile        *tile,
                                       gpointer     user_data);
+typedef gboolean (* TileLevelProc)   (TileManager *tm,
+                                      Tile        *tile,
+                                      gint         level,
+                                      gpointer     user_data);
 
 
 #endif /* __BASE_TYPES_H__ */
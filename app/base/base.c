@@ -47,18 +47,22 @@
 
 #include "base.h"
 #include "pixel-processor.h"
+#include "tile.h"
 #include "tile-cache.h"
 #include "tile-swap.h"
 
 
-static void   base_toast_old_swap_files   (const gchar *swap_path);
+static void   base_toast_old_swap_files      (const gchar *swap_path);
 
-static void   base_tile_cache_size_notify (GObject     *config,
-                                           GParamSpec  *param_spec,
-                                           gpointer     data);
-static void   base_num_processors_notify  (GObject     *config,
-                                           GParamSpec  *param_spec,
-                                           gpointer     data);
+static void   base_tile_cache_size_notify    (GObject     *config,
+                                              GParamSpec  *param_spec,
+                                              gpointer     data);
+static void   base_tile_compress_size_notify (GObject     *config,
+                                              GParamSpec  *param_spec,
+                                              gpointer     data);
+static void   base_num_processors_notify     (GObject     *config,
+                                              GParamSpec  *param_spec,
+                                              gpointer     data);
 
 
 static GimpBaseConfig *base_config = NULL;
@@ -79,6 +83,8 @@ base_init (GimpBaseConfig *config,
 
   base_config = g_object_ref (config);
 
+  tile_init ();
+
   tile_cache_init (config->tile_cache_size);
   g_signal_connect (config, "notify::tile-cache-size",
                     G_CALLBACK (base_tile_cache_size_notify),
@@ -91,6 +97,11 @@ base_init (GimpBaseConfig *config,
 
   tile_swap_init (config->swap_path);
 
+  tile_swap_set_compressed_size (config->tile_compress_size);
+  g_signal_connect (config, "notify::tile-compress-size",
+                    G_CALLBACK (base_tile_compress_size_notify),
+                    NULL);
+
   swap_is_ok = tile_swap_test ();
 
   /*  create the temp directory if it doesn't exist  */
@@ -132,6 +143,9 @@ base_exit (void)
   g_signal_handlers_disconnect_by_func (base_config,
                                         base_tile_cache_size_notify,
                                         NULL);
+  g_signal_handlers_disconnect_by_func (base_config,
+                                        base_tile_compress_size_notify,
+                                        NULL);
 
   g_object_unref (base_config);
   base_config = NULL;
@@ -202,6 +216,14 @@ base_tile_cache_size_notify (GObject    *config,
   tile_cache_set_size (GIMP_BASE_CONFIG (config)->tile_cache_size);
 }
 
+static void
+base_tile_compress_size_notify (GObject    *config,
+                                GParamSpec *param_spec,
+                                gpointer    data)
+{
+  tile_swap_set_compressed_size (GIMP_BASE_CONFIG (config)->tile_compress_size);
+}
+
 static void
 base_num_processors_notify (GObject    *config,
                             GParamSpec *param_spec,
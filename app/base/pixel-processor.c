@@ -36,13 +36,21 @@
 #include "tile.h"
 
 
-#define TILES_PER_THREAD  8
+/*  The region is split into chunks of one tile row and up to
+ *  CHUNK_TILES tiles, which are handed out to the workers up front.
+ */
+#define CHUNK_TILES       4
 #define PROGRESS_TIMEOUT  64
 
 
-static GThreadPool *pool       = NULL;
-static GMutex      *pool_mutex = NULL;
-static GCond       *pool_cond  = NULL;
+static GThreadPool    *pool       = NULL;
+static GMutex         *pool_mutex = NULL;
+static GCond          *pool_cond  = NULL;
+
+#ifdef ENABLE_MP
+/*  set in the pool's threads, to avoid nested parallel processing  */
+static GStaticPrivate  pool_thread = G_STATIC_PRIVATE_INIT;
+#endif
 
 
 typedef void  (* p1_func) (gpointer      data,
@@ -61,7 +69,21 @@ typedef void  (* p4_func) (gpointer      data,
                            PixelRegion  *region4);
 
 
-typedef struct _PixelProcessor PixelProcessor;
+typedef struct _PixelProcessor      PixelProcessor;
+typedef struct _PixelProcessorQueue PixelProcessorQueue;
+
+#ifdef ENABLE_MP
+/*  A range of chunks owned by one worker. The owner takes chunks from
+ *  the front, idle workers steal the back half.
+ */
+struct _PixelProcessorQueue
+{
+  GStaticMutex  mutex;
+  gint          head;      /*  the next chunk to process           */
+  gint          tail;      /*  one past the last chunk             */
+  gulong        progress;  /*  pixels processed, written by owner  */
+};
+#endif
 
 struct _PixelProcessor
 {
@@ -69,9 +91,17 @@ struct _PixelProcessor
   gpointer             data;
 
 #ifdef ENABLE_MP
-  GMutex              *mutex;
-  gint                 threads;
-  gboolean             first;
+  volatile gint        threads;
+  gint                 n_queues;
+  volatile gint        next_queue;
+  PixelProcessorQueue  queues[GIMP_MAX_NUM_THREADS];
+
+  gint                 width;      /*  size of the whole region        */
+  gint                 height;
+  gint                 offset_x;   /*  position of the region's origin */
+  gint                 offset_y;   /*  within the first chunk          */
+  gint                 chunk_cols;
+  gint                 n_chunks;
 #endif
 
   PixelRegionIterator *PRI;
@@ -82,108 +112,270 @@ struct _PixelProcessor
 };
 
 
+static void
+pixel_processor_call (PixelProcessor  *processor,
+                      PixelRegion    **regions)
+{
+  switch (processor->num_regions)
+    {
+    case 1:
+      ((p1_func) processor->func) (processor->data,
+                                   regions[0]);
+      break;
+
+    case 2:
+      ((p2_func) processor->func) (processor->data,
+                                   regions[0],
+                                   regions[1]);
+      break;
+
+    case 3:
+      ((p3_func) processor->func) (processor->data,
+                                   regions[0],
+                                   regions[1],
+                                   regions[2]);
+      break;
+
+    case 4:
+      ((p4_func) processor->func) (processor->data,
+                                   regions[0],
+                                   regions[1],
+                                   regions[2],
+                                   regions[3]);
+      break;
+
+    default:
+      g_warning ("pixel_processor_call: Bad number of regions %d\n",
+                 processor->num_regions);
+      break;
+    }
+}
+
 #ifdef ENABLE_MP
+/*  Splits the region into chunks aligned to the tile grid of the
+ *  region that gets written to (or of the first tiled region).
+ *  Returns FALSE if there is not enough work to go parallel.
+ */
+static gboolean
+pixel_processor_split (PixelProcessor *processor)
+{
+  PixelRegion *first = NULL;
+  PixelRegion *align = NULL;
+  gint         chunk_rows;
+  gint         i;
+
+  for (i = 0; i < processor->num_regions; i++)
+    {
+      PixelRegion *PR = processor->regions[i];
+
+      if (! PR)
+        continue;
+
+      if (! first)
+        first = PR;
+
+      if (PR->tiles && ! PR->data && (! align || (PR->dirty && ! align->dirty)))
+        align = PR;
+    }
+
+  if (! first || first->w <= 0 || first->h <= 0)
+    return FALSE;
+
+  if (! align)
+    align = first;
+
+  processor->width    = first->w;
+  processor->height   = first->h;
+  processor->offset_x = align->x % TILE_WIDTH;
+  processor->offset_y = align->y % TILE_HEIGHT;
+
+  processor->chunk_cols = ((processor->width + processor->offset_x +
+                            CHUNK_TILES * TILE_WIDTH - 1) /
+                           (CHUNK_TILES * TILE_WIDTH));
+  chunk_rows            = ((processor->height + processor->offset_y +
+                            TILE_HEIGHT - 1) / TILE_HEIGHT);
+
+  processor->n_chunks = processor->chunk_cols * chunk_rows;
+
+  return (processor->n_chunks > 1);
+}
+
 static void
-do_parallel_regions (PixelProcessor *processor)
+pixel_processor_chunk_rect (PixelProcessor *processor,
+                            gint            chunk,
+                            gint           *x,
+                            gint           *y,
+                            gint           *width,
+                            gint           *height)
+{
+  gint col = chunk % processor->chunk_cols;
+  gint row = chunk / processor->chunk_cols;
+  gint x1, y1, x2, y2;
+
+  x1 = col * CHUNK_TILES * TILE_WIDTH - processor->offset_x;
+  y1 = row * TILE_HEIGHT              - processor->offset_y;
+  x2 = x1 + CHUNK_TILES * TILE_WIDTH;
+  y2 = y1 + TILE_HEIGHT;
+
+  x1 = CLAMP (x1, 0, processor->width);
+  y1 = CLAMP (y1, 0, processor->height);
+  x2 = CLAMP (x2, 0, processor->width);
+  y2 = CLAMP (y2, 0, processor->height);
+
+  *x      = x1;
+  *y      = y1;
+  *width  = x2 - x1;
+  *height = y2 - y1;
+}
+
+static gint
+pixel_processor_queue_pop (PixelProcessorQueue *queue)
 {
-  PixelRegion tr[4];
-  gint        i;
+  gint chunk = -1;
 
-  g_mutex_lock (processor->mutex);
+  g_static_mutex_lock (&queue->mutex);
 
-  /*  the first thread getting here must not call pixel_regions_process()  */
-  if (!processor->first && processor->PRI)
-    processor->PRI = pixel_regions_process (processor->PRI);
-  else
-    processor->first = FALSE;
+  if (queue->head < queue->tail)
+    chunk = queue->head++;
+
+  g_static_mutex_unlock (&queue->mutex);
+
+  return chunk;
+}
 
-  while (processor->PRI)
+/*  Moves the back half of the fullest other queue into @queue and
+ *  returns its first chunk, or -1 if there's nothing left to steal.
+ */
+static gint
+pixel_processor_steal (PixelProcessor      *processor,
+                       PixelProcessorQueue *queue)
+{
+  while (TRUE)
     {
-      guint pixels = (processor->PRI->portion_width *
-                      processor->PRI->portion_height);
+      PixelProcessorQueue *victim    = NULL;
+      gint                 remaining = 0;
+      gint                 head      = 0;
+      gint                 tail      = 0;
+      gint                 i;
+
+      /*  a racy look is good enough to pick a victim  */
+      for (i = 0; i < processor->n_queues; i++)
+        {
+          PixelProcessorQueue *q = &processor->queues[i];
 
-      for (i = 0; i < processor->num_regions; i++)
-        if (processor->regions[i])
-          {
-            memcpy (&tr[i], processor->regions[i], sizeof (PixelRegion));
-            if (tr[i].tiles)
-              tile_lock (tr[i].curtile);
-          }
+          if (q != queue && q->tail - q->head > remaining)
+            {
+              victim    = q;
+              remaining = q->tail - q->head;
+            }
+        }
+
+      if (! victim)
+        return -1;
+
+      g_static_mutex_lock (&victim->mutex);
 
-      g_mutex_unlock (processor->mutex);
+      remaining = victim->tail - victim->head;
 
-      switch (processor->num_regions)
+      if (remaining > 0)
         {
-        case 1:
-          ((p1_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL);
-          break;
-
-        case 2:
-          ((p2_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL,
-                                       processor->regions[1] ? &tr[1] : NULL);
-          break;
-
-        case 3:
-          ((p3_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL,
-                                       processor->regions[1] ? &tr[1] : NULL,
-                                       processor->regions[2] ? &tr[2] : NULL);
-          break;
-
-        case 4:
-          ((p4_func) processor->func) (processor->data,
-                                       processor->regions[0] ? &tr[0] : NULL,
-                                       processor->regions[1] ? &tr[1] : NULL,
-                                       processor->regions[2] ? &tr[2] : NULL,
-                                       processor->regions[3] ? &tr[3] : NULL);
-          break;
-
-        default:
-          g_warning ("do_parallel_regions: Bad number of regions %d\n",
-                     processor->num_regions);
-          break;
+          head = victim->head + remaining / 2;
+          tail = victim->tail;
+
+          victim->tail = head;
         }
 
-      g_mutex_lock (processor->mutex);
+      g_static_mutex_unlock (&victim->mutex);
+
+      if (remaining > 0)
+        {
+          g_static_mutex_lock (&queue->mutex);
 
-      for (i = 0; i < processor->num_regions; i++)
-        if (processor->regions[i])
-          {
-            if (tr[i].tiles)
-              tile_release (tr[i].curtile, tr[i].dirty);
-          }
+          queue->head = head + 1;
+          queue->tail = tail;
 
-      processor->progress += pixels;
+          g_static_mutex_unlock (&queue->mutex);
 
-      if (processor->PRI)
-        processor->PRI = pixel_regions_process (processor->PRI);
+          return head;
+        }
     }
+}
 
-  processor->threads--;
+static void
+do_parallel_chunk (PixelProcessor      *processor,
+                   PixelProcessorQueue *queue,
+                   gint                 chunk)
+{
+  PixelRegion          tr[4];
+  PixelRegion         *regions[4] = { NULL, NULL, NULL, NULL };
+  PixelRegionIterator *PRI;
+  gint                 x, y, w, h;
+  gint                 i;
+
+  pixel_processor_chunk_rect (processor, chunk, &x, &y, &w, &h);
+
+  if (w == 0 || h == 0)
+    return;
+
+  /*  the workers iterate over private copies of the regions, the
+   *  caller's regions are left untouched
+   */
+  for (i = 0; i < processor->num_regions; i++)
+    if (processor->regions[i])
+      {
+        tr[i] = *processor->regions[i];
 
-  if (processor->threads == 0)
+        pixel_region_resize (&tr[i], tr[i].x + x, tr[i].y + y, w, h);
+
+        regions[i] = &tr[i];
+      }
+
+  for (PRI = pixel_regions_register (processor->num_regions,
+                                     regions[0], regions[1],
+                                     regions[2], regions[3]);
+       PRI;
+       PRI = pixel_regions_process (PRI))
     {
-      g_mutex_unlock (processor->mutex);
+      pixel_processor_call (processor, regions);
 
-      g_mutex_lock (pool_mutex);
-      g_cond_signal  (pool_cond);
-      g_mutex_unlock (pool_mutex);
+      queue->progress += PRI->portion_width * PRI->portion_height;
     }
-  else
+}
+
+static void
+do_parallel_regions (PixelProcessor *processor)
+{
+  PixelProcessorQueue *queue;
+  gint                 chunk;
+  gint                 i;
+
+  g_static_private_set (&pool_thread, GINT_TO_POINTER (TRUE), NULL);
+
+  i = g_atomic_int_exchange_and_add (&processor->next_queue, 1);
+
+  queue = &processor->queues[i];
+
+  while ((chunk = pixel_processor_queue_pop (queue)) != -1 ||
+         (chunk = pixel_processor_steal (processor, queue)) != -1)
     {
-      g_mutex_unlock (processor->mutex);
+      do_parallel_chunk (processor, queue, chunk);
+    }
+
+  if (g_atomic_int_dec_and_test (&processor->threads))
+    {
+      g_mutex_lock (pool_mutex);
+      g_cond_signal (pool_cond);
+      g_mutex_unlock (pool_mutex);
     }
 }
 #endif
 
-/*  do_parallel_regions_single is just like do_parallel_regions
- *   except that all the mutex and tile locks have been removed
+/*  do_parallel_regions_single iterates over the whole region in the
+ *   calling thread, using the caller's pixel regions directly.
  *
- * If we are processing with only a single thread we don't need to do
- * the mutex locks etc. and aditional tile locks even if we were
- * configured --with-mp
+ * It is used if we are processing with only a single thread, if the
+ * region is too small to be split or when called from one of the
+ * threads of the pool, even if we were configured --with-mp
  */
 
 static gpointer
@@ -199,39 +391,7 @@ do_parallel_regions_single (PixelProcessor             *processor,
 
   do
     {
-      switch (processor->num_regions)
-        {
-        case 1:
-          ((p1_func) processor->func) (processor->data,
-                                       processor->regions[0]);
-          break;
-
-        case 2:
-          ((p2_func) processor->func) (processor->data,
-                                       processor->regions[0],
-                                       processor->regions[1]);
-          break;
-
-        case 3:
-          ((p3_func) processor->func) (processor->data,
-                                       processor->regions[0],
-                                       processor->regions[1],
-                                       processor->regions[2]);
-          break;
-
-        case 4:
-          ((p4_func) processor->func) (processor->data,
-                                       processor->regions[0],
-                                       processor->regions[1],
-                                       processor->regions[2],
-                                       processor->regions[3]);
-          break;
-
-        default:
-          g_warning ("do_parallel_regions_single: Bad number of regions %d\n",
-                     processor->num_regions);
-          break;
-        }
+      pixel_processor_call (processor, processor->regions);
 
       if (progress_func)
         {
@@ -258,85 +418,113 @@ do_parallel_regions_single (PixelProcessor             *processor,
   return NULL;
 }
 
+#ifdef ENABLE_MP
+static gulong
+pixel_processor_get_progress (PixelProcessor *processor)
+{
+  gulong progress = 0;
+  gint   i;
+
+  for (i = 0; i < processor->n_queues; i++)
+    progress += processor->queues[i].progress;
+
+  return progress;
+}
+
 static void
 pixel_regions_do_parallel (PixelProcessor             *processor,
                            PixelProcessorProgressFunc  progress_func,
                            gpointer                    progress_data)
 {
-  gulong pixels = (processor->PRI->region_width *
-                   processor->PRI->region_height);
-  gulong tiles  = pixels / (TILE_WIDTH * TILE_HEIGHT);
+  GError *error = NULL;
+  gulong  pixels;
+  gint    tasks;
+  gint    i;
 
-#ifdef ENABLE_MP
-  if (pool && tiles > TILES_PER_THREAD)
+  pixels = (gulong) processor->width * (gulong) processor->height;
+  tasks  = MIN (processor->n_chunks, g_thread_pool_get_max_threads (pool));
+  tasks  = MIN (tasks, GIMP_MAX_NUM_THREADS);
+
+  /*  give each worker an equal, contiguous share of the chunks  */
+  for (i = 0; i < tasks; i++)
     {
-      GError *error = NULL;
-      gint    tasks = MIN (tiles / TILES_PER_THREAD,
-                           g_thread_pool_get_max_threads (pool));
+      PixelProcessorQueue *queue = &processor->queues[i];
 
-      /*
-       * g_printerr ("pushing %d tasks into the thread pool (for %lu tiles)\n",
-       *             tasks, tiles);
-       */
+      g_static_mutex_init (&queue->mutex);
 
-      processor->first   = TRUE;
-      processor->threads = tasks;
-      processor->mutex   = g_mutex_new();
+      queue->head     = processor->n_chunks * i / tasks;
+      queue->tail     = processor->n_chunks * (i + 1) / tasks;
+      queue->progress = 0;
+    }
 
-      g_mutex_lock (pool_mutex);
+  processor->n_queues   = tasks;
+  processor->next_queue = 0;
+  processor->threads    = tasks;
 
-      while (tasks--)
-        {
-          g_thread_pool_push (pool, processor, &error);
+  /*
+   * g_printerr ("pushing %d tasks into the thread pool (for %d chunks)\n",
+   *             tasks, processor->n_chunks);
+   */
 
-          if (G_UNLIKELY (error))
-            {
-              g_warning ("thread creation failed: %s", error->message);
-              g_clear_error (&error);
-              processor->threads--;
-            }
-        }
+  g_mutex_lock (pool_mutex);
 
-      if (progress_func)
+  for (i = 0; i < tasks; i++)
+    {
+      g_thread_pool_push (pool, processor, &error);
+
+      if (G_UNLIKELY (error))
         {
-          while (processor->threads != 0)
-            {
-              GTimeVal timeout;
-              gulong   progress;
+          g_warning ("thread creation failed: %s", error->message);
+          g_clear_error (&error);
+
+          /*  the chunks of the missing worker get stolen  */
+          g_atomic_int_add (&processor->threads, -1);
+        }
+    }
 
-              g_get_current_time (&timeout);
-              g_time_val_add (&timeout, PROGRESS_TIMEOUT * 1024);
+  /*  if no worker could be started, do the work here  */
+  if (g_atomic_int_get (&processor->threads) == 0)
+    {
+      processor->threads = 1;
 
-              g_cond_timed_wait (pool_cond, pool_mutex, &timeout);
+      g_mutex_unlock (pool_mutex);
+      do_parallel_regions (processor);
+      g_mutex_lock (pool_mutex);
 
-              g_mutex_lock (processor->mutex);
-              progress = processor->progress;
-              g_mutex_unlock (processor->mutex);
+      g_static_private_set (&pool_thread, NULL, NULL);
+    }
 
-              progress_func (progress_data,
-                             (gdouble) progress / (gdouble) pixels);
-            }
-        }
-      else
+  if (progress_func)
+    {
+      while (g_atomic_int_get (&processor->threads) != 0)
         {
-          while (processor->threads != 0)
-            g_cond_wait (pool_cond, pool_mutex);
-        }
+          GTimeVal timeout;
 
-      g_mutex_unlock (pool_mutex);
+          g_get_current_time (&timeout);
+          g_time_val_add (&timeout, PROGRESS_TIMEOUT * 1024);
+
+          g_cond_timed_wait (pool_cond, pool_mutex, &timeout);
 
-      g_mutex_free (processor->mutex);
+          progress_func (progress_data,
+                         (gdouble) pixel_processor_get_progress (processor) /
+                         (gdouble) pixels);
+        }
     }
   else
-#endif
     {
-      do_parallel_regions_single (processor,
-                                  progress_func, progress_data, pixels);
+      while (g_atomic_int_get (&processor->threads) != 0)
+        g_cond_wait (pool_cond, pool_mutex);
     }
 
+  g_mutex_unlock (pool_mutex);
+
+  for (i = 0; i < tasks; i++)
+    g_static_mutex_free (&processor->queues[i].mutex);
+
   if (progress_func)
     progress_func (progress_data, 1.0);
 }
+#endif
 
 static void
 pixel_regions_process_parallel_valist (PixelProcessorFunc         func,
@@ -347,11 +535,30 @@ pixel_regions_process_parallel_valist (PixelProcessorFunc         func,
                                        va_list                    ap)
 {
   PixelProcessor  processor = { NULL, };
+  gulong          pixels;
   gint            i;
 
   for (i = 0; i < num_regions; i++)
     processor.regions[i] = va_arg (ap, PixelRegion *);
 
+  processor.func        = func;
+  processor.data        = data;
+  processor.num_regions = num_regions;
+  processor.progress    = 0;
+
+#ifdef ENABLE_MP
+  /*  Don't go parallel from within one of the pool's threads, all of
+   *  them might be waiting for each other then.
+   */
+  if (pool && num_regions >= 1 && num_regions <= 4 &&
+      ! g_static_private_get (&pool_thread) &&
+      pixel_processor_split (&processor))
+    {
+      pixel_regions_do_parallel (&processor, progress_func, progress_data);
+      return;
+    }
+#endif
+
   switch (num_regions)
     {
     case 1:
@@ -389,17 +596,13 @@ pixel_regions_process_parallel_valist (PixelProcessorFunc         func,
   if (! processor.PRI)
     return;
 
-  processor.func        = func;
-  processor.data        = data;
-  processor.num_regions = num_regions;
+  pixels = (processor.PRI->region_width * processor.PRI->region_height);
 
-#ifdef ENABLE_MP
-  processor.threads     = 0;
-#endif
+  do_parallel_regions_single (&processor,
+                              progress_func, progress_data, pixels);
 
-  processor.progress    = 0;
-
-  pixel_regions_do_parallel (&processor, progress_func, progress_data);
+  if (progress_func)
+    progress_func (progress_data, 1.0);
 }
 
 void
@@ -28,6 +28,7 @@
 #include "pixel-region.h"
 #include "temp-buf.h"
 #include "tile-manager.h"
+#include "tile-swap.h"
 #include "tile.h"
 
 
@@ -37,6 +38,8 @@
 static gint                  get_portion_width       (PixelRegionIterator *PRI);
 static gint                  get_portion_height      (PixelRegionIterator *PRI);
 static PixelRegionIterator * pixel_regions_configure (PixelRegionIterator *PRI);
+static void                  pixel_region_prefetch   (PixelRegionHolder   *PRH,
+                                                      PixelRegionIterator *PRI);
 static void                  pixel_region_configure  (PixelRegionHolder   *PRH,
                                                       PixelRegionIterator *PRI);
 
@@ -267,6 +270,30 @@ pixel_region_has_alpha (PixelRegion *PR)
     return FALSE;
 }
 
+/*  Returns TRUE if the portion of @PR being processed is a whole tile
+ *  that is locked for writing, so that it may be marked uniform.
+ */
+gboolean
+pixel_region_covers_tile (PixelRegion *PR)
+{
+  return (PR->tiles && PR->curtile && PR->dirty &&
+          PR->offx == 0 && PR->offy == 0 &&
+          PR->w == tile_ewidth (PR->curtile) &&
+          PR->h == tile_eheight (PR->curtile));
+}
+
+/*  Returns TRUE if all pixels of the portion of @PR being processed
+ *  have the same value, because it lies in a uniform tile, and stores
+ *  that value in @pixel. Loops over pixel regions may use this to skip
+ *  reading the data.
+ */
+gboolean
+pixel_region_is_uniform (PixelRegion *PR,
+                         guchar      *pixel)
+{
+  return (PR->tiles && PR->curtile && tile_is_uniform (PR->curtile, pixel));
+}
+
 PixelRegionIterator *
 pixel_regions_register (gint num_regions,
                         ...)
@@ -550,6 +577,9 @@ pixel_region_configure (PixelRegionHolder   *PRH,
    */
   if (PRH->PR->tiles)
     {
+      if (PRH->PR->x == PRH->startx)
+        pixel_region_prefetch (PRH, PRI);
+
       PRH->PR->curtile = tile_manager_get_tile (PRH->PR->tiles,
                                                 PRH->PR->x,
                                                 PRH->PR->y,
@@ -574,3 +604,26 @@ pixel_region_configure (PixelRegionHolder   *PRH,
   PRH->PR->w = PRI->portion_width;
   PRH->PR->h = PRI->portion_height;
 }
+
+/*  At the start of each row of tiles, ask for the swapped out tiles of
+ *  that row to be read from disk while the first ones are processed.
+ */
+static void
+pixel_region_prefetch (PixelRegionHolder   *PRH,
+                       PixelRegionIterator *PRI)
+{
+  TileManager *tm  = PRH->PR->tiles;
+  gint         end = MIN (PRH->startx + PRI->region_width,
+                          tile_manager_width (tm));
+  gint         x;
+
+  for (x = PRH->PR->x + TILE_WIDTH - (PRH->PR->x % TILE_WIDTH);
+       x < end;
+       x += TILE_WIDTH)
+    {
+      Tile *tile = tile_manager_get_tile (tm, x, PRH->PR->y, FALSE, FALSE);
+
+      if (tile)
+        tile_swap_prefetch (tile);
+    }
+}
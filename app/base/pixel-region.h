@@ -109,6 +109,9 @@ void     pixel_region_set_col       (PixelRegion         *PR,
                                      gint                 h,
                                      const guchar        *data);
 gboolean pixel_region_has_alpha     (PixelRegion         *PR);
+gboolean pixel_region_covers_tile   (PixelRegion         *PR);
+gboolean pixel_region_is_uniform    (PixelRegion         *PR,
+                                     guchar              *pixel);
 
 PixelRegionIterator * pixel_regions_register     (gint    num_regions,
                                                   ...);
@@ -31,41 +31,109 @@
 
 #define IDLE_SWAPPER_TIMEOUT  250
 
-
-static gboolean  tile_cache_zorch_next     (void);
-static void      tile_cache_flush_internal (Tile     *tile);
-
-static gboolean  tile_idle_preswap         (gpointer  data);
+/*  The cache is split into shards so that threads working on different
+ *  tiles don't serialize on a single lock. A tile always goes to the
+ *  same shard (chosen by hashing its address), each shard keeps its own
+ *  LRU ordered clean and dirty lists, and the global size is accounted
+ *  with atomic operations. Eviction sweeps over the shards like a clock
+ *  hand, preferring clean tiles over dirty ones.
+ *
+ *  The number of shards must be a power of two.
+ */
+#define N_SHARDS  16
 
 
-static gboolean initialize = TRUE;
+typedef struct _TileList  TileList;
+typedef struct _TileShard TileShard;
 
-typedef struct _TileList
+struct _TileList
 {
   Tile *first;
   Tile *last;
-} TileList;
+};
+
+struct _TileShard
+{
+#ifdef ENABLE_MP
+  GStaticMutex  mutex;
+#endif
+
+  TileList      clean_list;
+  TileList      dirty_list;
+
+  gulong        cur_size;    /*  bytes held by this shard          */
+  gulong        cur_dirty;   /*  bytes on the dirty list           */
+
+  gulong        hits;        /*  tile locked while in the cache    */
+  gulong        misses;      /*  tile locked after being swapped   */
+  gulong        contended;   /*  lock acquisitions that had to wait */
+};
+
+
+static gboolean    tile_cache_zorch_next     (void);
+static gboolean    tile_cache_zorch_shard    (TileShard *shard,
+                                              gboolean   dirty);
+static Tile      * tile_cache_unlink_shard   (TileShard *shard,
+                                              gboolean   dirty);
+static void        tile_cache_flush_internal (TileShard *shard,
+                                              Tile      *tile);
+
+static void        tile_cache_size_add       (volatile gpointer *counter,
+                                              gssize             delta);
+static gboolean    tile_cache_size_reserve   (gint               size);
+
+static gboolean    tile_idle_preswap         (gpointer           data);
+
+
+static gboolean initialize = TRUE;
+
+static const gulong      max_tile_size   = TILE_WIDTH * TILE_HEIGHT * 4;
+static gulong            max_cache_size  = 0;
+static TileShard         shards[N_SHARDS];
+static guint             idle_swapper    = 0;
+
+/*  these hold gulong values but are accessed as pointers, because
+ *  pointer sized values are what the atomic operations in GLib offer
+ */
+static volatile gpointer cur_cache_size  = NULL;
+static volatile gpointer cur_cache_dirty = NULL;
+
+/*  the shards where the next eviction sweep and preswap start  */
+static volatile gint     zorch_hand      = 0;
+static gint              preswap_hand    = 0;
+
+#define CACHE_SIZE        GPOINTER_TO_SIZE (g_atomic_pointer_get (&cur_cache_size))
+#define CACHE_DIRTY       GPOINTER_TO_SIZE (g_atomic_pointer_get (&cur_cache_dirty))
 
-static const gulong  max_tile_size   = TILE_WIDTH * TILE_HEIGHT * 4;
-static gulong        cur_cache_size  = 0;
-static gulong        max_cache_size  = 0;
-static gulong        cur_cache_dirty = 0;
-static TileList      clean_list      = { NULL, NULL };
-static TileList      dirty_list      = { NULL, NULL };
-static guint         idle_swapper    = 0;
+#define TILE_SHARD(tile)  (&shards[((GPOINTER_TO_SIZE (tile) >> 6) ^      \
+                                    (GPOINTER_TO_SIZE (tile) >> 12)) &    \
+                                   (N_SHARDS - 1)])
 
 
 #ifdef ENABLE_MP
 
-static GStaticMutex   tile_cache_mutex = G_STATIC_MUTEX_INIT;
+#define SHARD_LOCK(shard)                                          \
+  G_STMT_START {                                                   \
+    if (! g_static_mutex_trylock (&(shard)->mutex))                \
+      {                                                            \
+        g_static_mutex_lock (&(shard)->mutex);                     \
+        (shard)->contended++;                                      \
+      }                                                            \
+  } G_STMT_END
+#define SHARD_UNLOCK(shard)  g_static_mutex_unlock (&(shard)->mutex)
 
-#define CACHE_LOCK    g_static_mutex_lock (&tile_cache_mutex)
-#define CACHE_UNLOCK  g_static_mutex_unlock (&tile_cache_mutex)
+static GStaticMutex idle_swapper_mutex = G_STATIC_MUTEX_INIT;
+
+#define IDLE_SWAPPER_LOCK()   g_static_mutex_lock (&idle_swapper_mutex)
+#define IDLE_SWAPPER_UNLOCK() g_static_mutex_unlock (&idle_swapper_mutex)
 
 #else
 
-#define CACHE_LOCK   /* nothing */
-#define CACHE_UNLOCK /* nothing */
+#define SHARD_LOCK(shard)     /* nothing */
+#define SHARD_UNLOCK(shard)   /* nothing */
+
+#define IDLE_SWAPPER_LOCK()   /* nothing */
+#define IDLE_SWAPPER_UNLOCK() /* nothing */
 
 #endif
 
@@ -75,10 +143,27 @@ tile_cache_init (gulong tile_cache_size)
 {
   if (initialize)
     {
+      gint i;
+
       initialize = FALSE;
 
-      clean_list.first = clean_list.last = NULL;
-      dirty_list.first = dirty_list.last = NULL;
+      for (i = 0; i < N_SHARDS; i++)
+        {
+          TileShard *shard = &shards[i];
+
+#ifdef ENABLE_MP
+          g_static_mutex_init (&shard->mutex);
+#endif
+
+          shard->clean_list.first = shard->clean_list.last = NULL;
+          shard->dirty_list.first = shard->dirty_list.last = NULL;
+
+          shard->cur_size  = 0;
+          shard->cur_dirty = 0;
+          shard->hits      = 0;
+          shard->misses    = 0;
+          shard->contended = 0;
+        }
 
       max_cache_size = tile_cache_size;
     }
@@ -87,14 +172,18 @@ tile_cache_init (gulong tile_cache_size)
 void
 tile_cache_exit (void)
 {
+  IDLE_SWAPPER_LOCK ();
+
   if (idle_swapper)
     {
       g_source_remove (idle_swapper);
       idle_swapper = 0;
     }
 
-  if (cur_cache_size > 0)
-    g_warning ("tile cache not empty (%ld bytes left)", cur_cache_size);
+  IDLE_SWAPPER_UNLOCK ();
+
+  if (CACHE_SIZE > 0)
+    g_warning ("tile cache not empty (%ld bytes left)", (glong) CACHE_SIZE);
 
   tile_cache_set_size (0);
 }
@@ -102,13 +191,15 @@ tile_cache_exit (void)
 void
 tile_cache_insert (Tile *tile)
 {
-  TileList *list;
-  TileList *newlist;
-
-  CACHE_LOCK;
+  TileShard *shard = TILE_SHARD (tile);
+  TileList  *list;
+  TileList  *newlist;
+  gboolean   reserved = FALSE;
 
   if (! tile->data)
-    goto out;
+    return;
+
+  SHARD_LOCK (shard);
 
   /* First check and see if the tile is already
    *  in the cache. In that case we will simply place
@@ -116,10 +207,36 @@ tile_cache_insert (Tile *tile)
    *  it was the most recently accessed tile.
    */
 
+  while (! tile->listhead && ! reserved)
+    {
+      /* The tile was not in the cache. First check and see
+       *  if there is room in the cache. If not then we'll have
+       *  to make room first. Note: it might be the case that the
+       *  cache is smaller than the size of a tile in which case
+       *  it won't be possible to put it in the cache.
+       *
+       * Making room may need to lock other shards (and this one),
+       *  so do it without holding our own lock and check again
+       *  afterwards.
+       */
+      SHARD_UNLOCK (shard);
+
+      if (! tile_cache_size_reserve (tile->size))
+        {
+          g_warning ("cache: unable to find room for a tile");
+          return;
+        }
+
+      reserved = TRUE;
+
+      SHARD_LOCK (shard);
+    }
+
   list = tile->listhead;
 
-  newlist = ((tile->dirty || tile->swap_offset == -1) ?
-             &dirty_list : &clean_list);
+  /*  uniform tiles are dropped as cheaply as clean ones  */
+  newlist = ((! tile->uniform && (tile->dirty || ! TILE_IS_SWAPPED (tile))) ?
+             &shard->dirty_list : &shard->clean_list);
 
   /* if list is NULL, the tile is not in the cache */
 
@@ -140,27 +257,19 @@ tile_cache_insert (Tile *tile)
 
       tile->listhead = NULL;
 
-      if (list == &dirty_list)
-        cur_cache_dirty -= tile->size;
-    }
-  else
-    {
-      /* The tile was not in the cache. First check and see
-       *  if there is room in the cache. If not then we'll have
-       *  to make room first. Note: it might be the case that the
-       *  cache is smaller than the size of a tile in which case
-       *  it won't be possible to put it in the cache.
-       */
-      while ((cur_cache_size + max_tile_size) > max_cache_size)
+      if (list == &shard->dirty_list)
         {
-          if (! tile_cache_zorch_next ())
-            {
-              g_warning ("cache: unable to find room for a tile");
-              goto out;
-            }
+          shard->cur_dirty -= tile->size;
+          tile_cache_size_add (&cur_cache_dirty, - tile->size);
         }
 
-      cur_cache_size += tile->size;
+      /*  somebody else put it into the cache while we made room  */
+      if (reserved)
+        tile_cache_size_add (&cur_cache_size, - tile->size);
+    }
+  else
+    {
+      shard->cur_size += tile->size;
     }
 
   /* Put the tile at the end of the proper list */
@@ -176,52 +285,115 @@ tile_cache_insert (Tile *tile)
 
   newlist->last = tile;
 
-  if (tile->dirty || (tile->swap_offset == -1))
+  if (newlist == &shard->dirty_list)
     {
-      cur_cache_dirty += tile->size;
+      shard->cur_dirty += tile->size;
+      tile_cache_size_add (&cur_cache_dirty, tile->size);
+    }
 
-      if (! idle_swapper &&
-          cur_cache_dirty * 2 > max_cache_size)
-        {
-          idle_swapper = g_timeout_add_full (G_PRIORITY_LOW,
-                                             IDLE_SWAPPER_TIMEOUT,
-                                             tile_idle_preswap,
-                                             NULL, NULL);
-        }
+  SHARD_UNLOCK (shard);
+
+  if (! idle_swapper &&
+      CACHE_DIRTY * 2 > max_cache_size)
+    {
+      /*  check again with the lock held, so that threads inserting
+       *  tiles at the same time don't install more than one swapper
+       */
+      IDLE_SWAPPER_LOCK ();
+
+      if (! idle_swapper)
+        idle_swapper = g_timeout_add_full (G_PRIORITY_LOW,
+                                           IDLE_SWAPPER_TIMEOUT,
+                                           tile_idle_preswap,
+                                           NULL, NULL);
+
+      IDLE_SWAPPER_UNLOCK ();
+    }
+}
+
+void
+tile_cache_lookup (Tile *tile)
+{
+  TileShard *shard = TILE_SHARD (tile);
+
+  SHARD_LOCK (shard);
+
+  if (tile->listhead)
+    {
+      shard->hits++;
+
+      /* remove from cache, move to main store */
+      tile_cache_flush_internal (shard, tile);
+    }
+  else if (! tile->data && TILE_IS_SWAPPED (tile))
+    {
+      shard->misses++;
     }
 
-out:
-  CACHE_UNLOCK;
+  SHARD_UNLOCK (shard);
 }
 
 void
 tile_cache_flush (Tile *tile)
 {
-  CACHE_LOCK;
+  TileShard *shard = TILE_SHARD (tile);
+
+  SHARD_LOCK (shard);
 
-  tile_cache_flush_internal (tile);
+  tile_cache_flush_internal (shard, tile);
 
-  CACHE_UNLOCK;
+  SHARD_UNLOCK (shard);
 }
 
 void
 tile_cache_set_size (gulong cache_size)
 {
-  CACHE_LOCK;
-
   max_cache_size = cache_size;
 
-  while (cur_cache_size > max_cache_size)
+  while (CACHE_SIZE > max_cache_size)
     {
       if (! tile_cache_zorch_next ())
         break;
     }
+}
+
+void
+tile_cache_dump_stats (void)
+{
+  gulong hits      = 0;
+  gulong misses    = 0;
+  gulong contended = 0;
+  gint   i;
+
+  g_print ("tile cache: %lu of %lu bytes used, %lu bytes dirty\n",
+           (gulong) CACHE_SIZE, max_cache_size, (gulong) CACHE_DIRTY);
+
+  for (i = 0; i < N_SHARDS; i++)
+    {
+      TileShard *shard = &shards[i];
+
+      SHARD_LOCK (shard);
 
-  CACHE_UNLOCK;
+      g_print ("  shard %2d: %9lu bytes (%9lu dirty)  "
+               "%9lu hits  %9lu misses  %9lu contended\n",
+               i, shard->cur_size, shard->cur_dirty,
+               shard->hits, shard->misses, shard->contended);
+
+      hits      += shard->hits;
+      misses    += shard->misses;
+      contended += shard->contended;
+
+      SHARD_UNLOCK (shard);
+    }
+
+  g_print ("  total   :                                "
+           "%9lu hits  %9lu misses  %9lu contended\n",
+           hits, misses, contended);
 }
 
 static void
-tile_cache_flush_internal (Tile *tile)
+tile_cache_flush_internal (TileShard *shard,
+                           Tile      *tile)
 {
   TileList *list = tile->listhead;
 
@@ -230,10 +402,14 @@ tile_cache_flush_internal (Tile *tile)
 
   if (list)
     {
-      cur_cache_size -= tile->size;
+      shard->cur_size -= tile->size;
+      tile_cache_size_add (&cur_cache_size, - tile->size);
 
-      if (list == &dirty_list)
-        cur_cache_dirty -= tile->size;
+      if (list == &shard->dirty_list)
+        {
+          shard->cur_dirty -= tile->size;
+          tile_cache_size_add (&cur_cache_dirty, - tile->size);
+        }
 
       if (tile->next)
         tile->next->prev = tile->prev;
@@ -249,75 +425,180 @@ tile_cache_flush_internal (Tile *tile)
     }
 }
 
+static void
+tile_cache_size_add (volatile gpointer *counter,
+                     gssize             delta)
+{
+  gpointer old_value;
+  gpointer new_value;
+
+  do
+    {
+      old_value = g_atomic_pointer_get (counter);
+      new_value = GSIZE_TO_POINTER (GPOINTER_TO_SIZE (old_value) + delta);
+    }
+  while (! g_atomic_pointer_compare_and_exchange (counter,
+                                                  old_value, new_value));
+}
+
+/*  Accounts for a tile of @size bytes that is about to enter the
+ *  cache, evicting other tiles until there is room for it.
+ */
 static gboolean
-tile_cache_zorch_next (void)
+tile_cache_size_reserve (gint size)
 {
-  Tile *tile;
+  while (TRUE)
+    {
+      gpointer old_value = g_atomic_pointer_get (&cur_cache_size);
+      gsize    old_size  = GPOINTER_TO_SIZE (old_value);
+      gpointer new_value = GSIZE_TO_POINTER (old_size + size);
 
-  if (clean_list.first)
-    tile = clean_list.first;
-  else if (dirty_list.first)
-    tile = dirty_list.first;
-  else
-    return FALSE;
+      if (old_size + max_tile_size <= max_cache_size)
+        {
+          if (g_atomic_pointer_compare_and_exchange (&cur_cache_size,
+                                                     old_value, new_value))
+            return TRUE;
+        }
+      else if (! tile_cache_zorch_next ())
+        {
+          return FALSE;
+        }
+    }
+}
 
-  tile_cache_flush_internal (tile);
+static gboolean
+tile_cache_zorch_next (void)
+{
+  gint pass;
+  gint i;
 
-  if (tile->dirty || tile->swap_offset == -1)
+  /*  sweep over all shards looking for a clean tile first, only
+   *  start swapping out dirty tiles if there is none
+   */
+  for (pass = 0; pass < 2; pass++)
     {
-      tile_swap_out (tile);
+      gint start = g_atomic_int_exchange_and_add (&zorch_hand, 1);
+
+      for (i = 0; i < N_SHARDS; i++)
+        {
+          TileShard *shard = &shards[(start + i) & (N_SHARDS - 1)];
+
+          if (tile_cache_zorch_shard (shard, pass == 1))
+            return TRUE;
+        }
     }
 
-  if (! tile->dirty)
+  return FALSE;
+}
+
+/*  Takes the least recently used tile that nobody else is working on
+ *  off the clean or dirty list of @shard and returns it with its tile
+ *  mutex held, or returns NULL. The tile mutexes are only tried here,
+ *  because our caller may already hold one of them and the usual lock
+ *  order is tile before shard.
+ */
+static Tile *
+tile_cache_unlink_shard (TileShard *shard,
+                         gboolean   dirty)
+{
+  Tile *tile;
+
+  SHARD_LOCK (shard);
+
+  tile = dirty ? shard->dirty_list.first : shard->clean_list.first;
+
+  while (tile && ! TILE_TRYLOCK (tile))
+    tile = tile->next;
+
+  if (tile)
+    tile_cache_flush_internal (shard, tile);
+
+  SHARD_UNLOCK (shard);
+
+  return tile;
+}
+
+static gboolean
+tile_cache_zorch_shard (TileShard *shard,
+                        gboolean   dirty)
+{
+  Tile     *tile;
+  gboolean  success = FALSE;
+
+  tile = tile_cache_unlink_shard (shard, dirty);
+
+  if (tile)
     {
-      g_free (tile->data);
-      tile->data = NULL;
+      /*  the tile is out of the cache and its mutex keeps it from
+       *  being locked or destroyed, so the swap file is written
+       *  without holding up the other tiles of the shard
+       */
+      if (tile_free_uniform (tile))
+        {
+          success = TRUE;
+        }
+      else if (tile->dirty || ! TILE_IS_SWAPPED (tile))
+        {
+          tile_swap_out (tile);
+        }
 
-      return TRUE;
+      if (tile->data && ! tile->dirty)
+        {
+          g_free (tile->data);
+          tile->data = NULL;
+
+          success = TRUE;
+        }
+
+      /* else unable to swap out tile for some reason */
+
+      TILE_UNLOCK (tile);
     }
 
-  /* unable to swap out tile for some reason */
-  return FALSE;
+  return success;
 }
 
 static gboolean
 tile_idle_preswap (gpointer data)
 {
-  Tile *tile;
+  gint i;
+
+  IDLE_SWAPPER_LOCK ();
 
-  if (cur_cache_dirty * 2 < max_cache_size)
+  if (CACHE_DIRTY * 2 < max_cache_size)
     {
       idle_swapper = 0;
+
+      IDLE_SWAPPER_UNLOCK ();
+
       return FALSE;
     }
 
-  CACHE_LOCK;
+  IDLE_SWAPPER_UNLOCK ();
 
-  if ((tile = dirty_list.first))
+  for (i = 0; i < N_SHARDS; i++)
     {
-      tile_swap_out (tile);
+      TileShard *shard = &shards[preswap_hand];
+      Tile      *tile;
 
-      dirty_list.first = tile->next;
+      preswap_hand = (preswap_hand + 1) & (N_SHARDS - 1);
 
-      if (tile->next)
-        tile->next->prev = NULL;
-      else
-        dirty_list.last = NULL;
+      if ((tile = tile_cache_unlink_shard (shard, TRUE)))
+        {
+          /*  a uniform tile needn't be written at all  */
+          if (! tile_free_uniform (tile))
+            {
+              tile_swap_out (tile);
 
-      tile->next = NULL;
-      tile->prev = clean_list.last;
-      tile->listhead = &clean_list;
+              /*  put it back, on the clean list unless the swap failed  */
+              tile_cache_insert (tile);
+            }
 
-      if (clean_list.last)
-        clean_list.last->next = tile;
-      else
-        clean_list.first = tile;
+          TILE_UNLOCK (tile);
 
-      clean_list.last = tile;
-      cur_cache_dirty -= tile->size;
+          break;
+        }
     }
 
-  CACHE_UNLOCK;
-
   return TRUE;
 }
@@ -20,13 +20,16 @@
 #define __TILE_CACHE_H__
 
 
-void   tile_cache_init     (gulong  cache_size);
-void   tile_cache_exit     (void);
+void   tile_cache_init       (gulong  cache_size);
+void   tile_cache_exit       (void);
 
-void   tile_cache_set_size (gulong  cache_size);
+void   tile_cache_set_size   (gulong  cache_size);
 
-void   tile_cache_insert   (Tile   *tile);
-void   tile_cache_flush    (Tile   *tile);
+void   tile_cache_insert     (Tile   *tile);
+void   tile_cache_lookup     (Tile   *tile);
+void   tile_cache_flush      (Tile   *tile);
+
+void   tile_cache_dump_stats (void);
 
 
 #endif /* __TILE_CACHE_H__ */
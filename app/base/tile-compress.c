@@ -0,0 +1,221 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*  A run-length encoding of tile data, fast enough to be used when
+ *  tiles are swapped out. Like the RLE used in XCF files, every channel
+ *  is encoded separately, so that flat colours, masks and transparent
+ *  areas turn into a few runs each.
+ *
+ *  Each packet starts with a byte n:
+ *
+ *    0 ... 126  a run of n + 1 copies of the byte that follows
+ *    127        a run, with its length in the next two bytes
+ *    128        literal bytes, with their count in the next two bytes
+ *    129 ... 255  256 - n literal bytes
+ *
+ *  Lengths are stored most significant byte first.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "base-types.h"
+
+#include "tile-compress.h"
+
+
+#define EMIT(b)  G_STMT_START { \
+                   if (d == dest_end) \
+                     return -1; \
+                   *d++ = (b); \
+                 } G_STMT_END
+
+
+/*  Encodes @size bytes of tile data with @bpp bytes per pixel from
+ *  @src into @dest. Returns the length of the encoded data, or -1 if
+ *  it doesn't fit into @dest_size bytes.
+ */
+gint
+tile_compress (const guchar *src,
+               gint          size,
+               gint          bpp,
+               guchar       *dest,
+               gint          dest_size)
+{
+  guchar *d        = dest;
+  guchar *dest_end = dest + dest_size;
+  gint    n_pixels = size / bpp;
+  gint    b;
+
+  for (b = 0; b < bpp; b++)
+    {
+      const guchar *s   = src + b;
+      const guchar *end = src + n_pixels * bpp + b;
+
+      while (s < end)
+        {
+          const guchar *t = s + bpp;
+          gint          length;
+
+          while (t < end && *t == *s && (t - s) / bpp < G_MAXUSHORT)
+            t += bpp;
+
+          length = (t - s) / bpp;
+
+          if (length >= 3)
+            {
+              if (length <= 127)
+                {
+                  EMIT (length - 1);
+                }
+              else
+                {
+                  EMIT (127);
+                  EMIT (length >> 8);
+                  EMIT (length & 0xff);
+                }
+
+              EMIT (*s);
+
+              s = t;
+            }
+          else
+            {
+              /*  collect literal bytes up to the next run of three  */
+              t = s;
+
+              while (t < end && (t - s) / bpp < G_MAXUSHORT)
+                {
+                  if (t + 2 * bpp < end &&
+                      t[0] == t[bpp] && t[0] == t[2 * bpp])
+                    break;
+
+                  t += bpp;
+                }
+
+              length = (t - s) / bpp;
+
+              if (length <= 127)
+                {
+                  EMIT (256 - length);
+                }
+              else
+                {
+                  EMIT (128);
+                  EMIT (length >> 8);
+                  EMIT (length & 0xff);
+                }
+
+              if (dest_end - d < length)
+                return -1;
+
+              while (s < t)
+                {
+                  *d++ = *s;
+                  s += bpp;
+                }
+            }
+        }
+    }
+
+  return d - dest;
+}
+
+/*  Decodes @src_size bytes of data encoded by tile_compress() into
+ *  @size bytes of tile data at @dest. Returns FALSE if the data is
+ *  corrupt.
+ */
+gboolean
+tile_decompress (const guchar *src,
+                 gint          src_size,
+                 gint          bpp,
+                 guchar       *dest,
+                 gint          size)
+{
+  const guchar *s        = src;
+  const guchar *src_end  = src + src_size;
+  gint          n_pixels = size / bpp;
+  gint          b;
+
+  for (b = 0; b < bpp; b++)
+    {
+      guchar *d   = dest + b;
+      guchar *end = dest + n_pixels * bpp + b;
+
+      while (d < end)
+        {
+          gint n;
+          gint length;
+
+          if (s == src_end)
+            return FALSE;
+
+          n = *s++;
+
+          if (n == 127 || n == 128)
+            {
+              if (src_end - s < 2)
+                return FALSE;
+
+              length = (s[0] << 8) | s[1];
+              s += 2;
+            }
+          else if (n < 127)
+            {
+              length = n + 1;
+            }
+          else
+            {
+              length = 256 - n;
+            }
+
+          if (length > (end - d + bpp - 1) / bpp)
+            return FALSE;
+
+          if (n <= 127)
+            {
+              guchar v;
+
+              if (s == src_end)
+                return FALSE;
+
+              v = *s++;
+
+              while (length--)
+                {
+                  *d = v;
+                  d += bpp;
+                }
+            }
+          else
+            {
+              if (src_end - s < length)
+                return FALSE;
+
+              while (length--)
+                {
+                  *d = *s++;
+                  d += bpp;
+                }
+            }
+        }
+    }
+
+  return (s == src_end);
+}
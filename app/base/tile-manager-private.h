@@ -37,9 +37,15 @@ struct _TileManager
   TileValidateProc   validate_proc; /*  this proc is called when an attempt  *
                                      *  to get an invalid tile is made       */
   gpointer           user_data;     /*  data to pass to the validate_proc    */
+  GBoxedCopyFunc     data_ref;      /*  refs user_data for duplicates        */
+  GDestroyNotify     data_unref;    /*  releases user_data                   */
 
   gint               cached_num;    /*  number of cached tile                */
   Tile              *cached_tile;   /*  the actual cached tile               */
+
+#ifdef ENABLE_MP
+  GStaticMutex       mutex;         /*  protects the tiles array             */
+#endif
 };
 
 
@@ -33,6 +33,23 @@
 #include "tile-private.h"
 
 
+#ifdef ENABLE_MP
+
+#define TM_LOCK(tm)    g_static_mutex_lock (&(tm)->mutex)
+#define TM_UNLOCK(tm)  g_static_mutex_unlock (&(tm)->mutex)
+
+#else
+
+#define TM_LOCK(tm)    /* nothing */
+#define TM_UNLOCK(tm)  /* nothing */
+
+#endif
+
+
+static void   tile_manager_allocate_tiles (TileManager *tm);
+static Tile * tile_manager_copy_tile      (Tile        *tile);
+
+
 static inline gint
 tile_manager_get_tile_num (TileManager *tm,
                            gint         xpixel,
@@ -66,9 +83,101 @@ tile_manager_new (gint width,
   tm->ntile_cols  = (width  + TILE_WIDTH  - 1) / TILE_WIDTH;
   tm->cached_num  = -1;
 
+#ifdef ENABLE_MP
+  g_static_mutex_init (&tm->mutex);
+#endif
+
   return tm;
 }
 
+/* Creates a new tile manager with the same contents as @tm. Tiles
+ * are shared between both tile managers, until one of them asks for
+ * write access to a tile.
+ */
+TileManager *
+tile_manager_duplicate (TileManager *tm)
+{
+  TileManager *copy;
+
+  g_return_val_if_fail (tm != NULL, NULL);
+
+  copy = tile_manager_new (tm->width, tm->height, tm->bpp);
+
+  copy->x = tm->x;
+  copy->y = tm->y;
+
+  /*  a validate proc that depends on @tm can't be handed to the copy,
+   *  so validate its tiles now. This locks @tm itself.
+   */
+  if (tm->tiles && tm->validate_proc && tm->user_data && ! tm->data_ref)
+    {
+      gint ntiles = tm->ntile_rows * tm->ntile_cols;
+      gint i;
+
+      for (i = 0; i < ntiles; i++)
+        {
+          if (! tm->tiles[i]->valid)
+            {
+              Tile *tile = tile_manager_get (tm, i, TRUE, FALSE);
+
+              tile_release (tile, FALSE);
+            }
+        }
+    }
+
+  TM_LOCK (tm);
+
+  if (tm->tiles)
+    {
+      gint ntiles = tm->ntile_rows * tm->ntile_cols;
+      gint i;
+
+      copy->tiles = g_new (Tile *, ntiles);
+
+      for (i = 0; i < ntiles; i++)
+        {
+          Tile *tile = tm->tiles[i];
+
+          if (! tile->valid)
+            {
+              /*  don't validate a tile just to share it  */
+              Tile *new = tile_new (tile->bpp);
+
+              new->ewidth  = tile->ewidth;
+              new->eheight = tile->eheight;
+              new->size    = tile->size;
+
+              tile = new;
+            }
+          else if (tile->write_count)
+            {
+              /*  somebody is writing to the tile, take a snapshot  */
+              tile = tile_manager_copy_tile (tile);
+            }
+
+          tile_attach (tile, copy, i);
+          copy->tiles[i] = tile;
+        }
+    }
+
+  /*  the tiles that weren't validated yet are validated in the copy
+   *  too, by procs that need no data, like the one filling new
+   *  channels, or that keep their data alive for duplicates
+   */
+  if (tm->data_ref)
+    tile_manager_set_validate_proc_full (copy,
+                                         tm->validate_proc,
+                                         tm->data_ref (tm->user_data),
+                                         tm->data_ref,
+                                         tm->data_unref);
+  else if (! tm->user_data)
+    tile_manager_set_validate_proc (copy, tm->validate_proc, NULL);
+
+  TM_UNLOCK (tm);
+
+  return copy;
+}
+
 TileManager *
 tile_manager_ref (TileManager *tm)
 {
@@ -102,6 +211,13 @@ tile_manager_unref (TileManager *tm)
           g_free (tm->tiles);
         }
 
+      if (tm->data_unref)
+        tm->data_unref (tm->user_data);
+
+#ifdef ENABLE_MP
+      g_static_mutex_free (&tm->mutex);
+#endif
+
       g_slice_free (TileManager, tm);
     }
 }
@@ -110,11 +226,26 @@ void
 tile_manager_set_validate_proc (TileManager      *tm,
                                 TileValidateProc  proc,
                                 gpointer          user_data)
+{
+  tile_manager_set_validate_proc_full (tm, proc, user_data, NULL, NULL);
+}
+
+void
+tile_manager_set_validate_proc_full (TileManager      *tm,
+                                     TileValidateProc  proc,
+                                     gpointer          user_data,
+                                     GBoxedCopyFunc    user_data_ref,
+                                     GDestroyNotify    user_data_unref)
 {
   g_return_if_fail (tm != NULL);
 
+  if (tm->data_unref)
+    tm->data_unref (tm->user_data);
+
   tm->validate_proc = proc;
   tm->user_data     = user_data;
+  tm->data_ref      = user_data_ref;
+  tm->data_unref    = user_data_unref;
 }
 
 Tile *
@@ -137,13 +268,9 @@ tile_manager_get (TileManager *tm,
                   gboolean     wantread,
                   gboolean     wantwrite)
 {
-  Tile **tiles;
   Tile **tile_ptr;
+  Tile  *tile;
   gint   ntiles;
-  gint   nrows, ncols;
-  gint   right_tile;
-  gint   bottom_tile;
-  gint   i, j, k;
 
   g_return_val_if_fail (tm != NULL, NULL);
 
@@ -152,37 +279,14 @@ tile_manager_get (TileManager *tm,
   if ((tile_num < 0) || (tile_num >= ntiles))
     return NULL;
 
-  if (! tm->tiles)
-    {
-      tm->tiles = g_new (Tile *, ntiles);
-      tiles = tm->tiles;
-
-      nrows = tm->ntile_rows;
-      ncols = tm->ntile_cols;
-
-      right_tile  = tm->width  - ((ncols - 1) * TILE_WIDTH);
-      bottom_tile = tm->height - ((nrows - 1) * TILE_HEIGHT);
-
-      for (i = 0, k = 0; i < nrows; i++)
-        {
-          for (j = 0; j < ncols; j++, k++)
-            {
-              Tile *new = tile_new (tm->bpp);
-
-              tile_attach (new, tm, k);
+  /*  Several threads may get tiles from the same tile manager, the
+   *  lock protects the tiles array while it's being set up and while
+   *  tiles are being copied on write.
+   */
+  TM_LOCK (tm);
 
-              if (j == (ncols - 1))
-                new->ewidth = right_tile;
-
-              if (i == (nrows - 1))
-                new->eheight = bottom_tile;
-
-              new->size = new->ewidth * new->eheight * new->bpp;
-
-              tiles[k] = new;
-            }
-        }
-    }
+  if (! tm->tiles)
+    tile_manager_allocate_tiles (tm);
 
   tile_ptr = &tm->tiles[tile_num];
 
@@ -210,42 +314,13 @@ tile_manager_get (TileManager *tm,
           if ((*tile_ptr)->share_count > 1)
             {
               /* Copy-on-write required */
-              Tile *new = tile_new ((*tile_ptr)->bpp);
-
-              new->ewidth  = (*tile_ptr)->ewidth;
-              new->eheight = (*tile_ptr)->eheight;
-              new->valid   = (*tile_ptr)->valid;
-
-              new->size    = new->ewidth * new->eheight * new->bpp;
-              new->data    = g_new (guchar, new->size);
-
-              if ((*tile_ptr)->rowhint)
-                {
-                  tile_allocate_rowhints (new);
-
-                  memcpy (new->rowhint, (*tile_ptr)->rowhint,
-                          new->eheight * sizeof (TileRowHint));
-                }
-
-              if ((*tile_ptr)->data)
-                {
-                  memcpy (new->data, (*tile_ptr)->data, new->size);
-                }
-              else
-                {
-                  tile_lock (*tile_ptr);
-                  memcpy (new->data, (*tile_ptr)->data, new->size);
-                  tile_release (*tile_ptr, FALSE);
-                }
+              Tile *new = tile_manager_copy_tile (*tile_ptr);
 
               tile_detach (*tile_ptr, tm, tile_num);
 
               tile_attach (new, tm, tile_num);
               *tile_ptr = new;
             }
-
-          (*tile_ptr)->write_count++;
-          (*tile_ptr)->dirty = TRUE;
         }
 #ifdef DEBUG_TILE_MANAGER
       else
@@ -256,10 +331,30 @@ tile_manager_get (TileManager *tm,
         }
 #endif
 
-      tile_lock (*tile_ptr);
+      tile = *tile_ptr;
+
+      TM_UNLOCK (tm);
+
+      tile_lock (tile);
+
+      /*  mark the tile dirty only after locking it, so it can't be
+       *  swapped out by another thread in between
+       */
+      if (wantwrite)
+        {
+          tile->write_count++;
+          tile->dirty   = TRUE;
+          tile->uniform = FALSE;
+        }
+
+      return tile;
     }
 
-  return *tile_ptr;
+  tile = *tile_ptr;
+
+  TM_UNLOCK (tm);
+
+  return tile;
 }
 
 Tile *
@@ -287,7 +382,8 @@ tile_manager_validate (TileManager *tm,
   g_return_if_fail (tm != NULL);
   g_return_if_fail (tile != NULL);
 
-  tile->valid = TRUE;
+  tile->valid   = TRUE;
+  tile->uniform = FALSE;
 
   if (tm->validate_proc)
     (* tm->validate_proc) (tm, tile, tm->user_data);
@@ -297,6 +393,36 @@ tile_manager_validate (TileManager *tm,
 #endif
 }
 
+gboolean
+tile_manager_mark_valid (TileManager *tm,
+                         gint         xpixel,
+                         gint         ypixel)
+{
+  Tile     *tile;
+  gboolean  invalid;
+
+  g_return_val_if_fail (tm != NULL, FALSE);
+
+  tile = tile_manager_get_tile (tm, xpixel, ypixel, FALSE, FALSE);
+
+  if (! tile)
+    return FALSE;
+
+  TILE_LOCK (tile);
+
+  invalid = ! tile->valid;
+
+  if (invalid)
+    {
+      tile->valid   = TRUE;
+      tile->uniform = FALSE;
+    }
+
+  TILE_UNLOCK (tile);
+
+  return invalid;
+}
+
 static void
 tile_manager_invalidate_tile (TileManager  *tm,
                               gint          tile_num)
@@ -319,8 +445,6 @@ tile_manager_invalidate_tile (TileManager  *tm,
       /* This tile is shared.  Replace it with a new, invalid tile. */
       Tile *new = tile_new (tile->bpp);
 
-      g_print ("invalidating shared tile (executing buggy code!!!)\n");
-
       new->ewidth  = tile->ewidth;
       new->eheight = tile->eheight;
       new->size    = tile->size;
@@ -334,7 +458,8 @@ tile_manager_invalidate_tile (TileManager  *tm,
   if (tile->listhead)
     tile_cache_flush (tile);
 
-  tile->valid = FALSE;
+  tile->valid   = FALSE;
+  tile->uniform = FALSE;
 
   if (tile->data)
     {
@@ -342,7 +467,7 @@ tile_manager_invalidate_tile (TileManager  *tm,
       tile->data = NULL;
     }
 
-  if (tile->swap_offset != -1)
+  if (TILE_IS_SWAPPED (tile))
     {
       /* If the tile is on disk, then delete its
        *  presence there.
@@ -391,13 +516,8 @@ tile_manager_map (TileManager *tm,
                   gint         tile_num,
                   Tile        *srctile)
 {
-  Tile **tiles;
   Tile **tile_ptr;
   gint   ntiles;
-  gint   nrows, ncols;
-  gint   right_tile;
-  gint   bottom_tile;
-  gint   i, j, k;
 
   g_return_if_fail (tm != NULL);
   g_return_if_fail (srctile != NULL);
@@ -414,37 +534,7 @@ tile_manager_map (TileManager *tm,
     {
       g_warning ("%s: empty tile level - initializing", G_GNUC_FUNCTION);
 
-      tm->tiles = g_new (Tile *, ntiles);
-      tiles = tm->tiles;
-
-      nrows = tm->ntile_rows;
-      ncols = tm->ntile_cols;
-
-      right_tile  = tm->width  - ((ncols - 1) * TILE_WIDTH);
-      bottom_tile = tm->height - ((nrows - 1) * TILE_HEIGHT);
-
-      for (i = 0, k = 0; i < nrows; i++)
-        {
-          for (j = 0; j < ncols; j++, k++)
-            {
-              Tile *new = tile_new (tm->bpp);
-
-#ifdef DEBUG_TILE_MANAGER
-              g_printerr (",");
-#endif
-              tile_attach (new, tm, k);
-
-              if (j == (ncols - 1))
-                new->ewidth = right_tile;
-
-              if (i == (nrows - 1))
-                new->eheight = bottom_tile;
-
-              new->size = new->ewidth * new->eheight * new->bpp;
-
-              tiles[k] = new;
-            }
-        }
+      tile_manager_allocate_tiles (tm);
     }
 
   tile_ptr = &tm->tiles[tile_num];
@@ -591,7 +681,8 @@ tile_manager_get_memsize (const TileManager *tm,
           for (i = 0; i < tm->ntile_rows; i++)
             for (j = 0; j < tm->ntile_cols; j++, tiles++)
               {
-                if (tile_is_valid (*tiles))
+                /*  uniform tiles don't need to keep their data  */
+                if (tile_is_valid (*tiles) && ! (*tiles)->uniform)
                   memsize += size;
               }
         }
@@ -833,3 +924,78 @@ write_pixel_data_1 (TileManager  *tm,
 
   tile_release (tile, TRUE);
 }
+
+static void
+tile_manager_allocate_tiles (TileManager *tm)
+{
+  Tile **tiles;
+  gint   nrows       = tm->ntile_rows;
+  gint   ncols       = tm->ntile_cols;
+  gint   right_tile  = tm->width  - ((ncols - 1) * TILE_WIDTH);
+  gint   bottom_tile = tm->height - ((nrows - 1) * TILE_HEIGHT);
+  gint   i, j, k;
+
+  tiles = g_new (Tile *, nrows * ncols);
+
+  for (i = 0, k = 0; i < nrows; i++)
+    {
+      for (j = 0; j < ncols; j++, k++)
+        {
+          Tile *new = tile_new (tm->bpp);
+
+          tile_attach (new, tm, k);
+
+          if (j == (ncols - 1))
+            new->ewidth = right_tile;
+
+          if (i == (nrows - 1))
+            new->eheight = bottom_tile;
+
+          new->size = new->ewidth * new->eheight * new->bpp;
+
+          tiles[k] = new;
+        }
+    }
+
+  tm->tiles = tiles;
+}
+
+/*  Returns a new tile with a copy of the data of @tile  */
+static Tile *
+tile_manager_copy_tile (Tile *tile)
+{
+  Tile *new = tile_new (tile->bpp);
+
+  new->ewidth  = tile->ewidth;
+  new->eheight = tile->eheight;
+  new->valid   = tile->valid;
+
+  new->size    = new->ewidth * new->eheight * new->bpp;
+
+  /*  a uniform tile is copied without touching its data  */
+  if (tile_is_uniform (tile, new->pixel))
+    {
+      new->uniform = TRUE;
+
+      return new;
+    }
+
+  new->data    = g_new (guchar, new->size);
+
+  if (tile->rowhint)
+    {
+      tile_allocate_rowhints (new);
+
+      memcpy (new->rowhint, tile->rowhint,
+              new->eheight * sizeof (TileRowHint));
+    }
+
+  /*  lock the tile even if its data is in memory, so
+   *  that the cache can't swap it out while we copy
+   */
+  tile_lock (tile);
+  memcpy (new->data, tile->data, new->size);
+  tile_release (tile, FALSE);
+
+  return new;
+}
@@ -33,6 +33,11 @@ TileManager * tile_manager_new               (gint width,
                                               gint height,
                                               gint bpp);
 
+/* Creates a new tile manager that shares the tiles of @tm, they are
+ *  copied when either tile manager writes to them.
+ */
+TileManager * tile_manager_duplicate         (TileManager *tm);
+
 /* Ref/Unref a tile manager.
  */
 TileManager * tile_manager_ref               (TileManager *tm);
@@ -47,6 +52,19 @@ void          tile_manager_set_validate_proc (TileManager      *tm,
                                               TileValidateProc  proc,
                                               gpointer          user_data);
 
+/* Like tile_manager_set_validate_proc(), for procedures that can
+ *  validate tiles of any tile manager with the same layout, such as
+ *  one that reads them from a file. The tile manager keeps a reference
+ *  to @user_data, and so do its duplicates, which keep validating
+ *  their tiles with @proc.
+ */
+void          tile_manager_set_validate_proc_full
+                                             (TileManager      *tm,
+                                              TileValidateProc  proc,
+                                              gpointer          user_data,
+                                              GBoxedCopyFunc    user_data_ref,
+                                              GDestroyNotify    user_data_unref);
+
 /* Get a specified tile from a tile manager.
  */
 Tile        * tile_manager_get_tile          (TileManager *tm,
@@ -82,6 +100,13 @@ void          tile_manager_map               (TileManager *tm,
 void          tile_manager_validate          (TileManager  *tm,
                                               Tile         *tile);
 
+/* Mark a tile valid without calling the validate proc, for callers
+ * that are about to write all of it. Returns TRUE if it was invalid.
+ */
+gboolean      tile_manager_mark_valid        (TileManager  *tm,
+                                              gint          xpixel,
+                                              gint          ypixel);
+
 void          tile_manager_invalidate_area   (TileManager       *tm,
                                               gint               x,
                                               gint               y,
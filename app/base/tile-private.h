@@ -21,7 +21,8 @@
 
 #include <sys/types.h>
 
-typedef struct _TileLink TileLink;
+typedef struct _TileLink       TileLink;
+typedef struct _TileCompressed TileCompressed;
 
 struct _TileLink
 {
@@ -48,8 +49,13 @@ struct _Tile
                            hold this tile */
   guint   dirty : 1;    /* is the tile dirty? has it been modified? */
   guint   valid : 1;    /* is the tile valid? */
+  guint   uniform : 1;  /* do all pixels have the same value? then the data
+                         *  is freed instead of swapped out, and filled
+                         *  from "pixel" when the tile is locked again.
+                         */
 
   guchar  bpp;          /* the bytes per pixel (1, 2, 3 or 4) */
+  guchar  pixel[4];     /* the value of all pixels of a uniform tile */
   gushort ewidth;       /* the effective width of the tile */
   gushort eheight;      /* the effective height of the tile
                          *  a tile's effective width and height may be smaller
@@ -69,12 +75,57 @@ struct _Tile
                          * to -1.
                          */
 
+  TileCompressed *compressed; /* a compressed copy of the tile data kept in
+                               * memory instead of the swap file, or NULL
+                               */
+
   TileLink *tlink;
 
+#ifdef ENABLE_MP
+  GThread  *validator;  /* the thread that is validating the tile, if any */
+#endif
+
   Tile     *next;
   Tile     *prev;       /* List pointers for the tile cache lists */
   gpointer  listhead;   /* Pointer to the head of the list this tile is on */
 };
 
 
+/* TRUE if the tile data was swapped out, to disk or compressed */
+#define TILE_IS_SWAPPED(tile) ((tile)->swap_offset != -1 || \
+                               (tile)->compressed != NULL)
+
+
+#ifdef ENABLE_MP
+
+/*  The reference counts and cache state of a tile are protected by a
+ *  mutex picked from a small pool by hashing the tile's address, so
+ *  that threads locking different tiles rarely have to wait for each
+ *  other. The number of mutexes must be a power of two.
+ */
+#define N_TILE_MUTEXES  64
+
+extern GStaticMutex tile_mutexes[N_TILE_MUTEXES];
+
+#define TILE_MUTEX(tile)   (&tile_mutexes[(GPOINTER_TO_SIZE (tile) >> 7) & \
+                                          (N_TILE_MUTEXES - 1)])
+
+#define TILE_LOCK(tile)    g_static_mutex_lock (TILE_MUTEX (tile))
+#define TILE_TRYLOCK(tile) g_static_mutex_trylock (TILE_MUTEX (tile))
+#define TILE_UNLOCK(tile)  g_static_mutex_unlock (TILE_MUTEX (tile))
+
+#else
+
+#define TILE_LOCK(tile)    /* nothing */
+#define TILE_TRYLOCK(tile) TRUE
+#define TILE_UNLOCK(tile)  /* nothing */
+
+#endif
+
+
+
+/*  for the tile cache, call with the tile mutex held  */
+gboolean  tile_free_uniform (Tile *tile);
+
+
 #endif /* __TILE_PRIVATE_H__ */
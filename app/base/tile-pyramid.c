@@ -22,6 +22,8 @@
 
 #include "base-types.h"
 
+#include "pixel-processor.h"
+#include "pixel-region.h"
 #include "tile.h"
 #include "tile-manager.h"
 #include "tile-pyramid.h"
@@ -38,18 +40,26 @@ struct _TilePyramid
   gint           bytes;
   TileManager   *tiles[PYRAMID_MAX_LEVELS];
   gint           top_level;
+  gboolean       foreign_bottom; /* the bottom level belongs to someone else */
+  TileLevelProc  level_proc;
+  gpointer       level_data;
 };
 
 
 static gint  tile_pyramid_alloc_levels  (TilePyramid *pyramid,
                                          gint         top_level);
-static void  tile_pyramid_validate_tile (TileManager *tm,
-                                         Tile        *tile,
-                                         TileManager *tm_below);
-static void  tile_pyramid_write_quarter (Tile        *dest,
-                                         Tile        *src,
-                                         gint         i,
-                                         gint         j);
+static void  tile_pyramid_validate_level (TileManager *tm,
+                                          Tile        *tile,
+                                          TilePyramid *pyramid);
+static void  tile_pyramid_write_region   (TileManager *src,
+                                          PixelRegion *region);
+static void  tile_pyramid_validate_tile  (TileManager *tm,
+                                          Tile        *tile,
+                                          TileManager *tm_below);
+static void  tile_pyramid_write_quarter  (Tile        *dest,
+                                          Tile        *src,
+                                          gint         i,
+                                          gint         j);
 
 /**
  * tile_pyramid_new:
@@ -61,9 +71,8 @@ static void  tile_pyramid_write_quarter (Tile        *dest,
  * each level is a sized-down version of the level below.
  *
  * This only works correctly if you set a validate procedure using
- * tile_pyramid_set_validate_proc() and invalidate areas. With some
- * small changes, it could be made to work for non-validating tile
- * managers also. But currently only the projection uses it.
+ * tile_pyramid_set_validate_proc() and invalidate areas. To build a
+ * pyramid on top of existing tiles, use tile_pyramid_new_for_tiles().
  *
  * Only the bottom-most tile-manager is allocated at this point. Upper
  * levels are created only if they are requested.
@@ -115,6 +124,57 @@ tile_pyramid_new (GimpImageType  type,
   return pyramid;
 }
 
+/**
+ * tile_pyramid_new_for_tiles:
+ * @tiles: the bottom level
+ *
+ * Creates a new #TilePyramid that uses @tiles as its bottom level,
+ * instead of allocating and validating one itself. The upper levels
+ * are computed from @tiles when they are requested. The pyramid holds
+ * a reference on @tiles, but never invalidates it: when the pixels in
+ * @tiles change, call tile_pyramid_invalidate_area() to throw away
+ * the upper levels of the changed area.
+ *
+ * Return value: a newly allocate #TilePyramid
+ **/
+TilePyramid *
+tile_pyramid_new_for_tiles (TileManager *tiles)
+{
+  TilePyramid *pyramid;
+
+  g_return_val_if_fail (tiles != NULL, NULL);
+
+  pyramid = g_slice_new0 (TilePyramid);
+
+  pyramid->width  = tile_manager_width (tiles);
+  pyramid->height = tile_manager_height (tiles);
+  pyramid->bytes  = tile_manager_bpp (tiles);
+
+  switch (pyramid->bytes)
+    {
+    case 1:
+      pyramid->type = GIMP_GRAY_IMAGE;
+      break;
+
+    case 2:
+      pyramid->type = GIMP_GRAYA_IMAGE;
+      break;
+
+    case 3:
+      pyramid->type = GIMP_RGB_IMAGE;
+      break;
+
+    case 4:
+      pyramid->type = GIMP_RGBA_IMAGE;
+      break;
+    }
+
+  pyramid->tiles[0]       = tile_manager_ref (tiles);
+  pyramid->foreign_bottom = TRUE;
+
+  return pyramid;
+}
+
 /**
  * tile_pyramid_destroy:
  * @pyramid: a #TilePyramid
@@ -229,8 +289,9 @@ tile_pyramid_invalidate_area (TilePyramid *pyramid,
       /* Tile invalidation must propagate all the way up in the pyramid,
        * so keep width and height > 0.
        */
-      tile_manager_invalidate_area (pyramid->tiles[level],
-                                    x, y, MAX (width, 1), MAX (height, 1));
+      if (level > 0 || ! pyramid->foreign_bottom)
+        tile_manager_invalidate_area (pyramid->tiles[level],
+                                      x, y, MAX (width, 1), MAX (height, 1));
 
       x      >>= 1;
       y      >>= 1;
@@ -253,10 +314,34 @@ tile_pyramid_set_validate_proc (TilePyramid      *pyramid,
                                 gpointer          user_data)
 {
   g_return_if_fail (pyramid != NULL);
+  g_return_if_fail (! pyramid->foreign_bottom);
 
   tile_manager_set_validate_proc (pyramid->tiles[0], proc, user_data);
 }
 
+/**
+ * tile_pyramid_set_level_proc:
+ * @pyramid:   a #TilePyramid
+ * @proc:      a function to validate the upper level tiles, or %NULL
+ * @user_data: data to pass to the @proc
+ *
+ * Sets a procedure that gets the first chance to validate the tiles
+ * of the upper levels. If it returns %FALSE, the tile is computed
+ * from the level below as usual. This allows the owner of the pyramid
+ * to fill upper levels from other sources of lower resolution data
+ * without having to construct the bottom level first.
+ **/
+void
+tile_pyramid_set_level_proc (TilePyramid   *pyramid,
+                             TileLevelProc  proc,
+                             gpointer       user_data)
+{
+  g_return_if_fail (pyramid != NULL);
+
+  pyramid->level_proc = proc;
+  pyramid->level_data = user_data;
+}
+
 /**
  * tile_pyramid_get_width:
  * @pyramid: a #TilePyramid
@@ -313,12 +398,46 @@ tile_pyramid_get_memsize (const TilePyramid *pyramid)
 
   g_return_val_if_fail (pyramid != NULL, 0);
 
-  for (level = 0; level <= pyramid->top_level; level++)
+  for (level = pyramid->foreign_bottom ? 1 : 0;
+       level <= pyramid->top_level;
+       level++)
     memsize += tile_manager_get_memsize (pyramid->tiles[level], TRUE);
 
   return memsize;
 }
 
+/**
+ * tile_pyramid_write_level:
+ * @src:  a #TileManager
+ * @dest: a #TileManager of the same bpp and half the size of @src
+ *
+ * Fills @dest with @src scaled down by a factor of two, the same way
+ * the upper levels of a #TilePyramid are computed from the level
+ * below. This can be used to compute the levels of a pyramid for
+ * tile-managers that are not part of one.
+ **/
+void
+tile_pyramid_write_level (TileManager *src,
+                          TileManager *dest)
+{
+  PixelRegion region;
+
+  g_return_if_fail (src != NULL);
+  g_return_if_fail (dest != NULL);
+  g_return_if_fail (tile_manager_bpp (src) == tile_manager_bpp (dest));
+  g_return_if_fail (tile_manager_width (dest)  == tile_manager_width (src)  / 2);
+  g_return_if_fail (tile_manager_height (dest) == tile_manager_height (src) / 2);
+
+  pixel_region_init (&region, dest,
+                     0, 0,
+                     tile_manager_width (dest), tile_manager_height (dest),
+                     TRUE);
+
+  pixel_regions_process_parallel ((PixelProcessorFunc)
+                                  tile_pyramid_write_region,
+                                  src, 1, &region);
+}
+
 /*  private functions  */
 
 /* This function make sure that levels are allocated up to the level
@@ -355,13 +474,40 @@ tile_pyramid_alloc_levels (TilePyramid *pyramid,
 
       /* Use the level below to validate tiles. */
       tile_manager_set_validate_proc (pyramid->tiles[level],
-                                      (TileValidateProc) tile_pyramid_validate_tile,
-                                      pyramid->tiles[level - 1]);
+                                      (TileValidateProc) tile_pyramid_validate_level,
+                                      pyramid);
     }
 
   return pyramid->top_level;
 }
 
+static void
+tile_pyramid_validate_level (TileManager *tm,
+                             Tile        *tile,
+                             TilePyramid *pyramid)
+{
+  gint level;
+
+  for (level = 1; level <= pyramid->top_level; level++)
+    if (pyramid->tiles[level] == tm)
+      break;
+
+  g_return_if_fail (level <= pyramid->top_level);
+
+  if (pyramid->level_proc &&
+      pyramid->level_proc (tm, tile, level, pyramid->level_data))
+    return;
+
+  tile_pyramid_validate_tile (tm, tile, pyramid->tiles[level - 1]);
+}
+
+static void
+tile_pyramid_write_region (TileManager *src,
+                           PixelRegion *region)
+{
+  tile_pyramid_validate_tile (region->tiles, region->curtile, src);
+}
+
 static void
 tile_pyramid_validate_tile (TileManager *tm,
                             Tile        *tile,
@@ -23,6 +23,7 @@
 TilePyramid * tile_pyramid_new               (GimpImageType      type,
                                               gint               width,
                                               gint               height);
+TilePyramid * tile_pyramid_new_for_tiles     (TileManager       *tiles);
 void          tile_pyramid_destroy           (TilePyramid       *pyramid);
 
 gint          tile_pyramid_get_level         (gint               width,
@@ -41,6 +42,9 @@ void          tile_pyramid_invalidate_area   (TilePyramid       *pyramid,
 void          tile_pyramid_set_validate_proc (TilePyramid       *pyramid,
                                               TileValidateProc   proc,
                                               gpointer           user_data);
+void          tile_pyramid_set_level_proc    (TilePyramid       *pyramid,
+                                              TileLevelProc      proc,
+                                              gpointer           user_data);
 
 gint          tile_pyramid_get_width         (const TilePyramid *pyramid);
 gint          tile_pyramid_get_height        (const TilePyramid *pyramid);
@@ -48,5 +52,8 @@ gint          tile_pyramid_get_bpp           (const TilePyramid *pyramid);
 
 gint64        tile_pyramid_get_memsize       (const TilePyramid *pyramid);
 
+void          tile_pyramid_write_level       (TileManager       *src,
+                                              TileManager       *dest);
+
 
 #endif /* __TILE_PYRAMID_H__ */
@@ -20,6 +20,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <sys/types.h>
 
 #ifdef HAVE_UNISTD_H
@@ -49,6 +50,7 @@
 #endif
 
 #include "tile.h"
+#include "tile-compress.h"
 #include "tile-rowhints.h"
 #include "tile-swap.h"
 #include "tile-private.h"
@@ -71,17 +73,55 @@ typedef gint (* SwapFunc) (gint         fd,
 
 #define MAX_OPEN_SWAP_FILES  16
 
+/*  Tiles are written to disk by an I/O thread, as long as there are
+ *  less than this many bytes waiting to be written. Beyond that, the
+ *  threads swapping out tiles wait for the I/O thread to catch up.
+ */
+#define MAX_PENDING_WRITES   (256 * TILE_WIDTH * TILE_HEIGHT * 4)
+
+/*  The maximum number of neighbouring tiles written in one go, and the
+ *  maximum number of tiles that are read ahead.
+ */
+#define MAX_WRITE_BATCH      64
+#define MAX_READ_AHEAD       64
+
+/*  Tiles are only kept compressed in memory if that saves at least
+ *  a quarter of their size.
+ */
+#define MAX_COMPRESSED_SIZE(size)  ((size) * 3 / 4)
+
 
 typedef struct _SwapFile     SwapFile;
 typedef struct _SwapFileGap  SwapFileGap;
+typedef struct _SwapRequest  SwapRequest;
 
 struct _SwapFile
 {
-  gchar   *filename;
-  gint     fd;
-  GList   *gaps;
-  gint64   swap_file_end;
-  gint64   cur_position;
+  gchar       *filename;
+  gint         fd;
+  GList       *gaps;
+  gint64       swap_file_end;
+
+#ifdef ENABLE_MP
+  GThread     *io_thread;
+  GAsyncQueue *io_queue;
+  GCond       *io_cond;       /*  signalled when writes are done       */
+  GHashTable  *writes;        /*  offset -> write not yet on disk      */
+  GHashTable  *reads;         /*  offset -> tile data read ahead       */
+  GQueue      *read_order;    /*  read ahead requests, oldest first    */
+  gint64       write_bytes;   /*  bytes queued for the I/O thread      */
+  gint         write_errno;   /*  error of the last failed write       */
+#endif
+};
+
+/*  A compressed tile. Its link is in the list of compressed tiles,
+ *  the least recently used one first, and points back to the tile.
+ */
+struct _TileCompressed
+{
+  GList   link;
+  gint    size;
+  guchar  data[1];
 };
 
 struct _SwapFileGap
@@ -90,18 +130,51 @@ struct _SwapFileGap
   gint64 end;
 };
 
+/*  A write or read ahead handled by the I/O thread. Requests are
+ *  protected by the swap lock, except for the data, which belongs
+ *  to the I/O thread while the request is in progress.
+ */
+struct _SwapRequest
+{
+  SwapCommand  cmd;           /*  SWAP_OUT or SWAP_IN                 */
+  gint64       offset;
+  gint         size;          /*  bytes of data                       */
+  gint         slot;          /*  bytes reserved in the swap file     */
+  guchar      *data;
+
+  guint        in_progress : 1;
+  guint        done        : 1;  /*  read ahead data is available     */
+  guint        failed      : 1;  /*  write failed, data kept in memory */
+  guint        cancelled   : 1;  /*  tile is gone, drop the request    */
+};
+
 
 static void          tile_swap_command        (Tile        *tile,
-                                               gint         command);
+                                               gint         command,
+                                               TileCompressed *compressed);
 static void          tile_swap_default_in     (SwapFile    *swap_file,
                                                Tile        *tile);
 static void          tile_swap_default_out    (SwapFile    *swap_file,
-                                               Tile        *tile);
+                                               Tile        *tile,
+                                               TileCompressed *compressed);
 static void          tile_swap_default_delete (SwapFile    *swap_file,
                                                Tile        *tile);
+static gboolean      tile_swap_write          (SwapFile    *swap_file,
+                                               Tile        *tile,
+                                               const guchar *data);
+static void          tile_swap_delete_disk    (SwapFile    *swap_file,
+                                               Tile        *tile);
+
+static TileCompressed * tile_swap_compress     (Tile        *tile);
+static void          tile_swap_uncompress     (Tile        *tile);
+static void          tile_swap_drop_compressed (Tile       *tile);
+static void          tile_swap_spill          (SwapFile    *swap_file);
 
 static gint64        tile_swap_find_offset    (SwapFile    *swap_file,
                                                gint64       bytes);
+static void          tile_swap_release        (SwapFile    *swap_file,
+                                               gint64       start,
+                                               gint64       end);
 static void          tile_swap_open           (SwapFile    *swap_file);
 static void          tile_swap_resize         (SwapFile    *swap_file,
                                                gint64       new_size);
@@ -109,6 +182,31 @@ static SwapFileGap * tile_swap_gap_new        (gint64       start,
                                                gint64       end);
 static void          tile_swap_gap_destroy    (SwapFileGap *gap);
 
+static gint          tile_swap_io             (gint         fd,
+                                               SwapCommand  cmd,
+                                               guchar      *buffer,
+                                               gint         size,
+                                               gint64       offset);
+
+#ifdef ENABLE_MP
+static void          tile_swap_io_start       (SwapFile    *swap_file);
+static void          tile_swap_io_stop        (SwapFile    *swap_file);
+static gpointer      tile_swap_io_thread      (SwapFile    *swap_file);
+static void          tile_swap_io_write       (SwapFile    *swap_file,
+                                               GList       *batch);
+static void          tile_swap_io_read        (SwapFile    *swap_file,
+                                               SwapRequest *request);
+static void          tile_swap_drop_read      (SwapFile    *swap_file,
+                                               gint64       offset);
+static void          tile_swap_request_free   (SwapRequest *request);
+static void          tile_swap_write_free     (gpointer     key,
+                                               gpointer     value,
+                                               gpointer     data);
+static guint         tile_swap_offset_hash    (gconstpointer key);
+static gboolean      tile_swap_offset_equal   (gconstpointer a,
+                                               gconstpointer b);
+#endif
+
 
 static SwapFile     * gimp_swap_file   = NULL;
 
@@ -118,6 +216,31 @@ static gboolean       seek_err_msg     = TRUE;
 static gboolean       read_err_msg     = TRUE;
 static gboolean       write_err_msg    = TRUE;
 
+/*  tiles that are kept compressed in memory, least recently used first  */
+static GQueue         compressed_tiles = { NULL, NULL, 0 };
+static gint64         compressed_size  = 0;
+static gint64         compressed_max   = 0;
+
+
+#ifdef ENABLE_MP
+
+/*  the tile cache shards may swap out tiles concurrently  */
+static GStaticMutex   swap_mutex       = G_STATIC_MUTEX_INIT;
+
+#define SWAP_LOCK    g_static_mutex_lock (&swap_mutex)
+#define SWAP_UNLOCK  g_static_mutex_unlock (&swap_mutex)
+#define SWAP_MUTEX   g_static_mutex_get_mutex (&swap_mutex)
+
+/*  pushed to the I/O thread to make it quit  */
+static SwapRequest    quit_request;
+
+#else
+
+#define SWAP_LOCK    /* nothing */
+#define SWAP_UNLOCK  /* nothing */
+
+#endif
+
 
 #ifdef G_OS_WIN32
 
@@ -142,6 +265,23 @@ win32_large_truncate (gint   fd,
 
 #endif
 
+#if ! defined (HAVE_PREAD) && defined (ENABLE_MP)
+
+/*  without pread() and pwrite(), seeking and reading or writing has
+ *  to be done atomically
+ */
+static GStaticMutex   seek_mutex       = G_STATIC_MUTEX_INIT;
+
+#define SEEK_LOCK    g_static_mutex_lock (&seek_mutex)
+#define SEEK_UNLOCK  g_static_mutex_unlock (&seek_mutex)
+
+#else
+
+#define SEEK_LOCK    /* nothing */
+#define SEEK_UNLOCK  /* nothing */
+
+#endif
+
 
 #ifdef GIMP_UNSTABLE
 static void
@@ -183,9 +323,12 @@ tile_swap_init (const gchar *path)
   gimp_swap_file->filename      = g_build_filename (dirname, basename, NULL);
   gimp_swap_file->gaps          = NULL;
   gimp_swap_file->swap_file_end = 0;
-  gimp_swap_file->cur_position  = 0;
   gimp_swap_file->fd            = -1;
 
+#ifdef ENABLE_MP
+  tile_swap_io_start (gimp_swap_file);
+#endif
+
   g_free (basename);
   g_free (dirname);
 }
@@ -205,6 +348,10 @@ tile_swap_exit (void)
 
   g_return_if_fail (gimp_swap_file != NULL);
 
+#ifdef ENABLE_MP
+  tile_swap_io_stop (gimp_swap_file);
+#endif
+
 #ifdef GIMP_UNSTABLE
   if (gimp_swap_file->swap_file_end != 0)
     {
@@ -212,6 +359,10 @@ tile_swap_exit (void)
                  gimp_filename_to_utf8 (gimp_swap_file->filename));
       tile_swap_print_gaps (gimp_swap_file);
     }
+
+  if (compressed_size != 0)
+    g_warning ("%d compressed tiles left (%" G_GINT64_FORMAT " bytes)\n",
+               g_queue_get_length (&compressed_tiles), compressed_size);
 #endif
 
 #ifdef G_OS_WIN32
@@ -253,40 +404,129 @@ tile_swap_test (void)
   return FALSE;
 }
 
+/* set the amount of memory used for compressed tiles, tiles exceeding
+ * it are moved to the swap file
+ */
+void
+tile_swap_set_compressed_size (guint64 size)
+{
+  SWAP_LOCK;
+
+  compressed_max = size;
+
+  if (compressed_size > compressed_max && gimp_swap_file)
+    {
+      if (gimp_swap_file->fd == -1)
+        tile_swap_open (gimp_swap_file);
+
+      if (gimp_swap_file->fd != -1)
+        tile_swap_spill (gimp_swap_file);
+    }
+
+  SWAP_UNLOCK;
+}
+
 void
 tile_swap_in (Tile *tile)
 {
-  if (tile->swap_offset == -1)
+  if (! TILE_IS_SWAPPED (tile))
     {
       tile_alloc (tile);
       return;
     }
 
-  tile_swap_command (tile, SWAP_IN);
+  tile_swap_command (tile, SWAP_IN, NULL);
 }
 
 void
 tile_swap_out (Tile *tile)
 {
-  tile_swap_command (tile, SWAP_OUT);
+  /*  compressing takes a while, don't hold the swap lock for it  */
+  tile_swap_command (tile, SWAP_OUT, tile_swap_compress (tile));
 }
 
 void
 tile_swap_delete (Tile *tile)
 {
-  tile_swap_command (tile, SWAP_DELETE);
+  tile_swap_command (tile, SWAP_DELETE, NULL);
+}
+
+void
+tile_swap_prefetch (Tile *tile)
+{
+#ifdef ENABLE_MP
+  SwapFile    *swap_file = gimp_swap_file;
+  SwapRequest *request;
+
+  if (! swap_file->io_thread)
+    return;
+
+  /*  the tile mutex keeps the tile from being swapped in or out
+   *  while we look at it
+   */
+  TILE_LOCK (tile);
+  SWAP_LOCK;
+
+  /*  make room by forgetting the oldest tiles that were read ahead
+   *  but never asked for
+   */
+  while (g_queue_get_length (swap_file->read_order) >= MAX_READ_AHEAD)
+    {
+      request = g_queue_peek_head (swap_file->read_order);
+
+      if (! request->done)
+        break;
+
+      tile_swap_drop_read (swap_file, request->offset);
+    }
+
+  /*  only read tiles that are on disk and not about to be written  */
+  if (tile->data                                                      ||
+      tile->swap_offset == -1                                         ||
+      swap_file->fd == -1                                             ||
+      g_queue_get_length (swap_file->read_order) >= MAX_READ_AHEAD    ||
+      g_hash_table_lookup (swap_file->reads,  &tile->swap_offset)     ||
+      g_hash_table_lookup (swap_file->writes, &tile->swap_offset))
+    {
+      SWAP_UNLOCK;
+      TILE_UNLOCK (tile);
+      return;
+    }
+
+  request = g_slice_new0 (SwapRequest);
+
+  request->cmd    = SWAP_IN;
+  request->offset = tile->swap_offset;
+  request->size   = tile->size;
+  request->slot   = TILE_WIDTH * TILE_HEIGHT * tile->bpp;
+  request->data   = g_new (guchar, tile->size);
+
+  g_hash_table_insert (swap_file->reads, &request->offset, request);
+  g_queue_push_tail (swap_file->read_order, request);
+
+  g_async_queue_push (swap_file->io_queue, request);
+
+  SWAP_UNLOCK;
+  TILE_UNLOCK (tile);
+#endif
 }
 
 static void
-tile_swap_command (Tile *tile,
-                   gint  command)
+tile_swap_command (Tile           *tile,
+                   gint            command,
+                   TileCompressed *compressed)
 {
+  SWAP_LOCK;
+
   if (gimp_swap_file->fd == -1)
     {
       tile_swap_open (gimp_swap_file);
 
       if (G_UNLIKELY (gimp_swap_file->fd == -1))
-        return;
+        {
+          g_free (compressed);
+          goto out;
+        }
     }
 
   switch (command)
@@ -295,12 +535,28 @@ tile_swap_command (Tile *tile,
       tile_swap_default_in (gimp_swap_file, tile);
       break;
     case SWAP_OUT:
-      tile_swap_default_out (gimp_swap_file, tile);
+      tile_swap_default_out (gimp_swap_file, tile, compressed);
       break;
     case SWAP_DELETE:
       tile_swap_default_delete (gimp_swap_file, tile);
       break;
     }
+
+#ifdef ENABLE_MP
+  /*  report errors of the I/O thread  */
+  if (G_UNLIKELY (gimp_swap_file->write_errno))
+    {
+      if (write_err_msg)
+        g_message ("unable to write tile data to disk: %s",
+                   g_strerror (gimp_swap_file->write_errno));
+      write_err_msg = FALSE;
+
+      gimp_swap_file->write_errno = 0;
+    }
+#endif
+
+out:
+  SWAP_UNLOCK;
 }
 
 /* The actual swap file code. The swap file consists of tiles
@@ -316,54 +572,71 @@ static void
 tile_swap_default_in (SwapFile *swap_file,
                       Tile     *tile)
 {
-  gint   nleft;
-  gint64 offset;
+  gint err;
 
   if (tile->data)
     return;
 
-  if (swap_file->cur_position != tile->swap_offset)
+  if (tile->compressed)
     {
-      swap_file->cur_position = tile->swap_offset;
-
-      offset = LARGE_SEEK (swap_file->fd, tile->swap_offset, SEEK_SET);
-      if (offset == -1)
-        {
-          if (seek_err_msg)
-            g_message ("unable to seek to tile location on disk: %s",
-                       g_strerror (errno));
-          seek_err_msg = FALSE;
-          return;
-        }
+      tile_swap_uncompress (tile);
+      return;
     }
 
-  tile_alloc (tile);
-
-  nleft = tile->size;
-  while (nleft > 0)
+#ifdef ENABLE_MP
+  if (swap_file->io_thread)
     {
-      gint err;
+      SwapRequest *request;
 
-      do
-        {
-          err = read (swap_file->fd, tile->data + tile->size - nleft, nleft);
-        }
-      while ((err == -1) && ((errno == EAGAIN) || (errno == EINTR)));
+      /*  the tile's data may still be waiting to be written  */
+      request = g_hash_table_lookup (swap_file->writes, &tile->swap_offset);
 
-      if (err <= 0)
+      if (request)
         {
-          if (read_err_msg)
-            g_message ("unable to read tile data from disk: "
-                       "%s (%d/%d bytes read)",
-                       g_strerror (errno), err, nleft);
-          read_err_msg = FALSE;
+          tile_alloc (tile);
+          memcpy (tile->data, request->data, tile->size);
+
           return;
         }
 
-      nleft -= err;
+      /*  or it may have been read ahead already  */
+      request = g_hash_table_lookup (swap_file->reads, &tile->swap_offset);
+
+      if (request)
+        {
+          g_hash_table_remove (swap_file->reads, &request->offset);
+          g_queue_remove (swap_file->read_order, request);
+
+          if (request->done)
+            {
+              tile->data    = request->data;
+              request->data = NULL;
+
+              tile_swap_request_free (request);
+
+              return;
+            }
+
+          /*  still in the I/O thread's queue, read it ourselves  */
+          request->cancelled = TRUE;
+        }
     }
+#endif
+
+  tile_alloc (tile);
 
-  swap_file->cur_position += tile->size;
+  err = tile_swap_io (swap_file->fd, SWAP_IN,
+                      tile->data, tile->size, tile->swap_offset);
+
+  if (err < tile->size)
+    {
+      if (read_err_msg)
+        g_message ("unable to read tile data from disk: "
+                   "%s (%d/%d bytes read)",
+                   g_strerror (errno), MAX (err, 0), tile->size);
+      read_err_msg = FALSE;
+      return;
+    }
 
   /*  Do not delete the swap from the file  */
   /*  tile_swap_default_delete (swap_file, fd, tile);  */
@@ -372,12 +645,57 @@ tile_swap_default_in (SwapFile *swap_file,
 }
 
 static void
-tile_swap_default_out (SwapFile *swap_file,
-                       Tile     *tile)
+tile_swap_default_out (SwapFile       *swap_file,
+                       Tile           *tile,
+                       TileCompressed *compressed)
+{
+#ifdef ENABLE_MP
+  if (swap_file->io_thread)
+    {
+      /*  wait for the I/O thread to catch up  */
+      while (swap_file->write_bytes > MAX_PENDING_WRITES)
+        g_cond_wait (swap_file->io_cond, SWAP_MUTEX);
+    }
+#endif
+
+  /*  any compressed copy is outdated  */
+  tile_swap_drop_compressed (tile);
+
+  /*  keep the tile in memory if it compressed well, otherwise
+   *  it goes to disk
+   */
+  if (compressed)
+    {
+      g_queue_push_tail_link (&compressed_tiles, &compressed->link);
+      compressed_size += compressed->size;
+
+      tile->compressed = compressed;
+
+      tile_swap_delete_disk (swap_file, tile);
+      tile_swap_spill (swap_file);
+    }
+  else if (! tile_swap_write (swap_file, tile, tile->data))
+    {
+      return;
+    }
+
+  /* Do NOT free tile->data because we may be pre-swapping.
+   * tile->data is freed in tile_cache_zorch_next
+   */
+  tile->dirty = FALSE;
+}
+
+/*  Writes @data as the data of @tile to the swap file, and sets the
+ *  tile's swap_offset. Returns FALSE if the data couldn't be written.
+ *  Doesn't release the swap lock, so that the tile can't go away.
+ */
+static gboolean
+tile_swap_write (SwapFile     *swap_file,
+                 Tile         *tile,
+                 const guchar *data)
 {
   gint   bytes;
-  gint   nleft;
-  gint64 offset;
+  gint   err;
   gint64 newpos;
 
   bytes = TILE_WIDTH * TILE_HEIGHT * tile->bpp;
@@ -388,61 +706,93 @@ tile_swap_default_out (SwapFile *swap_file,
   else
     newpos = tile->swap_offset;
 
-  if (swap_file->cur_position != newpos)
+#ifdef ENABLE_MP
+  if (swap_file->io_thread)
     {
-      offset = LARGE_SEEK (swap_file->fd, newpos, SEEK_SET);
+      SwapRequest *request;
 
-      if (offset == -1)
+      /*  anything read ahead from here is outdated now  */
+      tile_swap_drop_read (swap_file, newpos);
+
+      request = g_hash_table_lookup (swap_file->writes, &newpos);
+
+      if (request && ! request->in_progress && ! request->failed)
         {
-          if (seek_err_msg)
-            g_message ("unable to seek to tile location on disk: %s",
-                       g_strerror (errno));
-          seek_err_msg = FALSE;
-          return;
+          /*  the previous write didn't happen yet, just update it  */
+          memcpy (request->data, data, tile->size);
         }
+      else
+        {
+          if (request)
+            {
+              /*  a write that is in progress completes on its own,
+               *  a failed one is replaced by this one
+               */
+              g_hash_table_remove (swap_file->writes, &request->offset);
 
-      swap_file->cur_position = newpos;
-    }
+              if (request->failed)
+                tile_swap_request_free (request);
+            }
 
-  nleft = tile->size;
-  while (nleft > 0)
-    {
-      gint err = write (swap_file->fd, tile->data + tile->size - nleft, nleft);
+          request = g_slice_new0 (SwapRequest);
 
-      if (err <= 0)
-        {
-          if (write_err_msg)
-            g_message ("unable to write tile data to disk: "
-                       "%s (%d/%d bytes written)",
-                       g_strerror (errno), err, nleft);
-          write_err_msg = FALSE;
-          return;
+          request->cmd    = SWAP_OUT;
+          request->offset = newpos;
+          request->size   = tile->size;
+          request->slot   = bytes;
+          request->data   = g_memdup (data, tile->size);
+
+          g_hash_table_insert (swap_file->writes, &request->offset, request);
+          swap_file->write_bytes += request->size;
+
+          g_async_queue_push (swap_file->io_queue, request);
         }
 
-      nleft -= err;
+      tile->swap_offset = newpos;
+
+      return TRUE;
     }
+#endif
 
-  swap_file->cur_position += tile->size;
+  err = tile_swap_io (swap_file->fd, SWAP_OUT,
+                      (guchar *) data, tile->size, newpos);
+
+  if (err < tile->size)
+    {
+      if (write_err_msg)
+        g_message ("unable to write tile data to disk: "
+                   "%s (%d/%d bytes written)",
+                   g_strerror (errno), MAX (err, 0), tile->size);
+      write_err_msg = FALSE;
+
+      /*  don't leak the space if the tile had none before  */
+      if (tile->swap_offset == -1)
+        tile_swap_release (swap_file, newpos, newpos + bytes);
+
+      return FALSE;
+    }
 
-  /* Do NOT free tile->data because we may be pre-swapping.
-   * tile->data is freed in tile_cache_zorch_next
-   */
-  tile->dirty = FALSE;
   tile->swap_offset = newpos;
 
   write_err_msg = seek_err_msg = TRUE;
+
+  return TRUE;
 }
 
 static void
 tile_swap_default_delete (SwapFile *swap_file,
                           Tile     *tile)
 {
-  SwapFileGap *gap;
-  SwapFileGap *gap2;
-  GList       *tmp;
-  GList       *tmp2;
-  gint64       start;
-  gint64       end;
+  tile_swap_drop_compressed (tile);
+  tile_swap_delete_disk (swap_file, tile);
+}
+
+static void
+tile_swap_delete_disk (SwapFile *swap_file,
+                       Tile     *tile)
+{
+  gint64 start;
+  gint64 end;
 
   if (tile->swap_offset == -1)
     return;
@@ -451,6 +801,151 @@ tile_swap_default_delete (SwapFile *swap_file,
   end = start + TILE_WIDTH * TILE_HEIGHT * tile->bpp;
   tile->swap_offset = -1;
 
+#ifdef ENABLE_MP
+  if (swap_file->io_thread)
+    {
+      SwapRequest *request;
+
+      tile_swap_drop_read (swap_file, start);
+
+      request = g_hash_table_lookup (swap_file->writes, &start);
+
+      if (request)
+        {
+          g_hash_table_remove (swap_file->writes, &request->offset);
+
+          if (! request->failed)
+            {
+              /*  the I/O thread releases the space once it's done  */
+              request->cancelled = TRUE;
+              return;
+            }
+
+          tile_swap_request_free (request);
+        }
+    }
+#endif
+
+  tile_swap_release (swap_file, start, end);
+}
+
+/*  Returns a compressed copy of the tile data, if the tile compresses
+ *  well and compressed tiles are enabled at all. This is done without
+ *  holding the swap lock, the copy is linked to the tile later.
+ */
+static TileCompressed *
+tile_swap_compress (Tile *tile)
+{
+  TileCompressed *compressed;
+  gint            max_length = MAX_COMPRESSED_SIZE (tile->size);
+  gint            length;
+
+  if (compressed_max == 0)
+    return NULL;
+
+  compressed = g_malloc (G_STRUCT_OFFSET (TileCompressed, data) + max_length);
+
+  length = tile_compress (tile->data, tile->size, tile->bpp,
+                          compressed->data, max_length);
+
+  if (length < 0 || length > compressed_max)
+    {
+      g_free (compressed);
+      return NULL;
+    }
+
+  compressed = g_realloc (compressed,
+                          G_STRUCT_OFFSET (TileCompressed, data) + length);
+
+  compressed->link.data = tile;
+  compressed->link.next = NULL;
+  compressed->link.prev = NULL;
+  compressed->size      = length;
+
+  return compressed;
+}
+
+static void
+tile_swap_drop_compressed (Tile *tile)
+{
+  TileCompressed *compressed = tile->compressed;
+
+  if (compressed)
+    {
+      g_queue_unlink (&compressed_tiles, &compressed->link);
+      compressed_size -= compressed->size;
+
+      tile->compressed = NULL;
+      g_free (compressed);
+    }
+}
+
+static void
+tile_swap_uncompress (Tile *tile)
+{
+  TileCompressed *compressed = tile->compressed;
+
+  tile_alloc (tile);
+
+  if (! tile_decompress (compressed->data, compressed->size, tile->bpp,
+                         tile->data, tile->size))
+    {
+      g_warning ("%s: corrupt compressed tile data", G_STRFUNC);
+    }
+
+  /*  keep the compressed copy, and mark it as recently used  */
+  g_queue_unlink (&compressed_tiles, &compressed->link);
+  g_queue_push_tail_link (&compressed_tiles, &compressed->link);
+}
+
+/*  Moves the least recently used compressed tiles to the swap file,
+ *  until the compressed tiles fit into their limit again.
+ */
+static void
+tile_swap_spill (SwapFile *swap_file)
+{
+  guchar *buffer = NULL;
+
+  while (compressed_size > compressed_max)
+    {
+      GList          *link       = compressed_tiles.head;
+      Tile           *tile       = link->data;
+      TileCompressed *compressed = tile->compressed;
+
+      if (! buffer)
+        buffer = g_malloc (TILE_WIDTH * TILE_HEIGHT * 4);
+
+      if (! tile_decompress (compressed->data, compressed->size, tile->bpp,
+                             buffer, tile->size))
+        {
+          g_warning ("%s: corrupt compressed tile data", G_STRFUNC);
+        }
+
+      /*  leave the tile alone if writing it fails, it's not worth
+       *  losing its data over
+       */
+      if (! tile_swap_write (swap_file, tile, buffer))
+        break;
+
+      tile_swap_drop_compressed (tile);
+    }
+
+  g_free (buffer);
+}
+
+/*  Returns the space between @start and @end to the list of gaps,
+ *  shrinking the file if the space was at its end.
+ */
+static void
+tile_swap_release (SwapFile *swap_file,
+                   gint64    start,
+                   gint64    end)
+{
+  SwapFileGap *gap;
+  SwapFileGap *gap2;
+  GList       *tmp;
+  GList       *tmp2;
+
   tmp = swap_file->gaps;
   while (tmp)
     {
@@ -635,3 +1130,409 @@ tile_swap_gap_destroy (SwapFileGap *gap)
 {
   g_slice_free (SwapFileGap, gap);
 }
+
+/*  Reads (SWAP_IN) or writes (SWAP_OUT) @size bytes at @offset,
+ *  without relying on a file position shared between threads.
+ *  Returns the number of bytes transferred, less than @size on error.
+ */
+static gint
+tile_swap_io (gint         fd,
+              SwapCommand  cmd,
+              guchar      *buffer,
+              gint         size,
+              gint64       offset)
+{
+  gint nleft = size;
+
+  SEEK_LOCK;
+
+#ifndef HAVE_PREAD
+  if (LARGE_SEEK (fd, offset, SEEK_SET) == -1)
+    {
+      if (seek_err_msg)
+        g_message ("unable to seek to tile location on disk: %s",
+                   g_strerror (errno));
+      seek_err_msg = FALSE;
+
+      SEEK_UNLOCK;
+
+      return -1;
+    }
+#endif
+
+  while (nleft > 0)
+    {
+      gint err;
+
+      do
+        {
+#ifdef HAVE_PREAD
+          if (cmd == SWAP_OUT)
+            err = pwrite (fd, buffer + size - nleft, nleft,
+                          offset + size - nleft);
+          else
+            err = pread (fd, buffer + size - nleft, nleft,
+                         offset + size - nleft);
+#else
+          if (cmd == SWAP_OUT)
+            err = write (fd, buffer + size - nleft, nleft);
+          else
+            err = read (fd, buffer + size - nleft, nleft);
+#endif
+        }
+      while ((err == -1) && ((errno == EAGAIN) || (errno == EINTR)));
+
+      if (err <= 0)
+        break;
+
+      nleft -= err;
+    }
+
+  SEEK_UNLOCK;
+
+  return size - nleft;
+}
+
+#ifdef ENABLE_MP
+
+static void
+tile_swap_io_start (SwapFile *swap_file)
+{
+  GError *error = NULL;
+
+  swap_file->io_thread   = NULL;
+  swap_file->io_queue    = NULL;
+  swap_file->io_cond     = NULL;
+  swap_file->writes      = NULL;
+  swap_file->reads       = NULL;
+  swap_file->read_order  = NULL;
+  swap_file->write_bytes = 0;
+  swap_file->write_errno = 0;
+
+  /*  without threads all I/O is done synchronously  */
+  if (! g_thread_supported ())
+    return;
+
+  swap_file->io_queue   = g_async_queue_new ();
+  swap_file->io_cond    = g_cond_new ();
+  swap_file->writes     = g_hash_table_new (tile_swap_offset_hash,
+                                            tile_swap_offset_equal);
+  swap_file->reads      = g_hash_table_new (tile_swap_offset_hash,
+                                            tile_swap_offset_equal);
+  swap_file->read_order = g_queue_new ();
+
+  swap_file->io_thread = g_thread_create ((GThreadFunc) tile_swap_io_thread,
+                                          swap_file, TRUE, &error);
+
+  if (! swap_file->io_thread)
+    {
+      g_warning ("unable to start the swap file thread: %s", error->message);
+      g_clear_error (&error);
+    }
+}
+
+static void
+tile_swap_io_stop (SwapFile *swap_file)
+{
+  SwapRequest *request;
+
+  if (! swap_file->io_queue)
+    return;
+
+  if (swap_file->io_thread)
+    {
+      g_async_queue_push (swap_file->io_queue, &quit_request);
+      g_thread_join (swap_file->io_thread);
+
+      swap_file->io_thread = NULL;
+    }
+
+  while ((request = g_queue_pop_head (swap_file->read_order)))
+    tile_swap_request_free (request);
+
+  g_hash_table_foreach (swap_file->writes, tile_swap_write_free, NULL);
+
+  g_queue_free (swap_file->read_order);
+  g_hash_table_destroy (swap_file->reads);
+  g_hash_table_destroy (swap_file->writes);
+  g_cond_free (swap_file->io_cond);
+  g_async_queue_unref (swap_file->io_queue);
+
+  swap_file->io_queue = NULL;
+}
+
+static gint
+tile_swap_request_compare (const SwapRequest *a,
+                           const SwapRequest *b)
+{
+  return (a->offset < b->offset) ? -1 : (a->offset > b->offset) ? 1 : 0;
+}
+
+static gpointer
+tile_swap_io_thread (SwapFile *swap_file)
+{
+  SwapRequest *deferred = NULL;
+
+  while (TRUE)
+    {
+      SwapRequest *request;
+      GList       *batch;
+      gint         n_batch;
+
+      if (deferred)
+        {
+          request  = deferred;
+          deferred = NULL;
+        }
+      else
+        {
+          request = g_async_queue_pop (swap_file->io_queue);
+        }
+
+      if (request == &quit_request)
+        break;
+
+      if (request->cmd == SWAP_IN)
+        {
+          tile_swap_io_read (swap_file, request);
+          continue;
+        }
+
+      /*  collect the writes that queued up meanwhile, so that
+       *  neighbouring tiles can go to disk in one go
+       */
+      batch   = g_list_prepend (NULL, request);
+      n_batch = 1;
+
+      while (n_batch < MAX_WRITE_BATCH &&
+             (request = g_async_queue_try_pop (swap_file->io_queue)))
+        {
+          if (request == &quit_request || request->cmd != SWAP_OUT)
+            {
+              deferred = request;
+              break;
+            }
+
+          batch = g_list_prepend (batch, request);
+          n_batch++;
+        }
+
+      batch = g_list_sort (batch, (GCompareFunc) tile_swap_request_compare);
+
+      tile_swap_io_write (swap_file, batch);
+
+      g_list_free (batch);
+    }
+
+  return NULL;
+}
+
+static void
+tile_swap_io_write (SwapFile *swap_file,
+                    GList    *batch)
+{
+  GList *list;
+  GList *run;
+
+  SWAP_LOCK;
+
+  for (list = batch; list; list = g_list_next (list))
+    {
+      SwapRequest *request = list->data;
+
+      request->in_progress = TRUE;
+    }
+
+  SWAP_UNLOCK;
+
+  /*  write runs of tiles that are next to each other in the file  */
+  for (run = batch; run; run = list)
+    {
+      SwapRequest *first = run->data;
+      gint64       end   = first->offset + first->slot;
+      gint         size  = first->size;
+      gint         n     = 1;
+      gint         err;
+
+      for (list = g_list_next (run); list; list = g_list_next (list))
+        {
+          SwapRequest *request = list->data;
+          SwapRequest *prev    = list->prev->data;
+
+          if (request->cancelled || prev->cancelled ||
+              prev->size != prev->slot || request->offset != end)
+            break;
+
+          end  += request->slot;
+          size += request->size;
+          n++;
+        }
+
+      if (first->cancelled)
+        {
+          err = size;
+        }
+      else if (n == 1)
+        {
+          err = tile_swap_io (swap_file->fd, SWAP_OUT,
+                              first->data, first->size, first->offset);
+        }
+      else
+        {
+          guchar *buffer = g_malloc (size);
+          guchar *dest   = buffer;
+          GList  *iter;
+
+          for (iter = run; iter != list; iter = g_list_next (iter))
+            {
+              SwapRequest *request = iter->data;
+
+              memcpy (dest, request->data, request->size);
+              dest += request->size;
+            }
+
+          err = tile_swap_io (swap_file->fd, SWAP_OUT,
+                              buffer, size, first->offset);
+
+          g_free (buffer);
+        }
+
+      SWAP_LOCK;
+
+      if (err < size)
+        swap_file->write_errno = errno ? errno : EIO;
+
+      while (run != list)
+        {
+          SwapRequest *request = run->data;
+
+          request->in_progress = FALSE;
+          swap_file->write_bytes -= request->size;
+
+          if (request->cancelled)
+            {
+              tile_swap_release (swap_file,
+                                 request->offset,
+                                 request->offset + request->slot);
+              tile_swap_request_free (request);
+            }
+          else if (g_hash_table_lookup (swap_file->writes,
+                                        &request->offset) != request)
+            {
+              /*  superseded by a later write  */
+              tile_swap_request_free (request);
+            }
+          else if (err < size)
+            {
+              /*  keep the data around, the tile can be swapped in
+               *  from memory
+               */
+              request->failed = TRUE;
+            }
+          else
+            {
+              g_hash_table_remove (swap_file->writes, &request->offset);
+              tile_swap_request_free (request);
+            }
+
+          run = g_list_next (run);
+        }
+
+      g_cond_broadcast (swap_file->io_cond);
+
+      SWAP_UNLOCK;
+    }
+}
+
+static void
+tile_swap_io_read (SwapFile    *swap_file,
+                   SwapRequest *request)
+{
+  gboolean cancelled;
+  gint     err = -1;
+
+  SWAP_LOCK;
+
+  request->in_progress = TRUE;
+  cancelled = request->cancelled;
+
+  SWAP_UNLOCK;
+
+  if (! cancelled)
+    err = tile_swap_io (swap_file->fd, SWAP_IN,
+                        request->data, request->size, request->offset);
+
+  SWAP_LOCK;
+
+  request->in_progress = FALSE;
+
+  if (request->cancelled)
+    {
+      tile_swap_request_free (request);
+    }
+  else if (err < request->size)
+    {
+      g_hash_table_remove (swap_file->reads, &request->offset);
+      g_queue_remove (swap_file->read_order, request);
+
+      tile_swap_request_free (request);
+    }
+  else
+    {
+      request->done = TRUE;
+    }
+
+  SWAP_UNLOCK;
+}
+
+/*  Forgets about tile data read ahead from @offset. */
+static void
+tile_swap_drop_read (SwapFile *swap_file,
+                     gint64    offset)
+{
+  SwapRequest *request = g_hash_table_lookup (swap_file->reads, &offset);
+
+  if (request)
+    {
+      g_hash_table_remove (swap_file->reads, &offset);
+      g_queue_remove (swap_file->read_order, request);
+
+      if (request->done)
+        tile_swap_request_free (request);
+      else
+        request->cancelled = TRUE;
+    }
+}
+
+static void
+tile_swap_request_free (SwapRequest *request)
+{
+  g_free (request->data);
+  g_slice_free (SwapRequest, request);
+}
+
+/*  the writes are keyed by their offset, which is inside the request  */
+static void
+tile_swap_write_free (gpointer key,
+                      gpointer value,
+                      gpointer data)
+{
+  tile_swap_request_free (value);
+}
+
+static guint
+tile_swap_offset_hash (gconstpointer key)
+{
+  const gint64 offset = *(const gint64 *) key;
+
+  return (guint) (offset ^ (offset >> 32));
+}
+
+static gboolean
+tile_swap_offset_equal (gconstpointer a,
+                        gconstpointer b)
+{
+  return *(const gint64 *) a == *(const gint64 *) b;
+}
+
+#endif /* ENABLE_MP */
@@ -25,9 +25,12 @@ void     tile_swap_exit     (void);
 
 gboolean tile_swap_test     (void);
 
+void     tile_swap_set_compressed_size (guint64  size);
+
 void     tile_swap_in       (Tile        *tile);
 void     tile_swap_out      (Tile        *tile);
 void     tile_swap_delete   (Tile        *tile);
+void     tile_swap_prefetch (Tile        *tile);
 
 
 #endif /* __TILE_SWAP_H__ */
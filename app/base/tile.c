@@ -18,6 +18,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <glib-object.h>
 
 #include "base-types.h"
@@ -38,7 +40,7 @@
 
 
 /*  This is being used from tile-swap, but just for debugging purposes.  */
-static gint tile_ref_count    = 0;
+static volatile gint tile_ref_count = 0;
 
 
 #ifdef TILE_PROFILING
@@ -53,8 +55,25 @@ static gint tile_exist_count  = 0;
 #endif
 
 
-static void tile_destroy (Tile *tile);
+#ifdef ENABLE_MP
+GStaticMutex tile_mutexes[N_TILE_MUTEXES];
+#endif
+
+
+static void     tile_destroy       (Tile *tile);
+static void     tile_fill_uniform  (Tile *tile);
+
+
+void
+tile_init (void)
+{
+#ifdef ENABLE_MP
+  gint i;
 
+  for (i = 0; i < N_TILE_MUTEXES; i++)
+    g_static_mutex_init (&tile_mutexes[i]);
+#endif
+}
 
 Tile *
 tile_new (gint bpp)
@@ -78,7 +97,9 @@ tile_lock (Tile *tile)
 {
   /* Increment the global reference count.
    */
-  tile_ref_count++;
+  g_atomic_int_add (&tile_ref_count, 1);
+
+  TILE_LOCK (tile);
 
   /* Increment this tile's reference count.
    */
@@ -86,11 +107,8 @@ tile_lock (Tile *tile)
 
   if (tile->ref_count == 1)
     {
-      if (tile->listhead)
-        {
-          /* remove from cache, move to main store */
-          tile_cache_flush (tile);
-        }
+      /* remove from cache, move to main store */
+      tile_cache_lookup (tile);
 
 #ifdef TILE_PROFILING
       tile_active_count++;
@@ -99,17 +117,51 @@ tile_lock (Tile *tile)
 
   if (tile->data == NULL)
     {
-      /* There is no data, so the tile must be swapped out */
-      tile_swap_in (tile);
+      /* There is no data, so the tile is uniform or swapped out */
+      if (tile->uniform)
+        tile_fill_uniform (tile);
+      else
+        tile_swap_in (tile);
+    }
+
+#ifdef ENABLE_MP
+  /* If another thread is validating the tile, wait until it is done.
+   * The validating thread itself may lock the tile again meanwhile.
+   */
+  while (G_UNLIKELY (tile->validator && tile->validator != g_thread_self ()))
+    {
+      TILE_UNLOCK (tile);
+      g_thread_yield ();
+      TILE_LOCK (tile);
     }
+#endif
 
   /* Call 'tile_manager_validate' if the tile was invalid.
    */
   if (! tile->valid)
     {
       /* an invalid tile should never be shared, so this should work */
-      tile_manager_validate (tile->tlink->tm, tile);
+      TileManager *tm = tile->tlink->tm;
+
+#ifdef ENABLE_MP
+      tile->validator = g_thread_self ();
+#endif
+
+      /* the validate proc may do just about anything, including
+       * waiting for other threads, so don't hold the lock
+       */
+      TILE_UNLOCK (tile);
+
+      tile_manager_validate (tm, tile);
+
+      TILE_LOCK (tile);
+
+#ifdef ENABLE_MP
+      tile->validator = NULL;
+#endif
     }
+
+  TILE_UNLOCK (tile);
 }
 
 void
@@ -118,7 +170,9 @@ tile_release (Tile     *tile,
 {
   /* Decrement the global reference count.
    */
-  tile_ref_count--;
+  g_atomic_int_add (&tile_ref_count, -1);
+
+  TILE_LOCK (tile);
 
   /* Decrement this tile's reference count.
    */
@@ -147,6 +201,8 @@ tile_release (Tile     *tile,
 
       if (tile->share_count == 0)
         {
+          TILE_UNLOCK (tile);
+
           /* tile is truly dead */
           tile_destroy (tile);
           return;                        /* skip terminal unlock */
@@ -158,6 +214,8 @@ tile_release (Tile     *tile,
           tile_cache_insert (tile);
         }
     }
+
+  TILE_UNLOCK (tile);
 }
 
 void
@@ -200,7 +258,7 @@ tile_destroy (Tile *tile)
       g_slice_free1 (sizeof (TileRowHint) * TILE_HEIGHT, tile->rowhint);
       tile->rowhint = NULL;
     }
-  if (tile->swap_offset != -1)
+  if (TILE_IS_SWAPPED (tile))
     {
       /* If the tile is on disk, then delete its
        *  presence there.
@@ -252,6 +310,38 @@ tile_is_valid (Tile *tile)
   return tile->valid;
 }
 
+gboolean
+tile_is_uniform (Tile   *tile,
+                 guchar *pixel)
+{
+  gboolean uniform;
+
+  TILE_LOCK (tile);
+
+  uniform = tile->uniform && tile->valid;
+
+  if (uniform && pixel)
+    memcpy (pixel, tile->pixel, tile->bpp);
+
+  TILE_UNLOCK (tile);
+
+  return uniform;
+}
+
+void
+tile_set_uniform (Tile         *tile,
+                  const guchar *pixel)
+{
+  g_return_if_fail (tile->write_count > 0);
+
+  TILE_LOCK (tile);
+
+  memcpy (tile->pixel, pixel, tile->bpp);
+  tile->uniform = TRUE;
+
+  TILE_UNLOCK (tile);
+}
+
 void
 tile_attach (Tile *tile,
              void *tm,
@@ -265,6 +355,14 @@ tile_attach (Tile *tile,
       tile_manager_validate (tile->tlink->tm, tile);
     }
 
+  /* link this tile into the tile's tilelink chain */
+  tmp = g_slice_new (TileLink);
+
+  tmp->tm       = tm;
+  tmp->tile_num = tile_num;
+
+  TILE_LOCK (tile);
+
   tile->share_count++;
 
 #ifdef TILE_PROFILING
@@ -276,14 +374,10 @@ tile_attach (Tile *tile,
               tile, tm, tile_num, tile->share_count);
 #endif
 
-  /* link this tile into the tile's tilelink chain */
-  tmp = g_slice_new (TileLink);
-
-  tmp->tm       = tm;
-  tmp->tile_num = tile_num;
-  tmp->next     = tile->tlink;
-
+  tmp->next   = tile->tlink;
   tile->tlink = tmp;
+
+  TILE_UNLOCK (tile);
 }
 
 void
@@ -293,12 +387,15 @@ tile_detach (Tile *tile,
 {
   TileLink **link;
   TileLink  *tmp;
+  gboolean   dead;
 
 #ifdef TILE_DEBUG
   g_printerr ("tile_detach: %p ~> (%p,%d) r%d *%d\n",
               tile, tm, tile_num, tile->ref_count, tile->share_count);
 #endif
 
+  TILE_LOCK (tile);
+
   for (link = &tile->tlink;
        *link != NULL;
        link = &(*link)->next)
@@ -309,6 +406,8 @@ tile_detach (Tile *tile,
 
   if (G_UNLIKELY (*link == NULL))
     {
+      TILE_UNLOCK (tile);
+
       g_warning ("Tried to detach a nonattached tile -- TILE BUG!");
       return;
     }
@@ -316,15 +415,19 @@ tile_detach (Tile *tile,
   tmp = *link;
   *link = tmp->next;
 
-  g_slice_free (TileLink, tmp);
-
 #ifdef TILE_PROFILING
   tile_share_count--;
 #endif
 
   tile->share_count--;
 
-  if (tile->share_count == 0 && tile->ref_count == 0)
+  dead = (tile->share_count == 0 && tile->ref_count == 0);
+
+  TILE_UNLOCK (tile);
+
+  g_slice_free (TileLink, tmp);
+
+  if (dead)
     tile_destroy (tile);
 }
 
@@ -341,5 +444,75 @@ tile_data_pointer (Tile *tile,
 gint
 tile_global_refcount (void)
 {
-  return tile_ref_count;
+  return g_atomic_int_get (&tile_ref_count);
+}
+
+static void
+tile_fill_uniform (Tile *tile)
+{
+  guchar *d;
+  gint    n;
+
+  tile_alloc (tile);
+
+  d = tile->data;
+  n = tile->ewidth * tile->eheight;
+
+  switch (tile->bpp)
+    {
+    case 1:
+      memset (d, tile->pixel[0], n);
+      break;
+
+    default:
+      {
+        /*  set the first row, then copy it  */
+        gint rowstride = tile->ewidth * tile->bpp;
+        gint x, y;
+
+        for (x = 0; x < tile->ewidth; x++, d += tile->bpp)
+          memcpy (d, tile->pixel, tile->bpp);
+
+        for (y = 1; y < tile->eheight; y++, d += rowstride)
+          memcpy (d, tile->data, rowstride);
+      }
+      break;
+    }
+}
+
+/*  Called when a tile leaves the tile cache. If all its pixels have
+ *  the same value, marks the tile uniform and frees its data and any
+ *  copy in the swap file. Only tiles that were written since they were
+ *  last swapped out are checked. Returns TRUE if the data was freed.
+ */
+gboolean
+tile_free_uniform (Tile *tile)
+{
+  /*  tile_set_uniform() was called since the tile was last written  */
+  if (! tile->uniform)
+    {
+      const guchar *d   = tile->data;
+      const guchar *end = d + tile->size;
+      gint          bpp = tile->bpp;
+
+      if (! tile->dirty || ! tile->valid || ! d)
+        return FALSE;
+
+      for (d += bpp; d < end; d += bpp)
+        if (memcmp (d, tile->data, bpp))
+          return FALSE;
+
+      memcpy (tile->pixel, tile->data, bpp);
+      tile->uniform = TRUE;
+    }
+
+  tile->dirty = FALSE;
+
+  if (TILE_IS_SWAPPED (tile))
+    tile_swap_delete (tile);
+
+  g_free (tile->data);
+  tile->data = NULL;
+
+  return TRUE;
 }
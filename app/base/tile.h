@@ -24,6 +24,10 @@
 #define TILE_HEIGHT  64
 
 
+/* Sets up the locks that make tiles safe to use from several threads.
+ */
+void        tile_init            (void);
+
 /* Returns a newly allocated Tile with all fields initialized to "good" values.
  */
 Tile      * tile_new             (gint      bpp);
@@ -56,6 +60,17 @@ gint        tile_bpp             (Tile     *tile);
 
 gboolean    tile_is_valid        (Tile     *tile);
 
+/* A tile whose pixels all have the same value only stores that value
+ * once it drops out of the tile cache. tile_is_uniform returns that
+ * value. Callers that fill a tile locked for writing with a single value
+ * can tell so with tile_set_uniform, otherwise the tile is checked when
+ * it leaves the cache.
+ */
+gboolean    tile_is_uniform      (Tile         *tile,
+                                  guchar       *pixel);
+void        tile_set_uniform     (Tile         *tile,
+                                  const guchar *pixel);
+
 void      * tile_data_pointer    (Tile     *tile,
                                   gint      xoff,
                                   gint      yoff);
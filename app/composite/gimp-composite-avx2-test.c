@@ -0,0 +1,920 @@
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base/base-types.h"
+
+#include "gimp-composite.h"
+#include "gimp-composite-regression.h"
+#include "gimp-composite-util.h"
+#include "gimp-composite-generic.h"
+#include "gimp-composite-avx2.h"
+
+int
+gimp_composite_avx2_test (int iterations, int n_pixels)
+{
+#if defined(COMPILE_AVX2_IS_OKAY)
+  GimpCompositeContext generic_ctx;
+  GimpCompositeContext special_ctx;
+  double ft0;
+  double ft1;
+  gimp_rgba8_t *rgba8D1;
+  gimp_rgba8_t *rgba8D2;
+  gimp_rgba8_t *rgba8A;
+  gimp_rgba8_t *rgba8B;
+  gimp_rgba8_t *rgba8M;
+  gimp_va8_t *va8A;
+  gimp_va8_t *va8B;
+  gimp_va8_t *va8M;
+  gimp_va8_t *va8D1;
+  gimp_va8_t *va8D2;
+  gimp_rgb8_t *rgb8A;
+  gimp_rgb8_t *rgb8B;
+  gimp_rgb8_t *rgb8D1;
+  gimp_rgb8_t *rgb8D2;
+  gimp_v8_t *v8A;
+  gimp_v8_t *v8B;
+  gimp_v8_t *v8D1;
+  gimp_v8_t *v8D2;
+  int i;
+
+  if (gimp_composite_avx2_init () == 0)
+    {
+      g_print ("\ngimp_composite_avx2: Instruction set is not available.\n");
+      return EXIT_SUCCESS;
+    }
+
+  g_print ("\nRunning gimp_composite_avx2 tests...\n");
+
+  rgba8A =  gimp_composite_regression_random_rgba8(n_pixels+1);
+  rgba8B =  gimp_composite_regression_random_rgba8(n_pixels+1);
+  rgba8M =  gimp_composite_regression_random_rgba8(n_pixels+1);
+  rgba8D1 = (gimp_rgba8_t *) calloc(sizeof(gimp_rgba8_t), n_pixels+1);
+  rgba8D2 = (gimp_rgba8_t *) calloc(sizeof(gimp_rgba8_t), n_pixels+1);
+  va8A =    (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
+  va8B =    (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
+  va8M =    (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
+  va8D1 =   (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
+  va8D2 =   (gimp_va8_t *)   calloc(sizeof(gimp_va8_t), n_pixels+1);
+  rgb8A =   (gimp_rgb8_t *)  calloc(sizeof(gimp_rgb8_t), n_pixels+1);
+  rgb8B =   (gimp_rgb8_t *)  calloc(sizeof(gimp_rgb8_t), n_pixels+1);
+  rgb8D1 =  (gimp_rgb8_t *)  calloc(sizeof(gimp_rgb8_t), n_pixels+1);
+  rgb8D2 =  (gimp_rgb8_t *)  calloc(sizeof(gimp_rgb8_t), n_pixels+1);
+  v8A =     (gimp_v8_t *)    calloc(sizeof(gimp_v8_t), n_pixels+1);
+  v8B =     (gimp_v8_t *)    calloc(sizeof(gimp_v8_t), n_pixels+1);
+  v8D1 =    (gimp_v8_t *)    calloc(sizeof(gimp_v8_t), n_pixels+1);
+  v8D2 =    (gimp_v8_t *)    calloc(sizeof(gimp_v8_t), n_pixels+1);
+
+  for (i = 0; i < n_pixels; i++)
+    {
+      va8A[i].v = i;
+      va8A[i].a = 255-i;
+      va8B[i].v = i;
+      va8B[i].a = i;
+      va8M[i].v = i;
+      va8M[i].a = i;
+      rgb8A[i].r = rgba8A[i].r;
+      rgb8A[i].g = rgba8A[i].g;
+      rgb8A[i].b = rgba8A[i].b;
+      rgb8B[i].r = rgba8B[i].r;
+      rgb8B[i].g = rgba8B[i].g;
+      rgb8B[i].b = rgba8B[i].b;
+      v8A[i].v = rgba8A[i].a;
+      v8B[i].v = rgba8B[i].a;
+    }
+
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_addition_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("addition", &generic_ctx, &special_ctx))
+    {
+      g_print ("addition_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("addition_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_addition_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("addition", &generic_ctx, &special_ctx))
+    {
+      g_print ("addition_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("addition_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_BLEND, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_BLEND, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_blend_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("blend", &generic_ctx, &special_ctx))
+    {
+      g_print ("blend_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("blend_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_BLEND, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_BLEND, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_blend_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("blend", &generic_ctx, &special_ctx))
+    {
+      g_print ("blend_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("blend_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_BURN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_BURN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_burn_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("burn", &generic_ctx, &special_ctx))
+    {
+      g_print ("burn_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("burn_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_BURN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_BURN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_burn_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("burn", &generic_ctx, &special_ctx))
+    {
+      g_print ("burn_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("burn_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_darken_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("darken", &generic_ctx, &special_ctx))
+    {
+      g_print ("darken_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("darken_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_darken_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("darken", &generic_ctx, &special_ctx))
+    {
+      g_print ("darken_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("darken_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_difference_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("difference", &generic_ctx, &special_ctx))
+    {
+      g_print ("difference_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("difference_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_difference_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("difference", &generic_ctx, &special_ctx))
+    {
+      g_print ("difference_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("difference_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIVIDE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIVIDE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_divide_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("divide", &generic_ctx, &special_ctx))
+    {
+      g_print ("divide_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("divide_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIVIDE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIVIDE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_divide_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("divide", &generic_ctx, &special_ctx))
+    {
+      g_print ("divide_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("divide_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DODGE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DODGE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_dodge_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("dodge", &generic_ctx, &special_ctx))
+    {
+      g_print ("dodge_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("dodge_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DODGE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DODGE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_dodge_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("dodge", &generic_ctx, &special_ctx))
+    {
+      g_print ("dodge_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("dodge_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_extract_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("grain_extract", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_extract_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_extract_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_extract_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("grain_extract", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_extract_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_extract_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_merge_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("grain_merge", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_merge_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_merge_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_merge_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("grain_merge", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_merge_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_merge_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_HARDLIGHT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_HARDLIGHT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_hardlight_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("hardlight", &generic_ctx, &special_ctx))
+    {
+      g_print ("hardlight_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("hardlight_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_HARDLIGHT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_HARDLIGHT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_hardlight_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("hardlight", &generic_ctx, &special_ctx))
+    {
+      g_print ("hardlight_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("hardlight_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_lighten_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("lighten", &generic_ctx, &special_ctx))
+    {
+      g_print ("lighten_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("lighten_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_lighten_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("lighten", &generic_ctx, &special_ctx))
+    {
+      g_print ("lighten_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("lighten_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_multiply_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("multiply", &generic_ctx, &special_ctx))
+    {
+      g_print ("multiply_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("multiply_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_multiply_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("multiply", &generic_ctx, &special_ctx))
+    {
+      g_print ("multiply_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("multiply_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_OVERLAY, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_OVERLAY, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_overlay_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("overlay", &generic_ctx, &special_ctx))
+    {
+      g_print ("overlay_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("overlay_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_OVERLAY, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_OVERLAY, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_overlay_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("overlay", &generic_ctx, &special_ctx))
+    {
+      g_print ("overlay_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("overlay_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCALE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCALE, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_scale_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("scale", &generic_ctx, &special_ctx))
+    {
+      g_print ("scale_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("scale_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCALE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCALE, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_scale_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("scale", &generic_ctx, &special_ctx))
+    {
+      g_print ("scale_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("scale_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_screen_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("screen", &generic_ctx, &special_ctx))
+    {
+      g_print ("screen_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("screen_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_screen_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("screen", &generic_ctx, &special_ctx))
+    {
+      g_print ("screen_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("screen_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SOFTLIGHT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SOFTLIGHT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_softlight_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("softlight", &generic_ctx, &special_ctx))
+    {
+      g_print ("softlight_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("softlight_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SOFTLIGHT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SOFTLIGHT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_softlight_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("softlight", &generic_ctx, &special_ctx))
+    {
+      g_print ("softlight_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("softlight_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_subtract_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("subtract", &generic_ctx, &special_ctx))
+    {
+      g_print ("subtract_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("subtract_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_subtract_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("subtract", &generic_ctx, &special_ctx))
+    {
+      g_print ("subtract_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("subtract_rgba8_rgba8_rgba8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, GIMP_PIXELFORMAT_VA8, n_pixels, (unsigned char *) va8A, (unsigned char *) va8B, (unsigned char *) va8B, (unsigned char *) va8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_swap_va8_va8_va8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("swap", &generic_ctx, &special_ctx))
+    {
+      g_print ("swap_va8_va8_va8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("swap_va8_va8_va8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, GIMP_PIXELFORMAT_RGBA8, n_pixels, (unsigned char *) rgba8A, (unsigned char *) rgba8B, (unsigned char *) rgba8B, (unsigned char *) rgba8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_swap_rgba8_rgba8_rgba8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("swap", &generic_ctx, &special_ctx))
+    {
+      g_print ("swap_rgba8_rgba8_rgba8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("swap_rgba8_rgba8_rgba8", ft0, ft1);
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_addition_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("addition", &generic_ctx, &special_ctx))
+    {
+      g_print ("addition_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("addition_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_ADDITION, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_addition_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("addition", &generic_ctx, &special_ctx))
+    {
+      g_print ("addition_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("addition_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_BLEND, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_BLEND, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_blend_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("blend", &generic_ctx, &special_ctx))
+    {
+      g_print ("blend_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("blend_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_BLEND, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_BLEND, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_blend_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("blend", &generic_ctx, &special_ctx))
+    {
+      g_print ("blend_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("blend_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_BURN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_BURN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_burn_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("burn", &generic_ctx, &special_ctx))
+    {
+      g_print ("burn_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("burn_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_BURN, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_BURN, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_burn_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("burn", &generic_ctx, &special_ctx))
+    {
+      g_print ("burn_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("burn_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_darken_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("darken", &generic_ctx, &special_ctx))
+    {
+      g_print ("darken_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("darken_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DARKEN, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_darken_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("darken", &generic_ctx, &special_ctx))
+    {
+      g_print ("darken_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("darken_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_difference_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("difference", &generic_ctx, &special_ctx))
+    {
+      g_print ("difference_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("difference_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIFFERENCE, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_difference_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("difference", &generic_ctx, &special_ctx))
+    {
+      g_print ("difference_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("difference_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIVIDE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIVIDE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_divide_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("divide", &generic_ctx, &special_ctx))
+    {
+      g_print ("divide_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("divide_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DIVIDE, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DIVIDE, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_divide_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("divide", &generic_ctx, &special_ctx))
+    {
+      g_print ("divide_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("divide_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DODGE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DODGE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_dodge_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("dodge", &generic_ctx, &special_ctx))
+    {
+      g_print ("dodge_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("dodge_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_DODGE, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_DODGE, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_dodge_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("dodge", &generic_ctx, &special_ctx))
+    {
+      g_print ("dodge_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("dodge_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_extract_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("grain_extract", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_extract_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_extract_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_EXTRACT, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_extract_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("grain_extract", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_extract_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_extract_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_merge_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("grain_merge", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_merge_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_merge_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_GRAIN_MERGE, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_grain_merge_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("grain_merge", &generic_ctx, &special_ctx))
+    {
+      g_print ("grain_merge_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("grain_merge_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_HARDLIGHT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_HARDLIGHT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_hardlight_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("hardlight", &generic_ctx, &special_ctx))
+    {
+      g_print ("hardlight_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("hardlight_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_HARDLIGHT, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_HARDLIGHT, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_hardlight_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("hardlight", &generic_ctx, &special_ctx))
+    {
+      g_print ("hardlight_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("hardlight_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_lighten_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("lighten", &generic_ctx, &special_ctx))
+    {
+      g_print ("lighten_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("lighten_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_LIGHTEN, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_lighten_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("lighten", &generic_ctx, &special_ctx))
+    {
+      g_print ("lighten_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("lighten_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_multiply_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("multiply", &generic_ctx, &special_ctx))
+    {
+      g_print ("multiply_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("multiply_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_MULTIPLY, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_multiply_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("multiply", &generic_ctx, &special_ctx))
+    {
+      g_print ("multiply_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("multiply_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_OVERLAY, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_OVERLAY, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_overlay_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("overlay", &generic_ctx, &special_ctx))
+    {
+      g_print ("overlay_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("overlay_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_OVERLAY, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_OVERLAY, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_overlay_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("overlay", &generic_ctx, &special_ctx))
+    {
+      g_print ("overlay_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("overlay_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCALE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCALE, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_scale_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("scale", &generic_ctx, &special_ctx))
+    {
+      g_print ("scale_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("scale_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCALE, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCALE, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_scale_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("scale", &generic_ctx, &special_ctx))
+    {
+      g_print ("scale_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("scale_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_screen_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("screen", &generic_ctx, &special_ctx))
+    {
+      g_print ("screen_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("screen_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SCREEN, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_screen_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("screen", &generic_ctx, &special_ctx))
+    {
+      g_print ("screen_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("screen_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SOFTLIGHT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SOFTLIGHT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_softlight_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("softlight", &generic_ctx, &special_ctx))
+    {
+      g_print ("softlight_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("softlight_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SOFTLIGHT, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SOFTLIGHT, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_softlight_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("softlight", &generic_ctx, &special_ctx))
+    {
+      g_print ("softlight_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("softlight_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_subtract_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("subtract", &generic_ctx, &special_ctx))
+    {
+      g_print ("subtract_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("subtract_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SUBTRACT, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_subtract_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("subtract", &generic_ctx, &special_ctx))
+    {
+      g_print ("subtract_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("subtract_rgb8_rgb8_rgb8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, GIMP_PIXELFORMAT_V8, n_pixels, (unsigned char *) v8A, (unsigned char *) v8B, (unsigned char *) v8B, (unsigned char *) v8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_swap_v8_v8_v8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("swap", &generic_ctx, &special_ctx))
+    {
+      g_print ("swap_v8_v8_v8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("swap_v8_v8_v8", ft0, ft1);
+
+  gimp_composite_context_init (&special_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D2);
+  gimp_composite_context_init (&generic_ctx, GIMP_COMPOSITE_SWAP, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, GIMP_PIXELFORMAT_RGB8, n_pixels, (unsigned char *) rgb8A, (unsigned char *) rgb8B, (unsigned char *) rgb8B, (unsigned char *) rgb8D1);
+  ft0 = gimp_composite_regression_time_function (iterations, gimp_composite_dispatch, &generic_ctx);
+  ft1 = gimp_composite_regression_time_function (iterations, gimp_composite_swap_rgb8_rgb8_rgb8_avx2, &special_ctx);
+  if (gimp_composite_regression_compare_contexts ("swap", &generic_ctx, &special_ctx))
+    {
+      g_print ("swap_rgb8_rgb8_rgb8 failed\n");
+      return EXIT_FAILURE;
+    }
+  gimp_composite_regression_timer_report ("swap_rgb8_rgb8_rgb8", ft0, ft1);
+#endif
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int iterations;
+  int n_pixels;
+
+  srand (314159);
+
+  putenv ("GIMP_COMPOSITE=0x1");
+
+  iterations = 10;
+  n_pixels = 8388625;
+
+  argv++, argc--;
+  while (argc >= 2)
+    {
+      if (argc > 1 && (strcmp (argv[0], "--iterations") == 0 || strcmp (argv[0], "-i") == 0))
+        {
+          iterations = atoi(argv[1]);
+          argc -= 2, argv++; argv++;
+        }
+      else if (argc > 1 && (strcmp (argv[0], "--n-pixels") == 0 || strcmp (argv[0], "-n") == 0))
+        {
+          n_pixels = atoi (argv[1]);
+          argc -= 2, argv++; argv++;
+        }
+      else
+        {
+          g_print ("Usage: gimp-composites-*-test [-i|--iterations n] [-n|--n-pixels n]");
+          return EXIT_FAILURE;
+        }
+    }
+
+  gimp_composite_generic_install ();
+
+  return (gimp_composite_avx2_test (iterations, n_pixels));
+}
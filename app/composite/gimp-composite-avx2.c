@@ -0,0 +1,967 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Gimp image compositing
+ * Copyright (C) 2003  Helvetix Victorinox, a pseudonym, <helvetix@gimp.org>
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "base/base-types.h"
+
+#include "gimp-composite.h"
+#include "gimp-composite-avx2.h"
+
+#ifdef COMPILE_AVX2_IS_OKAY
+
+#include <immintrin.h>
+
+#include "gimp-composite-generic.h"
+
+/*
+ * All of the modes implemented here are independent per byte, so the
+ * pixels are treated as a plain stream of bytes, 32 at a time.  The
+ * colour bytes get the mode's operation, the alpha bytes (selected by
+ * an alpha mask) get MIN(A, B), exactly as the generic functions do
+ * when both sources have alpha.  Without alpha (RGB8 and V8) every
+ * byte gets the operation, so the 3 byte pixels need no shuffling.
+ * A run that is not a multiple of 32 bytes is finished through a
+ * bounce buffer on the stack.
+ *
+ * Every function produces results that are bit-identical to the
+ * generic implementation, rounding and truncation included, as
+ * checked by gimp-composite-avx2-test.
+ */
+
+#define AVX2_BYTES (32)
+
+static const guint32 rgba8_alpha_mask_256[8] =
+{
+  0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+  0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000
+};
+
+static const guint32 va8_alpha_mask_256[8] =
+{
+  0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00,
+  0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00
+};
+
+static const guint32 no_alpha_mask_256[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+
+/*  helpers working on 16 bit lanes holding values 0..255  */
+
+static inline __m256i
+avx2_int_mult_w (__m256i a,
+                 __m256i b)
+{
+  /*  INT_MULT(a,b,t): t = a * b + 0x80, ((t >> 8) + t) >> 8  */
+  __m256i t = _mm256_add_epi16 (_mm256_mullo_epi16 (a, b),
+                                _mm256_set1_epi16 (0x80));
+
+  return _mm256_srli_epi16 (_mm256_add_epi16 (_mm256_srli_epi16 (t, 8), t), 8);
+}
+
+static inline __m256i
+avx2_div_255_w (__m256i x)
+{
+  /*  x / 255 for 0 <= x <= 255 * 255  */
+  x = _mm256_add_epi16 (x, _mm256_add_epi16 (_mm256_srli_epi16 (x, 8),
+                                             _mm256_set1_epi16 (1)));
+
+  return _mm256_srli_epi16 (x, 8);
+}
+
+/*  Widens the bytes of a and b to 16 bits, applies op to both halves
+ *  and packs the results back with unsigned saturation.
+ */
+#define AVX2_VIA_WORDS(a, b, k, op)                                    \
+  _mm256_packus_epi16 (op (_mm256_unpacklo_epi8 (a, _mm256_setzero_si256 ()), \
+                           _mm256_unpacklo_epi8 (b, _mm256_setzero_si256 ()), \
+                           k),                                         \
+                       op (_mm256_unpackhi_epi8 (a, _mm256_setzero_si256 ()), \
+                           _mm256_unpackhi_epi8 (b, _mm256_setzero_si256 ()), \
+                           k))
+
+/*  Widens the bytes of a and b to 32 bits, applies op to the four
+ *  quarters and packs the results back into byte order.
+ */
+#define AVX2_VIA_DWORDS(a, b, op)                                      \
+  avx2_pack_dwords (op (_mm256_cvtepu8_epi32 (_mm256_castsi256_si128 (a)), \
+                        _mm256_cvtepu8_epi32 (_mm256_castsi256_si128 (b))), \
+                    op (_mm256_cvtepu8_epi32 (_mm_srli_si128 (_mm256_castsi256_si128 (a), 8)), \
+                        _mm256_cvtepu8_epi32 (_mm_srli_si128 (_mm256_castsi256_si128 (b), 8))), \
+                    op (_mm256_cvtepu8_epi32 (_mm256_extracti128_si256 (a, 1)), \
+                        _mm256_cvtepu8_epi32 (_mm256_extracti128_si256 (b, 1))), \
+                    op (_mm256_cvtepu8_epi32 (_mm_srli_si128 (_mm256_extracti128_si256 (a, 1), 8)), \
+                        _mm256_cvtepu8_epi32 (_mm_srli_si128 (_mm256_extracti128_si256 (b, 1), 8))))
+
+static inline __m256i
+avx2_pack_dwords (__m256i q0,
+                  __m256i q1,
+                  __m256i q2,
+                  __m256i q3)
+{
+  /*  the packs work within 128 bit lanes, the permutes undo that  */
+  __m256i w01 = _mm256_permute4x64_epi64 (_mm256_packus_epi32 (q0, q1), 0xD8);
+  __m256i w23 = _mm256_permute4x64_epi64 (_mm256_packus_epi32 (q2, q3), 0xD8);
+
+  return _mm256_permute4x64_epi64 (_mm256_packus_epi16 (w01, w23), 0xD8);
+}
+
+
+/*  the per byte operations  */
+
+static inline __m256i
+avx2_addition (__m256i a,
+               __m256i b,
+               __m256i k)
+{
+  return _mm256_adds_epu8 (a, b);
+}
+
+static inline __m256i
+avx2_subtract (__m256i a,
+               __m256i b,
+               __m256i k)
+{
+  return _mm256_subs_epu8 (a, b);
+}
+
+static inline __m256i
+avx2_difference (__m256i a,
+                 __m256i b,
+                 __m256i k)
+{
+  return _mm256_or_si256 (_mm256_subs_epu8 (a, b), _mm256_subs_epu8 (b, a));
+}
+
+static inline __m256i
+avx2_darken (__m256i a,
+             __m256i b,
+             __m256i k)
+{
+  return _mm256_min_epu8 (a, b);
+}
+
+static inline __m256i
+avx2_lighten (__m256i a,
+              __m256i b,
+              __m256i k)
+{
+  return _mm256_max_epu8 (a, b);
+}
+
+static inline __m256i
+avx2_grain_extract (__m256i a,
+                    __m256i b,
+                    __m256i k)
+{
+  /*  CLAMP (a - b + 128, 0, 255) computed as a signed byte  */
+  __m256i bias = _mm256_set1_epi8 ((gchar) 0x80);
+
+  return _mm256_xor_si256 (_mm256_subs_epi8 (_mm256_xor_si256 (a, bias),
+                                             _mm256_xor_si256 (b, bias)),
+                           bias);
+}
+
+static inline __m256i
+avx2_grain_merge_w (__m256i a,
+                    __m256i b,
+                    __m256i k)
+{
+  /*  CLAMP (a + b - 128, 0, 255), the packing does the clamping  */
+  return _mm256_sub_epi16 (_mm256_add_epi16 (a, b), _mm256_set1_epi16 (128));
+}
+
+static inline __m256i
+avx2_grain_merge (__m256i a,
+                  __m256i b,
+                  __m256i k)
+{
+  return AVX2_VIA_WORDS (a, b, k, avx2_grain_merge_w);
+}
+
+static inline __m256i
+avx2_multiply_w (__m256i a,
+                 __m256i b,
+                 __m256i k)
+{
+  return avx2_int_mult_w (a, b);
+}
+
+static inline __m256i
+avx2_multiply (__m256i a,
+               __m256i b,
+               __m256i k)
+{
+  return AVX2_VIA_WORDS (a, b, k, avx2_multiply_w);
+}
+
+static inline __m256i
+avx2_screen_w (__m256i a,
+               __m256i b,
+               __m256i k)
+{
+  __m256i w255 = _mm256_set1_epi16 (255);
+
+  return _mm256_sub_epi16 (w255,
+                           avx2_int_mult_w (_mm256_sub_epi16 (w255, a),
+                                            _mm256_sub_epi16 (w255, b)));
+}
+
+static inline __m256i
+avx2_screen (__m256i a,
+             __m256i b,
+             __m256i k)
+{
+  return AVX2_VIA_WORDS (a, b, k, avx2_screen_w);
+}
+
+static inline __m256i
+avx2_hardlight_w (__m256i a,
+                  __m256i b,
+                  __m256i k)
+{
+  __m256i w255 = _mm256_set1_epi16 (255);
+  __m256i w128 = _mm256_set1_epi16 (128);
+  __m256i low;
+  __m256i high;
+
+  /*  b <= 128: (a * 2b) >> 8  */
+  low = _mm256_srli_epi16 (_mm256_mullo_epi16 (a, _mm256_slli_epi16 (b, 1)), 8);
+
+  /*  b > 128: 255 - (((255 - a) * (255 - 2 (b - 128))) >> 8)  */
+  high = _mm256_mullo_epi16 (_mm256_sub_epi16 (w255, a),
+                             _mm256_sub_epi16 (w255,
+                                               _mm256_slli_epi16 (_mm256_sub_epi16 (b, w128), 1)));
+  high = _mm256_sub_epi16 (w255, _mm256_srli_epi16 (high, 8));
+
+  return _mm256_blendv_epi8 (low, high, _mm256_cmpgt_epi16 (b, w128));
+}
+
+static inline __m256i
+avx2_hardlight (__m256i a,
+                __m256i b,
+                __m256i k)
+{
+  return AVX2_VIA_WORDS (a, b, k, avx2_hardlight_w);
+}
+
+static inline __m256i
+avx2_softlight_w (__m256i a,
+                  __m256i b,
+                  __m256i k)
+{
+  __m256i w255 = _mm256_set1_epi16 (255);
+  __m256i ia   = _mm256_sub_epi16 (w255, a);
+  __m256i m    = avx2_int_mult_w (a, b);
+  __m256i s    = _mm256_sub_epi16 (w255,
+                                   avx2_int_mult_w (ia,
+                                                    _mm256_sub_epi16 (w255, b)));
+  __m256i d    = _mm256_add_epi16 (avx2_int_mult_w (ia, m),
+                                   avx2_int_mult_w (a, s));
+
+  /*  the generic code truncates the sum to a byte  */
+  return _mm256_and_si256 (d, w255);
+}
+
+static inline __m256i
+avx2_softlight (__m256i a,
+                __m256i b,
+                __m256i k)
+{
+  return AVX2_VIA_WORDS (a, b, k, avx2_softlight_w);
+}
+
+static inline __m256i
+avx2_blend_w (__m256i a,
+              __m256i b,
+              __m256i k)
+{
+  /*  (a * (255 - blend) + b * blend) / 255, k holds blend  */
+  __m256i x = _mm256_add_epi16 (_mm256_mullo_epi16 (a, _mm256_sub_epi16 (_mm256_set1_epi16 (255), k)),
+                                _mm256_mullo_epi16 (b, k));
+
+  return avx2_div_255_w (x);
+}
+
+static inline __m256i
+avx2_blend (__m256i a,
+            __m256i b,
+            __m256i k)
+{
+  return AVX2_VIA_WORDS (a, b, k, avx2_blend_w);
+}
+
+static inline __m256i
+avx2_scale_w (__m256i a,
+              __m256i b,
+              __m256i k)
+{
+  return avx2_int_mult_w (a, k);
+}
+
+static inline __m256i
+avx2_scale (__m256i a,
+            __m256i b,
+            __m256i k)
+{
+  return AVX2_VIA_WORDS (a, b, k, avx2_scale_w);
+}
+
+static inline __m256i
+avx2_overlay_d (__m256i a,
+                __m256i b)
+{
+  /*  INT_MULT(a, a + INT_MULT(2 * b, 255 - a)), truncated to a byte  */
+  __m256i d255 = _mm256_set1_epi32 (255);
+  __m256i d128 = _mm256_set1_epi32 (0x80);
+  __m256i t;
+
+  t = _mm256_add_epi32 (_mm256_mullo_epi32 (_mm256_slli_epi32 (b, 1),
+                                            _mm256_sub_epi32 (d255, a)),
+                        d128);
+  t = _mm256_srli_epi32 (_mm256_add_epi32 (_mm256_srli_epi32 (t, 8), t), 8);
+
+  t = _mm256_add_epi32 (_mm256_mullo_epi32 (a, _mm256_add_epi32 (a, t)), d128);
+  t = _mm256_srli_epi32 (_mm256_add_epi32 (_mm256_srli_epi32 (t, 8), t), 8);
+
+  return _mm256_and_si256 (t, d255);
+}
+
+static inline __m256i
+avx2_overlay (__m256i a,
+              __m256i b,
+              __m256i k)
+{
+  return AVX2_VIA_DWORDS (a, b, avx2_overlay_d);
+}
+
+/*  The quotients below are only ever used when they are below 256,
+ *  where a single precision division truncated towards zero gives
+ *  the exact integer quotient.  Larger ones saturate either way.
+ */
+
+static inline __m256i
+avx2_divide_d (__m256i a,
+               __m256i b)
+{
+  /*  MIN ((a * 256) / (b + 1), 255)  */
+  __m256 n = _mm256_cvtepi32_ps (_mm256_slli_epi32 (a, 8));
+  __m256 d = _mm256_cvtepi32_ps (_mm256_add_epi32 (b, _mm256_set1_epi32 (1)));
+
+  return _mm256_min_epi32 (_mm256_cvttps_epi32 (_mm256_div_ps (n, d)),
+                           _mm256_set1_epi32 (255));
+}
+
+static inline __m256i
+avx2_divide (__m256i a,
+             __m256i b,
+             __m256i k)
+{
+  return AVX2_VIA_DWORDS (a, b, avx2_divide_d);
+}
+
+static inline __m256i
+avx2_dodge_d (__m256i a,
+              __m256i b)
+{
+  /*  MIN ((a << 8) / (256 - b), 255)  */
+  __m256 n = _mm256_cvtepi32_ps (_mm256_slli_epi32 (a, 8));
+  __m256 d = _mm256_cvtepi32_ps (_mm256_sub_epi32 (_mm256_set1_epi32 (256), b));
+
+  return _mm256_min_epi32 (_mm256_cvttps_epi32 (_mm256_div_ps (n, d)),
+                           _mm256_set1_epi32 (255));
+}
+
+static inline __m256i
+avx2_dodge (__m256i a,
+            __m256i b,
+            __m256i k)
+{
+  return AVX2_VIA_DWORDS (a, b, avx2_dodge_d);
+}
+
+static inline __m256i
+avx2_burn_d (__m256i a,
+             __m256i b)
+{
+  /*  CLAMP (255 - ((255 - a) << 8) / (b + 1), 0, 255)  */
+  __m256i d255 = _mm256_set1_epi32 (255);
+  __m256  n    = _mm256_cvtepi32_ps (_mm256_slli_epi32 (_mm256_sub_epi32 (d255, a), 8));
+  __m256  d    = _mm256_cvtepi32_ps (_mm256_add_epi32 (b, _mm256_set1_epi32 (1)));
+  __m256i q    = _mm256_cvttps_epi32 (_mm256_div_ps (n, d));
+
+  return _mm256_max_epi32 (_mm256_sub_epi32 (d255, q), _mm256_setzero_si256 ());
+}
+
+static inline __m256i
+avx2_burn (__m256i a,
+           __m256i b,
+           __m256i k)
+{
+  return AVX2_VIA_DWORDS (a, b, avx2_burn_d);
+}
+
+
+/*  Runs op over the n_pixels * bpp bytes of the context and stores
+ *  MIN(A, B) wherever alpha_mask is set.  k is handed to op as is.
+ */
+#define AVX2_COMPOSITE(ctx, bpp, alpha_mask, op, k)                    \
+  G_STMT_START {                                                       \
+    const guchar *A     = (ctx)->A;                                    \
+    const guchar *B     = (ctx)->B;                                    \
+    guchar       *D     = (ctx)->D;                                    \
+    gulong        n     = (ctx)->n_pixels * (bpp);                     \
+    __m256i       mask  = _mm256_loadu_si256 ((const __m256i *) (alpha_mask)); \
+    __m256i       a, b, d;                                             \
+                                                                       \
+    for (; n >= AVX2_BYTES; n -= AVX2_BYTES)                           \
+      {                                                                \
+        a = _mm256_loadu_si256 ((const __m256i *) A);                  \
+        b = _mm256_loadu_si256 ((const __m256i *) B);                  \
+        d = _mm256_blendv_epi8 (op (a, b, k), _mm256_min_epu8 (a, b), mask); \
+        _mm256_storeu_si256 ((__m256i *) D, d);                        \
+                                                                       \
+        A += AVX2_BYTES;                                               \
+        B += AVX2_BYTES;                                               \
+        D += AVX2_BYTES;                                               \
+      }                                                                \
+                                                                       \
+    if (n > 0)                                                         \
+      {                                                                \
+        guchar ta[AVX2_BYTES] = { 0, };                                \
+        guchar tb[AVX2_BYTES] = { 0, };                                \
+        guchar td[AVX2_BYTES];                                         \
+                                                                       \
+        memcpy (ta, A, n);                                             \
+        memcpy (tb, B, n);                                             \
+                                                                       \
+        a = _mm256_loadu_si256 ((const __m256i *) ta);                 \
+        b = _mm256_loadu_si256 ((const __m256i *) tb);                 \
+        d = _mm256_blendv_epi8 (op (a, b, k), _mm256_min_epu8 (a, b), mask); \
+        _mm256_storeu_si256 ((__m256i *) td, d);                       \
+                                                                       \
+        memcpy (D, td, n);                                             \
+      }                                                                \
+                                                                       \
+    _mm256_zeroupper ();                                               \
+  } G_STMT_END
+
+
+void
+gimp_composite_addition_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_addition, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_addition_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_addition, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_addition_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_addition, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_addition_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_addition, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_subtract_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_subtract, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_subtract_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_subtract, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_subtract_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_subtract, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_subtract_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_subtract, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_difference_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_difference, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_difference_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_difference, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_difference_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_difference, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_difference_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_difference, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_darken_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_darken, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_darken_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_darken, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_darken_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_darken, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_darken_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_darken, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_lighten_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_lighten, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_lighten_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_lighten, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_lighten_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_lighten, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_lighten_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_lighten, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_grain_extract_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_grain_extract, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_grain_extract_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_grain_extract, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_grain_extract_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_grain_extract, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_grain_extract_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_grain_extract, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_grain_merge_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_grain_merge, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_grain_merge_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_grain_merge, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_grain_merge_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_grain_merge, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_grain_merge_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_grain_merge, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_multiply_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_multiply, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_multiply_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_multiply, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_multiply_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_multiply, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_multiply_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_multiply, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_screen_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_screen, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_screen_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_screen, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_screen_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_screen, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_screen_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_screen, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_overlay_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_overlay, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_overlay_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_overlay, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_overlay_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_overlay, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_overlay_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_overlay, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_divide_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_divide, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_divide_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_divide, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_divide_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_divide, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_divide_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_divide, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_dodge_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_dodge, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_dodge_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_dodge, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_dodge_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_dodge, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_dodge_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_dodge, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_burn_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_burn, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_burn_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_burn, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_burn_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_burn, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_burn_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_burn, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_hardlight_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_hardlight, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_hardlight_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_hardlight, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_hardlight_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_hardlight, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_hardlight_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_hardlight, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_softlight_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 4, rgba8_alpha_mask_256, avx2_softlight, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_softlight_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 2, va8_alpha_mask_256, avx2_softlight, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_softlight_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_softlight, _mm256_setzero_si256 ());
+}
+
+void
+gimp_composite_softlight_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_softlight, _mm256_setzero_si256 ());
+}
+
+/*  blend and scale treat the alpha bytes like any other byte  */
+
+void
+gimp_composite_blend_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  __m256i k = _mm256_set1_epi16 ((guchar) ctx->blend.blend);
+
+  AVX2_COMPOSITE (ctx, 4, no_alpha_mask_256, avx2_blend, k);
+}
+
+void
+gimp_composite_blend_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  __m256i k = _mm256_set1_epi16 ((guchar) ctx->blend.blend);
+
+  AVX2_COMPOSITE (ctx, 2, no_alpha_mask_256, avx2_blend, k);
+}
+
+void
+gimp_composite_blend_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  __m256i k = _mm256_set1_epi16 ((guchar) ctx->blend.blend);
+
+  AVX2_COMPOSITE (ctx, 3, no_alpha_mask_256, avx2_blend, k);
+}
+
+void
+gimp_composite_blend_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  __m256i k = _mm256_set1_epi16 ((guchar) ctx->blend.blend);
+
+  AVX2_COMPOSITE (ctx, 1, no_alpha_mask_256, avx2_blend, k);
+}
+
+static inline void
+gimp_composite_scale_avx2 (GimpCompositeContext *ctx,
+                           gint                  bpp)
+{
+  GimpCompositeContext scale_ctx = *ctx;
+  __m256i              k;
+
+  /*  the generic code wraps around for factors outside of 0..255  */
+  if (ctx->scale.scale < 0 || ctx->scale.scale > 255)
+    {
+      gimp_composite_scale_any_any_any_generic (ctx);
+      return;
+    }
+
+  k = _mm256_set1_epi16 (ctx->scale.scale);
+
+  /*  scale reads A only, handing it in as B too keeps the loop simple  */
+  scale_ctx.B = ctx->A;
+
+  AVX2_COMPOSITE (&scale_ctx, bpp, no_alpha_mask_256, avx2_scale, k);
+}
+
+void
+gimp_composite_scale_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_scale_avx2 (ctx, 4);
+}
+
+void
+gimp_composite_scale_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_scale_avx2 (ctx, 2);
+}
+
+void
+gimp_composite_scale_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_scale_avx2 (ctx, 3);
+}
+
+void
+gimp_composite_scale_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_scale_avx2 (ctx, 1);
+}
+
+static inline void
+gimp_composite_swap_avx2 (GimpCompositeContext *ctx,
+                          gulong                n)
+{
+  guchar  *A = ctx->A;
+  guchar  *B = ctx->B;
+  __m256i  a, b;
+
+  for (; n >= AVX2_BYTES; n -= AVX2_BYTES)
+    {
+      a = _mm256_loadu_si256 ((const __m256i *) A);
+      b = _mm256_loadu_si256 ((const __m256i *) B);
+      _mm256_storeu_si256 ((__m256i *) A, b);
+      _mm256_storeu_si256 ((__m256i *) B, a);
+
+      A += AVX2_BYTES;
+      B += AVX2_BYTES;
+    }
+
+  if (n > 0)
+    {
+      guchar t[AVX2_BYTES];
+
+      memcpy (t, A, n);
+      memcpy (A, B, n);
+      memcpy (B, t, n);
+    }
+
+  _mm256_zeroupper ();
+}
+
+void
+gimp_composite_swap_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_swap_avx2 (ctx, ctx->n_pixels * 4);
+}
+
+void
+gimp_composite_swap_va8_va8_va8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_swap_avx2 (ctx, ctx->n_pixels * 2);
+}
+
+void
+gimp_composite_swap_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_swap_avx2 (ctx, ctx->n_pixels * 3);
+}
+
+void
+gimp_composite_swap_v8_v8_v8_avx2 (GimpCompositeContext *ctx)
+{
+  gimp_composite_swap_avx2 (ctx, ctx->n_pixels);
+}
+
+#endif /* COMPILE_AVX2_IS_OKAY */
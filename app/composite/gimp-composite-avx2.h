@@ -0,0 +1,104 @@
+#ifndef gimp_composite_avx2_h
+#define gimp_composite_avx2_h
+
+extern gboolean gimp_composite_avx2_init (void);
+
+/*
+ * The function gimp_composite_*_install() is defined in the code generated by make-install.py
+ * I hate to create a .h file just for that declaration, so I do it here (for now).
+ */
+extern gboolean gimp_composite_avx2_install (void);
+
+/*
+ * Unlike the older x86 backends this one is written with compiler
+ * intrinsics rather than inline assembly, so it neither needs to
+ * keep %ebx free for PIC code nor cares about the register
+ * constraints of the Intel compiler.  GCC grew the AVX2 intrinsics
+ * in 4.7.
+ */
+#if defined(USE_AVX2)
+#if defined(ARCH_X86)
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)
+#define COMPILE_AVX2_IS_OKAY (1)
+#endif /* __GNUC__ >= 4.7 */
+#endif /* defined(ARCH_X86) */
+#endif /* defined(USE_AVX2) */
+
+#ifdef COMPILE_AVX2_IS_OKAY
+extern void gimp_composite_addition_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_blend_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_burn_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_darken_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_difference_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_divide_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_dodge_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_grain_extract_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_grain_merge_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_hardlight_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_lighten_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_multiply_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_overlay_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_scale_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_screen_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_softlight_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_subtract_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_swap_rgba8_rgba8_rgba8_avx2 (GimpCompositeContext *ctx);
+
+extern void gimp_composite_addition_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_blend_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_burn_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_darken_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_difference_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_divide_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_dodge_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_grain_extract_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_grain_merge_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_hardlight_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_lighten_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_multiply_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_overlay_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_scale_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_screen_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_softlight_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_subtract_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_swap_va8_va8_va8_avx2 (GimpCompositeContext *ctx);
+
+extern void gimp_composite_addition_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_blend_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_burn_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_darken_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_difference_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_divide_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_dodge_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_grain_extract_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_grain_merge_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_hardlight_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_lighten_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_multiply_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_overlay_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_scale_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_screen_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_softlight_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_subtract_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_swap_rgb8_rgb8_rgb8_avx2 (GimpCompositeContext *ctx);
+
+extern void gimp_composite_addition_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_blend_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_burn_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_darken_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_difference_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_divide_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_dodge_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_grain_extract_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_grain_merge_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_hardlight_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_lighten_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_multiply_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_overlay_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_scale_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_screen_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_softlight_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_subtract_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+extern void gimp_composite_swap_v8_v8_v8_avx2 (GimpCompositeContext *ctx);
+#endif
+#endif
@@ -363,6 +363,7 @@ gimp_composite_init (gboolean  be_verbose,
       extern gboolean gimp_composite_sse_install (void);
       extern gboolean gimp_composite_sse2_install (void);
       extern gboolean gimp_composite_3dnow_install (void);
+      extern gboolean gimp_composite_avx2_install (void);
       extern gboolean gimp_composite_altivec_install (void);
       extern gboolean gimp_composite_vis_install (void);
 
@@ -370,16 +371,18 @@ gimp_composite_init (gboolean  be_verbose,
       gboolean can_use_sse     = gimp_composite_sse_install ();
       gboolean can_use_sse2    = gimp_composite_sse2_install ();
       gboolean can_use_3dnow   = gimp_composite_3dnow_install ();
+      gboolean can_use_avx2    = gimp_composite_avx2_install ();
       gboolean can_use_altivec = gimp_composite_altivec_install ();
       gboolean can_use_vis     = gimp_composite_vis_install ();
 
       if (be_verbose)
         g_printerr ("Processor instruction sets: "
-                    "%cmmx %csse %csse2 %c3dnow %caltivec %cvis\n",
+                    "%cmmx %csse %csse2 %c3dnow %cavx2 %caltivec %cvis\n",
                     can_use_mmx     ? '+' : '-',
                     can_use_sse     ? '+' : '-',
                     can_use_sse2    ? '+' : '-',
                     can_use_3dnow   ? '+' : '-',
+                    can_use_avx2    ? '+' : '-',
                     can_use_altivec ? '+' : '-',
                     can_use_vis     ? '+' : '-');
     }
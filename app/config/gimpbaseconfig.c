@@ -49,6 +49,7 @@ enum
   PROP_SWAP_PATH,
   PROP_NUM_PROCESSORS,
   PROP_TILE_CACHE_SIZE,
+  PROP_TILE_COMPRESS_SIZE,
 
   /* ignored, only for backward compatibility: */
   PROP_STINGY_MEMORY_USE
@@ -114,6 +115,12 @@ gimp_base_config_class_init (GimpBaseConfigClass *klass)
                                     1 << 30, /* 1GB */
                                     GIMP_PARAM_STATIC_STRINGS |
                                     GIMP_CONFIG_PARAM_CONFIRM);
+  GIMP_CONFIG_INSTALL_PROP_MEMSIZE (object_class, PROP_TILE_COMPRESS_SIZE,
+                                    "tile-compress-size",
+                                    TILE_COMPRESS_SIZE_BLURB,
+                                    0, MIN (G_MAXULONG, GIMP_MAX_MEMSIZE),
+                                    1 << 28, /* 256MB */
+                                    GIMP_PARAM_STATIC_STRINGS);
 
   /*  only for backward compatibility:  */
   GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_STINGY_MEMORY_USE,
@@ -162,6 +169,9 @@ gimp_base_config_set_property (GObject      *object,
     case PROP_TILE_CACHE_SIZE:
       base_config->tile_cache_size = g_value_get_uint64 (value);
       break;
+    case PROP_TILE_COMPRESS_SIZE:
+      base_config->tile_compress_size = g_value_get_uint64 (value);
+      break;
 
     case PROP_STINGY_MEMORY_USE:
       /* ignored */
@@ -195,6 +205,9 @@ gimp_base_config_get_property (GObject    *object,
     case PROP_TILE_CACHE_SIZE:
       g_value_set_uint64 (value, base_config->tile_cache_size);
       break;
+    case PROP_TILE_COMPRESS_SIZE:
+      g_value_set_uint64 (value, base_config->tile_compress_size);
+      break;
 
     case PROP_STINGY_MEMORY_USE:
       /* ignored */
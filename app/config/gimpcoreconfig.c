@@ -80,6 +80,8 @@ enum
   PROP_UNDO_SIZE,
   PROP_UNDO_PREVIEW_SIZE,
   PROP_PLUG_IN_HISTORY_SIZE,
+  PROP_PLUG_IN_POOL_SIZE,
+  PROP_PLUG_IN_POOL_TIMEOUT,
   PROP_PLUGINRC_PATH,
   PROP_LAYER_PREVIEWS,
   PROP_LAYER_PREVIEW_SIZE,
@@ -89,7 +91,9 @@ enum
   PROP_MIN_COLORS,
   PROP_COLOR_MANAGEMENT,
   PROP_COLOR_PROFILE_POLICY,
-  PROP_SAVE_DOCUMENT_HISTORY
+  PROP_SAVE_DOCUMENT_HISTORY,
+  PROP_XCF_COMPRESSION,
+  PROP_XCF_LAZY_LOADING
 };
 
 
@@ -306,6 +310,16 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                 0, 256, 10,
                                 GIMP_PARAM_STATIC_STRINGS |
                                 GIMP_CONFIG_PARAM_RESTART);
+  GIMP_CONFIG_INSTALL_PROP_INT (object_class, PROP_PLUG_IN_POOL_SIZE,
+                                "plug-in-pool-size",
+                                PLUG_IN_POOL_SIZE_BLURB,
+                                0, 64, 4,
+                                GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_INT (object_class, PROP_PLUG_IN_POOL_TIMEOUT,
+                                "plug-in-pool-timeout",
+                                PLUG_IN_POOL_TIMEOUT_BLURB,
+                                1, 3600, 60,
+                                GIMP_PARAM_STATIC_STRINGS);
   GIMP_CONFIG_INSTALL_PROP_PATH (object_class,
                                  PROP_PLUGINRC_PATH,
                                  "pluginrc-path", PLUGINRC_PATH_BLURB,
@@ -358,6 +372,16 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                     SAVE_DOCUMENT_HISTORY_BLURB,
                                     TRUE,
                                     GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_ENUM (object_class, PROP_XCF_COMPRESSION,
+                                 "xcf-compression", XCF_COMPRESSION_BLURB,
+                                 GIMP_TYPE_XCF_COMPRESSION,
+                                 GIMP_XCF_COMPRESSION_RLE,
+                                 GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_LAZY_LOADING,
+                                    "xcf-lazy-loading",
+                                    XCF_LAZY_LOADING_BLURB,
+                                    TRUE,
+                                    GIMP_PARAM_STATIC_STRINGS);
 }
 
 static void
@@ -536,6 +560,12 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_PLUG_IN_HISTORY_SIZE:
       core_config->plug_in_history_size = g_value_get_int (value);
       break;
+    case PROP_PLUG_IN_POOL_SIZE:
+      core_config->plug_in_pool_size = g_value_get_int (value);
+      break;
+    case PROP_PLUG_IN_POOL_TIMEOUT:
+      core_config->plug_in_pool_timeout = g_value_get_int (value);
+      break;
     case PROP_UNDO_LEVELS:
       core_config->levels_of_undo = g_value_get_int (value);
       break;
@@ -578,6 +608,12 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_SAVE_DOCUMENT_HISTORY:
       core_config->save_document_history = g_value_get_boolean (value);
       break;
+    case PROP_XCF_COMPRESSION:
+      core_config->xcf_compression = g_value_get_enum (value);
+      break;
+    case PROP_XCF_LAZY_LOADING:
+      core_config->xcf_lazy_loading = g_value_get_boolean (value);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -679,6 +715,12 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_PLUG_IN_HISTORY_SIZE:
       g_value_set_int (value, core_config->plug_in_history_size);
       break;
+    case PROP_PLUG_IN_POOL_SIZE:
+      g_value_set_int (value, core_config->plug_in_pool_size);
+      break;
+    case PROP_PLUG_IN_POOL_TIMEOUT:
+      g_value_set_int (value, core_config->plug_in_pool_timeout);
+      break;
     case PROP_UNDO_LEVELS:
       g_value_set_int (value, core_config->levels_of_undo);
       break;
@@ -718,6 +760,12 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_SAVE_DOCUMENT_HISTORY:
       g_value_set_boolean (value, core_config->save_document_history);
       break;
+    case PROP_XCF_COMPRESSION:
+      g_value_set_enum (value, core_config->xcf_compression);
+      break;
+    case PROP_XCF_LAZY_LOADING:
+      g_value_set_boolean (value, core_config->xcf_lazy_loading);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -71,6 +71,8 @@ struct _GimpCoreConfig
   guint64                 undo_size;
   GimpViewSize            undo_preview_size;
   gint                    plug_in_history_size;
+  gint                    plug_in_pool_size;
+  gint                    plug_in_pool_timeout;
   gchar                  *plug_in_rc_path;
   gboolean                layer_previews;
   GimpViewSize            layer_preview_size;
@@ -81,6 +83,8 @@ struct _GimpCoreConfig
   GimpColorConfig        *color_management;
   GimpColorProfilePolicy  color_profile_policy;
   gboolean                save_document_history;
+  GimpXcfCompression      xcf_compression;
+  gboolean                xcf_lazy_loading;
 };
 
 struct _GimpCoreConfigClass
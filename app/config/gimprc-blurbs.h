@@ -235,6 +235,15 @@ N_("When enabled, the X server is queried for the mouse's current position " \
 #define PLUG_IN_HISTORY_SIZE_BLURB \
 "How many recently used plug-ins to keep on the Filters menu."
 
+#define PLUG_IN_POOL_SIZE_BLURB \
+"How many plug-ins that asked to stay resident are kept running between " \
+"calls.  Reusing a resident plug-in saves starting a new process for " \
+"every call.  Set this to 0 to always start a new process."
+
+#define PLUG_IN_POOL_TIMEOUT_BLURB \
+"Sets after how many seconds a resident plug-in that was not called is " \
+"shut down."
+
 #define PLUG_IN_PATH_BLURB \
 "Sets the plug-in search path."
 
@@ -388,6 +397,12 @@ N_("When the amount of pixel data exceeds this limit, GIMP will start to " \
    "work on images that wouldn't fit into memory otherwise.  If you have a " \
    "lot of RAM, you may want to set this to a higher value.")
 
+#define TILE_COMPRESS_SIZE_BLURB \
+N_("Tiles that don't fit into the tile cache are compressed and kept " \
+   "in memory, as long as the compressed tiles take less than this " \
+   "amount of memory.  Only the tiles beyond this limit are swapped to " \
+   "disk.  Set this to zero to swap all of them to disk.")
+
 #define TOOLBOX_COLOR_AREA_BLURB NULL
 #define TOOLBOX_FOO_AREA_BLURB NULL
 #define TOOLBOX_IMAGE_AREA_BLURB NULL
@@ -428,6 +443,16 @@ N_("Sets the external web browser to be used.  This can be an absolute " \
    "the URL will be appended to the command with a space separating the " \
    "two.")
 
+#define XCF_COMPRESSION_BLURB \
+N_("Sets how the pixel data is compressed when saving XCF files.  Files " \
+   "saved with zlib or LZ compression can't be opened by older versions " \
+   "of GIMP.")
+
+#define XCF_LAZY_LOADING_BLURB \
+N_("When enabled, the pixels of XCF files are only read when they are " \
+   "needed, which makes opening large files much faster.  The file is " \
+   "kept open meanwhile and must not be changed by other programs.")
+
 #define XOR_COLOR_BLURB \
 "Sets the color that is used for XOR drawing. This setting only exists as " \
 "a workaround for buggy display drivers. If lines on the canvas are not " \
@@ -1272,6 +1272,36 @@ gimp_color_profile_policy_get_type (void)
   return type;
 }
 
+GType
+gimp_xcf_compression_get_type (void)
+{
+  static const GEnumValue values[] =
+  {
+    { GIMP_XCF_COMPRESSION_RLE, "GIMP_XCF_COMPRESSION_RLE", "rle" },
+    { GIMP_XCF_COMPRESSION_ZLIB, "GIMP_XCF_COMPRESSION_ZLIB", "zlib" },
+    { GIMP_XCF_COMPRESSION_LZ, "GIMP_XCF_COMPRESSION_LZ", "lz" },
+    { 0, NULL, NULL }
+  };
+
+  static const GimpEnumDesc descs[] =
+  {
+    { GIMP_XCF_COMPRESSION_RLE, N_("RLE (compatible)"), NULL },
+    { GIMP_XCF_COMPRESSION_ZLIB, N_("zlib (smallest)"), NULL },
+    { GIMP_XCF_COMPRESSION_LZ, N_("LZ (fastest)"), NULL },
+    { 0, NULL, NULL }
+  };
+
+  static GType type = 0;
+
+  if (! type)
+    {
+      type = g_enum_register_static ("GimpXcfCompression", values);
+      gimp_enum_set_value_descriptions (type, descs);
+    }
+
+  return type;
+}
+
 
 /* Generated data ends here */
 
@@ -586,6 +586,18 @@ typedef enum  /*< pdb-skip >*/
 } GimpColorProfilePolicy;
 
 
+#define GIMP_TYPE_XCF_COMPRESSION (gimp_xcf_compression_get_type ())
+
+GType gimp_xcf_compression_get_type (void) G_GNUC_CONST;
+
+typedef enum  /*< pdb-skip >*/
+{
+  GIMP_XCF_COMPRESSION_RLE,   /*< desc="RLE (compatible)"   >*/
+  GIMP_XCF_COMPRESSION_ZLIB,  /*< desc="zlib (smallest)"    >*/
+  GIMP_XCF_COMPRESSION_LZ     /*< desc="LZ (fastest)"       >*/
+} GimpXcfCompression;
+
+
 /*
  * non-registered enums; register them if needed
  */
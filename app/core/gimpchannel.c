@@ -22,6 +22,7 @@
 
 #include <glib-object.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
 
 #include "core-types.h"
@@ -33,6 +34,7 @@
 #include "base/pixel-region.h"
 #include "base/tile.h"
 #include "base/tile-manager.h"
+#include "base/tile-pyramid.h"
 
 #include "paint-funcs/paint-funcs.h"
 
@@ -143,6 +145,11 @@ static void      gimp_channel_replace_region (GimpDrawable     *drawable,
                                               PixelRegion      *maskPR,
                                               gint              x,
                                               gint              y);
+static void      gimp_channel_update         (GimpDrawable     *drawable,
+                                              gint              x,
+                                              gint              y,
+                                              gint              width,
+                                              gint              height);
 static void      gimp_channel_set_tiles      (GimpDrawable     *drawable,
                                               gboolean          push_undo,
                                               const gchar      *undo_desc,
@@ -157,6 +164,9 @@ static void      gimp_channel_swap_pixels    (GimpDrawable     *drawable,
                                               gint              y,
                                               gint              width,
                                               gint              height);
+static TileManager * gimp_channel_get_mipmap (GimpDrawable     *drawable,
+                                              gint              level);
+static void      gimp_channel_free_pyramid   (GimpChannel      *channel);
 
 static gint      gimp_channel_get_opacity_at (GimpPickable     *pickable,
                                               gint              x,
@@ -218,6 +228,11 @@ G_DEFINE_TYPE_WITH_CODE (GimpChannel, gimp_channel, GIMP_TYPE_DRAWABLE,
 
 static guint channel_signals[LAST_SIGNAL] = { 0 };
 
+/*  the pyramids of masks are created lazily, also from the display's
+ *  render threads, see gimp_channel_get_mipmap()
+ */
+static GStaticMutex pyramid_mutex = G_STATIC_MUTEX_INIT;
+
 
 static void
 gimp_channel_class_init (GimpChannelClass *klass)
@@ -264,12 +279,14 @@ gimp_channel_class_init (GimpChannelClass *klass)
   item_class->transform_desc = _("Transform Channel");
   item_class->stroke_desc    = _("Stroke Channel");
 
+  drawable_class->update                = gimp_channel_update;
   drawable_class->invalidate_boundary   = gimp_channel_invalidate_boundary;
   drawable_class->get_active_components = gimp_channel_get_active_components;
   drawable_class->apply_region          = gimp_channel_apply_region;
   drawable_class->replace_region        = gimp_channel_replace_region;
   drawable_class->set_tiles             = gimp_channel_set_tiles;
   drawable_class->swap_pixels           = gimp_channel_swap_pixels;
+  drawable_class->get_mipmap            = gimp_channel_get_mipmap;
 
   klass->boundary       = gimp_channel_real_boundary;
   klass->bounds         = gimp_channel_real_bounds;
@@ -312,6 +329,8 @@ gimp_channel_init (GimpChannel *channel)
   channel->y1             = 0;
   channel->x2             = 0;
   channel->y2             = 0;
+
+  channel->pyramid        = NULL;
 }
 
 static void
@@ -337,6 +356,8 @@ gimp_channel_finalize (GObject *object)
       channel->segs_out = NULL;
     }
 
+  gimp_channel_free_pyramid (channel);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -345,11 +366,16 @@ gimp_channel_get_memsize (GimpObject *object,
                           gint64     *gui_size)
 {
   GimpChannel *channel = GIMP_CHANNEL (object);
+  gint64       memsize = 0;
 
   *gui_size += channel->num_segs_in  * sizeof (BoundSeg);
   *gui_size += channel->num_segs_out * sizeof (BoundSeg);
 
-  return GIMP_OBJECT_CLASS (parent_class)->get_memsize (object, gui_size);
+  if (channel->pyramid)
+    memsize += tile_pyramid_get_memsize (channel->pyramid);
+
+  return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
+                                                                  gui_size);
 }
 
 static gchar *
@@ -784,6 +810,32 @@ gimp_channel_replace_region (GimpDrawable *drawable,
   GIMP_CHANNEL (drawable)->bounds_known = FALSE;
 }
 
+static void
+gimp_channel_update (GimpDrawable *drawable,
+                     gint          x,
+                     gint          y,
+                     gint          width,
+                     gint          height)
+{
+  GimpChannel *channel = GIMP_CHANNEL (drawable);
+
+  GIMP_DRAWABLE_CLASS (parent_class)->update (drawable, x, y, width, height);
+
+  g_static_mutex_lock (&pyramid_mutex);
+
+  if (channel->pyramid &&
+      gimp_rectangle_intersect (x, y, width, height,
+                                0, 0,
+                                gimp_item_width  (GIMP_ITEM (drawable)),
+                                gimp_item_height (GIMP_ITEM (drawable)),
+                                &x, &y, &width, &height))
+    {
+      tile_pyramid_invalidate_area (channel->pyramid, x, y, width, height);
+    }
+
+  g_static_mutex_unlock (&pyramid_mutex);
+}
+
 static void
 gimp_channel_set_tiles (GimpDrawable *drawable,
                         gboolean      push_undo,
@@ -798,6 +850,8 @@ gimp_channel_set_tiles (GimpDrawable *drawable,
                                                  tiles, type,
                                                  offset_x, offset_y);
 
+  gimp_channel_free_pyramid (GIMP_CHANNEL (drawable));
+
   GIMP_CHANNEL (drawable)->bounds_known = FALSE;
 }
 
@@ -818,6 +872,57 @@ gimp_channel_swap_pixels (GimpDrawable *drawable,
   GIMP_CHANNEL (drawable)->bounds_known = FALSE;
 }
 
+/*  Masks are shown at all zoom levels, as quick mask or in the
+ *  display, so keep a pyramid of them like the projection does.
+ *  Its levels are computed on demand and invalidated in
+ *  gimp_channel_update(). This may be called from any thread, the
+ *  pyramid and its levels are created with pyramid_mutex held.
+ */
+static TileManager *
+gimp_channel_get_mipmap (GimpDrawable *drawable,
+                         gint          level)
+{
+  GimpChannel *channel = GIMP_CHANNEL (drawable);
+  TileManager *tiles;
+
+  g_static_mutex_lock (&pyramid_mutex);
+
+  /*  the tiles may have been replaced behind our back  */
+  if (channel->pyramid &&
+      tile_pyramid_get_tiles (channel->pyramid, 0) != drawable->tiles)
+    {
+      tile_pyramid_destroy (channel->pyramid);
+      channel->pyramid = NULL;
+    }
+
+  if (! channel->pyramid)
+    channel->pyramid = tile_pyramid_new_for_tiles (drawable->tiles);
+
+  tiles = tile_pyramid_get_tiles (channel->pyramid, level);
+
+  g_static_mutex_unlock (&pyramid_mutex);
+
+  /*  the pyramid doesn't go up that far  */
+  if (tile_manager_width (tiles) != gimp_item_width (GIMP_ITEM (drawable)) >> level)
+    return NULL;
+
+  return tiles;
+}
+
+static void
+gimp_channel_free_pyramid (GimpChannel *channel)
+{
+  g_static_mutex_lock (&pyramid_mutex);
+
+  if (channel->pyramid)
+    {
+      tile_pyramid_destroy (channel->pyramid);
+      channel->pyramid = NULL;
+    }
+
+  g_static_mutex_unlock (&pyramid_mutex);
+}
+
 static gint
 gimp_channel_get_opacity_at (GimpPickable *pickable,
                              gint          x,
@@ -50,6 +50,8 @@ struct _GimpChannel
   gboolean      bounds_known;      /*  recalculate the bounds?        */
   gint          x1, y1;            /*  coordinates for bounding box   */
   gint          x2, y2;            /*  lower right hand coordinate    */
+
+  TilePyramid  *pyramid;           /*  scaled down copies of the mask */
 };
 
 struct _GimpChannelClass
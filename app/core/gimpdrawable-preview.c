@@ -133,6 +133,7 @@ gimp_drawable_get_sub_preview (GimpDrawable *drawable,
 {
   GimpItem    *item;
   GimpImage   *image;
+  gint         level = 0;
 
   g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
   g_return_val_if_fail (src_x >= 0, NULL);
@@ -158,8 +159,18 @@ gimp_drawable_get_sub_preview (GimpDrawable *drawable,
                                           src_x, src_y, src_width, src_height,
                                           dest_width, dest_height);
 
-  return tile_manager_get_sub_preview (gimp_drawable_get_tiles (drawable),
-                                       src_x, src_y, src_width, src_height,
+  /*  use the smallest stored level that still has enough pixels  */
+  while (level < drawable->n_mipmaps                  &&
+         (src_width  >> (level + 1)) >= dest_width  &&
+         (src_height >> (level + 1)) >= dest_height)
+    level++;
+
+  return tile_manager_get_sub_preview (gimp_drawable_get_mipmap (drawable,
+                                                                 level),
+                                       src_x      >> level,
+                                       src_y      >> level,
+                                       src_width  >> level,
+                                       src_height >> level,
                                        dest_width, dest_height);
 }
 
@@ -123,6 +123,7 @@ static void       gimp_drawable_real_update        (GimpDrawable      *drawable,
                                                     gint               y,
                                                     gint               width,
                                                     gint               height);
+static void       gimp_drawable_free_mipmaps       (GimpDrawable      *drawable);
 
 static gint64  gimp_drawable_real_estimate_memsize (const GimpDrawable *drawable,
                                                     gint               width,
@@ -218,6 +219,7 @@ gimp_drawable_class_init (GimpDrawableClass *klass)
   klass->set_tiles                   = gimp_drawable_real_set_tiles;
   klass->push_undo                   = gimp_drawable_real_push_undo;
   klass->swap_pixels                 = gimp_drawable_real_swap_pixels;
+  klass->get_mipmap                  = NULL;
 }
 
 static void
@@ -229,6 +231,8 @@ gimp_drawable_init (GimpDrawable *drawable)
   drawable->has_alpha     = FALSE;
   drawable->preview_cache = NULL;
   drawable->preview_valid = FALSE;
+  drawable->mipmaps       = NULL;
+  drawable->n_mipmaps     = 0;
 }
 
 /* sorry for the evil casts */
@@ -254,6 +258,8 @@ gimp_drawable_finalize (GObject *object)
       drawable->tiles = NULL;
     }
 
+  gimp_drawable_free_mipmaps (drawable);
+
   if (drawable->preview_cache)
     gimp_preview_cache_invalidate (&drawable->preview_cache);
 
@@ -266,10 +272,14 @@ gimp_drawable_get_memsize (GimpObject *object,
 {
   GimpDrawable *drawable = GIMP_DRAWABLE (object);
   gint64        memsize  = 0;
+  gint          i;
 
   if (drawable->tiles)
     memsize += tile_manager_get_memsize (drawable->tiles, FALSE);
 
+  for (i = 0; i < drawable->n_mipmaps; i++)
+    memsize += tile_manager_get_memsize (drawable->mipmaps[i], FALSE);
+
   if (drawable->preview_cache)
     *gui_size += gimp_preview_cache_get_memsize (drawable->preview_cache);
 
@@ -321,8 +331,6 @@ gimp_drawable_duplicate (GimpItem *item,
       GimpDrawable  *drawable     = GIMP_DRAWABLE (item);
       GimpDrawable  *new_drawable = GIMP_DRAWABLE (new_item);
       GimpImageType  new_image_type;
-      PixelRegion    srcPR;
-      PixelRegion    destPR;
 
       if (add_alpha)
         new_image_type = gimp_drawable_type_with_alpha (drawable);
@@ -338,21 +346,30 @@ gimp_drawable_duplicate (GimpItem *item,
                                new_image_type,
                                GIMP_OBJECT (new_drawable)->name);
 
-      pixel_region_init (&srcPR, drawable->tiles,
-                         0, 0,
-                         item->width,
-                         item->height,
-                         FALSE);
-      pixel_region_init (&destPR, new_drawable->tiles,
-                         0, 0,
-                         new_item->width,
-                         new_item->height,
-                         TRUE);
-
       if (new_image_type == drawable->type)
-        copy_region (&srcPR, &destPR);
+        {
+          /*  share the tiles until either drawable changes them  */
+          tile_manager_unref (new_drawable->tiles);
+          new_drawable->tiles = tile_manager_duplicate (drawable->tiles);
+        }
       else
-        add_alpha_region (&srcPR, &destPR);
+        {
+          PixelRegion srcPR;
+          PixelRegion destPR;
+
+          pixel_region_init (&srcPR, drawable->tiles,
+                             0, 0,
+                             item->width,
+                             item->height,
+                             FALSE);
+          pixel_region_init (&destPR, new_drawable->tiles,
+                             0, 0,
+                             new_item->width,
+                             new_item->height,
+                             TRUE);
+
+          add_alpha_region (&srcPR, &destPR);
+        }
     }
 
   return new_item;
@@ -616,9 +633,26 @@ gimp_drawable_real_update (GimpDrawable *drawable,
                            gint          width,
                            gint          height)
 {
+  /*  the stored levels can't follow changes of the pixels  */
+  gimp_drawable_free_mipmaps (drawable);
+
   gimp_viewable_invalidate_preview (GIMP_VIEWABLE (drawable));
 }
 
+static void
+gimp_drawable_free_mipmaps (GimpDrawable *drawable)
+{
+  gint i;
+
+  for (i = 0; i < drawable->n_mipmaps; i++)
+    tile_manager_unref (drawable->mipmaps[i]);
+
+  g_free (drawable->mipmaps);
+
+  drawable->mipmaps   = NULL;
+  drawable->n_mipmaps = 0;
+}
+
 static gint64
 gimp_drawable_real_estimate_memsize (const GimpDrawable *drawable,
                                      gint                width,
@@ -657,6 +691,8 @@ gimp_drawable_real_set_tiles (GimpDrawable *drawable,
   if (drawable->tiles)
     tile_manager_unref (drawable->tiles);
 
+  gimp_drawable_free_mipmaps (drawable);
+
   drawable->tiles     = tiles;
   drawable->type      = type;
   drawable->bytes     = tile_manager_bpp (tiles);
@@ -692,14 +728,27 @@ gimp_drawable_real_push_undo (GimpDrawable *drawable,
 
   if (! tiles)
     {
-      PixelRegion srcPR, destPR;
+      GimpItem *item = GIMP_ITEM (drawable);
 
-      tiles = tile_manager_new (width, height, gimp_drawable_bytes (drawable));
-      pixel_region_init (&srcPR, gimp_drawable_get_tiles (drawable),
-                         x, y, width, height, FALSE);
-      pixel_region_init (&destPR, tiles,
-                         0, 0, width, height, TRUE);
-      copy_region (&srcPR, &destPR);
+      if (x == 0 && y == 0 &&
+          width  == gimp_item_width  (item) &&
+          height == gimp_item_height (item))
+        {
+          /*  the undo shares the drawable's tiles until they change  */
+          tiles = tile_manager_duplicate (gimp_drawable_get_tiles (drawable));
+        }
+      else
+        {
+          PixelRegion srcPR, destPR;
+
+          tiles = tile_manager_new (width, height,
+                                    gimp_drawable_bytes (drawable));
+          pixel_region_init (&srcPR, gimp_drawable_get_tiles (drawable),
+                             x, y, width, height, FALSE);
+          pixel_region_init (&destPR, tiles,
+                             0, 0, width, height, TRUE);
+          copy_region (&srcPR, &destPR);
+        }
 
       new_tiles = TRUE;
     }
@@ -808,6 +857,8 @@ gimp_drawable_configure (GimpDrawable  *drawable,
   if (drawable->tiles)
     tile_manager_unref (drawable->tiles);
 
+  gimp_drawable_free_mipmaps (drawable);
+
   drawable->tiles = tile_manager_new (width, height, drawable->bytes);
 
   /*  preview variables  */
@@ -1042,6 +1093,65 @@ gimp_drawable_push_undo (GimpDrawable *drawable,
                                                  x, y, width, height);
 }
 
+/**
+ * gimp_drawable_set_mipmaps:
+ * @drawable:  a #GimpDrawable
+ * @mipmaps:   an array of tile-managers, or %NULL
+ * @n_mipmaps: the number of tile-managers in @mipmaps
+ *
+ * Stores scaled down copies of the drawable's pixels, as they are
+ * found in files that were saved with them. @mipmaps[i] holds level
+ * i + 1, which is half the size of level i, like the levels of a
+ * #TilePyramid. The drawable takes ownership of the array and the
+ * tile-managers in it; they are dropped as soon as the drawable is
+ * updated.
+ **/
+void
+gimp_drawable_set_mipmaps (GimpDrawable  *drawable,
+                           TileManager  **mipmaps,
+                           gint           n_mipmaps)
+{
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (mipmaps != NULL || n_mipmaps == 0);
+
+  gimp_drawable_free_mipmaps (drawable);
+
+  drawable->mipmaps   = mipmaps;
+  drawable->n_mipmaps = n_mipmaps;
+}
+
+/**
+ * gimp_drawable_get_mipmap:
+ * @drawable: a #GimpDrawable
+ * @level:    a pyramid level
+ *
+ * Return value: the drawable's tiles for level 0, the stored scaled
+ *               down copy for higher levels, or %NULL if there is no
+ *               such copy and the drawable can't compute one.
+ **/
+TileManager *
+gimp_drawable_get_mipmap (const GimpDrawable *drawable,
+                          gint                level)
+{
+  GimpDrawableClass *drawable_class;
+
+  g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
+  g_return_val_if_fail (level >= 0, NULL);
+
+  if (level == 0)
+    return drawable->tiles;
+
+  if (level <= drawable->n_mipmaps)
+    return drawable->mipmaps[level - 1];
+
+  drawable_class = GIMP_DRAWABLE_GET_CLASS (drawable);
+
+  if (drawable_class->get_mipmap)
+    return drawable_class->get_mipmap ((GimpDrawable *) drawable, level);
+
+  return NULL;
+}
+
 TileManager *
 gimp_drawable_get_shadow_tiles (GimpDrawable *drawable)
 {
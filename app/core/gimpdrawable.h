@@ -46,6 +46,9 @@ struct _GimpDrawable
   /*  Preview variables  */
   GSList        *preview_cache;      /* preview caches of the channel  */
   gboolean       preview_valid;      /* is the preview valid?          */
+
+  TileManager  **mipmaps;            /* scaled down copies of tiles    */
+  gint           n_mipmaps;          /* number of mipmap levels        */
 };
 
 struct _GimpDrawableClass
@@ -107,6 +110,9 @@ struct _GimpDrawableClass
                                     gint                  y,
                                     gint                  width,
                                     gint                  height);
+
+  TileManager * (* get_mipmap)     (GimpDrawable         *drawable,
+                                    gint                  level);
 };
 
 
@@ -184,6 +190,12 @@ void            gimp_drawable_push_undo          (GimpDrawable       *drawable,
                                                   TileManager        *tiles,
                                                   gboolean            sparse);
 
+void            gimp_drawable_set_mipmaps        (GimpDrawable       *drawable,
+                                                  TileManager       **mipmaps,
+                                                  gint                n_mipmaps);
+TileManager   * gimp_drawable_get_mipmap         (const GimpDrawable *drawable,
+                                                  gint                level);
+
 TileManager   * gimp_drawable_get_shadow_tiles   (GimpDrawable       *drawable);
 void            gimp_drawable_merge_shadow       (GimpDrawable       *drawable,
                                                   gboolean            push_undo,
@@ -22,9 +22,7 @@
 
 #include "core-types.h"
 
-#include "base/pixel-region.h"
-
-#include "paint-funcs/paint-funcs.h"
+#include "base/tile-manager.h"
 
 #include "gimp.h"
 #include "gimpchannel.h"
@@ -191,21 +189,15 @@ gimp_image_duplicate (GimpImage *image)
 
   /*  Copy the selection mask  */
   {
-    TileManager *src_tiles;
-    TileManager *dest_tiles;
-    PixelRegion  srcPR, destPR;
-
-    src_tiles  =
-      gimp_drawable_get_tiles (GIMP_DRAWABLE (image->selection_mask));
-    dest_tiles =
-      gimp_drawable_get_tiles (GIMP_DRAWABLE (new_image->selection_mask));
+    GimpDrawable *mask = GIMP_DRAWABLE (image->selection_mask);
+    TileManager  *tiles;
 
-    pixel_region_init (&srcPR, src_tiles,
-                       0, 0, image->width, image->height, FALSE);
-    pixel_region_init (&destPR, dest_tiles,
-                       0, 0, image->width, image->height, TRUE);
+    /*  share the tiles until either mask changes them  */
+    tiles = tile_manager_duplicate (gimp_drawable_get_tiles (mask));
 
-    copy_region (&srcPR, &destPR);
+    gimp_drawable_set_tiles (GIMP_DRAWABLE (new_image->selection_mask),
+                             FALSE, NULL, tiles);
+    tile_manager_unref (tiles);
 
     new_image->selection_mask->bounds_known   = FALSE;
     new_image->selection_mask->boundary_known = FALSE;
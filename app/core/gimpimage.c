@@ -590,8 +590,6 @@ gimp_image_init (GimpImage *image)
 
   image->shadow                = NULL;
 
-  image->projection            = gimp_projection_new (image);
-
   image->guides                = NULL;
   image->grid                  = NULL;
   image->sample_points         = NULL;
@@ -601,6 +599,9 @@ gimp_image_init (GimpImage *image)
   image->vectors               = gimp_list_new (GIMP_TYPE_VECTORS, TRUE);
   image->layer_stack           = NULL;
 
+  /*  the projection watches the layers, create it after them  */
+  image->projection            = gimp_projection_new (image);
+
   image->layer_update_handler =
     gimp_container_add_handler (image->layers, "update",
                                 G_CALLBACK (gimp_image_drawable_update),
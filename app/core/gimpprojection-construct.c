@@ -25,6 +25,7 @@
 #include "core-types.h"
 
 #include "base/pixel-region.h"
+#include "base/tile.h"
 #include "base/tile-manager.h"
 
 #include "paint-funcs/paint-funcs.h"
@@ -42,42 +43,70 @@
 /*  local function prototypes  */
 
 static void   gimp_projection_construct_layers   (GimpProjection *proj,
+                                                  TileManager    *tiles,
+                                                  gint            level,
                                                   gint            x,
                                                   gint            y,
                                                   gint            w,
-                                                  gint            h);
+                                                  gint            h,
+                                                  GimpLayer      *first,
+                                                  GimpLayer      *last,
+                                                  gboolean       *construct_flag);
 static void   gimp_projection_construct_channels (GimpProjection *proj,
+                                                  TileManager    *tiles,
+                                                  gint            level,
                                                   gint            x,
                                                   gint            y,
                                                   gint            w,
-                                                  gint            h);
+                                                  gint            h,
+                                                  gboolean       *construct_flag);
 static void   gimp_projection_initialize         (GimpProjection *proj,
+                                                  TileManager    *tiles,
+                                                  gint            level,
+                                                  gint            x,
+                                                  gint            y,
+                                                  gint            w,
+                                                  gint            h,
+                                                  GimpLayer      *last);
+static gboolean gimp_projection_has_layers_below (GimpProjection *proj,
+                                                  GimpLayer      *layer);
+static gboolean gimp_projection_has_level        (GimpProjection *proj,
+                                                  gint            level);
+static gboolean gimp_projection_has_mipmap       (GimpDrawable   *drawable,
+                                                  gint            level);
+static gboolean gimp_projection_layer_is_clear   (GimpLayer      *layer,
+                                                  gint            level,
                                                   gint            x,
                                                   gint            y,
                                                   gint            w,
                                                   gint            h);
 
 static void   project_intensity                  (GimpProjection *proj,
+                                                  gboolean        construct_flag,
                                                   GimpLayer      *layer,
                                                   PixelRegion    *src,
                                                   PixelRegion    *dest,
                                                   PixelRegion    *mask);
 static void   project_intensity_alpha            (GimpProjection *proj,
+                                                  gboolean        construct_flag,
                                                   GimpLayer      *layer,
                                                   PixelRegion    *src,
                                                   PixelRegion    *dest,
                                                   PixelRegion    *mask);
 static void   project_indexed                    (GimpProjection *proj,
+                                                  gboolean        construct_flag,
                                                   GimpLayer      *layer,
                                                   PixelRegion    *src,
                                                   PixelRegion    *dest,
                                                   PixelRegion    *mask);
 static void   project_indexed_alpha              (GimpProjection *proj,
+                                                  gboolean        construct_flag,
                                                   GimpLayer      *layer,
                                                   PixelRegion    *src,
                                                   PixelRegion    *dest,
                                                   PixelRegion    *mask);
 static void   project_channel                    (GimpProjection *proj,
+                                                  gboolean        construct_flag,
                                                   GimpChannel    *channel,
                                                   PixelRegion    *src,
                                                   PixelRegion    *src2);
@@ -92,8 +121,13 @@ gimp_projection_construct (GimpProjection *proj,
                            gint            w,
                            gint            h)
 {
+  TileManager *tiles;
+  gboolean     construct_flag = FALSE;
+
   g_return_if_fail (GIMP_IS_PROJECTION (proj));
 
+  tiles = gimp_projection_get_tiles (proj);
+
 #if 0
   GimpImage *image = proj->image;
 
@@ -129,9 +163,10 @@ gimp_projection_construct (GimpProjection *proj,
 
               copy_region (&srcPR, &destPR);
 
-              proj->construct_flag = TRUE;
+              construct_flag = TRUE;
 
-              gimp_projection_construct_channels (proj, x, y, w, h);
+              gimp_projection_construct_channels (proj, x, y, w, h,
+                                                  &construct_flag);
 
               return;
             }
@@ -139,20 +174,124 @@ gimp_projection_construct (GimpProjection *proj,
     }
 #endif
 
-  proj->construct_flag = FALSE;
+  if (proj->below_tiles                                          &&
+      ! gimp_image_floating_sel (proj->image)                    &&
+      gimp_projection_has_layers_below (proj, proj->below_layer))
+    {
+      PixelRegion srcPR, destPR;
 
-  /*  First, determine if the projection image needs to be
-   *  initialized--this is the case when there are no visible
-   *  layers that cover the entire canvas--either because layers
-   *  are offset or only a floating selection is visible
-   */
-  gimp_projection_initialize (proj, x, y, w, h);
+      /*  Start with the cached composite of the layers below the
+       *  layer that is being edited, and project the rest on top.
+       *  The pixels are copied, as sharing the below cache's tiles
+       *  would replace a tile that may be being validated here.
+       */
+      pixel_region_init (&srcPR,  proj->below_tiles, x, y, w, h, FALSE);
+      pixel_region_init (&destPR, tiles,             x, y, w, h, TRUE);
 
-  /*  call functions which process the list of layers and
-   *  the list of channels
-   */
-  gimp_projection_construct_layers (proj, x, y, w, h);
-  gimp_projection_construct_channels (proj, x, y, w, h);
+      copy_region_nocow (&srcPR, &destPR);
+
+      construct_flag = TRUE;
+
+      gimp_projection_construct_layers (proj, tiles, 0, x, y, w, h,
+                                        proj->below_layer, NULL,
+                                        &construct_flag);
+    }
+  else
+    {
+      /*  First, determine if the projection image needs to be
+       *  initialized--this is the case when there are no visible
+       *  layers that cover the entire canvas--either because layers
+       *  are offset or only a floating selection is visible
+       */
+      gimp_projection_initialize (proj, tiles, 0, x, y, w, h, NULL);
+
+      gimp_projection_construct_layers (proj, tiles, 0, x, y, w, h,
+                                        NULL, NULL,
+                                        &construct_flag);
+    }
+
+  gimp_projection_construct_channels (proj, tiles, 0, x, y, w, h,
+                                      &construct_flag);
+}
+
+/**
+ * gimp_projection_construct_level:
+ * @proj:  A #GimpProjection.
+ * @level: an upper level of the projection's pyramid
+ * @x:     left edge of the area, in coordinates of @level
+ * @y:     top edge of the area, in coordinates of @level
+ * @w:     width of the area
+ * @h:     height of the area
+ *
+ * Composites an area of an upper pyramid level directly from the
+ * scaled down copies of the drawables that were loaded together with
+ * them, see gimp_drawable_get_mipmap(). This avoids constructing the
+ * full size projection when the image is only looked at from afar.
+ *
+ * Return value: %TRUE if the area was constructed, %FALSE if some
+ *               visible drawable has no suitable copy at @level.
+ **/
+gboolean
+gimp_projection_construct_level (GimpProjection *proj,
+                                 gint            level,
+                                 gint            x,
+                                 gint            y,
+                                 gint            w,
+                                 gint            h)
+{
+  TileManager *tiles;
+  gboolean     construct_flag = FALSE;
+
+  g_return_val_if_fail (GIMP_IS_PROJECTION (proj), FALSE);
+  g_return_val_if_fail (level > 0, FALSE);
+
+  if (! gimp_projection_has_level (proj, level))
+    return FALSE;
+
+  tiles = gimp_projection_get_tiles_at_level (proj, level);
+
+  gimp_projection_initialize (proj, tiles, level, x, y, w, h, NULL);
+
+  gimp_projection_construct_layers (proj, tiles, level, x, y, w, h,
+                                    NULL, NULL,
+                                    &construct_flag);
+
+  gimp_projection_construct_channels (proj, tiles, level, x, y, w, h,
+                                      &construct_flag);
+
+  return TRUE;
+}
+
+/**
+ * gimp_projection_construct_below:
+ * @proj: A #GimpProjection.
+ * @x:
+ * @y:
+ * @w:
+ * @h:
+ *
+ * Composites the visible layers below the projection's cache layer
+ * into its cache tiles. This is the validate proc of those tiles.
+ */
+void
+gimp_projection_construct_below (GimpProjection *proj,
+                                 gint            x,
+                                 gint            y,
+                                 gint            w,
+                                 gint            h)
+{
+  gboolean construct_flag = FALSE;
+
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+  g_return_if_fail (proj->below_tiles != NULL);
+
+  gimp_projection_initialize (proj, proj->below_tiles, 0,
+                              x, y, w, h, proj->below_layer);
+
+  gimp_projection_construct_layers (proj, proj->below_tiles, 0,
+                                    x, y, w, h,
+                                    NULL, proj->below_layer,
+                                    &construct_flag);
 }
 
 
@@ -160,10 +299,15 @@ gimp_projection_construct (GimpProjection *proj,
 
 static void
 gimp_projection_construct_layers (GimpProjection *proj,
+                                  TileManager    *tiles,
+                                  gint            level,
                                   gint            x,
                                   gint            y,
                                   gint            w,
-                                  gint            h)
+                                  gint            h,
+                                  GimpLayer      *first,
+                                  GimpLayer      *last,
+                                  gboolean       *construct_flag)
 {
   GimpLayer *layer;
   GList     *list;
@@ -172,26 +316,41 @@ gimp_projection_construct_layers (GimpProjection *proj,
   gint       off_x;
   gint       off_y;
 
+  gboolean   below = (last == NULL);
+
   /*  composite the floating selection if it exists  */
-  if ((layer = gimp_image_floating_sel (proj->image)))
+  if (! last && (layer = gimp_image_floating_sel (proj->image)))
     floating_sel_composite (layer, x, y, w, h, FALSE);
 
   reverse_list = NULL;
 
+  /*  the list is ordered from top to bottom, only take the layers
+   *  from @first up to, but not including, @last
+   */
   for (list = GIMP_LIST (proj->image->layers)->list;
        list;
        list = g_list_next (list))
     {
       layer = list->data;
 
+      if (layer == last)
+        {
+          below = TRUE;
+          continue;
+        }
+
       /*  only add layers that are visible and not floating selections
        *  to the list
        */
-      if (! gimp_layer_is_floating_sel (layer) &&
+      if (below                                &&
+          ! gimp_layer_is_floating_sel (layer) &&
           gimp_item_get_visible (GIMP_ITEM (layer)))
         {
           reverse_list = g_list_prepend (reverse_list, layer);
         }
+
+      if (layer == first)
+        break;
     }
 
   for (list = reverse_list; list; list = g_list_next (list))
@@ -204,13 +363,39 @@ gimp_projection_construct_layers (GimpProjection *proj,
 
       gimp_item_offsets (GIMP_ITEM (layer), &off_x, &off_y);
 
+      off_x >>= level;
+      off_y >>= level;
+
       x1 = CLAMP (off_x, x, x + w);
       y1 = CLAMP (off_y, y, y + h);
-      x2 = CLAMP (off_x + gimp_item_width  (GIMP_ITEM (layer)), x, x + w);
-      y2 = CLAMP (off_y + gimp_item_height (GIMP_ITEM (layer)), y, y + h);
+      x2 = CLAMP (off_x + (gimp_item_width  (GIMP_ITEM (layer)) >> level),
+                  x, x + w);
+      y2 = CLAMP (off_y + (gimp_item_height (GIMP_ITEM (layer)) >> level),
+                  y, y + h);
+
+      /*  Skip layers that don't touch this area at all.  */
+      if (x1 == x2 || y1 == y2)
+        {
+          *construct_flag = TRUE;
+          continue;
+        }
+
+      /*  Once something has been projected, a layer that is completely
+       *  transparent in this area can't change the result, whatever its
+       *  mode.  Uniform tiles let us find out without reading pixels.
+       */
+      if (*construct_flag                                    &&
+          ! (layer->mask && layer->mask->show_mask)          &&
+          gimp_drawable_has_alpha (GIMP_DRAWABLE (layer))    &&
+          gimp_projection_layer_is_clear (layer, level,
+                                          x1 - off_x, y1 - off_y,
+                                          x2 - x1,    y2 - y1))
+        {
+          continue;
+        }
 
       /* configure the pixel regions  */
-      pixel_region_init (&src1PR, gimp_projection_get_tiles (proj),
+      pixel_region_init (&src1PR, tiles,
                          x1, y1, (x2 - x1), (y2 - y1),
                          TRUE);
 
@@ -220,7 +405,7 @@ gimp_projection_construct_layers (GimpProjection *proj,
           GimpDrawable *drawable = GIMP_DRAWABLE (layer->mask);
 
           pixel_region_init (&src2PR,
-                             gimp_drawable_get_tiles (drawable),
+                             gimp_drawable_get_mipmap (drawable, level),
                              x1 - off_x, y1 - off_y,
                              x2 - x1,    y2 - y1,
                              FALSE);
@@ -233,7 +418,8 @@ gimp_projection_construct_layers (GimpProjection *proj,
           PixelRegion *mask = NULL;
 
           pixel_region_init (&src2PR,
-                             gimp_drawable_get_tiles (GIMP_DRAWABLE (layer)),
+                             gimp_drawable_get_mipmap (GIMP_DRAWABLE (layer),
+                                                       level),
                              x1 - off_x, y1 - off_y,
                              x2 - x1,    y2 - y1,
                              FALSE);
@@ -243,7 +429,7 @@ gimp_projection_construct_layers (GimpProjection *proj,
               GimpDrawable *drawable = GIMP_DRAWABLE (layer->mask);
 
               pixel_region_init (&maskPR,
-                                 gimp_drawable_get_tiles (drawable),
+                                 gimp_drawable_get_mipmap (drawable, level),
                                  x1 - off_x, y1 - off_y,
                                  x2 - x1,    y2 - y1,
                                  FALSE);
@@ -257,20 +443,24 @@ gimp_projection_construct_layers (GimpProjection *proj,
             {
             case GIMP_RGB_IMAGE:
             case GIMP_GRAY_IMAGE:
-              project_intensity (proj, layer, &src2PR, &src1PR, mask);
+              project_intensity (proj, *construct_flag, layer,
+                                 &src2PR, &src1PR, mask);
               break;
 
             case GIMP_RGBA_IMAGE:
             case GIMP_GRAYA_IMAGE:
-              project_intensity_alpha (proj, layer, &src2PR, &src1PR, mask);
+              project_intensity_alpha (proj, *construct_flag, layer,
+                                       &src2PR, &src1PR, mask);
               break;
 
             case GIMP_INDEXED_IMAGE:
-              project_indexed (proj, layer, &src2PR, &src1PR, mask);
+              project_indexed (proj, *construct_flag, layer,
+                               &src2PR, &src1PR, mask);
               break;
 
             case GIMP_INDEXEDA_IMAGE:
-              project_indexed_alpha (proj, layer, &src2PR, &src1PR, mask);
+              project_indexed_alpha (proj, *construct_flag, layer,
+                                     &src2PR, &src1PR, mask);
               break;
 
             default:
@@ -278,7 +468,7 @@ gimp_projection_construct_layers (GimpProjection *proj,
             }
         }
 
-      proj->construct_flag = TRUE;  /*  something was projected  */
+      *construct_flag = TRUE;  /*  something was projected  */
     }
 
   g_list_free (reverse_list);
@@ -286,10 +476,13 @@ gimp_projection_construct_layers (GimpProjection *proj,
 
 static void
 gimp_projection_construct_channels (GimpProjection *proj,
+                                    TileManager    *tiles,
+                                    gint            level,
                                     gint            x,
                                     gint            y,
                                     gint            w,
-                                    gint            h)
+                                    gint            h,
+                                    gboolean       *construct_flag)
 {
   GList *list;
   GList *reverse_list = NULL;
@@ -313,17 +506,18 @@ gimp_projection_construct_channels (GimpProjection *proj,
 
           /* configure the pixel regions  */
           pixel_region_init (&src1PR,
-                             gimp_projection_get_tiles (proj),
+                             tiles,
                              x, y, w, h,
                              TRUE);
           pixel_region_init (&src2PR,
-                             gimp_drawable_get_tiles (GIMP_DRAWABLE (channel)),
+                             gimp_drawable_get_mipmap (GIMP_DRAWABLE (channel),
+                                                       level),
                              x, y, w, h,
                              FALSE);
 
-          project_channel (proj, channel, &src1PR, &src2PR);
+          project_channel (proj, *construct_flag, channel, &src1PR, &src2PR);
 
-          proj->construct_flag = TRUE;
+          *construct_flag = TRUE;
         }
     }
 
@@ -333,10 +527,13 @@ gimp_projection_construct_channels (GimpProjection *proj,
 /**
  * gimp_projection_initialize:
  * @proj: A #GimpProjection.
+ * @tiles: the tiles to initialize
+ * @level: the pyramid level of @tiles
  * @x:
  * @y:
  * @w:
  * @h:
+ * @last: only look at the layers below this one, or %NULL
  *
  * This function determines whether a visible layer with combine mode Normal
  * provides complete coverage over the specified area.  If not, the projection
@@ -344,13 +541,17 @@ gimp_projection_construct_channels (GimpProjection *proj,
  */
 static void
 gimp_projection_initialize (GimpProjection *proj,
+                            TileManager    *tiles,
+                            gint            level,
                             gint            x,
                             gint            y,
                             gint            w,
-                            gint            h)
+                            gint            h,
+                            GimpLayer      *last)
 {
 
   GList    *list;
+  gboolean  below    = (last == NULL);
   gboolean  coverage = FALSE;
 
   for (list = GIMP_LIST (proj->image->layers)->list;
@@ -360,15 +561,25 @@ gimp_projection_initialize (GimpProjection *proj,
       GimpItem *item = list->data;
       gint      off_x, off_y;
 
+      if (item == GIMP_ITEM (last))
+        {
+          below = TRUE;
+          continue;
+        }
+
       gimp_item_offsets (item, &off_x, &off_y);
 
-      if (gimp_item_get_visible (item)                                  &&
+      off_x >>= level;
+      off_y >>= level;
+
+      if (below                                                         &&
+          gimp_item_get_visible (item)                                  &&
           ! gimp_drawable_has_alpha (GIMP_DRAWABLE (item))              &&
           gimp_layer_get_mode (GIMP_LAYER (item)) == GIMP_NORMAL_MODE   &&
           (off_x <= x)                                                  &&
           (off_y <= y)                                                  &&
-          (off_x + gimp_item_width  (item) >= x + w)                    &&
-          (off_y + gimp_item_height (item) >= y + h))
+          (off_x + (gimp_item_width  (item) >> level) >= x + w)         &&
+          (off_y + (gimp_item_height (item) >> level) >= y + h))
         {
           coverage = TRUE;
           break;
@@ -380,20 +591,145 @@ gimp_projection_initialize (GimpProjection *proj,
       PixelRegion PR;
       guchar      clear[4] = { 0, 0, 0, 0 };
 
-      pixel_region_init (&PR, gimp_projection_get_tiles (proj),
-                         x, y, w, h, TRUE);
+      pixel_region_init (&PR, tiles, x, y, w, h, TRUE);
       color_region (&PR, clear);
     }
 }
 
+/*  Returns TRUE if there are visible layers below @layer.  */
+static gboolean
+gimp_projection_has_layers_below (GimpProjection *proj,
+                                  GimpLayer      *layer)
+{
+  GList    *list;
+  gboolean  below = FALSE;
+
+  for (list = GIMP_LIST (proj->image->layers)->list;
+       list;
+       list = g_list_next (list))
+    {
+      GimpItem *item = list->data;
+
+      if (item == GIMP_ITEM (layer))
+        below = TRUE;
+      else if (below                                            &&
+               ! gimp_layer_is_floating_sel (GIMP_LAYER (item)) &&
+               gimp_item_get_visible (item))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*  Returns TRUE if all visible drawables have a scaled down copy that
+ *  can be composited at @level.
+ */
+static gboolean
+gimp_projection_has_level (GimpProjection *proj,
+                           gint            level)
+{
+  GList *list;
+
+  /*  compositing the floating selection needs the full size drawable  */
+  if (gimp_image_floating_sel (proj->image))
+    return FALSE;
+
+  for (list = GIMP_LIST (proj->image->layers)->list;
+       list;
+       list = g_list_next (list))
+    {
+      GimpLayer *layer = list->data;
+
+      if (! gimp_item_get_visible (GIMP_ITEM (layer)))
+        continue;
+
+      if (! gimp_projection_has_mipmap (GIMP_DRAWABLE (layer), level))
+        return FALSE;
+
+      if (layer->mask                                             &&
+          (layer->mask->apply_mask || layer->mask->show_mask)     &&
+          ! gimp_projection_has_mipmap (GIMP_DRAWABLE (layer->mask), level))
+        return FALSE;
+    }
+
+  for (list = GIMP_LIST (proj->image->channels)->list;
+       list;
+       list = g_list_next (list))
+    {
+      GimpDrawable *channel = list->data;
+
+      if (gimp_item_get_visible (GIMP_ITEM (channel)) &&
+          ! gimp_projection_has_mipmap (channel, level))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*  Returns TRUE if @drawable has a copy at @level which lines up with the
+ *  projection's pixels at that level, that is if its offsets are a
+ *  multiple of the level's scale.
+ */
+static gboolean
+gimp_projection_has_mipmap (GimpDrawable *drawable,
+                            gint          level)
+{
+  GimpItem *item = GIMP_ITEM (drawable);
+  gint      mask = (1 << level) - 1;
+  gint      off_x;
+  gint      off_y;
+
+  /*  drawables that are too small to show up at @level are skipped  */
+  if ((gimp_item_width (item)  >> level) == 0 ||
+      (gimp_item_height (item) >> level) == 0)
+    return TRUE;
+
+  if (! gimp_drawable_get_mipmap (drawable, level))
+    return FALSE;
+
+  gimp_item_offsets (item, &off_x, &off_y);
+
+  return ! (off_x & mask) && ! (off_y & mask);
+}
+
+/*  Returns TRUE if all tiles of @layer touching the given area (in layer
+ *  coordinates) are uniform and fully transparent.
+ */
+static gboolean
+gimp_projection_layer_is_clear (GimpLayer *layer,
+                                gint       level,
+                                gint       x,
+                                gint       y,
+                                gint       w,
+                                gint       h)
+{
+  TileManager *tiles = gimp_drawable_get_mipmap (GIMP_DRAWABLE (layer),
+                                                 level);
+  gint         bytes = tile_manager_bpp (tiles);
+  gint         tx, ty;
+
+  for (ty = y; ty < y + h; ty = (ty / TILE_HEIGHT + 1) * TILE_HEIGHT)
+    for (tx = x; tx < x + w; tx = (tx / TILE_WIDTH + 1) * TILE_WIDTH)
+      {
+        Tile   *tile = tile_manager_get_tile (tiles, tx, ty, FALSE, FALSE);
+        guchar  pixel[MAX_CHANNELS];
+
+        if (! tile || ! tile_is_uniform (tile, pixel) || pixel[bytes - 1])
+          return FALSE;
+      }
+
+  return TRUE;
+}
+
 static void
 project_intensity (GimpProjection *proj,
+                   gboolean        construct_flag,
                    GimpLayer      *layer,
                    PixelRegion    *src,
                    PixelRegion    *dest,
                    PixelRegion    *mask)
 {
-  if (! proj->construct_flag)
+  if (! construct_flag)
     initial_region (src, dest, mask, NULL,
                     layer->opacity * 255.999,
                     layer->mode,
@@ -409,12 +745,13 @@ project_intensity (GimpProjection *proj,
 
 static void
 project_intensity_alpha (GimpProjection *proj,
+                         gboolean        construct_flag,
                          GimpLayer      *layer,
                          PixelRegion    *src,
                          PixelRegion    *dest,
                          PixelRegion    *mask)
 {
-  if (proj->construct_flag)
+  if (construct_flag)
     {
       combine_regions (dest, src, dest, mask, NULL,
                        layer->opacity * 255.999,
@@ -434,6 +771,7 @@ project_intensity_alpha (GimpProjection *proj,
 
 static void
 project_indexed (GimpProjection *proj,
+                 gboolean        construct_flag,
                  GimpLayer      *layer,
                  PixelRegion    *src,
                  PixelRegion    *dest,
@@ -441,7 +779,7 @@ project_indexed (GimpProjection *proj,
 {
   g_return_if_fail (proj->image->cmap != NULL);
 
-  if (proj->construct_flag)
+  if (construct_flag)
     {
       combine_regions (dest, src, dest, mask, proj->image->cmap,
                        layer->opacity * 255.999,
@@ -461,6 +799,7 @@ project_indexed (GimpProjection *proj,
 
 static void
 project_indexed_alpha (GimpProjection *proj,
+                       gboolean        construct_flag,
                        GimpLayer      *layer,
                        PixelRegion    *src,
                        PixelRegion    *dest,
@@ -468,7 +807,7 @@ project_indexed_alpha (GimpProjection *proj,
 {
   g_return_if_fail (proj->image->cmap != NULL);
 
-  if (proj->construct_flag)
+  if (construct_flag)
     {
       combine_regions (dest, src, dest, mask, proj->image->cmap,
                        layer->opacity * 255.999,
@@ -488,6 +827,7 @@ project_indexed_alpha (GimpProjection *proj,
 
 static void
 project_channel (GimpProjection *proj,
+                 gboolean        construct_flag,
                  GimpChannel    *channel,
                  PixelRegion    *src,
                  PixelRegion    *src2)
@@ -498,7 +838,7 @@ project_channel (GimpProjection *proj,
   gimp_rgba_get_uchar (&channel->color,
                        &col[0], &col[1], &col[2], &opacity);
 
-  if (proj->construct_flag)
+  if (construct_flag)
     {
       combine_regions (src, src2, src, NULL, col,
                        opacity,
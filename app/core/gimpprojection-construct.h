@@ -20,11 +20,22 @@
 #define __GIMP_PROJECTION_CONSTRUCT_H__
 
 
-void   gimp_projection_construct (GimpProjection *proj,
-                                  gint            x,
-                                  gint            y,
-                                  gint            w,
-                                  gint            h);
+void     gimp_projection_construct       (GimpProjection *proj,
+                                          gint            x,
+                                          gint            y,
+                                          gint            w,
+                                          gint            h);
+gboolean gimp_projection_construct_level (GimpProjection *proj,
+                                          gint            level,
+                                          gint            x,
+                                          gint            y,
+                                          gint            w,
+                                          gint            h);
+void     gimp_projection_construct_below (GimpProjection *proj,
+                                          gint            x,
+                                          gint            y,
+                                          gint            w,
+                                          gint            h);
 
 
 #endif /* __GIMP_PROJECTION_CONSTRUCT_H__ */
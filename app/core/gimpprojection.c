@@ -22,13 +22,17 @@
 
 #include "core-types.h"
 
+#include "config/gimpbaseconfig.h"
+
 #include "base/tile.h"
 #include "base/tile-manager.h"
 #include "base/tile-pyramid.h"
 
 #include "gimp.h"
 #include "gimparea.h"
+#include "gimpcontainer.h"
 #include "gimpimage.h"
+#include "gimplayer.h"
 #include "gimpmarshal.h"
 #include "gimppickable.h"
 #include "gimpprojection.h"
@@ -85,9 +89,33 @@ static void       gimp_projection_invalidate            (GimpProjection *proj,
                                                          guint           y,
                                                          guint           w,
                                                          guint           h);
+static void       gimp_projection_validate_run          (GimpProjection *proj,
+                                                         TileManager    *tiles,
+                                                         gint            level,
+                                                         gint            x,
+                                                         gint            y,
+                                                         gint            w);
 static void       gimp_projection_validate_tile         (TileManager    *tm,
                                                          Tile           *tile,
                                                          GimpProjection *proj);
+static gboolean   gimp_projection_validate_level_tile   (TileManager    *tm,
+                                                         Tile           *tile,
+                                                         gint            level,
+                                                         GimpProjection *proj);
+static void       gimp_projection_below_new             (GimpProjection *proj,
+                                                         GimpLayer      *layer);
+static void       gimp_projection_below_free            (GimpProjection *proj);
+static void       gimp_projection_validate_below_tile   (TileManager    *tm,
+                                                         Tile           *tile,
+                                                         GimpProjection *proj);
+static void       gimp_projection_layer_update          (GimpLayer      *layer,
+                                                         gint            x,
+                                                         gint            y,
+                                                         gint            w,
+                                                         gint            h,
+                                                         GimpProjection *proj);
+static void       gimp_projection_layer_visibility      (GimpLayer      *layer,
+                                                         GimpProjection *proj);
 static void       gimp_projection_image_update          (GimpImage      *image,
                                                          gint            x,
                                                          gint            y,
@@ -142,10 +170,11 @@ gimp_projection_init (GimpProjection *proj)
 {
   proj->image                    = NULL;
   proj->pyramid                  = NULL;
+  proj->below_tiles              = NULL;
+  proj->below_layer              = NULL;
   proj->update_areas             = NULL;
   proj->idle_render.idle_id      = 0;
   proj->idle_render.update_areas = NULL;
-  proj->construct_flag           = FALSE;
 }
 
 /* sorry for the evil casts */
@@ -185,6 +214,18 @@ gimp_projection_finalize (GObject *object)
       proj->pyramid = NULL;
     }
 
+  gimp_projection_below_free (proj);
+
+  if (proj->layer_update_handler)
+    {
+      gimp_container_remove_handler (proj->image->layers,
+                                     proj->layer_update_handler);
+      gimp_container_remove_handler (proj->image->layers,
+                                     proj->layer_visible_handler);
+      proj->layer_update_handler  = 0;
+      proj->layer_visible_handler = 0;
+    }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -196,7 +237,10 @@ gimp_projection_get_memsize (GimpObject *object,
   gint64          memsize    = 0;
 
   if (projection->pyramid)
-    memsize = tile_pyramid_get_memsize (projection->pyramid);
+    memsize += tile_pyramid_get_memsize (projection->pyramid);
+
+  if (projection->below_tiles)
+    memsize += tile_manager_get_memsize (projection->below_tiles, FALSE);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -304,6 +348,37 @@ gimp_projection_new (GimpImage *image)
                            G_CALLBACK (gimp_projection_image_flush),
                            proj, 0);
 
+  /*  keep track of the layers for the cached composite of the layers
+   *  below the one being edited
+   */
+  proj->layer_update_handler =
+    gimp_container_add_handler (image->layers, "update",
+                                G_CALLBACK (gimp_projection_layer_update),
+                                proj);
+  proj->layer_visible_handler =
+    gimp_container_add_handler (image->layers, "visibility-changed",
+                                G_CALLBACK (gimp_projection_layer_visibility),
+                                proj);
+
+  g_signal_connect_object (image->layers, "add",
+                           G_CALLBACK (gimp_projection_below_free),
+                           proj, G_CONNECT_SWAPPED);
+  g_signal_connect_object (image->layers, "remove",
+                           G_CALLBACK (gimp_projection_below_free),
+                           proj, G_CONNECT_SWAPPED);
+  g_signal_connect_object (image->layers, "reorder",
+                           G_CALLBACK (gimp_projection_below_free),
+                           proj, G_CONNECT_SWAPPED);
+  g_signal_connect_object (image, "floating-selection-changed",
+                           G_CALLBACK (gimp_projection_below_free),
+                           proj, G_CONNECT_SWAPPED);
+  g_signal_connect_object (image, "component-visibility-changed",
+                           G_CALLBACK (gimp_projection_below_free),
+                           proj, G_CONNECT_SWAPPED);
+  g_signal_connect_object (image, "colormap-changed",
+                           G_CALLBACK (gimp_projection_below_free),
+                           proj, G_CONNECT_SWAPPED);
+
   return proj;
 }
 
@@ -329,6 +404,9 @@ gimp_projection_get_tiles_at_level (GimpProjection *proj,
       tile_pyramid_set_validate_proc (proj->pyramid,
                                       (TileValidateProc) gimp_projection_validate_tile,
                                       proj);
+      tile_pyramid_set_level_proc (proj->pyramid,
+                                   (TileLevelProc) gimp_projection_validate_level_tile,
+                                   proj);
     }
 
   return tile_pyramid_get_tiles (proj->pyramid, level);
@@ -354,6 +432,82 @@ gimp_projection_get_level (GimpProjection *proj,
                                  MAX (scale_x, scale_y));
 }
 
+/**
+ * gimp_projection_validate_area:
+ * @proj:   pointer to a GimpProjection
+ * @level:  pyramid level
+ * @x:      left edge of the area, in coordinates of @level
+ * @y:      top edge of the area, in coordinates of @level
+ * @width:  width of the area
+ * @height: height of the area
+ *
+ * Constructs all invalid projection tiles of the given area. Tiles are
+ * otherwise constructed lazily, one at a time, when they are first
+ * read. Here, each run of neighbouring invalid tiles is constructed
+ * in one go instead, so that compositing the layers can be spread
+ * over the pixel processor threads.
+ *
+ * Construction walks the image's layers and caches, so this must be
+ * called from the main thread, like any other projection update.
+ *
+ * Return value: %TRUE if all tiles of the area are valid now, %FALSE
+ *               if the area is outside of the projection.
+ **/
+gboolean
+gimp_projection_validate_area (GimpProjection *proj,
+                               gint            level,
+                               gint            x,
+                               gint            y,
+                               gint            width,
+                               gint            height)
+{
+  TileManager *tiles;
+  gint         x1, y1, x2, y2;
+  gint         tx, ty;
+
+  g_return_val_if_fail (GIMP_IS_PROJECTION (proj), FALSE);
+
+  tiles = gimp_projection_get_tiles_at_level (proj, level);
+
+  x1 = CLAMP (x,          0, tile_manager_width (tiles));
+  y1 = CLAMP (y,          0, tile_manager_height (tiles));
+  x2 = CLAMP (x + width,  0, tile_manager_width (tiles));
+  y2 = CLAMP (y + height, 0, tile_manager_height (tiles));
+
+  if (x1 == x2 || y1 == y2)
+    return FALSE;
+
+  for (ty = y1 - y1 % TILE_HEIGHT; ty < y2; ty += TILE_HEIGHT)
+    {
+      gint run_x = -1;
+
+      for (tx = x1 - x1 % TILE_WIDTH; tx < x2; tx += TILE_WIDTH)
+        {
+          Tile *tile = tile_manager_get_tile (tiles, tx, ty, FALSE, FALSE);
+
+          if (! tile_is_valid (tile))
+            {
+              if (run_x < 0)
+                run_x = tx;
+            }
+          else if (run_x >= 0)
+            {
+              gimp_projection_validate_run (proj, tiles, level,
+                                            run_x, ty, tx - run_x);
+              run_x = -1;
+            }
+        }
+
+      if (run_x >= 0)
+        gimp_projection_validate_run (proj, tiles, level,
+                                      run_x, ty,
+                                      MIN (tx, tile_manager_width (tiles)) -
+                                      run_x);
+    }
+
+  return TRUE;
+}
+
 GimpImage *
 gimp_projection_get_image (const GimpProjection *proj)
 {
@@ -679,6 +833,44 @@ gimp_projection_invalidate (GimpProjection *proj,
     tile_pyramid_invalidate_area (proj->pyramid, x, y, w, h);
 }
 
+/*  Constructs a row of neighbouring invalid tiles, starting at @x, @y.
+ *  The tiles are marked valid first, so that locking them for writing
+ *  from the pixel processor threads doesn't construct them once more.
+ */
+static void
+gimp_projection_validate_run (GimpProjection *proj,
+                              TileManager    *tiles,
+                              gint            level,
+                              gint            x,
+                              gint            y,
+                              gint            w)
+{
+  gint h = MIN (TILE_HEIGHT, tile_manager_height (tiles) - y);
+  gint tx;
+
+  for (tx = x; tx < x + w; tx += TILE_WIDTH)
+    tile_manager_mark_valid (tiles, tx, y);
+
+  if (level == 0)
+    {
+      gimp_projection_construct (proj, x, y, w, h);
+    }
+  else if (! gimp_projection_construct_level (proj, level, x, y, w, h))
+    {
+      /*  the level has to be scaled down from the one below, which
+       *  the tiles' validate proc does one tile at a time
+       */
+      tile_manager_invalidate_area (tiles, x, y, w, h);
+
+      for (tx = x; tx < x + w; tx += TILE_WIDTH)
+        {
+          Tile *tile = tile_manager_get_tile (tiles, tx, y, TRUE, FALSE);
+
+          tile_release (tile, FALSE);
+        }
+    }
+}
+
 static void
 gimp_projection_validate_tile (TileManager    *tm,
                                Tile           *tile,
@@ -694,8 +886,111 @@ gimp_projection_validate_tile (TileManager    *tm,
                              tile_ewidth (tile), tile_eheight (tile));
 }
 
+/*  Upper pyramid levels are composited from the drawables' stored
+ *  levels if possible, and scaled down from the level below otherwise.
+ */
+static gboolean
+gimp_projection_validate_level_tile (TileManager    *tm,
+                                     Tile           *tile,
+                                     gint            level,
+                                     GimpProjection *proj)
+{
+  gint x, y;
+
+  tile_manager_get_tile_coordinates (tm, tile, &x, &y);
+
+  return gimp_projection_construct_level (proj, level,
+                                          x, y,
+                                          tile_ewidth (tile),
+                                          tile_eheight (tile));
+}
+
+/*  The projection keeps the composite of all layers below the layer
+ *  that was last updated, so that repeated edits of that layer only
+ *  need to project the layers from there on up. The cache is created
+ *  for the layer that receives an update, its tiles are constructed
+ *  on demand, and it is dropped whenever a layer below could have
+ *  changed.
+ */
+static void
+gimp_projection_below_new (GimpProjection *proj,
+                           GimpLayer      *layer)
+{
+  GimpBaseConfig *config = GIMP_BASE_CONFIG (proj->image->gimp->config);
+  gint64          size;
+
+  size = ((gint64) proj->image->width * proj->image->height *
+          gimp_projection_get_bytes (proj));
+
+  /*  don't let the cache push everything else out of the tile cache  */
+  if (size > config->tile_cache_size / 4)
+    return;
+
+  proj->below_layer = layer;
+  proj->below_tiles = tile_manager_new (proj->image->width,
+                                        proj->image->height,
+                                        gimp_projection_get_bytes (proj));
+
+  tile_manager_set_validate_proc (proj->below_tiles,
+                                  (TileValidateProc)
+                                  gimp_projection_validate_below_tile,
+                                  proj);
+}
+
+static void
+gimp_projection_below_free (GimpProjection *proj)
+{
+  if (proj->below_tiles)
+    {
+      tile_manager_unref (proj->below_tiles);
+      proj->below_tiles = NULL;
+    }
+
+  proj->below_layer = NULL;
+}
+
+static void
+gimp_projection_validate_below_tile (TileManager    *tm,
+                                     Tile           *tile,
+                                     GimpProjection *proj)
+{
+  gint x, y;
+
+  tile_manager_get_tile_coordinates (tm, tile, &x, &y);
+
+  gimp_projection_construct_below (proj,
+                                   x, y,
+                                   tile_ewidth (tile), tile_eheight (tile));
+}
+
 /*  image callbacks  */
 
+static void
+gimp_projection_layer_update (GimpLayer      *layer,
+                              gint            x,
+                              gint            y,
+                              gint            w,
+                              gint            h,
+                              GimpProjection *proj)
+{
+  /*  updates of the cached layer itself don't affect the layers below  */
+  if (layer == proj->below_layer              ||
+      gimp_layer_is_floating_sel (layer)      ||
+      ! gimp_item_get_visible (GIMP_ITEM (layer)))
+    return;
+
+  /*  some other layer changed, move the cache to it  */
+  gimp_projection_below_free (proj);
+  gimp_projection_below_new (proj, layer);
+}
+
+static void
+gimp_projection_layer_visibility (GimpLayer      *layer,
+                                  GimpProjection *proj)
+{
+  gimp_projection_below_free (proj);
+}
+
 static void
 gimp_projection_image_update (GimpImage      *image,
                               gint            x,
@@ -717,6 +1012,8 @@ gimp_projection_image_size_changed (GimpImage      *image,
       proj->pyramid = NULL;
     }
 
+  gimp_projection_below_free (proj);
+
   gimp_projection_add_update_area (proj, 0, 0, image->width, image->height);
 }
 
@@ -730,6 +1027,8 @@ gimp_projection_image_mode_changed (GimpImage      *image,
       proj->pyramid = NULL;
     }
 
+  gimp_projection_below_free (proj);
+
   gimp_projection_add_update_area (proj, 0, 0, image->width, image->height);
 }
 
@@ -57,10 +57,14 @@ struct _GimpProjection
 
   TilePyramid              *pyramid;
 
+  TileManager              *below_tiles;  /*  layers below below_layer  */
+  GimpLayer                *below_layer;
+  GQuark                    layer_update_handler;
+  GQuark                    layer_visible_handler;
+
   GSList                   *update_areas;
   GimpProjectionIdleRender  idle_render;
 
-  gboolean                  construct_flag;
   gboolean                  invalidate_preview;
 };
 
@@ -89,6 +93,12 @@ TileManager    * gimp_projection_get_tiles_at_level
 gint             gimp_projection_get_level        (GimpProjection       *proj,
                                                    gdouble               scale_x,
                                                    gdouble               scale_y);
+gboolean         gimp_projection_validate_area    (GimpProjection       *proj,
+                                                   gint                  level,
+                                                   gint                  x,
+                                                   gint                  y,
+                                                   gint                  width,
+                                                   gint                  height);
 
 GimpImage      * gimp_projection_get_image        (const GimpProjection *proj);
 GimpImageType    gimp_projection_get_image_type   (const GimpProjection *proj);
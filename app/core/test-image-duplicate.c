@@ -0,0 +1,162 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * Test for gimp_image_duplicate().
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core-types.h"
+
+#include "base/base.h"
+#include "base/tile-manager.h"
+
+#include "config/gimpbaseconfig.h"
+
+#include "gimp.h"
+#include "gimpchannel.h"
+#include "gimpchannel-select.h"
+#include "gimpimage.h"
+#include "gimpimage-duplicate.h"
+
+
+#define IMAGE_SIZE  512
+
+#define SEL_X       10
+#define SEL_Y       10
+#define SEL_SIZE    20
+
+
+static gint  check_mask (GimpImage   *image,
+                         const gchar *name);
+
+
+int
+main (int   argc,
+      char *argv[])
+{
+  Gimp      *gimp;
+  GimpImage *image;
+  GimpImage *new_image;
+  gint       failures = 0;
+  gint       i;
+
+  for (i = 1; i < argc; i++)
+    {
+      if (strcmp (argv[i], "--g-fatal-warnings") == 0)
+        {
+          GLogLevelFlags fatal_mask;
+
+          fatal_mask = g_log_set_always_fatal (G_LOG_FATAL_MASK);
+          fatal_mask |= G_LOG_LEVEL_WARNING | G_LOG_LEVEL_CRITICAL;
+          g_log_set_always_fatal (fatal_mask);
+        }
+    }
+
+  g_type_init ();
+
+  g_print ("\nTesting gimp_image_duplicate() ...\n");
+
+  gimp = gimp_new ("test-image-duplicate", NULL,
+                   FALSE,  /* be_verbose       */
+                   TRUE,   /* no_data          */
+                   TRUE,   /* no_fonts         */
+                   TRUE,   /* no_interface     */
+                   FALSE,  /* use_shm          */
+                   TRUE,   /* console_messages */
+                   GIMP_STACK_TRACE_NEVER,
+                   GIMP_PDB_COMPAT_OFF);
+
+  gimp_load_config (gimp, NULL, NULL);
+
+  base_init (GIMP_BASE_CONFIG (gimp->config), FALSE, FALSE);
+
+  g_print (" Creating an image with a partial selection ...");
+  image = gimp_image_new (gimp, IMAGE_SIZE, IMAGE_SIZE, GIMP_RGB);
+
+  /*  adding to the empty selection leaves the other mask tiles
+   *  unvalidated, the way a new selection has them
+   */
+  gimp_channel_select_rectangle (gimp_image_get_mask (image),
+                                 SEL_X, SEL_Y, SEL_SIZE, SEL_SIZE,
+                                 GIMP_CHANNEL_OP_ADD,
+                                 FALSE, 0.0, 0.0, FALSE);
+  g_print (" done.\n");
+
+  g_print (" Duplicating the image ...");
+  new_image = gimp_image_duplicate (image);
+  g_print (" done.\n");
+
+  failures += check_mask (new_image, "duplicate");
+  failures += check_mask (image,     "original");
+
+  g_object_unref (new_image);
+  g_object_unref (image);
+  g_object_unref (gimp);
+
+  base_exit ();
+
+  if (failures)
+    {
+      g_print ("\n%d pixels of the selection masks are wrong.\n\n", failures);
+      return EXIT_FAILURE;
+    }
+
+  g_print ("\nFinished test of gimp_image_duplicate().\n\n");
+
+  return EXIT_SUCCESS;
+}
+
+/*  Checks that the mask is 255 inside of the selected rectangle and 0
+ *  everywhere else, sampling a few pixels of every tile.
+ */
+static gint
+check_mask (GimpImage   *image,
+            const gchar *name)
+{
+  TileManager *tiles;
+  gint         failures = 0;
+  gint         x, y;
+
+  g_print (" Checking the selection mask of the %s ...", name);
+
+  tiles = gimp_drawable_get_tiles (GIMP_DRAWABLE (gimp_image_get_mask (image)));
+
+  for (y = 0; y < IMAGE_SIZE; y += 7)
+    for (x = 0; x < IMAGE_SIZE; x += 7)
+      {
+        guchar   value    = 0x55;
+        gboolean selected = (x >= SEL_X && x < SEL_X + SEL_SIZE &&
+                             y >= SEL_Y && y < SEL_Y + SEL_SIZE);
+
+        read_pixel_data_1 (tiles, x, y, &value);
+
+        if (value != (selected ? OPAQUE_OPACITY : TRANSPARENT_OPACITY))
+          failures++;
+      }
+
+  g_print (failures ? " FAILED.\n" : " OK.\n");
+
+  return failures;
+}
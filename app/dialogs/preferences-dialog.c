@@ -1562,9 +1562,9 @@ prefs_dialog_new (Gimp       *gimp,
                            GTK_CONTAINER (vbox), FALSE);
 
 #ifdef ENABLE_MP
-  table = prefs_table_new (5, GTK_CONTAINER (vbox2));
+  table = prefs_table_new (6, GTK_CONTAINER (vbox2));
 #else
-  table = prefs_table_new (4, GTK_CONTAINER (vbox2));
+  table = prefs_table_new (5, GTK_CONTAINER (vbox2));
 #endif /* ENABLE_MP */
 
   prefs_spin_button_add (object, "undo-levels", 1.0, 5.0, 0,
@@ -1576,16 +1576,23 @@ prefs_dialog_new (Gimp       *gimp,
   prefs_memsize_entry_add (object, "tile-cache-size",
                            _("Tile cache _size:"),
                            GTK_TABLE (table), 2, size_group);
+  prefs_memsize_entry_add (object, "tile-compress-size",
+                           _("Memory for _compressed tiles:"),
+                           GTK_TABLE (table), 3, size_group);
   prefs_memsize_entry_add (object, "max-new-image-size",
                            _("Maximum _new image size:"),
-                           GTK_TABLE (table), 3, size_group);
+                           GTK_TABLE (table), 4, size_group);
 
 #ifdef ENABLE_MP
   prefs_spin_button_add (object, "num-processors", 1.0, 4.0, 0,
                          _("Number of _processors to use:"),
-                         GTK_TABLE (table), 4, size_group);
+                         GTK_TABLE (table), 5, size_group);
 #endif /* ENABLE_MP */
 
+  prefs_check_button_add (object, "xcf-lazy-loading",
+                          _("Read XCF image data _when it is needed"),
+                          GTK_BOX (vbox2));
+
   /*  Image Thumbnails  */
   vbox2 = prefs_frame_new (_("Image Thumbnails"), GTK_CONTAINER (vbox), FALSE);
 
@@ -1606,6 +1613,12 @@ prefs_dialog_new (Gimp       *gimp,
                           _("Confirm closing of unsa_ved images"),
                           GTK_BOX (vbox2));
 
+  table = prefs_table_new (1, GTK_CONTAINER (vbox2));
+
+  prefs_enum_combo_box_add (object, "xcf-compression", 0, 0,
+                            _("XCF _compression:"),
+                            GTK_TABLE (table), 0, size_group);
+
   g_object_unref (size_group);
   size_group = NULL;
 
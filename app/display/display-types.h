@@ -35,6 +35,7 @@ typedef struct _GimpNavigationEditor  GimpNavigationEditor;
 typedef struct _GimpScaleComboBox     GimpScaleComboBox;
 typedef struct _GimpStatusbar         GimpStatusbar;
 
+typedef struct _RenderCache           RenderCache;
 typedef struct _Selection             Selection;
 
 
@@ -38,6 +38,7 @@
 #include "gimpdisplay-handlers.h"
 #include "gimpdisplayshell.h"
 #include "gimpdisplayshell-handlers.h"
+#include "gimpdisplayshell-render-cache.h"
 #include "gimpdisplayshell-transform.h"
 
 #include "gimp-intl.h"
@@ -570,5 +571,7 @@ gimp_display_paint_area (GimpDisplay *display,
   x2 = ceil (x2_f + 0.5);
   y2 = ceil (y2_f + 0.5);
 
+  gimp_display_shell_render_cache_invalidate (shell,
+                                              x1, y1, x2 - x1, y2 - y1);
   gimp_display_shell_expose_area (shell, x1, y1, x2 - x1, y2 - y1);
 }
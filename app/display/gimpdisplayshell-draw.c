@@ -47,6 +47,7 @@
 #include "gimpdisplayshell-appearance.h"
 #include "gimpdisplayshell-draw.h"
 #include "gimpdisplayshell-render.h"
+#include "gimpdisplayshell-render-cache.h"
 #include "gimpdisplayshell-transform.h"
 
 
@@ -548,6 +549,12 @@ gimp_display_shell_draw_area (GimpDisplayShell *shell,
       gint          x2, y2;
       gint          i, j;
 
+      /*  render whole tiles of the render cache, so they can be cached  */
+      gimp_display_shell_render_cache_align (shell, &x, &y, &w, &h);
+      gimp_rectangle_intersect (x, y, w, h,
+                                sx, sy, sw, sh,
+                                &x, &y, &w, &h);
+
       x2 = x + w;
       y2 = y + h;
 
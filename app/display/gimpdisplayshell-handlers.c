@@ -41,6 +41,7 @@
 #include "gimpdisplayshell-callbacks.h"
 #include "gimpdisplayshell-draw.h"
 #include "gimpdisplayshell-handlers.h"
+#include "gimpdisplayshell-render.h"
 #include "gimpdisplayshell-scale.h"
 #include "gimpdisplayshell-selection.h"
 #include "gimpdisplayshell-title.h"
@@ -427,6 +428,9 @@ static void
 gimp_display_shell_size_changed_handler (GimpImage        *image,
                                          GimpDisplayShell *shell)
 {
+  /*  the areas waiting to be refined are in the old image's coordinates  */
+  gimp_display_shell_render_stop_progressive (shell);
+
   gimp_display_shell_scale_resize (shell,
                                    GIMP_DISPLAY_CONFIG (image->gimp->config)->resize_windows_on_resize,
                                    TRUE);
@@ -0,0 +1,452 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*  The render cache keeps the final RGB pixels gimp_display_shell_render()
+ *  produced, after scaling, checkerboard blending and the display
+ *  filters, in tiles on a fixed grid of the zoomed image.  The grid does
+ *  not move when the view is scrolled, so exposes caused by scrolling,
+ *  unhiding the window or undrawing the marching ants are served from
+ *  the cache instead of being rendered again.
+ *
+ *  Each tile remembers how much of it, counted from its top left corner,
+ *  holds valid pixels.  This covers tiles cut off by the image edge.
+ *
+ *  The cache is only good for one zoom level.  It is dropped when the
+ *  scale changes and on gimp_display_shell_expose_full().  Projection
+ *  updates invalidate the tiles they touch.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "display-types.h"
+
+#include "gimpdisplayshell.h"
+#include "gimpdisplayshell-render-cache.h"
+
+
+#define TILE_SIZE   64
+#define MAX_TILES  512   /*  6 MB of RGB pixels per display  */
+
+
+typedef struct _RenderCacheTile RenderCacheTile;
+
+struct _RenderCacheTile
+{
+  guint   key;
+  GList   link;                /*  link in the LRU queue               */
+  gint    width;               /*  extent of the valid pixels          */
+  gint    height;
+  guchar  data[TILE_SIZE * TILE_SIZE * 3];
+};
+
+struct _RenderCache
+{
+  GimpDisplayShell *shell;
+  gdouble           scale_x;   /*  scale the cached tiles were made at */
+  gdouble           scale_y;
+  GHashTable       *tiles;     /*  tiles by row and column             */
+  GQueue           *lru;       /*  most recently used tile first       */
+};
+
+
+#define TILE_KEY(col,row)  (((guint) (row) << 16) | (guint) (col))
+#define TILE_KEY_MAX       0xffff
+
+
+static void      render_cache_check_scale (RenderCache     *cache);
+static void      render_cache_remove      (RenderCache     *cache,
+                                           RenderCacheTile *tile);
+
+
+/*  public functions  */
+
+void
+gimp_display_shell_render_cache_init (GimpDisplayShell *shell)
+{
+  RenderCache *cache;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+  g_return_if_fail (shell->render_cache == NULL);
+
+  cache = g_slice_new0 (RenderCache);
+
+  cache->shell   = shell;
+  cache->scale_x = shell->scale_x;
+  cache->scale_y = shell->scale_y;
+  cache->tiles   = g_hash_table_new (g_direct_hash, g_direct_equal);
+  cache->lru     = g_queue_new ();
+
+  shell->render_cache = cache;
+}
+
+void
+gimp_display_shell_render_cache_free (GimpDisplayShell *shell)
+{
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (shell->render_cache)
+    {
+      RenderCache *cache = shell->render_cache;
+
+      gimp_display_shell_render_cache_flush (shell);
+
+      g_hash_table_destroy (cache->tiles);
+      g_queue_free (cache->lru);
+
+      g_slice_free (RenderCache, cache);
+
+      shell->render_cache = NULL;
+    }
+}
+
+void
+gimp_display_shell_render_cache_flush (GimpDisplayShell *shell)
+{
+  RenderCache *cache;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  cache = shell->render_cache;
+
+  if (! cache)
+    return;
+
+  while (cache->lru->head)
+    render_cache_remove (cache, cache->lru->head->data);
+}
+
+/*  invalidates the cached pixels in an area given in display coordinates  */
+void
+gimp_display_shell_render_cache_invalidate (GimpDisplayShell *shell,
+                                            gint              x,
+                                            gint              y,
+                                            gint              w,
+                                            gint              h)
+{
+  RenderCache *cache;
+  gint         col1, row1;
+  gint         col2, row2;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  cache = shell->render_cache;
+
+  if (! cache)
+    return;
+
+  render_cache_check_scale (cache);
+
+  /*  to coordinates of the zoomed image  */
+  x += shell->offset_x - shell->disp_xoffset;
+  y += shell->offset_y - shell->disp_yoffset;
+
+  if (x + w <= 0 || y + h <= 0 || w <= 0 || h <= 0)
+    return;
+
+  col1 = MAX (x, 0) / TILE_SIZE;
+  row1 = MAX (y, 0) / TILE_SIZE;
+  col2 = (x + w - 1) / TILE_SIZE;
+  row2 = (y + h - 1) / TILE_SIZE;
+
+  if ((gint64) (col2 - col1 + 1) * (row2 - row1 + 1) >
+      (gint64) g_queue_get_length (cache->lru))
+    {
+      GList *list = cache->lru->head;
+
+      /*  the area covers more tiles than are cached, go through the cache  */
+      while (list)
+        {
+          RenderCacheTile *tile = list->data;
+          gint             col  = tile->key & TILE_KEY_MAX;
+          gint             row  = tile->key >> 16;
+
+          list = g_list_next (list);
+
+          if (col >= col1 && col <= col2 && row >= row1 && row <= row2)
+            render_cache_remove (cache, tile);
+        }
+    }
+  else
+    {
+      gint col, row;
+
+      for (row = row1; row <= MIN (row2, TILE_KEY_MAX); row++)
+        for (col = col1; col <= MIN (col2, TILE_KEY_MAX); col++)
+          {
+            RenderCacheTile *tile;
+
+            tile = g_hash_table_lookup (cache->tiles,
+                                        GUINT_TO_POINTER (TILE_KEY (col, row)));
+
+            if (tile)
+              render_cache_remove (cache, tile);
+          }
+    }
+}
+
+/*  grows an area given in display coordinates to whole cache tiles, so
+ *  that rendering it fills the tiles it touches; the area must not start
+ *  left of or above the image
+ */
+void
+gimp_display_shell_render_cache_align (GimpDisplayShell *shell,
+                                       gint             *x,
+                                       gint             *y,
+                                       gint             *w,
+                                       gint             *h)
+{
+  gint sx, sy;
+  gint x1, y1;
+  gint x2, y2;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+  g_return_if_fail (x != NULL && y != NULL && w != NULL && h != NULL);
+
+  /*  the image's origin in display coordinates  */
+  sx = shell->disp_xoffset - shell->offset_x;
+  sy = shell->disp_yoffset - shell->offset_y;
+
+  if (*x < sx || *y < sy)
+    return;
+
+  x1 = ((*x - sx) / TILE_SIZE) * TILE_SIZE;
+  y1 = ((*y - sy) / TILE_SIZE) * TILE_SIZE;
+  x2 = ((*x + *w - sx + TILE_SIZE - 1) / TILE_SIZE) * TILE_SIZE;
+  y2 = ((*y + *h - sy + TILE_SIZE - 1) / TILE_SIZE) * TILE_SIZE;
+
+  *x = sx + x1;
+  *y = sy + y1;
+  *w = x2 - x1;
+  *h = y2 - y1;
+}
+
+/*  copies an area of the zoomed image from the cache to buf, if all of
+ *  it is cached
+ */
+gboolean
+gimp_display_shell_render_cache_fetch (GimpDisplayShell *shell,
+                                       gint              x,
+                                       gint              y,
+                                       gint              w,
+                                       gint              h,
+                                       guchar           *buf,
+                                       gint              bpl)
+{
+  RenderCache *cache;
+  gint         col1, row1;
+  gint         col2, row2;
+  gint         col, row;
+
+  g_return_val_if_fail (GIMP_IS_DISPLAY_SHELL (shell), FALSE);
+  g_return_val_if_fail (buf != NULL, FALSE);
+
+  cache = shell->render_cache;
+
+  if (! cache || x < 0 || y < 0)
+    return FALSE;
+
+  render_cache_check_scale (cache);
+
+  col1 = x / TILE_SIZE;
+  row1 = y / TILE_SIZE;
+  col2 = (x + w - 1) / TILE_SIZE;
+  row2 = (y + h - 1) / TILE_SIZE;
+
+  if (col2 > TILE_KEY_MAX || row2 > TILE_KEY_MAX)
+    return FALSE;
+
+  /*  first make sure all of the area is there  */
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      {
+        RenderCacheTile *tile;
+
+        tile = g_hash_table_lookup (cache->tiles,
+                                    GUINT_TO_POINTER (TILE_KEY (col, row)));
+
+        if (! tile ||
+            MIN (x + w, (col + 1) * TILE_SIZE) > col * TILE_SIZE + tile->width ||
+            MIN (y + h, (row + 1) * TILE_SIZE) > row * TILE_SIZE + tile->height)
+          return FALSE;
+      }
+
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      {
+        RenderCacheTile *tile;
+        const guchar    *src;
+        guchar          *dest;
+        gint             tx, ty;
+        gint             x1, y1;
+        gint             x2, y2;
+        gint             i;
+
+        tile = g_hash_table_lookup (cache->tiles,
+                                    GUINT_TO_POINTER (TILE_KEY (col, row)));
+
+        tx = col * TILE_SIZE;
+        ty = row * TILE_SIZE;
+
+        x1 = MAX (x, tx);
+        y1 = MAX (y, ty);
+        x2 = MIN (x + w, tx + TILE_SIZE);
+        y2 = MIN (y + h, ty + TILE_SIZE);
+
+        src  = tile->data + ((y1 - ty) * TILE_SIZE + (x1 - tx)) * 3;
+        dest = buf + (y1 - y) * bpl + (x1 - x) * 3;
+
+        for (i = y1; i < y2; i++)
+          {
+            memcpy (dest, src, (x2 - x1) * 3);
+
+            src  += TILE_SIZE * 3;
+            dest += bpl;
+          }
+
+        g_queue_unlink (cache->lru, &tile->link);
+        g_queue_push_head_link (cache->lru, &tile->link);
+      }
+
+  return TRUE;
+}
+
+/*  puts the pixels of an area of the zoomed image that were just
+ *  rendered to buf into the cache
+ */
+void
+gimp_display_shell_render_cache_store (GimpDisplayShell *shell,
+                                       gint              x,
+                                       gint              y,
+                                       gint              w,
+                                       gint              h,
+                                       const guchar     *buf,
+                                       gint              bpl)
+{
+  RenderCache *cache;
+  gint         col1, row1;
+  gint         col2, row2;
+  gint         col, row;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+  g_return_if_fail (buf != NULL);
+
+  cache = shell->render_cache;
+
+  if (! cache || x < 0 || y < 0)
+    return;
+
+  render_cache_check_scale (cache);
+
+  /*  only tiles whose top left corner lies in the area can be stored  */
+  col1 = (x + TILE_SIZE - 1) / TILE_SIZE;
+  row1 = (y + TILE_SIZE - 1) / TILE_SIZE;
+  col2 = MIN ((x + w - 1) / TILE_SIZE, TILE_KEY_MAX);
+  row2 = MIN ((y + h - 1) / TILE_SIZE, TILE_KEY_MAX);
+
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      {
+        RenderCacheTile *tile;
+        const guchar    *src;
+        guchar          *dest;
+        guint            key = TILE_KEY (col, row);
+        gint             tx  = col * TILE_SIZE;
+        gint             ty  = row * TILE_SIZE;
+        gint             width;
+        gint             height;
+        gint             i;
+
+        width  = MIN (x + w - tx, TILE_SIZE);
+        height = MIN (y + h - ty, TILE_SIZE);
+
+        tile = g_hash_table_lookup (cache->tiles, GUINT_TO_POINTER (key));
+
+        if (tile)
+          {
+            g_queue_unlink (cache->lru, &tile->link);
+          }
+        else
+          {
+            tile = g_slice_new (RenderCacheTile);
+
+            tile->key       = key;
+            tile->link.data = tile;
+            tile->width     = 0;
+            tile->height    = 0;
+
+            g_hash_table_insert (cache->tiles, GUINT_TO_POINTER (key), tile);
+          }
+
+        g_queue_push_head_link (cache->lru, &tile->link);
+
+        src  = buf + (ty - y) * bpl + (tx - x) * 3;
+        dest = tile->data;
+
+        for (i = 0; i < height; i++)
+          {
+            memcpy (dest, src, width * 3);
+
+            src  += bpl;
+            dest += TILE_SIZE * 3;
+          }
+
+        /*  the pixels already there are just as valid as the new ones,
+         *  keep whichever of the two areas is larger
+         */
+        if (width * height >= tile->width * tile->height)
+          {
+            tile->width  = width;
+            tile->height = height;
+          }
+      }
+
+  while (g_queue_get_length (cache->lru) > MAX_TILES)
+    render_cache_remove (cache, cache->lru->tail->data);
+}
+
+
+/*  private functions  */
+
+static void
+render_cache_check_scale (RenderCache *cache)
+{
+  GimpDisplayShell *shell = cache->shell;
+
+  if (cache->scale_x != shell->scale_x ||
+      cache->scale_y != shell->scale_y)
+    {
+      gimp_display_shell_render_cache_flush (shell);
+
+      cache->scale_x = shell->scale_x;
+      cache->scale_y = shell->scale_y;
+    }
+}
+
+static void
+render_cache_remove (RenderCache     *cache,
+                     RenderCacheTile *tile)
+{
+  g_queue_unlink (cache->lru, &tile->link);
+  g_hash_table_remove (cache->tiles, GUINT_TO_POINTER (tile->key));
+
+  g_slice_free (RenderCacheTile, tile);
+}
@@ -0,0 +1,54 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GIMP_DISPLAY_SHELL_RENDER_CACHE_H__
+#define __GIMP_DISPLAY_SHELL_RENDER_CACHE_H__
+
+
+void       gimp_display_shell_render_cache_init       (GimpDisplayShell *shell);
+void       gimp_display_shell_render_cache_free       (GimpDisplayShell *shell);
+
+void       gimp_display_shell_render_cache_flush      (GimpDisplayShell *shell);
+void       gimp_display_shell_render_cache_invalidate (GimpDisplayShell *shell,
+                                                       gint              x,
+                                                       gint              y,
+                                                       gint              w,
+                                                       gint              h);
+void       gimp_display_shell_render_cache_align      (GimpDisplayShell *shell,
+                                                       gint             *x,
+                                                       gint             *y,
+                                                       gint             *w,
+                                                       gint             *h);
+
+gboolean   gimp_display_shell_render_cache_fetch      (GimpDisplayShell *shell,
+                                                       gint              x,
+                                                       gint              y,
+                                                       gint              w,
+                                                       gint              h,
+                                                       guchar           *buf,
+                                                       gint              bpl);
+void       gimp_display_shell_render_cache_store      (GimpDisplayShell *shell,
+                                                       gint              x,
+                                                       gint              y,
+                                                       gint              w,
+                                                       gint              h,
+                                                       const guchar     *buf,
+                                                       gint              bpl);
+
+
+#endif  /*  __GIMP_DISPLAY_SHELL_RENDER_CACHE_H__  */
@@ -28,9 +28,11 @@
 
 #include "display-types.h"
 
+#include "base/pixel-processor.h"
 #include "base/tile-manager.h"
 #include "base/tile.h"
 
+#include "config/gimpbaseconfig.h"
 #include "config/gimpdisplayconfig.h"
 
 #include "core/gimp.h"
@@ -46,6 +48,7 @@
 #include "gimpdisplayshell.h"
 #include "gimpdisplayshell-filter.h"
 #include "gimpdisplayshell-render.h"
+#include "gimpdisplayshell-render-cache.h"
 
 #define GIMP_DISPLAY_ZOOM_FAST     (1 << 0) /* use the fastest possible code
                                                path trading quality for speed
@@ -56,6 +59,18 @@
                                                100% and 200% zoom)
                                              */
 
+/*  exposed areas are split into strips of at least this many rows,
+ *  which are rendered in parallel
+ */
+#define RENDER_MIN_STRIP_HEIGHT    32
+
+#define RENDER_TILE_BUF_SIZE       (GIMP_RENDER_BUF_WIDTH * MAX_CHANNELS)
+
+/*  images with fewer pixels than this are rendered at full quality
+ *  right away when the zoom changes
+ */
+#define PROGRESSIVE_MIN_PIXELS     (2048 * 2048)
+
 typedef struct _RenderInfo  RenderInfo;
 
 typedef void (* RenderFunc) (RenderInfo *info);
@@ -67,6 +82,7 @@ struct _RenderInfo
   const guint      *alpha;
   const guchar     *src;
   guchar           *dest;
+  guchar           *tile_buf;   /* scratch row for the tile fault functions */
   gint              x, y;
   gint              w, h;
   gdouble           scalex;
@@ -96,20 +112,60 @@ struct _RenderInfo
   gint64            dy;
 };
 
+typedef struct _RenderStrip RenderStrip;
+
+struct _RenderStrip
+{
+  RenderInfo        info;
+  RenderFunc        func;
+};
+
+static void  gimp_display_shell_render_info_init    (RenderInfo       *info,
+                                                     GimpDisplayShell *shell,
+                                                     gint              x,
+                                                     gint              y,
+                                                     gint              w,
+                                                     gint              h);
 static void  gimp_display_shell_render_info_scale   (RenderInfo       *info,
                                                      GimpDisplayShell *shell,
                                                      TileManager      *tiles,
                                                      gint              level);
 
+static void  gimp_display_shell_render_projection   (GimpDisplayShell *shell,
+                                                     RenderInfo       *info,
+                                                     gboolean          coarse);
+static void  gimp_display_shell_render_queue_refine (GimpDisplayShell *shell,
+                                                     gint              x,
+                                                     gint              y,
+                                                     gint              w,
+                                                     gint              h);
+static gboolean gimp_display_shell_render_refine_idle
+                                                    (GimpDisplayShell *shell);
+static void  gimp_display_shell_render_strips       (RenderInfo       *info,
+                                                     RenderFunc        func,
+                                                     TileManager      *tiles,
+                                                     gint              level);
+
 static void  gimp_display_shell_render_setup_notify (GObject          *config,
                                                      GParamSpec       *param_spec,
                                                      Gimp             *gimp);
+static void  gimp_display_shell_render_threads_notify
+                                                    (GObject          *config,
+                                                     GParamSpec       *param_spec,
+                                                     Gimp             *gimp);
+
 
+static guchar      *tile_buf       = NULL;
 
-static guchar *tile_buf    = NULL;
+static guint        check_mod      = 0;
+static guint        check_shift    = 0;
 
-static guint   check_mod   = 0;
-static guint   check_shift = 0;
+#ifdef ENABLE_MP
+static GThreadPool *render_pool    = NULL;
+static GMutex      *render_mutex   = NULL;
+static GCond       *render_cond    = NULL;
+static gint         render_pending = 0;
+#endif
 
 
 void
@@ -124,11 +180,18 @@ gimp_display_shell_render_init (Gimp *gimp)
   g_signal_connect (gimp->config, "notify::transparency-type",
                     G_CALLBACK (gimp_display_shell_render_setup_notify),
                     gimp);
+  g_signal_connect (gimp->config, "notify::num-processors",
+                    G_CALLBACK (gimp_display_shell_render_threads_notify),
+                    gimp);
 
-  /*  allocate a buffer for arranging information from a row of tiles  */
-  tile_buf = g_new (guchar, GIMP_RENDER_BUF_WIDTH * MAX_CHANNELS);
+  /*  allocate buffers for arranging information from a row of tiles,
+   *  one for each strip that may be rendered at the same time
+   */
+  tile_buf = g_new (guchar, GIMP_MAX_NUM_THREADS * RENDER_TILE_BUF_SIZE);
 
   gimp_display_shell_render_setup_notify (G_OBJECT (gimp->config), NULL, gimp);
+  gimp_display_shell_render_threads_notify (G_OBJECT (gimp->config), NULL,
+                                            gimp);
 }
 
 void
@@ -139,6 +202,23 @@ gimp_display_shell_render_exit (Gimp *gimp)
   g_signal_handlers_disconnect_by_func (gimp->config,
                                         gimp_display_shell_render_setup_notify,
                                         gimp);
+  g_signal_handlers_disconnect_by_func (gimp->config,
+                                        gimp_display_shell_render_threads_notify,
+                                        gimp);
+
+#ifdef ENABLE_MP
+  if (render_pool)
+    {
+      g_thread_pool_free (render_pool, TRUE, TRUE);
+      render_pool = NULL;
+
+      g_cond_free (render_cond);
+      render_cond = NULL;
+
+      g_mutex_free (render_mutex);
+      render_mutex = NULL;
+    }
+#endif
 
   if (tile_buf)
     {
@@ -177,6 +257,70 @@ gimp_display_shell_render_setup_notify (GObject    *config,
     }
 }
 
+#ifdef ENABLE_MP
+static void
+gimp_display_shell_render_strip (RenderStrip *strip,
+                                 gpointer     data)
+{
+  strip->func (&strip->info);
+
+  g_mutex_lock (render_mutex);
+
+  if (--render_pending == 0)
+    g_cond_signal (render_cond);
+
+  g_mutex_unlock (render_mutex);
+}
+#endif
+
+static void
+gimp_display_shell_render_threads_notify (GObject    *config,
+                                          GParamSpec *param_spec,
+                                          Gimp       *gimp)
+{
+#ifdef ENABLE_MP
+  gint    num_threads = GIMP_BASE_CONFIG (config)->num_processors;
+  GError *error       = NULL;
+
+  /*  the calling thread renders one of the strips itself  */
+  num_threads = MIN (num_threads, GIMP_MAX_NUM_THREADS) - 1;
+
+  if (num_threads < 1)
+    {
+      if (render_pool)
+        {
+          g_thread_pool_free (render_pool, TRUE, TRUE);
+          render_pool = NULL;
+
+          g_cond_free (render_cond);
+          render_cond = NULL;
+
+          g_mutex_free (render_mutex);
+          render_mutex = NULL;
+        }
+    }
+  else if (render_pool)
+    {
+      g_thread_pool_set_max_threads (render_pool, num_threads, &error);
+    }
+  else
+    {
+      render_pool = g_thread_pool_new ((GFunc) gimp_display_shell_render_strip,
+                                       NULL, num_threads, TRUE, &error);
+
+      render_mutex = g_mutex_new ();
+      render_cond  = g_cond_new ();
+    }
+
+  if (G_UNLIKELY (error))
+    {
+      g_warning ("changing the number of render threads to %d failed: %s",
+                 num_threads, error->message);
+      g_clear_error (&error);
+    }
+#endif
+}
+
 
 /*  Render Image functions  */
 
@@ -214,86 +358,47 @@ gimp_display_shell_render (GimpDisplayShell *shell,
                            GdkRectangle     *highlight)
 {
   GimpProjection *projection;
-  GimpImage      *image;
   RenderInfo      info;
-  GimpImageType   type;
 
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
   g_return_if_fail (w > 0 && h > 0);
 
-  image = shell->display->image;
-  projection = image->projection;
-
-  /* Initialize RenderInfo with values that don't change during the
-   * call of this function.
-   */
-  info.shell      = shell;
-
-  info.x          = x + shell->offset_x;
-  info.y          = y + shell->offset_y;
-  info.w          = w;
-  info.h          = h;
+  projection = shell->display->image->projection;
 
-  info.dest_bpp   = 3;
-  info.dest_bpl   = info.dest_bpp * GIMP_RENDER_BUF_WIDTH;
-  info.dest_width = info.dest_bpp * info.w;
-
-  switch (GIMP_DISPLAY_CONFIG (image->gimp->config)->zoom_quality)
-    {
-    case GIMP_ZOOM_QUALITY_LOW:
-      info.zoom_quality = GIMP_DISPLAY_ZOOM_FAST;
-      break;
+  gimp_display_shell_render_info_init (&info, shell,
+                                       x + shell->offset_x,
+                                       y + shell->offset_y,
+                                       w, h);
 
-    case GIMP_ZOOM_QUALITY_HIGH:
-      info.zoom_quality = GIMP_DISPLAY_ZOOM_PIXEL_AA;
-      break;
-    }
-
-  if (GIMP_IMAGE_TYPE_HAS_ALPHA (gimp_projection_get_image_type (projection)))
+  /*  reuse the pixels rendered for this area before, if they are
+   *  still cached, otherwise render them and put them in the cache
+   */
+  if (! gimp_display_shell_render_cache_fetch (shell,
+                                               info.x, info.y, w, h,
+                                               shell->render_buf,
+                                               info.dest_bpl))
     {
-      gdouble opacity = gimp_projection_get_opacity (projection);
-
-      info.alpha = render_image_init_alpha (opacity * 255.999);
-    }
-
-  /* Setup RenderInfo for rendering a GimpProjection level. */
-  {
-    TileManager *src_tiles;
-    gint         level;
-
-    level = gimp_projection_get_level (projection,
-                                       shell->scale_x,
-                                       shell->scale_y);
-
-    src_tiles = gimp_projection_get_tiles_at_level (projection, level);
-
-    gimp_display_shell_render_info_scale (&info, shell, src_tiles, level);
-  }
+      if (shell->render_coarse)
+        {
+          /*  right after a zoom change, show something quickly and
+           *  leave rendering at full quality to the refine idle
+           */
+          gimp_display_shell_render_projection (shell, &info, TRUE);
 
-  /* Currently, only RGBA and GRAYA projection types are used. */
-  type = gimp_projection_get_image_type (projection);
+          gimp_display_shell_render_queue_refine (shell,
+                                                  info.x, info.y, w, h);
+        }
+      else
+        {
+          gimp_display_shell_render_projection (shell, &info, FALSE);
 
-  switch (type)
-    {
-      case GIMP_RGBA_IMAGE:
-        render_image_rgb_a (&info);
-        break;
-      case GIMP_GRAYA_IMAGE:
-        render_image_gray_a (&info);
-        break;
-      default:
-        g_warning ("%s: unsupported projection type (%d)", G_STRFUNC, type);
-        g_assert_not_reached ();
+          gimp_display_shell_render_cache_store (shell,
+                                                 info.x, info.y, w, h,
+                                                 shell->render_buf,
+                                                 info.dest_bpl);
+        }
     }
 
-  /*  apply filters to the rendered projection  */
-  if (shell->filter_stack)
-    gimp_color_display_stack_convert (shell->filter_stack,
-                                      shell->render_buf,
-                                      w, h,
-                                      3,
-                                      3 * GIMP_RENDER_BUF_WIDTH);
-
   /*  dim pixels outside the highlighted rectangle  */
   if (highlight)
     {
@@ -301,10 +406,25 @@ gimp_display_shell_render (GimpDisplayShell *shell,
     }
   else if (shell->mask)
     {
-      TileManager *src_tiles = gimp_drawable_get_tiles (shell->mask);
+      TileManager *src_tiles;
+      gint         level;
 
-      /* The mask does not (yet) have an image pyramid, use 0 as level, */
-      gimp_display_shell_render_info_scale (&info, shell, src_tiles, 0);
+      /*  use the same pyramid level as for the projection, if the
+       *  mask has one, so zooming out doesn't read all of its pixels
+       */
+      level = gimp_projection_get_level (projection,
+                                         shell->scale_x,
+                                         shell->scale_y);
+
+      src_tiles = gimp_drawable_get_mipmap (shell->mask, level);
+
+      if (! src_tiles)
+        {
+          src_tiles = gimp_drawable_get_tiles (shell->mask);
+          level     = 0;
+        }
+
+      gimp_display_shell_render_info_scale (&info, shell, src_tiles, level);
 
       gimp_display_shell_render_mask (shell, &info);
     }
@@ -328,6 +448,149 @@ gimp_display_shell_render (GimpDisplayShell *shell,
 
 /*  This function highlights the given area by dimming all pixels outside. */
 
+/**
+ * gimp_display_shell_render_progressive:
+ * @shell: a #GimpDisplayShell
+ *
+ * Makes @shell render exposed areas it has no cached pixels for from
+ * a coarser projection level with nearest neighbour sampling, which
+ * is a lot faster, and render them again at full quality from an idle
+ * handler afterwards. Called when the zoom changes, so large images
+ * show up at the new zoom right away. Any pending refinement from an
+ * earlier zoom change is dropped.
+ **/
+void
+gimp_display_shell_render_progressive (GimpDisplayShell *shell)
+{
+  GimpImage *image;
+
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  gimp_display_shell_render_stop_progressive (shell);
+
+  image = shell->display->image;
+
+  if ((gint64) image->width * image->height >= PROGRESSIVE_MIN_PIXELS)
+    shell->render_coarse = TRUE;
+}
+
+/**
+ * gimp_display_shell_render_stop_progressive:
+ * @shell: a #GimpDisplayShell
+ *
+ * Cancels the refinement started by gimp_display_shell_render_progressive()
+ * and goes back to rendering at full quality.
+ **/
+void
+gimp_display_shell_render_stop_progressive (GimpDisplayShell *shell)
+{
+  g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
+
+  if (shell->refine_idle_id)
+    {
+      g_source_remove (shell->refine_idle_id);
+      shell->refine_idle_id = 0;
+    }
+
+  if (shell->refine_region)
+    {
+      gdk_region_destroy (shell->refine_region);
+      shell->refine_region = NULL;
+    }
+
+  shell->render_coarse = FALSE;
+}
+
+static void
+gimp_display_shell_render_queue_refine (GimpDisplayShell *shell,
+                                        gint              x,
+                                        gint              y,
+                                        gint              w,
+                                        gint              h)
+{
+  GdkRectangle rect = { x, y, w, h };
+
+  if (shell->refine_region)
+    gdk_region_union_with_rect (shell->refine_region, &rect);
+  else
+    shell->refine_region = gdk_region_rectangle (&rect);
+
+  /*  refine at low priority, so that new input is always handled first  */
+  if (! shell->refine_idle_id)
+    shell->refine_idle_id =
+      g_idle_add_full (G_PRIORITY_LOW,
+                       (GSourceFunc) gimp_display_shell_render_refine_idle,
+                       shell, NULL);
+}
+
+/*  renders one chunk of the areas drawn coarsely at full quality into
+ *  the render cache and exposes it, so it is drawn from there
+ */
+static gboolean
+gimp_display_shell_render_refine_idle (GimpDisplayShell *shell)
+{
+  GimpImage    *image = shell->display->image;
+  GdkRectangle *rects;
+  gint          n_rects;
+  GdkRectangle  rect;
+  GdkRectangle  extent;
+  GdkRegion    *clip;
+  GdkRegion    *done;
+  RenderInfo    info;
+
+  /*  nothing outside of the zoomed image is rendered  */
+  extent.x      = 0;
+  extent.y      = 0;
+  extent.width  = SCALEX (shell, image->width);
+  extent.height = SCALEY (shell, image->height);
+
+  clip = gdk_region_rectangle (&extent);
+  gdk_region_intersect (shell->refine_region, clip);
+  gdk_region_destroy (clip);
+
+  gdk_region_get_rectangles (shell->refine_region, &rects, &n_rects);
+
+  if (n_rects == 0)
+    {
+      g_free (rects);
+
+      shell->refine_idle_id = 0;
+
+      gimp_display_shell_render_stop_progressive (shell);
+
+      return FALSE;
+    }
+
+  rect = rects[0];
+  g_free (rects);
+
+  rect.width  = MIN (rect.width,  GIMP_RENDER_BUF_WIDTH);
+  rect.height = MIN (rect.height, GIMP_RENDER_BUF_HEIGHT);
+
+  gimp_display_shell_render_info_init (&info, shell,
+                                       rect.x, rect.y,
+                                       rect.width, rect.height);
+
+  gimp_display_shell_render_projection (shell, &info, FALSE);
+
+  gimp_display_shell_render_cache_store (shell,
+                                         rect.x, rect.y,
+                                         rect.width, rect.height,
+                                         shell->render_buf,
+                                         info.dest_bpl);
+
+  done = gdk_region_rectangle (&rect);
+  gdk_region_subtract (shell->refine_region, done);
+  gdk_region_destroy (done);
+
+  gimp_display_shell_expose_area (shell,
+                                  rect.x - shell->offset_x + shell->disp_xoffset,
+                                  rect.y - shell->offset_y + shell->disp_yoffset,
+                                  rect.width, rect.height);
+
+  return TRUE;
+}
+
 static void
 gimp_display_shell_render_highlight (GimpDisplayShell *shell,
                                      gint              x,
@@ -581,6 +844,209 @@ render_image_rgb_a (RenderInfo *info)
     }
 }
 
+/*  renders the projection and applies the display filters  */
+static void
+gimp_display_shell_render_projection (GimpDisplayShell *shell,
+                                      RenderInfo       *info,
+                                      gboolean          coarse)
+{
+  GimpProjection *projection = shell->display->image->projection;
+  RenderFunc      func;
+  GimpImageType   type;
+
+  if (GIMP_IMAGE_TYPE_HAS_ALPHA (gimp_projection_get_image_type (projection)))
+    {
+      gdouble opacity = gimp_projection_get_opacity (projection);
+
+      info->alpha = render_image_init_alpha (opacity * 255.999);
+    }
+
+  /* Currently, only RGBA and GRAYA projection types are used. */
+  type = gimp_projection_get_image_type (projection);
+
+  switch (type)
+    {
+      case GIMP_RGBA_IMAGE:
+        func = render_image_rgb_a;
+        break;
+      case GIMP_GRAYA_IMAGE:
+        func = render_image_gray_a;
+        break;
+      default:
+        g_warning ("%s: unsupported projection type (%d)", G_STRFUNC, type);
+        g_assert_not_reached ();
+        return;
+    }
+
+  /* Setup RenderInfo for rendering a GimpProjection level. */
+  {
+    TileManager *src_tiles;
+    gint         level;
+    gboolean     validated;
+
+    if (coarse)
+      {
+        /*  nearest neighbour samples from the next coarser level  */
+        level = gimp_projection_get_level (projection,
+                                           shell->scale_x / 2.0,
+                                           shell->scale_y / 2.0);
+
+        info->zoom_quality = GIMP_DISPLAY_ZOOM_FAST;
+      }
+    else
+      {
+        level = gimp_projection_get_level (projection,
+                                           shell->scale_x,
+                                           shell->scale_y);
+      }
+
+    src_tiles = gimp_projection_get_tiles_at_level (projection, level);
+
+    gimp_display_shell_render_info_scale (info, shell, src_tiles, level);
+
+    /*  construct the projection tiles we are about to read in one go,
+     *  with some margin for the filters sampling neighbouring pixels
+     */
+    validated =
+      gimp_projection_validate_area (projection, level,
+                                     info->src_x - 1,
+                                     info->src_y - 1,
+                                     ceil (info->w / info->scalex) + 3,
+                                     ceil (info->h / info->scaley) + 3);
+
+    /*  tiles that are still invalid are constructed when they are read,
+     *  which composites the floating selection and has to happen on
+     *  this thread
+     */
+    if (validated && ! gimp_image_floating_sel (shell->display->image))
+      gimp_display_shell_render_strips (info, func, src_tiles, level);
+    else
+      func (info);
+  }
+
+  /*  apply filters to the rendered projection  */
+  if (shell->filter_stack)
+    gimp_color_display_stack_convert (shell->filter_stack,
+                                      shell->render_buf,
+                                      info->w, info->h,
+                                      3,
+                                      3 * GIMP_RENDER_BUF_WIDTH);
+}
+
+/*  Renders the area described by info in horizontal strips, all but
+ *  the first of which are handed to the render thread pool.  Returns
+ *  when all strips are done.
+ */
+static void
+gimp_display_shell_render_strips (RenderInfo  *info,
+                                  RenderFunc   func,
+                                  TileManager *tiles,
+                                  gint         level)
+{
+#ifdef ENABLE_MP
+  RenderStrip strips[GIMP_MAX_NUM_THREADS];
+  gint        n_strips;
+  gint        y, i;
+
+  if (! render_pool)
+    {
+      func (info);
+      return;
+    }
+
+  n_strips = g_thread_pool_get_max_threads (render_pool) + 1;
+  n_strips = MIN (n_strips, info->h / RENDER_MIN_STRIP_HEIGHT);
+  n_strips = CLAMP (n_strips, 1, GIMP_MAX_NUM_THREADS);
+
+  if (n_strips == 1)
+    {
+      func (info);
+      return;
+    }
+
+  for (i = 0, y = 0; i < n_strips; i++)
+    {
+      RenderStrip *strip = strips + i;
+      gint         h     = (info->h - y) / (n_strips - i);
+
+      strip->info   = *info;
+      strip->func   = func;
+
+      strip->info.y = info->y + y;
+      strip->info.h = h;
+
+      gimp_display_shell_render_info_scale (&strip->info, info->shell,
+                                            tiles, level);
+
+      strip->info.dest     += y * info->dest_bpl;
+      strip->info.tile_buf  = info->tile_buf + i * RENDER_TILE_BUF_SIZE;
+
+      y += h;
+    }
+
+  g_mutex_lock (render_mutex);
+  render_pending = n_strips - 1;
+  g_mutex_unlock (render_mutex);
+
+  for (i = 1; i < n_strips; i++)
+    g_thread_pool_push (render_pool, strips + i, NULL);
+
+  func (&strips[0].info);
+
+  g_mutex_lock (render_mutex);
+
+  while (render_pending > 0)
+    g_cond_wait (render_cond, render_mutex);
+
+  g_mutex_unlock (render_mutex);
+
+#else
+
+  func (info);
+
+#endif
+}
+
+/*  initializes the values of info that don't depend on the tiles
+ *  rendered from; x and y are in coordinates of the zoomed image
+ */
+static void
+gimp_display_shell_render_info_init (RenderInfo       *info,
+                                     GimpDisplayShell *shell,
+                                     gint              x,
+                                     gint              y,
+                                     gint              w,
+                                     gint              h)
+{
+  GimpDisplayConfig *config;
+
+  config = GIMP_DISPLAY_CONFIG (shell->display->image->gimp->config);
+
+  info->shell      = shell;
+
+  info->x          = x;
+  info->y          = y;
+  info->w          = w;
+  info->h          = h;
+
+  info->dest_bpp   = 3;
+  info->dest_bpl   = info->dest_bpp * GIMP_RENDER_BUF_WIDTH;
+  info->dest_width = info->dest_bpp * info->w;
+
+  info->tile_buf   = tile_buf;
+
+  switch (config->zoom_quality)
+    {
+    case GIMP_ZOOM_QUALITY_LOW:
+      info->zoom_quality = GIMP_DISPLAY_ZOOM_FAST;
+      break;
+
+    case GIMP_ZOOM_QUALITY_HIGH:
+      info->zoom_quality = GIMP_DISPLAY_ZOOM_PIXEL_AA;
+      break;
+    }
+}
+
 static void
 gimp_display_shell_render_info_scale (RenderInfo       *info,
                                       GimpDisplayShell *shell,
@@ -912,7 +1378,7 @@ render_image_tile_fault (RenderInfo *info)
                                    info->src_x - 1, info->src_y - 1,
                                    TRUE, FALSE);
 
-  g_return_val_if_fail (tile[4] != NULL, tile_buf);
+  g_return_val_if_fail (tile[4] != NULL, info->tile_buf);
 
   src[4] = tile_data_pointer (tile[4], info->src_x, info->src_y);
 
@@ -991,7 +1457,7 @@ render_image_tile_fault (RenderInfo *info)
     }
 
   bpp    = tile_manager_bpp (info->src_tiles);
-  dest   = tile_buf;
+  dest   = info->tile_buf;
 
   dx     = info->dx_start;
   src_x  = info->src_x;
@@ -1250,7 +1716,7 @@ done:
     if (tile[dx])
       tile_release (tile[dx], FALSE);
 
-  return tile_buf;
+  return info->tile_buf;
 }
 
 /* function to render a horizontal line of view data */
@@ -1269,12 +1735,12 @@ render_image_tile_fault_nearest (RenderInfo *info)
   tile = tile_manager_get_tile (info->src_tiles,
                                 info->src_x, info->src_y, TRUE, FALSE);
 
-  g_return_val_if_fail (tile != NULL, tile_buf);
+  g_return_val_if_fail (tile != NULL, info->tile_buf);
 
   src = tile_data_pointer (tile, info->src_x, info->src_y);
 
   bpp   = tile_manager_bpp (info->src_tiles);
-  dest  = tile_buf;
+  dest  = info->tile_buf;
 
   dx    = info->dx_start;
 
@@ -1317,7 +1783,7 @@ render_image_tile_fault_nearest (RenderInfo *info)
               tile = tile_manager_get_tile (info->src_tiles,
                                             src_x, info->src_y, TRUE, FALSE);
               if (! tile)
-                return tile_buf;
+                return info->tile_buf;
 
               src = tile_data_pointer (tile, src_x, info->src_y);
             }
@@ -1327,7 +1793,7 @@ render_image_tile_fault_nearest (RenderInfo *info)
 
   tile_release (tile, FALSE);
 
-  return tile_buf;
+  return info->tile_buf;
 }
 
 static const guchar *
@@ -1388,7 +1854,7 @@ render_image_tile_fault_one_row (RenderInfo *info)
   tile[2] = tile_manager_get_tile (info->src_tiles,
                                    info->src_x - 1, info->src_y, TRUE, FALSE);
 
-  g_return_val_if_fail (tile[0] != NULL, tile_buf);
+  g_return_val_if_fail (tile[0] != NULL, info->tile_buf);
 
   src[4] = tile_data_pointer (tile[0], info->src_x, info->src_y);
   src[7] = tile_data_pointer (tile[0], info->src_x, info->src_y + 1);
@@ -1443,7 +1909,7 @@ render_image_tile_fault_one_row (RenderInfo *info)
     }
 
   bpp    = tile_manager_bpp (info->src_tiles);
-  dest   = tile_buf;
+  dest   = info->tile_buf;
 
   dx     = info->dx_start;
   src_x  = info->src_x;
@@ -1615,5 +2081,5 @@ done:
     if (tile[dx])
       tile_release (tile[dx], FALSE);
 
-  return tile_buf;
+  return info->tile_buf;
 }
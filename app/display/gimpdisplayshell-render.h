@@ -30,5 +30,8 @@ void   gimp_display_shell_render      (GimpDisplayShell *shell,
                                        gint              h,
                                        GdkRectangle     *highlight);
 
+void   gimp_display_shell_render_progressive      (GimpDisplayShell *shell);
+void   gimp_display_shell_render_stop_progressive (GimpDisplayShell *shell);
+
 
 #endif  /*  __GIMP_DISPLAY_SHELL_RENDER_H__  */
@@ -38,6 +38,7 @@
 
 #include "gimpdisplay.h"
 #include "gimpdisplayshell.h"
+#include "gimpdisplayshell-render.h"
 #include "gimpdisplayshell-scale.h"
 #include "gimpdisplayshell-scroll.h"
 #include "gimpdisplayshell-title.h"
@@ -500,6 +501,10 @@ gimp_display_shell_scale_by_values (GimpDisplayShell *shell,
   /* freeze the active tool */
   gimp_display_shell_pause (shell);
 
+  /*  show the new zoom right away, refine it later  */
+  if (! SCALE_EQUALS (gimp_zoom_model_get_factor (shell->zoom), scale))
+    gimp_display_shell_render_progressive (shell);
+
   gimp_zoom_model_zoom (shell->zoom, GIMP_ZOOM_TO, scale);
 
   shell->offset_x = offset_x;
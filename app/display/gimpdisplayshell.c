@@ -65,6 +65,8 @@
 #include "gimpdisplayshell-filter.h"
 #include "gimpdisplayshell-handlers.h"
 #include "gimpdisplayshell-progress.h"
+#include "gimpdisplayshell-render.h"
+#include "gimpdisplayshell-render-cache.h"
 #include "gimpdisplayshell-scale.h"
 #include "gimpdisplayshell-selection.h"
 #include "gimpdisplayshell-title.h"
@@ -278,6 +280,10 @@ gimp_display_shell_init (GimpDisplayShell *shell)
   shell->render_buf             = g_new (guchar,
                                          GIMP_RENDER_BUF_WIDTH  *
                                          GIMP_RENDER_BUF_HEIGHT * 3);
+  shell->render_cache           = NULL;
+  shell->render_coarse          = FALSE;
+  shell->refine_region          = NULL;
+  shell->refine_idle_id         = 0;
 
   shell->title_idle_id          = 0;
 
@@ -443,6 +449,8 @@ gimp_display_shell_destroy (GtkObject *object)
   shell->popup_manager = NULL;
 
   gimp_display_shell_selection_free (shell);
+  gimp_display_shell_render_stop_progressive (shell);
+  gimp_display_shell_render_cache_free (shell);
 
   if (shell->filter_stack)
     gimp_display_shell_filter_set (shell, NULL);
@@ -897,6 +905,7 @@ gimp_display_shell_new (GimpDisplay     *display,
   shell->canvas = gimp_canvas_new (shell->display->image->gimp);
 
   gimp_display_shell_selection_init (shell);
+  gimp_display_shell_render_cache_init (shell);
 
   /*  the horizontal ruler  */
   shell->hrule = gtk_hruler_new ();
@@ -1448,6 +1457,8 @@ gimp_display_shell_expose_full (GimpDisplayShell *shell)
 {
   g_return_if_fail (GIMP_IS_DISPLAY_SHELL (shell));
 
+  gimp_display_shell_render_cache_flush (shell);
+
   gtk_widget_queue_draw (shell->canvas);
 }
 
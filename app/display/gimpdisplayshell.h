@@ -125,6 +125,10 @@ struct _GimpDisplayShell
   GtkWidget        *statusbar;         /*  statusbar                          */
 
   guchar           *render_buf;        /*  buffer for rendering the image     */
+  RenderCache      *render_cache;      /*  cache of rendered image tiles      */
+  gboolean          render_coarse;     /*  render quickly after zooming       */
+  GdkRegion        *refine_region;     /*  areas rendered coarsely            */
+  guint             refine_idle_id;    /*  idle rendering them again          */
 
   guint             title_idle_id;     /*  title update idle ID               */
 
@@ -41,7 +41,6 @@
 
 
 #define RANDOM_SEED   314159265
-#define EPSILON       0.0001
 
 #define LOG_1_255     -5.541263545    /*  log (1.0 / 255.0)  */
 
@@ -125,6 +124,14 @@ static const LayerModeFunc layer_mode_funcs[] =
 
 static const guchar  no_mask = OPAQUE_OPACITY;
 
+/*  ceil (2^24 / a), see ALPHA_DIV()  */
+static guint32       alpha_recip[256];
+
+/*  x / a for 0 <= x <= 255 * 255 and 0 < a <= 255, exact,
+ *  using the reciprocal of a from alpha_recip[]
+ */
+#define ALPHA_DIV(x,recip) ((guint) (((guint64) (x) * (recip)) >> 24))
+
 
 /*  Local function prototypes  */
 
@@ -263,6 +270,10 @@ paint_funcs_setup (void)
   for (i = 256; i <= 510; i++)
     add_lut[i] = 255;
 
+  alpha_recip[0] = 0;
+  for (i = 1; i < 256; i++)
+    alpha_recip[i] = ((1 << 24) + i - 1) / i;
+
   g_rand_free (gr);
 }
 
@@ -703,12 +714,12 @@ combine_inten_and_inten_a_pixels (const guchar   *src1,
               do { \
               b--; dest [b] = affect [b] ? src2 [b] : src1 [b];} while (b);        \
             } else {                                                                                \
-              ratio = (float) src2_alpha / new_alpha;                                                \
-              compl_ratio = 1.0 - ratio;                                                        \
+              const guint   compl_alpha = new_alpha - src2_alpha;                              \
+              const guint32 recip       = alpha_recip[new_alpha];                              \
                                                                                                   \
               do { b--; \
                 dest[b] = affect[b] ?                                                                \
-                  (guchar) (src2[b] * ratio + src1[b] * compl_ratio + EPSILON) : src1[b];\
+                  ALPHA_DIV (src2[b] * src2_alpha + src1[b] * compl_alpha, recip) : src1[b];\
                    } while (b); \
             }    \
           }
@@ -747,8 +758,6 @@ combine_inten_a_and_inten_pixels (const guchar   *src1,
   const gint    src2_bytes = bytes - 1;
   const gint    alpha      = bytes - 1;
   gint          b;
-  gfloat        ratio;
-  gfloat        compl_ratio;
   glong         tmp;
 
   if (mask)
@@ -844,8 +853,6 @@ combine_inten_a_and_inten_a_pixels (const guchar   *src1,
 {
   const guint alpha = bytes - 1;
   guint       b;
-  gfloat      ratio;
-  gfloat      compl_ratio;
   glong       tmp;
 
   if (mask)
@@ -1271,8 +1278,6 @@ behind_inten_pixels (const guchar   *src1,
   const guint   alpha = bytes1 - 1;
   const guchar *m     = mask ? mask : &no_mask;
   guint         b;
-  gfloat        ratio;
-  gfloat        compl_ratio;
   glong         tmp;
 
   while (length --)
@@ -1283,16 +1288,20 @@ behind_inten_pixels (const guchar   *src1,
         src2_alpha + INT_MULT ((255 - src2_alpha), src1_alpha, tmp);
 
       if (new_alpha)
-        ratio = (float) src1_alpha / new_alpha;
-      else
-        ratio = 0.0;
-
-      compl_ratio = 1.0 - ratio;
+        {
+          const guint   compl_alpha = new_alpha - src1_alpha;
+          const guint32 recip       = alpha_recip[new_alpha];
 
-      for (b = 0; b < alpha; b++)
-        dest[b] = (affect[b]) ?
-          (guchar) (src1[b] * ratio + src2[b] * compl_ratio + EPSILON) :
-        src1[b];
+          for (b = 0; b < alpha; b++)
+            dest[b] = (affect[b]) ?
+              ALPHA_DIV (src1[b] * src1_alpha + src2[b] * compl_alpha, recip) :
+              src1[b];
+        }
+      else
+        {
+          for (b = 0; b < alpha; b++)
+            dest[b] = (affect[b]) ? src2[b] : src1[b];
+        }
 
       dest[alpha] = (affect[alpha]) ? new_alpha : src1[alpha];
 
@@ -1869,6 +1878,10 @@ color_region (PixelRegion  *dest,
               s += dest->rowstride;
             }
         }
+
+      /* spare tile_release() from checking the tile's pixels */
+      if (pixel_region_covers_tile (dest))
+        tile_set_uniform (dest->curtile, col);
     }
 }
 
@@ -2023,17 +2036,46 @@ copy_region (PixelRegion *src,
           guchar       *d      = dest->data;
           gint          h      = src->h;
           gint          pixels = src->w * src->bytes;
+          guchar        col[4];
 
 #ifdef COWSHOW
           fputc ('.',stderr);
 #endif
 
-          while (h --)
+          if (pixel_region_covers_tile (dest) &&
+              pixel_region_is_uniform (src, col))
             {
-              memcpy (d, s, pixels);
+              if (tile_ewidth (src->curtile)  == dest->w &&
+                  tile_eheight (src->curtile) == dest->h)
+                {
+                  /* any part of a uniform tile is as good as all of it,
+                   * so share it like an aligned tile
+                   */
+                  tile_manager_map_over_tile (dest->tiles,
+                                              dest->curtile, src->curtile);
+                }
+              else
+                {
+                  /* the source is a single colour, so is the dest tile */
+                  while (h --)
+                    {
+                      color_pixels (d, col, src->w, src->bytes);
 
-              s += src->rowstride;
-              d += dest->rowstride;
+                      d += dest->rowstride;
+                    }
+
+                  tile_set_uniform (dest->curtile, col);
+                }
+            }
+          else
+            {
+              while (h --)
+                {
+                  memcpy (d, s, pixels);
+
+                  s += src->rowstride;
+                  d += dest->rowstride;
+                }
             }
         }
     }
@@ -42,6 +42,7 @@
 #include "gimpplugin.h"
 #include "gimpplugin-message.h"
 #include "gimppluginmanager.h"
+#include "gimppluginmanager-pool.h"
 #include "gimpplugindef.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
@@ -53,6 +54,13 @@
 static void gimp_plug_in_handle_quit             (GimpPlugIn      *plug_in);
 static void gimp_plug_in_handle_tile_req         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *tile_req);
+static void gimp_plug_in_handle_tiles_req        (GimpPlugIn      *plug_in,
+                                                  GPTilesReq      *tiles_req);
+static void gimp_plug_in_send_tiles              (GimpPlugIn      *plug_in,
+                                                  GPTilesReq      *tiles_req);
+static void gimp_plug_in_receive_tiles           (GimpPlugIn      *plug_in);
+static void gimp_plug_in_handle_drawable_map     (GimpPlugIn      *plug_in,
+                                                  GPDrawableMap   *drawable_map);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
@@ -65,6 +73,12 @@ static void gimp_plug_in_handle_proc_uninstall   (GimpPlugIn      *plug_in,
                                                   GPProcUninstall *proc_uninstall);
 static void gimp_plug_in_handle_extension_ack    (GimpPlugIn      *plug_in);
 static void gimp_plug_in_handle_has_init         (GimpPlugIn      *plug_in);
+static void gimp_plug_in_handle_persistent       (GimpPlugIn      *plug_in);
+
+static TileManager * gimp_plug_in_get_tile_manager (GimpPlugIn *plug_in,
+                                                    gint32      drawable_ID,
+                                                    gboolean    shadow);
+static gboolean      gimp_plug_in_read_tile_ack    (GimpPlugIn *plug_in);
 
 
 /*  public functions  */
@@ -150,6 +164,27 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_TILES_REQ:
+      gimp_plug_in_handle_tiles_req (plug_in, msg->data);
+      break;
+
+    case GP_TILES_DATA:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a TILES_DATA message.  This should not happen.",
+                    gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
+
+    case GP_DRAWABLE_MAP:
+      gimp_plug_in_handle_drawable_map (plug_in, msg->data);
+      break;
+
+    case GP_PERSISTENT:
+      gimp_plug_in_handle_persistent (plug_in);
+      break;
     }
 }
 
@@ -345,6 +380,356 @@ gimp_plug_in_handle_tile_req (GimpPlugIn *plug_in,
     }
 }
 
+/*  Batched tile transfers: the plug-in names many tiles at once and
+ *  they travel in batches of up to half the shared memory, so that
+ *  one half can be filled while the other one is still being read.
+ *  We don't return to the main loop until the transfer is complete,
+ *  which keeps other plug-ins from using the shared memory meanwhile.
+ */
+static void
+gimp_plug_in_handle_tiles_req (GimpPlugIn *plug_in,
+                               GPTilesReq *tiles_req)
+{
+  if (tiles_req->drawable_ID == -1)
+    gimp_plug_in_receive_tiles (plug_in);
+  else
+    gimp_plug_in_send_tiles (plug_in, tiles_req);
+}
+
+/*  this communicates with libgimp/gimptile.c:gimp_tile_get_tiles()  */
+static void
+gimp_plug_in_send_tiles (GimpPlugIn *plug_in,
+                         GPTilesReq *tiles_req)
+{
+  GimpPlugInShm *shm     = plug_in->manager->shm;
+  TileManager   *tm;
+  guchar        *buffer  = NULL;
+  gsize          half;
+  gint           pending = 0;
+  gint           part    = 0;
+  guint          i       = 0;
+
+  tm = gimp_plug_in_get_tile_manager (plug_in,
+                                      tiles_req->drawable_ID,
+                                      tiles_req->shadow);
+  if (! tm)
+    return;
+
+  half = TILE_WIDTH * TILE_HEIGHT * 4 * (GP_SHM_N_TILES / 2);
+
+  if (! shm)
+    buffer = g_malloc (half);
+
+  while (i < tiles_req->n_tiles)
+    {
+      GPTilesData  tiles_data;
+      guchar      *dest;
+      guint        first  = i;
+      gsize        length = 0;
+
+      /*  wait until the plug-in is done with this half  */
+      if (pending == 2)
+        {
+          if (! gimp_plug_in_read_tile_ack (plug_in))
+            goto out;
+
+          pending--;
+        }
+
+      if (shm)
+        dest = gimp_plug_in_shm_get_addr (shm) + part * half;
+      else
+        dest = buffer;
+
+      for (; i < tiles_req->n_tiles && i - first < GP_SHM_N_TILES / 2; i++)
+        {
+          Tile *tile = tile_manager_get (tm, tiles_req->tile_nums[i],
+                                         TRUE, FALSE);
+
+          if (! tile)
+            {
+              gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                            "Plug-In \"%s\"\n(%s)\n\n"
+                            "requested invalid tile (killing)",
+                            gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                            gimp_filename_to_utf8 (plug_in->prog));
+              gimp_plug_in_close (plug_in, TRUE);
+              goto out;
+            }
+
+          memcpy (dest + length, tile_data_pointer (tile, 0, 0),
+                  tile_size (tile));
+          length += tile_size (tile);
+
+          tile_release (tile, FALSE);
+        }
+
+      tiles_data.drawable_ID = tiles_req->drawable_ID;
+      tiles_data.shadow      = tiles_req->shadow;
+      tiles_data.n_tiles     = i - first;
+      tiles_data.tile_nums   = tiles_req->tile_nums + first;
+      tiles_data.use_shm     = (shm != NULL);
+      tiles_data.shm_offset  = shm ? part * half : 0;
+      tiles_data.length      = length;
+      tiles_data.data        = shm ? NULL : buffer;
+
+      if (! gp_tiles_data_write (plug_in->my_write, &tiles_data, plug_in))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "plug_in_send_tiles: ERROR");
+          gimp_plug_in_close (plug_in, TRUE);
+          goto out;
+        }
+
+      pending++;
+      part = 1 - part;
+    }
+
+  while (pending--)
+    if (! gimp_plug_in_read_tile_ack (plug_in))
+      break;
+
+ out:
+  g_free (buffer);
+}
+
+/*  this communicates with libgimp/gimptile.c:gimp_tile_put_tiles()  */
+static void
+gimp_plug_in_receive_tiles (GimpPlugIn *plug_in)
+{
+  GimpPlugInShm *shm = plug_in->manager->shm;
+
+  /*  tell the plug-in that the shared memory is reserved for it  */
+  if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "plug_in_receive_tiles: ERROR");
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  while (TRUE)
+    {
+      GimpWireMessage  msg;
+      GPTilesData     *tiles_data;
+      TileManager     *tm;
+      const guchar    *src;
+      gsize            length;
+      guint            i;
+
+      if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "plug_in_receive_tiles: ERROR");
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      if (msg.type != GP_TILES_DATA)
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "expected tiles data and received: %d", msg.type);
+          gimp_wire_destroy (&msg);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      tiles_data = msg.data;
+
+      /*  an empty batch ends the transfer  */
+      if (tiles_data->n_tiles == 0)
+        {
+          gimp_wire_destroy (&msg);
+          return;
+        }
+
+      if (tiles_data->use_shm)
+        {
+          if (! shm ||
+              tiles_data->shm_offset > gimp_plug_in_shm_get_size (shm) ||
+              tiles_data->length > (gimp_plug_in_shm_get_size (shm) -
+                                    tiles_data->shm_offset))
+            {
+              gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                            "Plug-In \"%s\"\n(%s)\n\n"
+                            "sent invalid tile data (killing)",
+                            gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                            gimp_filename_to_utf8 (plug_in->prog));
+              gimp_wire_destroy (&msg);
+              gimp_plug_in_close (plug_in, TRUE);
+              return;
+            }
+
+          src = gimp_plug_in_shm_get_addr (shm) + tiles_data->shm_offset;
+        }
+      else
+        {
+          src = tiles_data->data;
+        }
+
+      tm = gimp_plug_in_get_tile_manager (plug_in,
+                                          tiles_data->drawable_ID,
+                                          tiles_data->shadow);
+      if (! tm)
+        {
+          gimp_wire_destroy (&msg);
+          return;
+        }
+
+      length = tiles_data->length;
+
+      for (i = 0; i < tiles_data->n_tiles; i++)
+        {
+          Tile *tile = tile_manager_get (tm, tiles_data->tile_nums[i],
+                                         TRUE, TRUE);
+
+          if (! tile || tile_size (tile) > length)
+            {
+              if (tile)
+                tile_release (tile, FALSE);
+
+              gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                            "Plug-In \"%s\"\n(%s)\n\n"
+                            "sent invalid tile data (killing)",
+                            gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                            gimp_filename_to_utf8 (plug_in->prog));
+              gimp_wire_destroy (&msg);
+              gimp_plug_in_close (plug_in, TRUE);
+              return;
+            }
+
+          memcpy (tile_data_pointer (tile, 0, 0), src, tile_size (tile));
+          src    += tile_size (tile);
+          length -= tile_size (tile);
+
+          tile_release (tile, TRUE);
+        }
+
+      gimp_wire_destroy (&msg);
+
+      if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "plug_in_receive_tiles: ERROR");
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+    }
+}
+
+/*  this communicates with libgimp/gimpdrawable.c:gimp_drawable_map()
+ *
+ *  The core's tiles live in private memory and may be swapped out or
+ *  shared with other tile managers, so they can't be handed out as
+ *  they are. Instead the drawable is copied once into a segment of
+ *  its own and the plug-in maps that, which saves it from requesting
+ *  any tiles at all.
+ */
+static void
+gimp_plug_in_handle_drawable_map (GimpPlugIn    *plug_in,
+                                  GPDrawableMap *drawable_map)
+{
+  GPDrawableMap  reply;
+  TileManager   *tm;
+  GimpPlugInShm *shm = NULL;
+
+  tm = gimp_plug_in_get_tile_manager (plug_in,
+                                      drawable_map->drawable_ID, FALSE);
+  if (! tm)
+    return;
+
+  reply.drawable_ID = drawable_map->drawable_ID;
+  reply.shm_ID      = -1;
+  reply.serial      = 0;
+  reply.width       = tile_manager_width (tm);
+  reply.height      = tile_manager_height (tm);
+  reply.bpp         = tile_manager_bpp (tm);
+  reply.rowstride   = reply.width * reply.bpp;
+
+  /*  without shared memory the plug-in falls back to reading tiles  */
+  if (plug_in->manager->shm)
+    shm = gimp_plug_in_shm_new_export ((gsize) reply.rowstride *
+                                       reply.height);
+
+  if (shm)
+    {
+      read_pixel_data (tm, 0, 0, reply.width - 1, reply.height - 1,
+                       gimp_plug_in_shm_get_addr (shm), reply.rowstride);
+
+      reply.shm_ID = gimp_plug_in_shm_get_ID (shm);
+      reply.serial = gimp_plug_in_shm_get_serial (shm);
+    }
+
+  if (! gp_drawable_map_write (plug_in->my_write, &reply, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "plug_in_handle_drawable_map: ERROR");
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+  else if (shm)
+    {
+      /*  the segment can go away once the plug-in has attached to it  */
+      gimp_plug_in_read_tile_ack (plug_in);
+    }
+
+  if (shm)
+    gimp_plug_in_shm_free (shm);
+}
+
+static TileManager *
+gimp_plug_in_get_tile_manager (GimpPlugIn *plug_in,
+                               gint32      drawable_ID,
+                               gboolean    shadow)
+{
+  GimpDrawable *drawable;
+
+  drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
+                                                   drawable_ID);
+
+  if (! GIMP_IS_DRAWABLE (drawable))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "requested invalid drawable (killing)",
+                    gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      return NULL;
+    }
+
+  if (shadow)
+    return gimp_drawable_get_shadow_tiles (drawable);
+  else
+    return gimp_drawable_get_tiles (drawable);
+}
+
+static gboolean
+gimp_plug_in_read_tile_ack (GimpPlugIn *plug_in)
+{
+  GimpWireMessage msg;
+
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "plug_in_read_tile_ack: ERROR");
+      gimp_plug_in_close (plug_in, TRUE);
+      return FALSE;
+    }
+
+  if (msg.type != GP_TILE_ACK)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected tile ack and received: %d", msg.type);
+      gimp_wire_destroy (&msg);
+      gimp_plug_in_close (plug_in, TRUE);
+      return FALSE;
+    }
+
+  gimp_wire_destroy (&msg);
+
+  return TRUE;
+}
+
 static void
 gimp_plug_in_handle_proc_run (GimpPlugIn *plug_in,
                               GPProcRun  *proc_run)
@@ -482,7 +867,13 @@ gimp_plug_in_handle_proc_return (GimpPlugIn   *plug_in,
       g_main_loop_quit (proc_frame->main_loop);
     }
 
-  gimp_plug_in_close (plug_in, FALSE);
+  /*  a synchronous caller puts the plug-in into the pool itself,
+   *  once it has taken the return values
+   */
+  if (! plug_in->persistent)
+    gimp_plug_in_close (plug_in, FALSE);
+  else if (! proc_frame->main_loop)
+    gimp_plug_in_manager_pool_add (plug_in->manager, plug_in);
 }
 
 static void
@@ -745,3 +1136,25 @@ gimp_plug_in_handle_has_init (GimpPlugIn *plug_in)
       gimp_plug_in_close (plug_in, TRUE);
     }
 }
+
+static void
+gimp_plug_in_handle_persistent (GimpPlugIn *plug_in)
+{
+  GimpProcedure *procedure = plug_in->main_proc_frame.procedure;
+
+  if (plug_in->call_mode == GIMP_PLUG_IN_CALL_RUN &&
+      procedure && procedure->proc_type == GIMP_PLUGIN)
+    {
+      plug_in->persistent = TRUE;
+    }
+  else
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "sent a PERSISTENT message while not running a "
+                    "plug-in procedure.  This should not happen.",
+                    gimp_object_get_name (GIMP_OBJECT (plug_in)),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+}
@@ -44,6 +44,7 @@
 #include "gimppluginmanager.h"
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
 #include "gimppluginmanager-call.h"
+#include "gimppluginmanager-pool.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
@@ -153,8 +154,18 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
   g_return_val_if_fail (args != NULL, NULL);
   g_return_val_if_fail (display == NULL || GIMP_IS_OBJECT (display), NULL);
 
-  plug_in = gimp_plug_in_new (manager, context, progress,
-                              procedure, NULL);
+  /*  reuse a resident plug-in if there is one  */
+  if (GIMP_PROCEDURE (procedure)->proc_type == GIMP_PLUGIN)
+    plug_in = gimp_plug_in_manager_pool_take (manager, procedure);
+  else
+    plug_in = NULL;
+
+  if (plug_in)
+    gimp_plug_in_proc_frame_init (&plug_in->main_proc_frame,
+                                  context, progress, procedure);
+  else
+    plug_in = gimp_plug_in_new (manager, context, progress,
+                                procedure, NULL);
 
   if (plug_in)
     {
@@ -166,7 +177,8 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
       gint               display_ID;
       gint               monitor;
 
-      if (! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_RUN, FALSE))
+      if (! plug_in->open &&
+          ! gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_RUN, FALSE))
         {
           g_object_unref (plug_in);
           goto done;
@@ -255,6 +267,9 @@ gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
           proc_frame->main_loop = NULL;
 
           return_vals = gimp_plug_in_proc_frame_get_return_vals (proc_frame);
+
+          if (plug_in->persistent && plug_in->open)
+            gimp_plug_in_manager_pool_add (manager, plug_in);
         }
 
       g_object_unref (plug_in);
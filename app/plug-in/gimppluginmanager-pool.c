@@ -0,0 +1,171 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppluginmanager-pool.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*  Plug-ins that call gimp_plugin_set_persistent() don't exit after
+ *  their procedure returned. They are kept here, idle, until they are
+ *  called again, or until they were not used for a while.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "plug-in-types.h"
+
+#include "config/gimpcoreconfig.h"
+
+#include "core/gimp.h"
+
+#include "gimpplugin.h"
+#include "gimppluginmanager.h"
+#include "gimppluginmanager-pool.h"
+#include "gimppluginprocedure.h"
+
+
+static gboolean   gimp_plug_in_manager_pool_timeout (gpointer data);
+
+
+/*  public functions  */
+
+void
+gimp_plug_in_manager_pool_add (GimpPlugInManager *manager,
+                               GimpPlugIn        *plug_in)
+{
+  gint size;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+  g_return_if_fail (plug_in->open);
+  g_return_if_fail (plug_in->idle_id == 0);
+
+  /*  end the run the way closing the plug-in would: finish its
+   *  progress and close the undo groups it left open
+   */
+  gimp_plug_in_proc_frame_dispose (&plug_in->main_proc_frame, plug_in);
+
+  /*  the plug-in has to ask again after its next run  */
+  plug_in->persistent = FALSE;
+
+  size = manager->gimp->config->plug_in_pool_size;
+
+  if (size < 1)
+    {
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  /*  make room by shutting down the plug-in that was idle the longest  */
+  while (g_slist_length (manager->idle_plug_ins) >= size)
+    {
+      GSList *last = g_slist_last (manager->idle_plug_ins);
+
+      gimp_plug_in_close (last->data, TRUE);
+    }
+
+  manager->idle_plug_ins = g_slist_prepend (manager->idle_plug_ins,
+                                            g_object_ref (plug_in));
+
+  plug_in->idle_id =
+    g_timeout_add (manager->gimp->config->plug_in_pool_timeout * 1000,
+                   gimp_plug_in_manager_pool_timeout, plug_in);
+}
+
+/*  Returns an idle plug-in that can run @procedure, along with the
+ *  reference the pool held on it, or %NULL.
+ */
+GimpPlugIn *
+gimp_plug_in_manager_pool_take (GimpPlugInManager   *manager,
+                                GimpPlugInProcedure *procedure)
+{
+  const gchar *prog;
+  GSList      *list;
+
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_PROCEDURE (procedure), NULL);
+
+  prog = gimp_plug_in_procedure_get_progname (procedure);
+
+  for (list = manager->idle_plug_ins; list; list = g_slist_next (list))
+    {
+      GimpPlugIn *plug_in = list->data;
+
+      if (! strcmp (plug_in->prog, prog))
+        {
+          manager->idle_plug_ins = g_slist_delete_link (manager->idle_plug_ins,
+                                                        list);
+
+          g_source_remove (plug_in->idle_id);
+          plug_in->idle_id = 0;
+
+          return plug_in;
+        }
+    }
+
+  return NULL;
+}
+
+/*  called from gimp_plug_in_close()  */
+void
+gimp_plug_in_manager_pool_remove (GimpPlugInManager *manager,
+                                  GimpPlugIn        *plug_in)
+{
+  GSList *list;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  list = g_slist_find (manager->idle_plug_ins, plug_in);
+
+  if (! list)
+    return;
+
+  manager->idle_plug_ins = g_slist_delete_link (manager->idle_plug_ins, list);
+
+  if (plug_in->idle_id)
+    {
+      g_source_remove (plug_in->idle_id);
+      plug_in->idle_id = 0;
+    }
+
+  g_object_unref (plug_in);
+}
+
+
+/*  private functions  */
+
+static gboolean
+gimp_plug_in_manager_pool_timeout (gpointer data)
+{
+  GimpPlugIn *plug_in = data;
+
+  plug_in->idle_id = 0;
+
+  if (plug_in->manager->gimp->be_verbose)
+    g_print ("Shutting down idle plug-in: '%s'\n",
+             gimp_filename_to_utf8 (plug_in->prog));
+
+  gimp_plug_in_close (plug_in, TRUE);
+
+  return FALSE;
+}
@@ -23,6 +23,7 @@
 #include <string.h>
 
 #include <glib-object.h>
+#include <glib/gstdio.h>
 
 #include "libgimpbase/gimpbase.h"
 #include "libgimpconfig/gimpconfig.h"
@@ -46,13 +47,20 @@
 #include "gimppluginmanager-restore.h"
 #include "gimppluginprocedure.h"
 #include "plug-in-rc.h"
+#include "plug-in-rc-cache.h"
 
 #include "gimp-intl.h"
 
 
 static void    gimp_plug_in_manager_search            (GimpPlugInManager      *manager,
+                                                       const gchar            *path,
                                                        GimpInitStatusFunc      status_callback);
 static gchar * gimp_plug_in_manager_get_pluginrc      (GimpPlugInManager      *manager);
+static gboolean gimp_plug_in_manager_read_cache       (GimpPlugInManager      *manager,
+                                                       const gchar            *cache,
+                                                       const gchar            *pluginrc,
+                                                       const gchar            *path,
+                                                       GimpInitStatusFunc      status_callback);
 static void    gimp_plug_in_manager_read_pluginrc     (GimpPlugInManager      *manager,
                                                        const gchar            *pluginrc,
                                                        GimpInitStatusFunc      status_callback);
@@ -84,10 +92,13 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
                               GimpContext        *context,
                               GimpInitStatusFunc  status_callback)
 {
-  Gimp   *gimp;
-  gchar  *pluginrc;
-  GSList *list;
-  GError *error = NULL;
+  Gimp     *gimp;
+  gchar    *path;
+  gchar    *pluginrc;
+  gchar    *cache;
+  gboolean  write_cache = FALSE;
+  GSList   *list;
+  GError   *error = NULL;
 
   g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
   g_return_if_fail (GIMP_IS_CONTEXT (context));
@@ -95,13 +106,22 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
 
   gimp = manager->gimp;
 
-  /* search for binaries in the plug-in directory path */
-  gimp_plug_in_manager_search (manager, status_callback);
-
-  /* read the pluginrc file for cached data */
+  path     = gimp_config_path_expand (gimp->config->plug_in_path, TRUE, NULL);
   pluginrc = gimp_plug_in_manager_get_pluginrc (manager);
+  cache    = g_strconcat (pluginrc, ".cache", NULL);
 
-  gimp_plug_in_manager_read_pluginrc (manager, pluginrc, status_callback);
+  /* use the binary copy of pluginrc if no plug-in changed */
+  if (! gimp_plug_in_manager_read_cache (manager, cache, pluginrc, path,
+                                         status_callback))
+    {
+      /* search for binaries in the plug-in directory path */
+      gimp_plug_in_manager_search (manager, path, status_callback);
+
+      /* read the pluginrc file for cached data */
+      gimp_plug_in_manager_read_pluginrc (manager, pluginrc, status_callback);
+
+      write_cache = TRUE;
+    }
 
   /* query any plug-ins that changed since we last wrote out pluginrc */
   gimp_plug_in_manager_query_new (manager, context, status_callback);
@@ -127,16 +147,41 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
       if (gimp->be_verbose)
         g_print ("Writing '%s'\n", gimp_filename_to_utf8 (pluginrc));
 
-      if (! plug_in_rc_write (manager->plug_in_defs, pluginrc, &error))
+      if (plug_in_rc_write (manager->plug_in_defs, pluginrc, &error))
+        {
+          write_cache = TRUE;
+        }
+      else
         {
           gimp_message (gimp, NULL, GIMP_MESSAGE_ERROR, "%s", error->message);
           g_clear_error (&error);
+
+          write_cache = FALSE;
         }
 
       manager->write_pluginrc = FALSE;
     }
 
+  /* the cache is only valid along with the pluginrc it was made from */
+  if (write_cache)
+    {
+      if (gimp->be_verbose)
+        g_print ("Writing '%s'\n", gimp_filename_to_utf8 (cache));
+
+      if (! plug_in_rc_cache_write (manager->plug_in_defs, cache, pluginrc,
+                                    path, &error))
+        {
+          if (gimp->be_verbose)
+            g_print ("%s\n", error->message);
+
+          g_clear_error (&error);
+          g_unlink (cache);
+        }
+    }
+
+  g_free (cache);
   g_free (pluginrc);
+  g_free (path);
 
   /* create locale and help domain lists */
   for (list = manager->plug_in_defs; list; list = list->next)
@@ -192,9 +237,9 @@ gimp_plug_in_manager_restore (GimpPlugInManager  *manager,
 /* search for binaries in the plug-in directory path */
 static void
 gimp_plug_in_manager_search (GimpPlugInManager  *manager,
+                             const gchar        *path,
                              GimpInitStatusFunc  status_callback)
 {
-  gchar       *path;
   const gchar *pathext = g_getenv ("PATHEXT");
 
   /*  If PATHEXT is set, we are likely on Windows and need to add
@@ -221,15 +266,10 @@ gimp_plug_in_manager_search (GimpPlugInManager  *manager,
 
   status_callback (_("Searching Plug-Ins"), "", 0.0);
 
-  path = gimp_config_path_expand (manager->gimp->config->plug_in_path,
-                                  TRUE, NULL);
-
   gimp_datafiles_read_directories (path,
                                    G_FILE_TEST_IS_EXECUTABLE,
                                    gimp_plug_in_manager_add_from_file,
                                    manager);
-
-  g_free (path);
 }
 
 static gchar *
@@ -259,6 +299,38 @@ gimp_plug_in_manager_get_pluginrc (GimpPlugInManager *manager)
   return pluginrc;
 }
 
+/* read the binary pluginrc cache, fails if it is missing or outdated */
+static gboolean
+gimp_plug_in_manager_read_cache (GimpPlugInManager  *manager,
+                                 const gchar        *cache,
+                                 const gchar        *pluginrc,
+                                 const gchar        *path,
+                                 GimpInitStatusFunc  status_callback)
+{
+  GSList *rc_defs;
+
+  status_callback (_("Resource configuration"),
+                   gimp_filename_to_utf8 (cache), 0.0);
+
+  rc_defs = plug_in_rc_cache_read (manager->gimp, cache, pluginrc, path);
+
+  if (! rc_defs)
+    {
+      if (manager->gimp->be_verbose)
+        g_print ("Not using '%s'\n", gimp_filename_to_utf8 (cache));
+
+      return FALSE;
+    }
+
+  if (manager->gimp->be_verbose)
+    g_print ("Using '%s'\n", gimp_filename_to_utf8 (cache));
+
+  /* the cache holds exactly the plug-ins found on disk last time */
+  manager->plug_in_defs = g_slist_concat (manager->plug_in_defs, rc_defs);
+
+  return TRUE;
+}
+
 /* read the pluginrc file for cached data */
 static void
 gimp_plug_in_manager_read_pluginrc (GimpPlugInManager  *manager,
@@ -62,6 +62,9 @@
 
 #endif /* G_OS_WIN32 || G_WITH_CYGWIN */
 
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
 #include "plug-in-types.h"
 
 #include "base/tile.h"
@@ -69,7 +72,7 @@
 #include "gimppluginshm.h"
 
 
-#define TILE_MAP_SIZE (TILE_WIDTH * TILE_HEIGHT * 4)
+#define TILE_MAP_SIZE (TILE_WIDTH * TILE_HEIGHT * 4 * GP_SHM_N_TILES)
 
 #define ERRMSG_SHM_DISABLE "Disabling shared memory tile transport"
 
@@ -77,6 +80,8 @@
 struct _GimpPlugInShm
 {
   gint    shm_ID;
+  gint    serial;
+  gsize   size;
   guchar *shm_addr;
 
 #if defined(USE_WIN32_SHM)
@@ -85,6 +90,23 @@ struct _GimpPlugInShm
 };
 
 
+static GimpPlugInShm * gimp_plug_in_shm_create   (gsize        size,
+                                                  gint         serial);
+#if defined(USE_WIN32_SHM) || defined(USE_POSIX_SHM)
+static void            gimp_plug_in_shm_get_name (gchar       *name,
+                                                  gsize        len,
+                                                  gint         shm_ID,
+                                                  gint         serial);
+#endif
+#if defined(USE_POSIX_SHM)
+static gboolean        gimp_plug_in_shm_allocate (gint         shm_fd,
+                                                  gsize        size);
+#endif
+
+
+static gint shm_serial = 0;
+
+
 GimpPlugInShm *
 gimp_plug_in_shm_new (void)
 {
@@ -93,15 +115,117 @@ gimp_plug_in_shm_new (void)
    *  we'll fall back on sending the data over the pipe.
    */
 
+  return gimp_plug_in_shm_create (TILE_MAP_SIZE, 0);
+}
+
+/*  Allocates a segment of @size bytes that holds a copy of a drawable
+ *  for a single plug-in, see gimp_plug_in_handle_drawable_map(). Each
+ *  segment gets its own serial number, the plug-in derives the name of
+ *  the segment from that and the shm ID. The segment is freed as soon
+ *  as the plug-in has attached to it, the plug-in's mapping stays valid
+ *  until it detaches.
+ */
+GimpPlugInShm *
+gimp_plug_in_shm_new_export (gsize size)
+{
+  g_return_val_if_fail (size > 0, NULL);
+
+  return gimp_plug_in_shm_create (size, ++shm_serial);
+}
+
+void
+gimp_plug_in_shm_free (GimpPlugInShm *shm)
+{
+  g_return_if_fail (shm != NULL);
+
+  if (shm->shm_ID != -1)
+    {
+
+#if defined (USE_SYSV_SHM)
+
+#ifndef IPC_RMID_DEFERRED_RELEASE
+      shmdt (shm->shm_addr);
+      shmctl (shm->shm_ID, IPC_RMID, NULL);
+#else
+      shmdt (shm->shm_addr);
+#endif /* IPC_RMID_DEFERRED_RELEASE */
+
+#elif defined(USE_WIN32_SHM)
+
+      if (shm->serial)
+        UnmapViewOfFile (shm->shm_addr);
+
+      if (shm->shm_handle)
+        CloseHandle (shm->shm_handle);
+
+#elif defined(USE_POSIX_SHM)
+
+      gchar shm_handle[32];
+
+      munmap (shm->shm_addr, shm->size);
+
+      gimp_plug_in_shm_get_name (shm_handle, sizeof (shm_handle),
+                                 shm->shm_ID, shm->serial);
+
+      shm_unlink (shm_handle);
+
+#endif
+
+    }
+
+  g_slice_free (GimpPlugInShm, shm);
+}
+
+gint
+gimp_plug_in_shm_get_ID (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, -1);
+
+  return shm->shm_ID;
+}
+
+guchar *
+gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, NULL);
+
+  return shm->shm_addr;
+}
+
+gint
+gimp_plug_in_shm_get_serial (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return shm->serial;
+}
+
+gsize
+gimp_plug_in_shm_get_size (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return shm->size;
+}
+
+
+/*  private functions  */
+
+static GimpPlugInShm *
+gimp_plug_in_shm_create (gsize size,
+                         gint  serial)
+{
   GimpPlugInShm *shm = g_slice_new0 (GimpPlugInShm);
 
   shm->shm_ID = -1;
+  shm->serial = serial;
+  shm->size   = size;
 
 #if defined(USE_SYSV_SHM)
 
   /* Use SysV shared memory mechanisms for transferring tile data. */
   {
-    shm->shm_ID = shmget (IPC_PRIVATE, TILE_MAP_SIZE, IPC_CREAT | 0600);
+    shm->shm_ID = shmget (IPC_PRIVATE, size, IPC_CREAT | 0600);
 
     if (shm->shm_ID != -1)
       {
@@ -138,12 +262,13 @@ gimp_plug_in_shm_new (void)
     pid = GetCurrentProcessId ();
 
     /* From the id, derive the file map name */
-    g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d.SHM", pid);
+    gimp_plug_in_shm_get_name (fileMapName, sizeof (fileMapName), pid, serial);
 
     /* Create the file mapping into paging space */
     shm->shm_handle = CreateFileMapping ((HANDLE) 0xFFFFFFFF, NULL,
-                                         PAGE_READWRITE, 0,
-                                         TILE_MAP_SIZE,
+                                         PAGE_READWRITE,
+                                         (DWORD) ((guint64) size >> 32),
+                                         (DWORD) size,
                                          fileMapName);
 
     if (shm->shm_handle)
@@ -151,7 +276,7 @@ gimp_plug_in_shm_new (void)
         /* Map the shared memory into our address space for use */
         shm->shm_addr = (guchar *) MapViewOfFile (shm->shm_handle,
                                                   FILE_MAP_ALL_ACCESS,
-                                                  0, 0, TILE_MAP_SIZE);
+                                                  0, 0, size);
 
         /* Verify that we mapped our view */
         if (shm->shm_addr)
@@ -162,6 +287,7 @@ gimp_plug_in_shm_new (void)
           {
             g_printerr ("MapViewOfFile error: %d... " ERRMSG_SHM_DISABLE,
                         GetLastError ());
+            CloseHandle (shm->shm_handle);
           }
       }
     else
@@ -183,17 +309,17 @@ gimp_plug_in_shm_new (void)
     pid = getpid ();
 
     /* From the id, derive the file map name */
-    g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d", pid);
+    gimp_plug_in_shm_get_name (shm_handle, sizeof (shm_handle), pid, serial);
 
     /* Create the file mapping into paging space */
     shm_fd = shm_open (shm_handle, O_RDWR | O_CREAT, 0600);
 
     if (shm_fd != -1)
       {
-        if (ftruncate (shm_fd, TILE_MAP_SIZE) != -1)
+        if (gimp_plug_in_shm_allocate (shm_fd, size))
           {
             /* Map the shared memory into our address space for use */
-            shm->shm_addr = (guchar *) mmap (NULL, TILE_MAP_SIZE,
+            shm->shm_addr = (guchar *) mmap (NULL, size,
                                              PROT_READ | PROT_WRITE, MAP_SHARED,
                                              shm_fd, 0);
 
@@ -212,7 +338,8 @@ gimp_plug_in_shm_new (void)
           }
         else
           {
-            g_printerr ("ftruncate() failed: %s\n" ERRMSG_SHM_DISABLE,
+            g_printerr ("Could not allocate shared memory: %s\n"
+                        ERRMSG_SHM_DISABLE,
                         g_strerror (errno));
 
             shm_unlink (shm_handle);
@@ -238,58 +365,70 @@ gimp_plug_in_shm_new (void)
   return shm;
 }
 
-void
-gimp_plug_in_shm_free (GimpPlugInShm *shm)
-{
-  g_return_if_fail (shm != NULL);
-
-  if (shm->shm_ID != -1)
-    {
-
-#if defined (USE_SYSV_SHM)
+#if defined(USE_WIN32_SHM) || defined(USE_POSIX_SHM)
 
-#ifndef IPC_RMID_DEFERRED_RELEASE
-      shmdt (shm->shm_addr);
-      shmctl (shm->shm_ID, IPC_RMID, NULL);
+/*  keep in sync with libgimp/gimp.c:gimp_shm_get_name()  */
+static void
+gimp_plug_in_shm_get_name (gchar *name,
+                           gsize  len,
+                           gint   shm_ID,
+                           gint   serial)
+{
+#if defined(USE_WIN32_SHM)
+  if (serial)
+    g_snprintf (name, len, "GIMP%d-%d.SHM", shm_ID, serial);
+  else
+    g_snprintf (name, len, "GIMP%d.SHM", shm_ID);
 #else
-      shmdt (shm->shm_addr);
-#endif /* IPC_RMID_DEFERRED_RELEASE */
-
-#elif defined(USE_WIN32_SHM)
-
-      if (shm->shm_handle)
-        CloseHandle (shm->shm_handle);
+  if (serial)
+    g_snprintf (name, len, "/gimp-shm-%d-%d", shm_ID, serial);
+  else
+    g_snprintf (name, len, "/gimp-shm-%d", shm_ID);
+#endif
+}
 
-#elif defined(USE_POSIX_SHM)
+#endif
 
-      gchar shm_handle[32];
+#if defined(USE_POSIX_SHM)
 
-      munmap (shm->shm_addr, TILE_MAP_SIZE);
+/*  Gives the segment its size and backs all of its pages right away.
+ *  A segment that was only truncated to size would be sparse, and the
+ *  process touching a page that can't be backed gets SIGBUS instead of
+ *  an error here.
+ */
+static gboolean
+gimp_plug_in_shm_allocate (gint  shm_fd,
+                           gsize size)
+{
+#ifdef HAVE_POSIX_FALLOCATE
+  gint error = posix_fallocate (shm_fd, 0, size);
 
-      g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d",
-                  shm->shm_ID);
+  if (error == 0)
+    return TRUE;
 
-      shm_unlink (shm_handle);
+  errno = error;
 
-#endif
+  return FALSE;
+#else
+  static const guchar zeros[4096] = { 0, };
 
+  while (size > 0)
+    {
+      gssize count = write (shm_fd, zeros, MIN (size, sizeof (zeros)));
+
+      if (count == -1)
+        {
+          if (errno != EINTR)
+            return FALSE;
+        }
+      else
+        {
+          size -= count;
+        }
     }
 
-  g_slice_free (GimpPlugInShm, shm);
-}
-
-gint
-gimp_plug_in_shm_get_ID (GimpPlugInShm *shm)
-{
-  g_return_val_if_fail (shm != NULL, -1);
-
-  return shm->shm_ID;
+  return TRUE;
+#endif
 }
 
-guchar *
-gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
-{
-  g_return_val_if_fail (shm != NULL, NULL);
-
-  return shm->shm_addr;
-}
+#endif
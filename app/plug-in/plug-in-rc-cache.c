@@ -0,0 +1,698 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * plug-in-rc-cache.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*  A binary copy of pluginrc that is mapped into memory at startup.
+ *
+ *  Next to the plug-in definitions it stores the modification times
+ *  of pluginrc, of the directories in the plug-in path and of every
+ *  plug-in binary. As long as none of them changed, the cache is used
+ *  instead of scanning the plug-in directories and parsing pluginrc.
+ *  It is written in the host's byte order and never copied between
+ *  machines, a cache that doesn't match is simply ignored.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <sys/types.h>
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
+#ifdef G_OS_WIN32
+#include "libgimpbase/gimpwin32-io.h"
+#endif
+
+#include "plug-in-types.h"
+
+#include "core/gimp.h"
+
+#include "pdb/gimp-pdb-compat.h"
+
+#include "gimpplugindef.h"
+#include "gimppluginprocedure.h"
+#include "plug-in-rc-cache.h"
+
+
+#define PLUG_IN_RC_CACHE_MAGIC    "GIMPPRC"
+#define PLUG_IN_RC_CACHE_VERSION  1
+#define PLUG_IN_RC_CACHE_NO_STR   G_MAXUINT32
+
+
+typedef struct _PlugInRcCache PlugInRcCache;
+
+struct _PlugInRcCache
+{
+  const gchar *data;
+  gsize        length;
+  gsize        pos;
+  gboolean     error;
+};
+
+
+static gboolean   plug_in_rc_cache_check_times (PlugInRcCache *cache,
+                                                const gchar   *pluginrc,
+                                                const gchar   *plug_in_path);
+static GimpPlugInDef *
+                  plug_in_rc_cache_read_def    (PlugInRcCache *cache,
+                                                Gimp          *gimp);
+static GimpPlugInProcedure *
+                  plug_in_rc_cache_read_proc   (PlugInRcCache *cache,
+                                                Gimp          *gimp,
+                                                const gchar   *prog);
+
+static guint32    cache_read_uint32            (PlugInRcCache *cache);
+static gint64     cache_read_int64             (PlugInRcCache *cache);
+static gchar    * cache_read_string            (PlugInRcCache *cache);
+static guint8   * cache_read_data              (PlugInRcCache *cache,
+                                                gsize          length);
+
+static void       plug_in_rc_cache_write_times (GString       *buffer,
+                                                const gchar   *pluginrc,
+                                                const gchar   *plug_in_path);
+static void       plug_in_rc_cache_write_def   (GString       *buffer,
+                                                GimpPlugInDef *plug_in_def);
+static void       plug_in_rc_cache_write_proc  (GString       *buffer,
+                                                GimpPlugInProcedure *proc);
+
+static void       cache_write_uint32           (GString       *buffer,
+                                                guint32        value);
+static void       cache_write_int64            (GString       *buffer,
+                                                gint64         value);
+static void       cache_write_string           (GString       *buffer,
+                                                const gchar   *str);
+
+static gint64     cache_get_mtime              (const gchar   *filename);
+
+
+/*  Returns the plug-in definitions stored in the cache, or %NULL if
+ *  there is no cache or if it is out of date.
+ */
+GSList *
+plug_in_rc_cache_read (Gimp        *gimp,
+                       const gchar *filename,
+                       const gchar *pluginrc,
+                       const gchar *plug_in_path)
+{
+  GMappedFile   *file;
+  PlugInRcCache  cache;
+  GSList        *plug_in_defs = NULL;
+  GSList        *list;
+  gchar         *magic;
+  guint32        n_defs;
+  guint32        i;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (pluginrc != NULL, NULL);
+  g_return_val_if_fail (plug_in_path != NULL, NULL);
+
+  file = g_mapped_file_new (filename, FALSE, NULL);
+
+  if (! file)
+    return NULL;
+
+  cache.data   = g_mapped_file_get_contents (file);
+  cache.length = g_mapped_file_get_length (file);
+  cache.pos    = 0;
+  cache.error  = FALSE;
+
+  magic = cache_read_string (&cache);
+
+  if (! magic || strcmp (magic, PLUG_IN_RC_CACHE_MAGIC)                ||
+      cache_read_uint32 (&cache) != PLUG_IN_RC_CACHE_VERSION           ||
+      cache_read_uint32 (&cache) != GIMP_PROTOCOL_VERSION              ||
+      ! plug_in_rc_cache_check_times (&cache, pluginrc, plug_in_path))
+    {
+      g_free (magic);
+      g_mapped_file_free (file);
+
+      return NULL;
+    }
+
+  g_free (magic);
+
+  n_defs = cache_read_uint32 (&cache);
+
+  for (i = 0; i < n_defs && ! cache.error; i++)
+    {
+      GimpPlugInDef *plug_in_def = plug_in_rc_cache_read_def (&cache, gimp);
+
+      if (plug_in_def)
+        plug_in_defs = g_slist_prepend (plug_in_defs, plug_in_def);
+    }
+
+  g_mapped_file_free (file);
+
+  plug_in_defs = g_slist_reverse (plug_in_defs);
+
+  /*  a plug-in that was replaced in place doesn't touch its directory  */
+  for (list = plug_in_defs; list && ! cache.error; list = g_slist_next (list))
+    {
+      GimpPlugInDef *plug_in_def = list->data;
+
+      if (cache_get_mtime (plug_in_def->prog) != plug_in_def->mtime)
+        cache.error = TRUE;
+    }
+
+  if (cache.error)
+    {
+      g_slist_foreach (plug_in_defs, (GFunc) g_object_unref, NULL);
+      g_slist_free (plug_in_defs);
+
+      return NULL;
+    }
+
+  return plug_in_defs;
+}
+
+gboolean
+plug_in_rc_cache_write (GSList       *plug_in_defs,
+                        const gchar  *filename,
+                        const gchar  *pluginrc,
+                        const gchar  *plug_in_path,
+                        GError      **error)
+{
+  GString  *buffer;
+  GSList   *list;
+  gboolean  success;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (pluginrc != NULL, FALSE);
+  g_return_val_if_fail (plug_in_path != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  buffer = g_string_sized_new (256 * 1024);
+
+  cache_write_string (buffer, PLUG_IN_RC_CACHE_MAGIC);
+  cache_write_uint32 (buffer, PLUG_IN_RC_CACHE_VERSION);
+  cache_write_uint32 (buffer, GIMP_PROTOCOL_VERSION);
+
+  plug_in_rc_cache_write_times (buffer, pluginrc, plug_in_path);
+
+  cache_write_uint32 (buffer, g_slist_length (plug_in_defs));
+
+  for (list = plug_in_defs; list; list = g_slist_next (list))
+    plug_in_rc_cache_write_def (buffer, list->data);
+
+  success = g_file_set_contents (filename, buffer->str, buffer->len, error);
+
+  g_string_free (buffer, TRUE);
+
+  return success;
+}
+
+
+/*  reading  */
+
+static gboolean
+plug_in_rc_cache_check_times (PlugInRcCache *cache,
+                              const gchar   *pluginrc,
+                              const gchar   *plug_in_path)
+{
+  gchar    *path;
+  GList    *dirs;
+  GList    *list;
+  guint32   n_dirs;
+  gboolean  valid;
+
+  if (cache_read_int64 (cache) != cache_get_mtime (pluginrc))
+    return FALSE;
+
+  path = cache_read_string (cache);
+  valid = path && ! strcmp (path, plug_in_path);
+  g_free (path);
+
+  if (! valid)
+    return FALSE;
+
+  dirs   = gimp_path_parse (plug_in_path, 16, TRUE, NULL);
+  n_dirs = cache_read_uint32 (cache);
+
+  valid = (n_dirs == g_list_length (dirs));
+
+  for (list = dirs; list && valid; list = g_list_next (list))
+    {
+      gchar *dirname = cache_read_string (cache);
+
+      valid = (dirname                                         &&
+               ! strcmp (dirname, list->data)                  &&
+               cache_read_int64 (cache) == cache_get_mtime (dirname));
+
+      g_free (dirname);
+    }
+
+  gimp_path_free (dirs);
+
+  return valid && ! cache->error;
+}
+
+static GimpPlugInDef *
+plug_in_rc_cache_read_def (PlugInRcCache *cache,
+                           Gimp          *gimp)
+{
+  GimpPlugInDef *plug_in_def;
+  gchar         *prog;
+  gchar         *name;
+  gchar         *path;
+  guint32        n_procs;
+  guint32        i;
+
+  prog = cache_read_string (cache);
+
+  if (! prog)
+    {
+      cache->error = TRUE;
+      return NULL;
+    }
+
+  plug_in_def = gimp_plug_in_def_new (prog);
+  g_free (prog);
+
+  plug_in_def->mtime = cache_read_int64 (cache);
+
+  name = cache_read_string (cache);
+  path = cache_read_string (cache);
+
+  if (name)
+    gimp_plug_in_def_set_locale_domain (plug_in_def, name, path);
+
+  g_free (name);
+  g_free (path);
+
+  name = cache_read_string (cache);
+  path = cache_read_string (cache);
+
+  if (name)
+    gimp_plug_in_def_set_help_domain (plug_in_def, name, path);
+
+  g_free (name);
+  g_free (path);
+
+  plug_in_def->has_init = cache_read_uint32 (cache) ? TRUE : FALSE;
+
+  n_procs = cache_read_uint32 (cache);
+
+  for (i = 0; i < n_procs && ! cache->error; i++)
+    {
+      GimpPlugInProcedure *proc;
+
+      proc = plug_in_rc_cache_read_proc (cache, gimp, plug_in_def->prog);
+
+      if (proc)
+        {
+          gimp_plug_in_def_add_procedure (plug_in_def, proc);
+          g_object_unref (proc);
+        }
+    }
+
+  if (cache->error)
+    {
+      g_object_unref (plug_in_def);
+      return NULL;
+    }
+
+  return plug_in_def;
+}
+
+static GimpPlugInProcedure *
+plug_in_rc_cache_read_proc (PlugInRcCache *cache,
+                            Gimp          *gimp,
+                            const gchar   *prog)
+{
+  GimpProcedure       *procedure;
+  GimpPlugInProcedure *proc;
+  gchar               *original_name;
+  gchar               *str;
+  guint32              n_menu_paths;
+  guint32              n_args;
+  guint32              n_return_vals;
+  guint32              i;
+
+  original_name = cache_read_string (cache);
+
+  if (! original_name)
+    {
+      cache->error = TRUE;
+      return NULL;
+    }
+
+  procedure = gimp_plug_in_procedure_new (cache_read_uint32 (cache), prog);
+  proc      = GIMP_PLUG_IN_PROCEDURE (procedure);
+
+  gimp_object_take_name (GIMP_OBJECT (procedure),
+                         gimp_canonicalize_identifier (original_name));
+
+  procedure->original_name = original_name;
+
+  procedure->blurb     = cache_read_string (cache);
+  procedure->help      = cache_read_string (cache);
+  procedure->author    = cache_read_string (cache);
+  procedure->copyright = cache_read_string (cache);
+  procedure->date      = cache_read_string (cache);
+  proc->menu_label     = cache_read_string (cache);
+
+  n_menu_paths = cache_read_uint32 (cache);
+
+  for (i = 0; i < n_menu_paths && ! cache->error; i++)
+    proc->menu_paths = g_list_append (proc->menu_paths,
+                                      cache_read_string (cache));
+
+  proc->icon_type        = cache_read_uint32 (cache);
+  proc->icon_data_length = (gint32) cache_read_uint32 (cache);
+
+  switch (proc->icon_type)
+    {
+    case GIMP_ICON_TYPE_STOCK_ID:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      proc->icon_data = (guint8 *) cache_read_string (cache);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+      if (proc->icon_data_length > 0)
+        proc->icon_data = cache_read_data (cache, proc->icon_data_length);
+      else
+        cache->error = TRUE;
+      break;
+    }
+
+  proc->file_proc  = cache_read_uint32 (cache) ? TRUE : FALSE;
+  proc->extensions = cache_read_string (cache);
+  proc->prefixes   = cache_read_string (cache);
+  proc->magics     = cache_read_string (cache);
+
+  str = cache_read_string (cache);
+  if (str)
+    gimp_plug_in_procedure_set_mime_type (proc, str);
+  g_free (str);
+
+  str = cache_read_string (cache);
+  if (str)
+    gimp_plug_in_procedure_set_thumb_loader (proc, str);
+  g_free (str);
+
+  str = cache_read_string (cache);
+  gimp_plug_in_procedure_set_image_types (proc, str);
+  g_free (str);
+
+  n_args        = cache_read_uint32 (cache);
+  n_return_vals = cache_read_uint32 (cache);
+
+  for (i = 0; i < n_args + n_return_vals && ! cache->error; i++)
+    {
+      GParamSpec *pspec;
+      gint        arg_type = cache_read_uint32 (cache);
+      gchar      *name     = cache_read_string (cache);
+      gchar      *desc     = cache_read_string (cache);
+
+      if (name && ! cache->error)
+        {
+          pspec = gimp_pdb_compat_param_spec (gimp, arg_type, name, desc);
+
+          if (i < n_args)
+            gimp_procedure_add_argument (procedure, pspec);
+          else
+            gimp_procedure_add_return_value (procedure, pspec);
+        }
+      else
+        {
+          cache->error = TRUE;
+        }
+
+      g_free (name);
+      g_free (desc);
+    }
+
+  if (cache->error)
+    {
+      g_object_unref (proc);
+      return NULL;
+    }
+
+  return proc;
+}
+
+static guint32
+cache_read_uint32 (PlugInRcCache *cache)
+{
+  guint32 value;
+
+  if (cache->error || cache->length - cache->pos < sizeof (value))
+    {
+      cache->error = TRUE;
+      return 0;
+    }
+
+  memcpy (&value, cache->data + cache->pos, sizeof (value));
+  cache->pos += sizeof (value);
+
+  return value;
+}
+
+static gint64
+cache_read_int64 (PlugInRcCache *cache)
+{
+  gint64 value;
+
+  if (cache->error || cache->length - cache->pos < sizeof (value))
+    {
+      cache->error = TRUE;
+      return 0;
+    }
+
+  memcpy (&value, cache->data + cache->pos, sizeof (value));
+  cache->pos += sizeof (value);
+
+  return value;
+}
+
+/*  strings are stored with their length and the trailing NUL  */
+static gchar *
+cache_read_string (PlugInRcCache *cache)
+{
+  guint32 length = cache_read_uint32 (cache);
+
+  if (cache->error || length == PLUG_IN_RC_CACHE_NO_STR)
+    return NULL;
+
+  if (cache->length - cache->pos <= length ||
+      cache->data[cache->pos + length] != '\0')
+    {
+      cache->error = TRUE;
+      return NULL;
+    }
+
+  return (gchar *) cache_read_data (cache, length + 1);
+}
+
+static guint8 *
+cache_read_data (PlugInRcCache *cache,
+                 gsize          length)
+{
+  guint8 *data;
+
+  if (cache->error || cache->length - cache->pos < length)
+    {
+      cache->error = TRUE;
+      return NULL;
+    }
+
+  data = g_memdup (cache->data + cache->pos, length);
+  cache->pos += length;
+
+  return data;
+}
+
+
+/*  writing  */
+
+static void
+plug_in_rc_cache_write_times (GString     *buffer,
+                              const gchar *pluginrc,
+                              const gchar *plug_in_path)
+{
+  GList *dirs;
+  GList *list;
+
+  cache_write_int64 (buffer, cache_get_mtime (pluginrc));
+  cache_write_string (buffer, plug_in_path);
+
+  dirs = gimp_path_parse (plug_in_path, 16, TRUE, NULL);
+
+  cache_write_uint32 (buffer, g_list_length (dirs));
+
+  for (list = dirs; list; list = g_list_next (list))
+    {
+      cache_write_string (buffer, list->data);
+      cache_write_int64 (buffer, cache_get_mtime (list->data));
+    }
+
+  gimp_path_free (dirs);
+}
+
+static void
+plug_in_rc_cache_write_def (GString       *buffer,
+                            GimpPlugInDef *plug_in_def)
+{
+  GSList *list;
+  gint    n_procs = 0;
+
+  cache_write_string (buffer, plug_in_def->prog);
+  cache_write_int64 (buffer, plug_in_def->mtime);
+
+  cache_write_string (buffer, plug_in_def->locale_domain_name);
+  cache_write_string (buffer, plug_in_def->locale_domain_path);
+  cache_write_string (buffer, plug_in_def->help_domain_name);
+  cache_write_string (buffer, plug_in_def->help_domain_uri);
+
+  cache_write_uint32 (buffer, plug_in_def->has_init);
+
+  /*  like pluginrc, leave out the procedures installed by init()  */
+  for (list = plug_in_def->procedures; list; list = g_slist_next (list))
+    {
+      GimpPlugInProcedure *proc = list->data;
+
+      if (! proc->installed_during_init)
+        n_procs++;
+    }
+
+  cache_write_uint32 (buffer, n_procs);
+
+  for (list = plug_in_def->procedures; list; list = g_slist_next (list))
+    {
+      GimpPlugInProcedure *proc = list->data;
+
+      if (! proc->installed_during_init)
+        plug_in_rc_cache_write_proc (buffer, proc);
+    }
+}
+
+static void
+plug_in_rc_cache_write_proc (GString             *buffer,
+                             GimpPlugInProcedure *proc)
+{
+  GimpProcedure *procedure = GIMP_PROCEDURE (proc);
+  GList         *list;
+  gint           i;
+
+  cache_write_string (buffer, procedure->original_name);
+  cache_write_uint32 (buffer, procedure->proc_type);
+
+  cache_write_string (buffer, procedure->blurb);
+  cache_write_string (buffer, procedure->help);
+  cache_write_string (buffer, procedure->author);
+  cache_write_string (buffer, procedure->copyright);
+  cache_write_string (buffer, procedure->date);
+  cache_write_string (buffer, proc->menu_label);
+
+  cache_write_uint32 (buffer, g_list_length (proc->menu_paths));
+
+  for (list = proc->menu_paths; list; list = g_list_next (list))
+    cache_write_string (buffer, list->data);
+
+  cache_write_uint32 (buffer, proc->icon_type);
+  cache_write_uint32 (buffer, proc->icon_data_length);
+
+  switch (proc->icon_type)
+    {
+    case GIMP_ICON_TYPE_STOCK_ID:
+    case GIMP_ICON_TYPE_IMAGE_FILE:
+      cache_write_string (buffer, (const gchar *) proc->icon_data);
+      break;
+
+    case GIMP_ICON_TYPE_INLINE_PIXBUF:
+      g_string_append_len (buffer,
+                           (const gchar *) proc->icon_data,
+                           proc->icon_data_length);
+      break;
+    }
+
+  cache_write_uint32 (buffer, proc->file_proc);
+  cache_write_string (buffer, proc->extensions);
+  cache_write_string (buffer, proc->prefixes);
+  cache_write_string (buffer, proc->magics);
+  cache_write_string (buffer, proc->mime_type);
+  cache_write_string (buffer, proc->thumb_loader);
+  cache_write_string (buffer, proc->image_types);
+
+  cache_write_uint32 (buffer, procedure->num_args);
+  cache_write_uint32 (buffer, procedure->num_values);
+
+  for (i = 0; i < procedure->num_args + procedure->num_values; i++)
+    {
+      GParamSpec *pspec;
+
+      if (i < procedure->num_args)
+        pspec = procedure->args[i];
+      else
+        pspec = procedure->values[i - procedure->num_args];
+
+      cache_write_uint32 (buffer,
+                          gimp_pdb_compat_arg_type_from_gtype (G_PARAM_SPEC_VALUE_TYPE (pspec)));
+      cache_write_string (buffer, g_param_spec_get_name (pspec));
+      cache_write_string (buffer, g_param_spec_get_blurb (pspec));
+    }
+}
+
+static void
+cache_write_uint32 (GString *buffer,
+                    guint32  value)
+{
+  g_string_append_len (buffer, (const gchar *) &value, sizeof (value));
+}
+
+static void
+cache_write_int64 (GString *buffer,
+                   gint64   value)
+{
+  g_string_append_len (buffer, (const gchar *) &value, sizeof (value));
+}
+
+static void
+cache_write_string (GString     *buffer,
+                    const gchar *str)
+{
+  if (str)
+    {
+      guint32 length = strlen (str);
+
+      cache_write_uint32 (buffer, length);
+      g_string_append_len (buffer, str, length + 1);
+    }
+  else
+    {
+      cache_write_uint32 (buffer, PLUG_IN_RC_CACHE_NO_STR);
+    }
+}
+
+/*  returns -1 for files that don't exist  */
+static gint64
+cache_get_mtime (const gchar *filename)
+{
+  struct stat filestat;
+
+  if (g_stat (filename, &filestat))
+    return -1;
+
+  return filestat.st_mtime;
+}
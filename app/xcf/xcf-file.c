@@ -0,0 +1,388 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib-object.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimp-utils.h"
+#include "core/gimpimage.h"
+
+#include "xcf-private.h"
+#include "xcf-file.h"
+
+#include "gimp-intl.h"
+
+
+#define XCF_FILE_COPY_SIZE  (1024 * 1024)
+
+
+/*  An XCF file that is kept open after loading, so that the tiles of
+ *  the image can be read from it when they are first needed.
+ */
+struct _XcfFile
+{
+  gint          ref_count;
+  Gimp         *gimp;
+  GimpImage    *image;      /*  the image loaded from it, or NULL    */
+  gchar        *filename;   /*  the file the image was loaded from   */
+  gchar        *copy;       /*  a private copy of it, or NULL        */
+  FILE         *fp;
+  gboolean      error;      /*  some tiles could not be read         */
+  GStaticMutex  mutex;      /*  protects fp, copy and error          */
+};
+
+
+static gboolean  xcf_file_is_same      (XcfFile      *file,
+                                        const gchar  *filename);
+static gboolean  xcf_file_copy         (FILE         *src,
+                                        const gchar  *dest,
+                                        GError      **error);
+static gboolean  xcf_file_report_error (XcfFile      *file);
+
+
+/*  all open files, so that they can be detached before saving  */
+static GList        *xcf_files   = NULL;
+static GStaticMutex  files_mutex = G_STATIC_MUTEX_INIT;
+
+
+XcfFile *
+xcf_file_open (Gimp        *gimp,
+               const gchar *filename)
+{
+  XcfFile *file;
+  FILE    *fp;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  fp = g_fopen (filename, "rb");
+
+  if (! fp)
+    return NULL;
+
+  file = g_slice_new0 (XcfFile);
+
+  file->ref_count = 1;
+  file->gimp      = gimp;
+  file->filename  = g_strdup (filename);
+  file->fp        = fp;
+
+  g_static_mutex_init (&file->mutex);
+
+  g_static_mutex_lock (&files_mutex);
+  xcf_files = g_list_prepend (xcf_files, file);
+  g_static_mutex_unlock (&files_mutex);
+
+  return file;
+}
+
+XcfFile *
+xcf_file_ref (XcfFile *file)
+{
+  g_return_val_if_fail (file != NULL, NULL);
+
+  g_atomic_int_inc (&file->ref_count);
+
+  return file;
+}
+
+void
+xcf_file_unref (XcfFile *file)
+{
+  g_return_if_fail (file != NULL);
+
+  if (! g_atomic_int_dec_and_test (&file->ref_count))
+    return;
+
+  g_static_mutex_lock (&files_mutex);
+  xcf_files = g_list_remove (xcf_files, file);
+  g_static_mutex_unlock (&files_mutex);
+
+  if (file->image)
+    g_object_remove_weak_pointer (G_OBJECT (file->image),
+                                  (gpointer) &file->image);
+
+  if (file->fp)
+    fclose (file->fp);
+
+  if (file->copy)
+    {
+      g_unlink (file->copy);
+      g_free (file->copy);
+    }
+
+  g_static_mutex_free (&file->mutex);
+
+  g_free (file->filename);
+  g_slice_free (XcfFile, file);
+}
+
+/*  Sets the image whose tiles are read from the file, so that it can
+ *  be marked dirty if some of them turn out to be unreadable. This
+ *  must be called from the main thread.
+ */
+void
+xcf_file_set_image (XcfFile   *file,
+                    GimpImage *image)
+{
+  g_return_if_fail (file != NULL);
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+  g_return_if_fail (file->image == NULL);
+
+  file->image = image;
+
+  g_object_add_weak_pointer (G_OBJECT (image), (gpointer) &file->image);
+}
+
+/*  Flags the file as damaged after a tile could not be read from it.
+ *  The user is told about it from the main loop, and the file is not
+ *  overwritten while the flag is set. This may be called from any
+ *  thread.
+ */
+void
+xcf_file_set_error (XcfFile *file)
+{
+  gboolean report;
+
+  g_return_if_fail (file != NULL);
+
+  g_static_mutex_lock (&file->mutex);
+
+  report = ! file->error;
+  file->error = TRUE;
+
+  g_static_mutex_unlock (&file->mutex);
+
+  if (report)
+    g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                     (GSourceFunc) xcf_file_report_error,
+                     xcf_file_ref (file),
+                     (GDestroyNotify) xcf_file_unref);
+}
+
+/*  Reads size bytes starting at pos and returns the number of bytes
+ *  read, which is less than size at the end of the file. This may be
+ *  called from any thread.
+ */
+gsize
+xcf_file_read (XcfFile *file,
+               guint64  pos,
+               guchar  *buffer,
+               gsize    size)
+{
+  gsize count = 0;
+
+  g_return_val_if_fail (file != NULL, 0);
+  g_return_val_if_fail (buffer != NULL, 0);
+
+  g_static_mutex_lock (&file->mutex);
+
+  if (file->fp && xcf_fseek (file->fp, pos, SEEK_SET) != -1)
+    count = fread (buffer, 1, size, file->fp);
+
+  g_static_mutex_unlock (&file->mutex);
+
+  return count;
+}
+
+/*  Must be called before filename is overwritten. Any open file that
+ *  refers to it is copied to a temporary file first, and its tiles
+ *  are read from the copy from then on.
+ */
+gboolean
+xcf_file_detach (Gimp         *gimp,
+                 const gchar  *filename,
+                 GError      **error)
+{
+  GList    *list;
+  gboolean  success = TRUE;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  g_static_mutex_lock (&files_mutex);
+
+  for (list = xcf_files; list && success; list = g_list_next (list))
+    {
+      XcfFile *file = list->data;
+
+      g_static_mutex_lock (&file->mutex);
+
+      if (file->error && ! file->copy && file->fp &&
+          xcf_file_is_same (file, filename))
+        {
+          /*  the rest of the image would be lost  */
+          g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                       _("Some of the pixels of '%s' could not be read, "
+                         "refusing to overwrite it. Please save the image "
+                         "under a different name."),
+                       gimp_filename_to_utf8 (filename));
+
+          success = FALSE;
+        }
+      else if (file->fp && ! file->copy && xcf_file_is_same (file, filename))
+        {
+          gchar *copy = gimp_get_temp_filename (gimp, "xcf");
+          FILE  *fp   = NULL;
+
+          if (xcf_file_copy (file->fp, copy, error))
+            {
+              fp = g_fopen (copy, "rb");
+
+              if (! fp)
+                g_set_error (error, G_FILE_ERROR,
+                             g_file_error_from_errno (errno),
+                             _("Could not open '%s' for reading: %s"),
+                             gimp_filename_to_utf8 (copy),
+                             g_strerror (errno));
+            }
+
+          if (fp)
+            {
+              fclose (file->fp);
+
+              file->fp   = fp;
+              file->copy = copy;
+            }
+          else
+            {
+              g_unlink (copy);
+              g_free (copy);
+
+              success = FALSE;
+            }
+        }
+
+      g_static_mutex_unlock (&file->mutex);
+    }
+
+  g_static_mutex_unlock (&files_mutex);
+
+  return success;
+}
+
+
+/*  private functions  */
+
+static gboolean
+xcf_file_is_same (XcfFile     *file,
+                  const gchar *filename)
+{
+#ifndef G_OS_WIN32
+  struct stat open_stat;
+  struct stat name_stat;
+
+  /*  catches links and different spellings of the same path  */
+  if (fstat (fileno (file->fp), &open_stat) == 0 &&
+      g_stat (filename, &name_stat) == 0)
+    return (open_stat.st_dev == name_stat.st_dev &&
+            open_stat.st_ino == name_stat.st_ino);
+#endif
+
+  return strcmp (file->filename, filename) == 0;
+}
+
+static gboolean
+xcf_file_copy (FILE         *src,
+               const gchar  *dest,
+               GError      **error)
+{
+  FILE     *fp;
+  guchar   *buffer;
+  gsize     count;
+  gboolean  success = TRUE;
+
+  fp = g_fopen (dest, "wb");
+
+  if (! fp)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not open '%s' for writing: %s"),
+                   gimp_filename_to_utf8 (dest), g_strerror (errno));
+      return FALSE;
+    }
+
+  buffer = g_malloc (XCF_FILE_COPY_SIZE);
+
+  if (xcf_fseek (src, 0, SEEK_SET) == -1)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Could not seek in XCF file: %s"),
+                   g_strerror (errno));
+      success = FALSE;
+    }
+
+  while (success && (count = fread (buffer, 1, XCF_FILE_COPY_SIZE, src)) > 0)
+    {
+      if (fwrite (buffer, 1, count, fp) != count)
+        {
+          g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                       _("Error writing '%s': %s"),
+                       gimp_filename_to_utf8 (dest), g_strerror (errno));
+          success = FALSE;
+        }
+    }
+
+  if (success && ferror (src))
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Error reading XCF file: %s"),
+                   g_strerror (errno));
+      success = FALSE;
+    }
+
+  if (fclose (fp) != 0 && success)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                   _("Error writing '%s': %s"),
+                   gimp_filename_to_utf8 (dest), g_strerror (errno));
+      success = FALSE;
+    }
+
+  g_free (buffer);
+
+  return success;
+}
+
+static gboolean
+xcf_file_report_error (XcfFile *file)
+{
+  /*  the zero-filled tiles are not what is in the file  */
+  if (file->image)
+    gimp_image_dirty (file->image, GIMP_DIRTY_IMAGE);
+
+  gimp_message (file->gimp, NULL, GIMP_MESSAGE_ERROR,
+                _("Some of the pixels of '%s' could not be read, "
+                  "the file may be damaged. They are left empty."),
+                gimp_filename_to_utf8 (file->filename));
+
+  return FALSE;
+}
@@ -0,0 +1,42 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __XCF_FILE_H__
+#define __XCF_FILE_H__
+
+
+XcfFile  * xcf_file_open      (Gimp         *gimp,
+                               const gchar  *filename);
+XcfFile  * xcf_file_ref       (XcfFile      *file);
+void       xcf_file_unref     (XcfFile      *file);
+
+void       xcf_file_set_image (XcfFile      *file,
+                               GimpImage    *image);
+void       xcf_file_set_error (XcfFile      *file);
+
+gsize      xcf_file_read      (XcfFile      *file,
+                               guint64       pos,
+                               guchar       *buffer,
+                               gsize         size);
+
+gboolean   xcf_file_detach    (Gimp         *gimp,
+                               const gchar  *filename,
+                               GError      **error);
+
+
+#endif  /* __XCF_FILE_H__ */
@@ -23,11 +23,17 @@
 
 #include <glib-object.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
 
 #include "core/core-types.h"
 
+#include "base/pixel-processor.h"
+#include "base/pixel-region.h"
 #include "base/tile.h"
 #include "base/tile-manager.h"
 #include "base/tile-manager-private.h"
@@ -62,7 +68,9 @@
 #include "vectors/gimpvectors-compat.h"
 
 #include "xcf-private.h"
+#include "xcf-file.h"
 #include "xcf-load.h"
+#include "xcf-lz.h"
 #include "xcf-read.h"
 #include "xcf-seek.h"
 
@@ -71,6 +79,62 @@
 
 /* #define GIMP_XCF_PATH_DEBUG */
 
+
+/*  The tiles of a level are read in batches of whole tile rows with
+ *  about this many bytes of tile data, and each batch is decoded by
+ *  the pixel processor threads.
+ */
+#define XCF_LOAD_BATCH_SIZE  (16 * 1024 * 1024)
+
+/*  A hierarchy has one level per halving of the size, more than these
+ *  can't be valid.
+ */
+#define XCF_MAX_LEVELS       32
+
+typedef struct _XcfLevelData XcfLevelData;
+
+struct _XcfLevelData
+{
+  XcfCompressionType  compression;
+  gint                n_cols;
+  const guint64      *offsets;       /*  where the tiles start            */
+  const guint64      *ends;          /*  where the tiles end              */
+  const guchar       *buffer;        /*  the tile data of the batch       */
+  guint64             buffer_start;  /*  file position of buffer[0]       */
+  guint64             buffer_end;    /*  file position after the data     */
+  gboolean            failed;
+};
+
+/*  Where the tiles of a level are found in the file, for reading them
+ *  when they are first needed. It is shared by the duplicates of the
+ *  level's tile manager.
+ */
+typedef struct _XcfTileSource XcfTileSource;
+
+struct _XcfTileSource
+{
+  gint                ref_count;
+  XcfFile            *file;
+  XcfCompressionType  compression;
+  gint                n_cols;
+  guint64            *offsets;
+  guint64            *ends;
+};
+
+/*  The scaled down levels stored in the hierarchy of a drawable. They
+ *  are handed to the drawable when the image is complete, as anything
+ *  the loader does to the drawables after loading their pixels may
+ *  look like a change to them.
+ */
+typedef struct _XcfMipmaps XcfMipmaps;
+
+struct _XcfMipmaps
+{
+  GimpDrawable  *drawable;
+  TileManager  **levels;
+  gint           n_levels;
+};
+
 static gboolean        xcf_load_image_props   (XcfInfo      *info,
                                                GimpImage    *image);
 static gboolean        xcf_load_layer_props   (XcfInfo      *info,
@@ -93,13 +157,31 @@ static GimpChannel   * xcf_load_channel       (XcfInfo      *info,
 static GimpLayerMask * xcf_load_layer_mask    (XcfInfo      *info,
                                                GimpImage    *image);
 static gboolean        xcf_load_hierarchy     (XcfInfo      *info,
-                                               TileManager  *tiles);
+                                               GimpDrawable *drawable);
+static void            xcf_load_mipmaps       (XcfInfo      *info,
+                                               GimpDrawable *drawable,
+                                               guint64      *offsets,
+                                               gint          n_offsets);
+static void            xcf_load_set_mipmaps   (XcfInfo      *info,
+                                               gboolean      set);
 static gboolean        xcf_load_level         (XcfInfo      *info,
                                                TileManager  *tiles);
-static gboolean        xcf_load_tile          (XcfInfo      *info,
-                                               Tile         *tile);
-static gboolean        xcf_load_tile_rle      (XcfInfo      *info,
+static guint           xcf_read_offset        (XcfInfo      *info,
+                                               guint64      *data,
+                                               gint          count);
+static void            xcf_load_level_region  (XcfLevelData *data,
+                                               PixelRegion  *region);
+static gpointer        xcf_load_source_ref    (gpointer      data);
+static void            xcf_load_source_unref  (gpointer      data);
+static void            xcf_load_source_tile   (TileManager  *tiles,
+                                               Tile         *tile,
+                                               gpointer      data);
+static gboolean        xcf_load_tile_data     (XcfCompressionType compression,
                                                Tile         *tile,
+                                               const guchar *xcfdata,
+                                               gint          data_length);
+static gboolean        xcf_load_tile_rle      (Tile         *tile,
+                                               const guchar *xcfdata,
                                                gint          data_length);
 static GimpParasite  * xcf_load_parasite      (XcfInfo      *info);
 static gboolean        xcf_load_old_paths     (XcfInfo      *info,
@@ -127,8 +209,8 @@ xcf_load_image (Gimp    *gimp,
   GimpLayer          *layer;
   GimpChannel        *channel;
   const GimpParasite *parasite;
-  guint32             saved_pos;
-  guint32             offset;
+  guint64             saved_pos;
+  guint64             offset;
   gint                width;
   gint                height;
   gint                image_type;
@@ -170,7 +252,7 @@ xcf_load_image (Gimp    *gimp,
   while (TRUE)
     {
       /* read in the offset of the next layer */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+      info->cp += xcf_read_offset (info, &offset, 1);
 
       /* if the offset is 0 then we are at the end
        *  of the layer list.
@@ -211,7 +293,7 @@ xcf_load_image (Gimp    *gimp,
   while (TRUE)
     {
       /* read in the offset of the next channel */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+      info->cp += xcf_read_offset (info, &offset, 1);
 
       /* if the offset is 0 then we are at the end
        *  of the channel list.
@@ -263,6 +345,8 @@ xcf_load_image (Gimp    *gimp,
   if (info->tattoo_state > 0)
     gimp_image_set_tattoo_state (image, info->tattoo_state);
 
+  xcf_load_set_mipmaps (info, TRUE);
+
   gimp_image_undo_enable (image);
 
   return image;
@@ -271,6 +355,8 @@ xcf_load_image (Gimp    *gimp,
   if (num_successful_elements == 0)
     goto hard_error;
 
+  xcf_load_set_mipmaps (info, TRUE);
+
   gimp_message (gimp, G_OBJECT (info->progress), GIMP_MESSAGE_WARNING,
                 _("This XCF file is corrupt!  I have loaded as much "
                   "of it as I can, but it is incomplete."));
@@ -280,6 +366,8 @@ xcf_load_image (Gimp    *gimp,
   return image;
 
  hard_error:
+  xcf_load_set_mipmaps (info, FALSE);
+
   gimp_message (gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
                 _("This XCF file is corrupt!  I could not even "
                   "salvage any partial image data from it."));
@@ -360,7 +448,8 @@ xcf_load_image_props (XcfInfo   *info,
             if ((compression != COMPRESS_NONE) &&
                 (compression != COMPRESS_RLE) &&
                 (compression != COMPRESS_ZLIB) &&
-                (compression != COMPRESS_FRACTAL))
+                (compression != COMPRESS_FRACTAL) &&
+                (compression != COMPRESS_LZ))
               {
                 gimp_message (info->gimp, G_OBJECT (info->progress),
                               GIMP_MESSAGE_ERROR,
@@ -369,6 +458,17 @@ xcf_load_image_props (XcfInfo   *info,
                 return FALSE;
               }
 
+#ifndef HAVE_ZLIB
+            if (compression == COMPRESS_ZLIB)
+              {
+                gimp_message (info->gimp, G_OBJECT (info->progress),
+                              GIMP_MESSAGE_ERROR,
+                              "zlib compression is not supported by "
+                              "this build");
+                return FALSE;
+              }
+#endif
+
             info->compression = compression;
           }
           break;
@@ -461,7 +561,7 @@ xcf_load_image_props (XcfInfo   *info,
 
         case PROP_PARASITES:
           {
-            glong         base = info->cp;
+            guint64       base = info->cp;
             GimpParasite *p;
 
             while (info->cp - base < prop_size)
@@ -556,7 +656,7 @@ xcf_load_image_props (XcfInfo   *info,
 
         case PROP_VECTORS:
           {
-            guint32 base = info->cp;
+            guint64 base = info->cp;
 
             if (xcf_load_vectors (info, image))
               {
@@ -564,7 +664,7 @@ xcf_load_image_props (XcfInfo   *info,
                   {
                     g_printerr ("Mismatch in PROP_VECTORS size: "
                                 "skipping %d bytes.\n",
-                                base + prop_size - info->cp);
+                                (gint) (base + prop_size - info->cp));
                     xcf_seek_pos (info, base + prop_size, NULL);
                   }
               }
@@ -634,9 +734,7 @@ xcf_load_layer_props (XcfInfo   *info,
 
         case PROP_FLOATING_SELECTION:
           info->floating_sel = layer;
-          info->cp +=
-            xcf_read_int32 (info->fp,
-                            (guint32 *) &info->floating_sel_offset, 1);
+          info->cp += xcf_read_offset (info, &info->floating_sel_offset, 1);
           break;
 
         case PROP_OPACITY:
@@ -709,7 +807,7 @@ xcf_load_layer_props (XcfInfo   *info,
 
         case PROP_PARASITES:
           {
-            glong         base = info->cp;
+            guint64       base = info->cp;
             GimpParasite *p;
 
             while (info->cp - base < prop_size)
@@ -852,7 +950,7 @@ xcf_load_channel_props (XcfInfo      *info,
 
         case PROP_PARASITES:
           {
-            glong         base = info->cp;
+            guint64       base = info->cp;
             GimpParasite *p;
 
             while ((info->cp - base) < prop_size)
@@ -920,8 +1018,8 @@ xcf_load_layer (XcfInfo   *info,
 {
   GimpLayer     *layer;
   GimpLayerMask *layer_mask;
-  guint32        hierarchy_offset;
-  guint32        layer_mask_offset;
+  guint64        hierarchy_offset;
+  guint64        layer_mask_offset;
   gboolean       apply_mask = TRUE;
   gboolean       edit_mask  = FALSE;
   gboolean       show_mask  = FALSE;
@@ -976,14 +1074,14 @@ xcf_load_layer (XcfInfo   *info,
     }
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->fp, &hierarchy_offset, 1);
-  info->cp += xcf_read_int32 (info->fp, &layer_mask_offset, 1);
+  info->cp += xcf_read_offset (info, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info, &layer_mask_offset, 1);
 
   /* read in the hierarchy */
   if (! xcf_seek_pos (info, hierarchy_offset, NULL))
     goto error;
 
-  if (! xcf_load_hierarchy (info, GIMP_DRAWABLE (layer)->tiles))
+  if (! xcf_load_hierarchy (info, GIMP_DRAWABLE (layer)))
     goto error;
 
   xcf_progress_update (info);
@@ -1023,7 +1121,7 @@ xcf_load_channel (XcfInfo   *info,
                   GimpImage *image)
 {
   GimpChannel *channel;
-  guint32      hierarchy_offset;
+  guint64      hierarchy_offset;
   gint         width;
   gint         height;
   gboolean     is_fs_drawable;
@@ -1053,13 +1151,13 @@ xcf_load_channel (XcfInfo   *info,
   xcf_progress_update (info);
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->fp, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info, &hierarchy_offset, 1);
 
   /* read in the hierarchy */
   if (!xcf_seek_pos (info, hierarchy_offset, NULL))
     goto error;
 
-  if (!xcf_load_hierarchy (info, GIMP_DRAWABLE (channel)->tiles))
+  if (!xcf_load_hierarchy (info, GIMP_DRAWABLE (channel)))
     goto error;
 
   xcf_progress_update (info);
@@ -1080,7 +1178,7 @@ xcf_load_layer_mask (XcfInfo   *info,
 {
   GimpLayerMask *layer_mask;
   GimpChannel   *channel;
-  guint32        hierarchy_offset;
+  guint64        hierarchy_offset;
   gint           width;
   gint           height;
   gboolean       is_fs_drawable;
@@ -1111,13 +1209,13 @@ xcf_load_layer_mask (XcfInfo   *info,
   xcf_progress_update (info);
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->fp, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info, &hierarchy_offset, 1);
 
   /* read in the hierarchy */
   if (! xcf_seek_pos (info, hierarchy_offset, NULL))
     goto error;
 
-  if (!xcf_load_hierarchy (info, GIMP_DRAWABLE (layer_mask)->tiles))
+  if (!xcf_load_hierarchy (info, GIMP_DRAWABLE (layer_mask)))
     goto error;
 
   xcf_progress_update (info);
@@ -1134,15 +1232,18 @@ xcf_load_layer_mask (XcfInfo   *info,
 }
 
 static gboolean
-xcf_load_hierarchy (XcfInfo     *info,
-                    TileManager *tiles)
+xcf_load_hierarchy (XcfInfo      *info,
+                    GimpDrawable *drawable)
 {
-  guint32 saved_pos;
-  guint32 offset;
-  guint32 junk;
-  gint    width;
-  gint    height;
-  gint    bpp;
+  TileManager *tiles = gimp_drawable_get_tiles (drawable);
+  guint64      saved_pos;
+  guint64      offset;
+  guint64      levels[XCF_MAX_LEVELS];
+  guint64      junk;
+  gint         n_levels = 0;
+  gint         width;
+  gint         height;
+  gint         bpp;
 
   info->cp += xcf_read_int32 (info->fp, (guint32 *) &width, 1);
   info->cp += xcf_read_int32 (info->fp, (guint32 *) &height, 1);
@@ -1161,13 +1262,16 @@ xcf_load_hierarchy (XcfInfo     *info,
    *  as the number of levels found in the file.
    */
 
-  info->cp += xcf_read_int32 (info->fp, &offset, 1); /* top level */
+  info->cp += xcf_read_offset (info, &offset, 1); /* top level */
 
-  /* discard offsets for layers below first, if any.
+  /* remember the offsets of the smaller levels, if any.
    */
   do
     {
-      info->cp += xcf_read_int32 (info->fp, &junk, 1);
+      info->cp += xcf_read_offset (info, &junk, 1);
+
+      if (junk != 0 && n_levels < XCF_MAX_LEVELS)
+        levels[n_levels++] = junk;
     }
   while (junk != 0);
 
@@ -1184,6 +1288,12 @@ xcf_load_hierarchy (XcfInfo     *info,
   if (!xcf_load_level (info, tiles))
     return FALSE;
 
+  /* indexed levels are never stored, colormap indices can't be
+   *  scaled down like other pixels.
+   */
+  if (n_levels > 0 && ! gimp_drawable_is_indexed (drawable))
+    xcf_load_mipmaps (info, drawable, levels, n_levels);
+
   /* restore the saved position so we'll be ready to
    *  read the next offset.
    */
@@ -1193,20 +1303,131 @@ xcf_load_hierarchy (XcfInfo     *info,
   return TRUE;
 }
 
+/*  Loads the scaled down levels that follow the top level, stopping at
+ *  the first one that is empty. Files written by older versions only
+ *  have empty levels. The levels are optional, so any problem with
+ *  them just means that they are not used.
+ */
+static void
+xcf_load_mipmaps (XcfInfo      *info,
+                  GimpDrawable *drawable,
+                  guint64      *offsets,
+                  gint          n_offsets)
+{
+  TileManager  *tiles  = gimp_drawable_get_tiles (drawable);
+  TileManager **levels = g_new0 (TileManager *, n_offsets);
+  gint          width  = tile_manager_width (tiles);
+  gint          height = tile_manager_height (tiles);
+  gint          n_levels;
+
+  for (n_levels = 0; n_levels < n_offsets; n_levels++)
+    {
+      guint64 first;
+      gint    level_width;
+      gint    level_height;
+
+      width  /= 2;
+      height /= 2;
+
+      if (width == 0 || height == 0)
+        break;
+
+      if (! xcf_seek_pos (info, offsets[n_levels], NULL))
+        break;
+
+      info->cp += xcf_read_int32 (info->fp, (guint32 *) &level_width, 1);
+      info->cp += xcf_read_int32 (info->fp, (guint32 *) &level_height, 1);
+      info->cp += xcf_read_offset (info, &first, 1);
+
+      if (level_width != width || level_height != height || first == 0)
+        break;
+
+      if (! xcf_seek_pos (info, offsets[n_levels], NULL))
+        break;
+
+      levels[n_levels] = tile_manager_new (width, height,
+                                           tile_manager_bpp (tiles));
+
+      if (! xcf_load_level (info, levels[n_levels]))
+        {
+          tile_manager_unref (levels[n_levels]);
+          break;
+        }
+    }
+
+  if (n_levels > 0)
+    {
+      XcfMipmaps *mipmaps = g_slice_new (XcfMipmaps);
+
+      mipmaps->drawable = g_object_ref (drawable);
+      mipmaps->levels   = levels;
+      mipmaps->n_levels = n_levels;
+
+      info->mipmaps = g_list_prepend (info->mipmaps, mipmaps);
+    }
+  else
+    {
+      g_free (levels);
+    }
+}
+
+/*  Hands the loaded levels to their drawables if @set is TRUE and the
+ *  drawable made it into the image, and frees them otherwise.
+ */
+static void
+xcf_load_set_mipmaps (XcfInfo  *info,
+                      gboolean  set)
+{
+  GList *list;
+
+  for (list = info->mipmaps; list; list = g_list_next (list))
+    {
+      XcfMipmaps *mipmaps = list->data;
+
+      if (set && gimp_item_is_attached (GIMP_ITEM (mipmaps->drawable)))
+        {
+          gimp_drawable_set_mipmaps (mipmaps->drawable,
+                                     mipmaps->levels, mipmaps->n_levels);
+        }
+      else
+        {
+          gint i;
+
+          for (i = 0; i < mipmaps->n_levels; i++)
+            tile_manager_unref (mipmaps->levels[i]);
+
+          g_free (mipmaps->levels);
+        }
+
+      g_object_unref (mipmaps->drawable);
+      g_slice_free (XcfMipmaps, mipmaps);
+    }
+
+  g_list_free (info->mipmaps);
+  info->mipmaps = NULL;
+}
+
 
 static gboolean
 xcf_load_level (XcfInfo     *info,
                 TileManager *tiles)
 {
-  guint32 saved_pos;
-  guint32 offset, offset2;
-  guint ntiles;
-  gint  width;
-  gint  height;
-  gint  i;
-  gint  fail;
-  Tile *previous;
-  Tile *tile;
+  XcfLevelData  data;
+  PixelRegion   region;
+  guint64       saved_pos;
+  guint64       offset;
+  guint64      *offsets;
+  guint64      *ends;
+  guint         ntiles;
+  gint          width;
+  gint          height;
+  gint          n_cols;
+  gint          row;
+  gint          n_rows;
+  gint          i;
+  gboolean      success = TRUE;
+  Tile         *previous;
+  Tile         *tile;
 
   info->cp += xcf_read_int32 (info->fp, (guint32 *) &width, 1);
   info->cp += xcf_read_int32 (info->fp, (guint32 *) &height, 1);
@@ -1219,141 +1440,247 @@ xcf_load_level (XcfInfo     *info,
    *  if it is '0', then this tile level is empty
    *  and we can simply return.
    */
-  info->cp += xcf_read_int32 (info->fp, &offset, 1);
+  info->cp += xcf_read_offset (info, &offset, 1);
   if (offset == 0)
     return TRUE;
 
-  /* Initialise the reference for the in-memory tile-compression
+  n_cols = tiles->ntile_cols;
+  ntiles = tiles->ntile_rows * tiles->ntile_cols;
+
+  /* read the whole offset table, including the terminating '0'
    */
-  previous = NULL;
+  offsets = g_new (guint64, ntiles + 1);
+  ends    = g_new (guint64, ntiles);
+
+  offsets[0] = offset;
+  info->cp += xcf_read_offset (info, offsets + 1, ntiles);
 
-  ntiles = tiles->ntile_rows * tiles->ntile_cols;
   for (i = 0; i < ntiles; i++)
     {
-      fail = FALSE;
-
-      if (offset == 0)
+      if (offsets[i] == 0)
         {
           gimp_message (info->gimp, G_OBJECT (info->progress),
                         GIMP_MESSAGE_ERROR,
                         "not enough tiles found in level");
-          return FALSE;
+          success = FALSE;
+          goto out;
         }
+    }
 
-      /* save the current position as it is where the
-       *  next tile offset is stored.
-       */
-      saved_pos = info->cp;
-
-      /* read in the offset of the next tile so we can calculate the amount
-         of data needed for this tile*/
-      info->cp += xcf_read_int32 (info->fp, &offset2, 1);
+  if (offsets[ntiles] != 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "encountered garbage after reading level: %"
+                    G_GUINT64_FORMAT, offsets[ntiles]);
+      success = FALSE;
+      goto out;
+    }
 
-      /* if the offset is 0 then we need to read in the maximum possible
-         allowing for negative compression */
-      if (offset2 == 0)
-        offset2 = offset + TILE_WIDTH * TILE_WIDTH * 4 * 1.5;
+  /* a tile's data ends where the next tile starts. For the last tile
+   *  we read the maximum possible amount, allowing for negative
+   *  compression.
+   */
+  for (i = 0; i < ntiles; i++)
+    {
+      if (info->compression == COMPRESS_NONE)
+        ends[i] = offsets[i] + TILE_WIDTH * TILE_HEIGHT * tile_manager_bpp (tiles);
+      else if (i + 1 < ntiles)
+        ends[i] = offsets[i + 1];
+      else
+        ends[i] = offsets[i] + TILE_WIDTH * TILE_WIDTH * 4 * 1.5;
                                         /* 1.5 is probably more
                                            than we need to allow */
+    }
 
-      /* seek to the tile offset */
-      if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
+  /* if the file stays open, leave the tiles invalid and read each
+   *  one when it is first needed. Our position in the file is
+   *  already where the hierarchy continues.
+   */
+  if (info->file)
+    {
+      XcfTileSource *source = g_slice_new (XcfTileSource);
+
+      source->ref_count   = 1;
+      source->file        = xcf_file_ref (info->file);
+      source->compression = info->compression;
+      source->n_cols      = n_cols;
+      source->offsets     = offsets;
+      source->ends        = ends;
+
+      tile_manager_set_validate_proc_full (tiles,
+                                           xcf_load_source_tile,
+                                           source,
+                                           xcf_load_source_ref,
+                                           xcf_load_source_unref);
+      return TRUE;
+    }
 
-      /* get the tile from the tile manager */
-      tile = tile_manager_get (tiles, i, TRUE, TRUE);
+  /* save the current position as it is where the hierarchy
+   *  continues.
+   */
+  saved_pos = info->cp;
+
+  data.compression = info->compression;
+  data.n_cols      = n_cols;
+  data.offsets     = offsets;
+  data.ends        = ends;
+
+  /* Initialise the reference for the in-memory tile-compression
+   */
+  previous = NULL;
+
+  for (row = 0; row < tiles->ntile_rows; row += n_rows)
+    {
+      guint64  start = G_MAXUINT64;
+      guint64  end   = 0;
+      guchar  *buffer = NULL;
 
-      /* read in the tile */
-      switch (info->compression)
+      /* collect whole tile rows until the batch is big enough
+       */
+      for (n_rows = 0; row + n_rows < tiles->ntile_rows; n_rows++)
         {
-        case COMPRESS_NONE:
-          if (!xcf_load_tile (info, tile))
-            fail = TRUE;
-          break;
-        case COMPRESS_RLE:
-          if (!xcf_load_tile_rle (info, tile, offset2 - offset))
-            fail = TRUE;
-          break;
-        case COMPRESS_ZLIB:
-          g_error ("xcf: zlib compression unimplemented");
-          fail = TRUE;
+          guint64 row_start = start;
+          guint64 row_end   = end;
+
+          for (i = (row + n_rows) * n_cols; i < (row + n_rows + 1) * n_cols; i++)
+            {
+              row_start = MIN (row_start, offsets[i]);
+              row_end   = MAX (row_end, ends[i]);
+            }
+
+          if (n_rows > 0 && row_end - row_start > XCF_LOAD_BATCH_SIZE)
+            break;
+
+          start = row_start;
+          end   = row_end;
+        }
+
+      if (end - start <= G_MAXINT32)
+        buffer = g_try_malloc (end - start);
+
+      if (! buffer)
+        {
+          gimp_message (info->gimp, G_OBJECT (info->progress),
+                        GIMP_MESSAGE_ERROR,
+                        "invalid tile offsets found in level");
+          success = FALSE;
           break;
-        case COMPRESS_FRACTAL:
-          g_error ("xcf: fractal compression unimplemented");
-          fail = TRUE;
+        }
+
+      if (! xcf_seek_pos (info, start, NULL))
+        {
+          g_free (buffer);
+          success = FALSE;
           break;
         }
 
-      if (fail)
+      /* we have to use fread instead of xcf_read_* because we may be
+         reading past the end of the file here */
+      info->cp += fread (buffer, sizeof (guchar), end - start, info->fp);
+
+      data.buffer       = buffer;
+      data.buffer_start = start;
+      data.buffer_end   = info->cp;
+      data.failed       = FALSE;
+
+      pixel_region_init (&region, tiles,
+                         0, row * TILE_HEIGHT,
+                         width, MIN (n_rows * TILE_HEIGHT,
+                                     height - row * TILE_HEIGHT),
+                         TRUE);
+
+      pixel_regions_process_parallel ((PixelProcessorFunc) xcf_load_level_region,
+                                      &data, 1, &region);
+
+      g_free (buffer);
+
+      if (data.failed)
         {
-          tile_release (tile, TRUE);
-          return FALSE;
+          success = FALSE;
+          break;
         }
 
       /* To potentially save memory, we compare the
-       *  newly-fetched tile against the last one, and
+       *  newly-fetched tiles against the previous ones, and
        *  if they're the same we copy-on-write mirror one against
        *  the other.
        */
-      if (previous != NULL)
+      for (i = row * n_cols; i < (row + n_rows) * n_cols; i++)
         {
-          tile_lock (previous);
-          if (tile_ewidth (tile) == tile_ewidth (previous) &&
-              tile_eheight (tile) == tile_eheight (previous) &&
-              tile_bpp (tile) == tile_bpp (previous) &&
-              memcmp (tile_data_pointer (tile, 0, 0),
-                      tile_data_pointer (previous, 0, 0),
-                      tile_size (tile)) == 0)
-            tile_manager_map (tiles, i, previous);
-          tile_release (previous, FALSE);
-        }
-      tile_release (tile, TRUE);
-      previous = tile_manager_get (tiles, i, FALSE, FALSE);
-
-      /* restore the saved position so we'll be ready to
-       *  read the next offset.
-       */
-      if (!xcf_seek_pos (info, saved_pos, NULL))
-        return FALSE;
+          tile = tile_manager_get (tiles, i, TRUE, FALSE);
 
-      /* read in the offset of the next tile */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+          if (previous != NULL)
+            {
+              tile_lock (previous);
+              if (tile_ewidth (tile) == tile_ewidth (previous) &&
+                  tile_eheight (tile) == tile_eheight (previous) &&
+                  tile_bpp (tile) == tile_bpp (previous) &&
+                  memcmp (tile_data_pointer (tile, 0, 0),
+                          tile_data_pointer (previous, 0, 0),
+                          tile_size (tile)) == 0)
+                tile_manager_map (tiles, i, previous);
+              tile_release (previous, FALSE);
+            }
+          tile_release (tile, FALSE);
+          previous = tile_manager_get (tiles, i, FALSE, FALSE);
+        }
     }
 
-  if (offset != 0)
-    {
-      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
-                    "encountered garbage after reading level: %d", offset);
-      return FALSE;
-    }
+  /* restore the saved position so we'll be ready to
+   *  read the rest of the hierarchy.
+   */
+  if (! xcf_seek_pos (info, saved_pos, NULL))
+    success = FALSE;
 
-  return TRUE;
+ out:
+  g_free (offsets);
+  g_free (ends);
+
+  return success;
 }
 
-static gboolean
-xcf_load_tile (XcfInfo *info,
-               Tile    *tile)
+/*  Reads count file offsets, which take 8 bytes each in version 4
+ *  files and 4 bytes in older ones.
+ */
+static guint
+xcf_read_offset (XcfInfo *info,
+                 guint64 *data,
+                 gint     count)
 {
-  info->cp += xcf_read_int8 (info->fp, tile_data_pointer(tile, 0, 0),
-                             tile_size (tile));
+  guint32 *data32 = (guint32 *) data;
+  guint    total;
 
-  return TRUE;
+  if (info->bytes_per_offset == 8)
+    return xcf_read_int64 (info->fp, data, count);
+
+  /*  read the 32 bit offsets into the first half of data, then widen
+   *  them from the back so that none is overwritten before it is read
+   */
+  total = xcf_read_int32 (info->fp, data32, count);
+
+  while (count--)
+    data[count] = data32[count];
+
+  return total;
 }
 
-static gboolean
-xcf_load_tile_rle (XcfInfo *info,
-                   Tile    *tile,
-                   int     data_length)
+/*  Called from the pixel processor threads with one tile of the batch
+ *  at a time, the tile is locked for writing.
+ */
+static void
+xcf_load_level_region (XcfLevelData *data,
+                       PixelRegion  *region)
 {
-  guchar *data;
-  guchar val;
-  gint size;
-  gint count;
-  gint length;
-  gint bpp;
-  gint i, j;
-  gint nmemb_read_successfully;
-  guchar *xcfdata, *xcfodata, *xcfdatalimit;
+  Tile    *tile = region->curtile;
+  gint     i;
+  guint64  start;
+  guint64  end;
+  gint     length;
+
+  i = (region->y / TILE_HEIGHT) * data->n_cols + region->x / TILE_WIDTH;
+
+  start = data->offsets[i];
+  end   = data->ends[i];
 
   /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
    * this tile (return TRUE without storing data) as if it did not
@@ -1361,21 +1688,166 @@ xcf_load_tile_rle (XcfInfo *info,
    * skip the whole hierarchy while there may still be some valid
    * tiles in the file.
    */
-  if (data_length <= 0)
-    return TRUE;
+  if (end <= start)
+    return;
+
+  /* the data may have been cut short by the end of the file */
+  if (start < data->buffer_end)
+    length = MIN (end, data->buffer_end) - start;
+  else
+    length = 0;
+
+  if (! xcf_load_tile_data (data->compression, tile,
+                            data->buffer + (start - data->buffer_start),
+                            length))
+    data->failed = TRUE;
+}
 
-  data = tile_data_pointer (tile, 0, 0);
-  bpp = tile_bpp (tile);
+static gpointer
+xcf_load_source_ref (gpointer data)
+{
+  XcfTileSource *source = data;
+
+  g_atomic_int_inc (&source->ref_count);
+
+  return source;
+}
+
+static void
+xcf_load_source_unref (gpointer data)
+{
+  XcfTileSource *source = data;
+
+  if (g_atomic_int_dec_and_test (&source->ref_count))
+    {
+      xcf_file_unref (source->file);
+
+      g_free (source->offsets);
+      g_free (source->ends);
+
+      g_slice_free (XcfTileSource, source);
+    }
+}
+
+/*  The validate proc of lazily loaded levels, it reads and decodes
+ *  the tile's data. This may be called from any thread, with the
+ *  tile locked.
+ */
+static void
+xcf_load_source_tile (TileManager *tiles,
+                      Tile        *tile,
+                      gpointer     data)
+{
+  XcfTileSource *source = data;
+  guchar        *buffer = NULL;
+  guint64        start;
+  guint64        end;
+  gsize          length = 0;
+  gint           col;
+  gint           row;
+  gint           i;
+
+  tile_manager_get_tile_col_row (tiles, tile, &col, &row);
+
+  i = row * source->n_cols + col;
+
+  start = source->offsets[i];
+  end   = source->ends[i];
+
+  /* see xcf_load_level_region() for why this tile is skipped */
+  if (end <= start)
+    {
+      memset (tile_data_pointer (tile, 0, 0), 0, tile_size (tile));
+      return;
+    }
+
+  if (end - start <= G_MAXINT32)
+    buffer = g_try_malloc (end - start);
+
+  if (buffer)
+    length = xcf_file_read (source->file, start, buffer, end - start);
+
+  if (! buffer ||
+      ! xcf_load_tile_data (source->compression, tile, buffer, length))
+    {
+      xcf_file_set_error (source->file);
+
+      memset (tile_data_pointer (tile, 0, 0), 0, tile_size (tile));
+    }
 
-  xcfdata = xcfodata = g_malloc (data_length);
+  g_free (buffer);
+}
 
-  /* we have to use fread instead of xcf_read_* because we may be
-     reading past the end of the file here */
-  nmemb_read_successfully = fread ((gchar *) xcfdata, sizeof (gchar),
-                                   data_length, info->fp);
-  info->cp += nmemb_read_successfully;
+/*  Decodes data_length bytes of tile data, which may be less than the
+ *  tile needs if the file was cut short. This is called from the pixel
+ *  processor threads and must not touch the XcfInfo.
+ */
+static gboolean
+xcf_load_tile_data (XcfCompressionType  compression,
+                    Tile               *tile,
+                    const guchar       *xcfdata,
+                    gint                data_length)
+{
+  switch (compression)
+    {
+    case COMPRESS_NONE:
+      if (data_length > 0)
+        memcpy (tile_data_pointer (tile, 0, 0), xcfdata,
+                MIN (data_length, tile_size (tile)));
+      return TRUE;
+
+    case COMPRESS_RLE:
+      return xcf_load_tile_rle (tile, xcfdata, MAX (data_length, 0));
+
+    case COMPRESS_ZLIB:
+#ifdef HAVE_ZLIB
+      {
+        uLongf size = tile_size (tile);
+
+        return (data_length > 0 &&
+                uncompress (tile_data_pointer (tile, 0, 0), &size,
+                            xcfdata, data_length) == Z_OK &&
+                size == tile_size (tile));
+      }
+#else
+      return FALSE;
+#endif
+
+    case COMPRESS_LZ:
+      return (data_length > 0 &&
+              xcf_lz_decompress (xcfdata, data_length,
+                                 tile_data_pointer (tile, 0, 0),
+                                 tile_size (tile)));
+
+    case COMPRESS_FRACTAL:
+      g_error ("xcf: fractal compression unimplemented");
+      break;
+    }
+
+  return FALSE;
+}
+
+/*  Decodes data_length bytes of RLE data into the tile. This is
+ *  called from the pixel processor threads and must not touch
+ *  the XcfInfo.
+ */
+static gboolean
+xcf_load_tile_rle (Tile         *tile,
+                   const guchar *xcfdata,
+                   gint          data_length)
+{
+  guchar       *data;
+  guchar        val;
+  gint          size;
+  gint          count;
+  gint          length;
+  gint          bpp;
+  gint          i, j;
+  const guchar *xcfdatalimit;
+
+  bpp = tile_bpp (tile);
 
-  xcfdatalimit = &xcfodata[nmemb_read_successfully - 1];
+  xcfdatalimit = &xcfdata[data_length - 1];
 
   for (i = 0; i < bpp; i++)
     {
@@ -1463,12 +1935,9 @@ xcf_load_tile_rle (XcfInfo *info,
             }
         }
     }
-  g_free (xcfodata);
   return TRUE;
 
  bogus_rle:
-  if (xcfodata)
-    g_free (xcfodata);
   return FALSE;
 }
 
@@ -1615,7 +2084,7 @@ xcf_load_vectors (XcfInfo   *info,
   guint32      active_index;
   guint32      num_paths;
   GimpVectors *active_vectors;
-  guint32      base;
+  guint64      base;
 
 #ifdef GIMP_XCF_PATH_DEBUG
   g_printerr ("xcf_load_vectors\n");
@@ -1651,7 +2120,7 @@ xcf_load_vectors (XcfInfo   *info,
     gimp_image_set_active_vectors (image, active_vectors);
 
 #ifdef GIMP_XCF_PATH_DEBUG
-  g_printerr ("xcf_load_vectors: loaded %d bytes\n", info->cp - base);
+  g_printerr ("xcf_load_vectors: loaded %d bytes\n", (gint) (info->cp - base));
 #endif
   return TRUE;
 }
@@ -0,0 +1,290 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*  A simple and fast LZ77 codec for XCF tile data.
+ *
+ *  The compressed data is a sequence of literal runs, each one
+ *  followed by a back reference into the data already decompressed,
+ *  in the block format of LZ4:
+ *
+ *    token         high nibble: literal count, low nibble: match length - 4,
+ *                  a nibble of 15 continues in bytes added to it until
+ *                  a byte is below 255
+ *    literals
+ *    offset        two bytes, little endian, 1 to 65535
+ *
+ *  The last run has no back reference, and the last five bytes are
+ *  always literals.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "xcf-lz.h"
+
+
+#define HASH_BITS      12
+#define MIN_MATCH       4
+#define MAX_OFFSET  65535
+#define LAST_LITERALS   5    /*  the last bytes are always literals     */
+#define MATCH_LIMIT    12    /*  no match starts closer to the end      */
+
+
+static inline guint32
+xcf_lz_read32 (const guchar *p)
+{
+  guint32 v;
+
+  memcpy (&v, p, sizeof (v));
+
+  return v;
+}
+
+static inline guint
+xcf_lz_hash (guint32 v)
+{
+  return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static inline guchar *
+xcf_lz_write_length (guchar *op,
+                     gint    length)
+{
+  for (; length >= 255; length -= 255)
+    *op++ = 255;
+
+  *op++ = length;
+
+  return op;
+}
+
+static guchar *
+xcf_lz_write_sequence (guchar       *op,
+                       const guchar *literals,
+                       gint          n_literals,
+                       gint          offset,
+                       gint          match_length)
+{
+  guchar *token = op++;
+
+  if (n_literals >= 15)
+    {
+      *token = 15 << 4;
+      op = xcf_lz_write_length (op, n_literals - 15);
+    }
+  else
+    {
+      *token = n_literals << 4;
+    }
+
+  memcpy (op, literals, n_literals);
+  op += n_literals;
+
+  /*  the last sequence has no match  */
+  if (match_length == 0)
+    return op;
+
+  *op++ = offset & 0xff;
+  *op++ = offset >> 8;
+
+  match_length -= MIN_MATCH;
+
+  if (match_length >= 15)
+    {
+      *token |= 15;
+      op = xcf_lz_write_length (op, match_length - 15);
+    }
+  else
+    {
+      *token |= match_length;
+    }
+
+  return op;
+}
+
+/**
+ * xcf_lz_compress:
+ * @src:     the data to compress
+ * @src_len: the number of bytes in @src
+ * @dest:    a buffer of at least XCF_LZ_BOUND (@src_len) bytes
+ *
+ * Returns: the number of bytes written to @dest.
+ **/
+gint
+xcf_lz_compress (const guchar *src,
+                 gint          src_len,
+                 guchar       *dest)
+{
+  const guchar *end    = src + src_len;
+  const guchar *ip     = src;
+  const guchar *anchor = src;
+  guchar       *op     = dest;
+  gint          table[1 << HASH_BITS];
+
+  if (src_len > MATCH_LIMIT)
+    {
+      const guchar *match_limit = end - MATCH_LIMIT;
+      const guchar *copy_limit  = end - LAST_LITERALS;
+
+      memset (table, 0xff, sizeof (table));
+
+      while (ip < match_limit)
+        {
+          guint32       seq  = xcf_lz_read32 (ip);
+          guint         hash = xcf_lz_hash (seq);
+          gint          ref  = table[hash];
+          const guchar *match;
+          gint          length;
+
+          table[hash] = ip - src;
+
+          if (ref < 0                          ||
+              (ip - src) - ref > MAX_OFFSET    ||
+              xcf_lz_read32 (src + ref) != seq)
+            {
+              /*  skip ahead faster through data that doesn't compress  */
+              ip += 1 + ((ip - anchor) >> 6);
+              continue;
+            }
+
+          match = src + ref;
+
+          while (ip > anchor && match > src && ip[-1] == match[-1])
+            {
+              ip--;
+              match--;
+            }
+
+          for (length = MIN_MATCH;
+               ip + length < copy_limit && ip[length] == match[length];
+               length++);
+
+          op = xcf_lz_write_sequence (op, anchor, ip - anchor,
+                                      ip - match, length);
+
+          ip += length;
+          anchor = ip;
+        }
+    }
+
+  op = xcf_lz_write_sequence (op, anchor, end - anchor, 0, 0);
+
+  return op - dest;
+}
+
+static inline gboolean
+xcf_lz_read_length (const guchar **ip,
+                    const guchar  *end,
+                    gint          *length,
+                    gint           limit)
+{
+  guint b;
+
+  do
+    {
+      if (*ip >= end)
+        return FALSE;
+
+      b = *(*ip)++;
+      *length += b;
+
+      if (*length > limit)
+        return FALSE;
+    }
+  while (b == 255);
+
+  return TRUE;
+}
+
+/**
+ * xcf_lz_decompress:
+ * @src:      the compressed data
+ * @src_len:  the number of bytes in @src
+ * @dest:     the buffer to decompress to
+ * @dest_len: the number of bytes expected in @dest
+ *
+ * Decompresses @src until @dest_len bytes are produced, any data
+ * after that is ignored.
+ *
+ * Returns: %TRUE on success, %FALSE if @src is corrupt or too short.
+ **/
+gboolean
+xcf_lz_decompress (const guchar *src,
+                   gint          src_len,
+                   guchar       *dest,
+                   gint          dest_len)
+{
+  const guchar *ip   = src;
+  const guchar *iend = src + src_len;
+  guchar       *op   = dest;
+  guchar       *oend = dest + dest_len;
+
+  while (ip < iend)
+    {
+      const guchar *match;
+      guint         token  = *ip++;
+      gint          length = token >> 4;
+      gint          offset;
+
+      if (length == 15 &&
+          ! xcf_lz_read_length (&ip, iend, &length, dest_len))
+        return FALSE;
+
+      if (length > iend - ip || length > oend - op)
+        return FALSE;
+
+      memcpy (op, ip, length);
+      op += length;
+      ip += length;
+
+      /*  the last sequence has no match, the data after it isn't
+       *  ours
+       */
+      if (op == oend)
+        return TRUE;
+
+      if (iend - ip < 2)
+        return FALSE;
+
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+
+      if (offset == 0 || offset > op - dest)
+        return FALSE;
+
+      length = token & 15;
+
+      if (length == 15 &&
+          ! xcf_lz_read_length (&ip, iend, &length, dest_len))
+        return FALSE;
+
+      length += MIN_MATCH;
+
+      if (length > oend - op)
+        return FALSE;
+
+      /*  the match may overlap the bytes it produces  */
+      for (match = op - offset; length > 0; length--)
+        *op++ = *match++;
+    }
+
+  return FALSE;
+}
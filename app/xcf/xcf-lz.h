@@ -0,0 +1,36 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __XCF_LZ_H__
+#define __XCF_LZ_H__
+
+
+/*  The largest size the compressed data of src_len bytes can have  */
+#define XCF_LZ_BOUND(src_len) ((src_len) + (src_len) / 255 + 16)
+
+
+gint       xcf_lz_compress   (const guchar *src,
+                              gint          src_len,
+                              guchar       *dest);
+gboolean   xcf_lz_decompress (const guchar *src,
+                              gint          src_len,
+                              guchar       *dest,
+                              gint          dest_len);
+
+
+#endif  /* __XCF_LZ_H__ */
@@ -20,6 +20,19 @@
 #define __XCF_PRIVATE_H__
 
 
+/*  XCF files may be larger than 4GB, use 64 bit file positions  */
+#if defined (HAVE_FSEEKO)
+#define xcf_fseek(fp, pos, whence) fseeko ((fp), (off_t) (pos), (whence))
+#define xcf_ftell(fp)              ftello (fp)
+#elif defined (G_OS_WIN32)
+#define xcf_fseek(fp, pos, whence) _fseeki64 ((fp), (pos), (whence))
+#define xcf_ftell(fp)              _ftelli64 (fp)
+#else
+#define xcf_fseek(fp, pos, whence) fseek ((fp), (pos), (whence))
+#define xcf_ftell(fp)              ftell (fp)
+#endif
+
+
 typedef enum
 {
   PROP_END                =  0,
@@ -56,8 +69,9 @@ typedef enum
 {
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
-  COMPRESS_ZLIB              =  2,  /* unused */
-  COMPRESS_FRACTAL           =  3   /* unused */
+  COMPRESS_ZLIB              =  2,
+  COMPRESS_FRACTAL           =  3,  /* unused */
+  COMPRESS_LZ                =  4
 } XcfCompressionType;
 
 typedef enum
@@ -73,24 +87,29 @@ typedef enum
 } XcfStrokeType;
 
 typedef struct _XcfInfo  XcfInfo;
+typedef struct _XcfFile  XcfFile;
 
 struct _XcfInfo
 {
   Gimp               *gimp;
   GimpProgress       *progress;
   FILE               *fp;
-  guint               cp;
+  guint64             cp;
   const gchar        *filename;
   GimpTattoo          tattoo_state;
   GimpLayer          *active_layer;
   GimpChannel        *active_channel;
   GimpDrawable       *floating_sel_drawable;
   GimpLayer          *floating_sel;
-  guint               floating_sel_offset;
+  guint64             floating_sel_offset;
   gint                swap_num;
   gint               *ref_count;
   XcfCompressionType  compression;
   gint                file_version;
+  gint                bytes_per_offset;  /*  4, or 8 from version 4 on  */
+  GList              *mipmaps;           /*  scaled down levels to set  */
+  XcfFile            *file;              /*  to read tiles from later,
+                                          *  or NULL to read them now  */
 };
 
 
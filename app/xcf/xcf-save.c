@@ -23,14 +23,21 @@
 
 #include <glib-object.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
 
 #include "core/core-types.h"
 
+#include "base/pixel-processor.h"
+#include "base/pixel-region.h"
 #include "base/tile.h"
 #include "base/tile-manager.h"
 #include "base/tile-manager-private.h"
+#include "base/tile-pyramid.h"
 
 #include "core/gimp.h"
 #include "core/gimpchannel.h"
@@ -60,6 +67,7 @@
 #include "vectors/gimpvectors-compat.h"
 
 #include "xcf-private.h"
+#include "xcf-lz.h"
 #include "xcf-read.h"
 #include "xcf-save.h"
 #include "xcf-seek.h"
@@ -68,6 +76,26 @@
 #include "gimp-intl.h"
 
 
+/*  The tiles of a level are compressed in batches of whole tile rows
+ *  which need at most about this many bytes of compressed data. The
+ *  tiles of a batch are compressed by the pixel processor threads and
+ *  then written out in order.
+ */
+#define XCF_SAVE_BATCH_SIZE  (16 * 1024 * 1024)
+
+typedef struct _XcfLevelData XcfLevelData;
+
+struct _XcfLevelData
+{
+  XcfCompressionType  compression;
+  gint                n_cols;
+  gint                first_tile;  /*  the index of the batch's first tile  */
+  gint                max_size;    /*  bytes reserved for each tile         */
+  guchar             *buffer;      /*  the compressed tiles of the batch    */
+  gint               *lengths;     /*  the length of each compressed tile   */
+};
+
+
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
@@ -93,17 +121,19 @@ static gboolean xcf_save_channel       (XcfInfo           *info,
                                         GimpChannel       *channel,
                                         GError           **error);
 static gboolean xcf_save_hierarchy     (XcfInfo           *info,
-                                        TileManager       *tiles,
+                                        GimpDrawable      *drawable,
+                                        gboolean           mipmaps,
                                         GError           **error);
 static gboolean xcf_save_level         (XcfInfo           *info,
                                         TileManager       *tiles,
                                         GError           **error);
-static gboolean xcf_save_tile          (XcfInfo           *info,
-                                        Tile              *tile,
-                                        GError           **error);
-static gboolean xcf_save_tile_rle      (XcfInfo           *info,
-                                        Tile              *tile,
-                                        guchar            *rlebuf,
+static void     xcf_save_level_region  (XcfLevelData      *data,
+                                        PixelRegion       *region);
+static gint     xcf_save_tile_rle      (Tile              *tile,
+                                        guchar            *rlebuf);
+static guint    xcf_write_offset       (XcfInfo           *info,
+                                        const guint64     *data,
+                                        gint               count,
                                         GError           **error);
 static gboolean xcf_save_parasite      (XcfInfo           *info,
                                         GimpParasite      *parasite,
@@ -156,6 +186,15 @@ static gboolean xcf_save_vectors       (XcfInfo           *info,
     }                                                               \
   } G_STMT_END
 
+#define xcf_write_offset_check_error(info, data, count) G_STMT_START { \
+  info->cp += xcf_write_offset (info, data, count, &tmp_error); \
+  if (tmp_error)                                                \
+    {                                                           \
+      g_propagate_error (error, tmp_error);                     \
+      return FALSE;                                             \
+    }                                                           \
+  } G_STMT_END
+
 #define xcf_write_int32_print_error(info, data, count) G_STMT_START { \
   info->cp += xcf_write_int32 (info->fp, data, count, &error); \
   if (error)                                                   \
@@ -204,6 +243,18 @@ static gboolean xcf_save_vectors       (XcfInfo           *info,
     }                                                           \
   } G_STMT_END
 
+#define xcf_write_offset_print_error(info, data, count) G_STMT_START { \
+  info->cp += xcf_write_offset (info, data, count, &error); \
+  if (error)                                                \
+    {                                                       \
+      gimp_message (info->gimp, G_OBJECT (info->progress),  \
+                    GIMP_MESSAGE_ERROR,                     \
+                    _("Error saving XCF file: %s"),         \
+                    error->message);                        \
+      return FALSE;                                         \
+    }                                                       \
+  } G_STMT_END
+
 #define xcf_write_prop_type_check_error(info, prop_type) G_STMT_START { \
   guint32 _prop_int32 = prop_type;                     \
   xcf_write_int32_check_error (info, &_prop_int32, 1); \
@@ -239,12 +290,26 @@ static gboolean xcf_save_vectors       (XcfInfo           *info,
   } G_STMT_END
 
 
+/*  An upper limit of the size of the drawable's data in an XCF file,
+ *  assuming the worst case for compressed tiles. The scaled down levels
+ *  add up to another third of the pixels.
+ */
+static guint64
+xcf_save_estimate_size (GimpDrawable *drawable)
+{
+  GimpItem *item = GIMP_ITEM (drawable);
+
+  return ((guint64) gimp_item_width (item) * gimp_item_height (item) *
+          gimp_drawable_bytes (drawable) * 2 + 4096);
+}
+
 void
 xcf_save_choose_format (XcfInfo   *info,
                         GimpImage *image)
 {
   GimpLayer *layer;
   GList     *list;
+  guint64    size = 0;
 
   gint save_version = 0;                /* default to oldest */
 
@@ -272,7 +337,39 @@ xcf_save_choose_format (XcfInfo   *info,
         }
     }
 
-  info->file_version = save_version;
+  /* zlib and LZ compressed tiles are not supported by gimp-2.4 */
+  if (info->compression == COMPRESS_ZLIB ||
+      info->compression == COMPRESS_LZ)
+    save_version = 3;
+
+  /* files larger than 4GB need 64 bit offsets */
+  for (list = GIMP_LIST (image->layers)->list;
+       list;
+       list = g_list_next (list))
+    {
+      layer = GIMP_LAYER (list->data);
+
+      size += xcf_save_estimate_size (GIMP_DRAWABLE (layer));
+
+      if (layer->mask)
+        size += xcf_save_estimate_size (GIMP_DRAWABLE (layer->mask));
+    }
+
+  for (list = GIMP_LIST (image->channels)->list;
+       list;
+       list = g_list_next (list))
+    {
+      size += xcf_save_estimate_size (GIMP_DRAWABLE (list->data));
+    }
+
+  size += xcf_save_estimate_size (GIMP_DRAWABLE (gimp_image_get_mask (image)));
+
+  /* leave some room for everything else in the file */
+  if (size > G_MAXUINT32 - (16 << 20))
+    save_version = 4;
+
+  info->file_version     = save_version;
+  info->bytes_per_offset = (save_version >= 4) ? 8 : 4;
 }
 
 gint
@@ -283,8 +380,8 @@ xcf_save_image (XcfInfo   *info,
   GimpLayer   *floating_layer;
   GimpChannel *channel;
   GList       *list;
-  guint32      saved_pos;
-  guint32      offset;
+  guint64      saved_pos;
+  guint64      offset;
   guint32      value;
   guint        nlayers;
   guint        nchannels;
@@ -344,7 +441,8 @@ xcf_save_image (XcfInfo   *info,
 
   /* seek to after the offset lists */
   xcf_print_error (info, xcf_seek_pos (info,
-                                       info->cp + (nlayers + nchannels + 2) * 4,
+                                       info->cp + (nlayers + nchannels + 2) *
+                                       info->bytes_per_offset,
                                        &error));
 
   for (list = GIMP_LIST (image->layers)->list;
@@ -367,7 +465,7 @@ xcf_save_image (XcfInfo   *info,
        *  layer offset and write it out.
        */
       xcf_print_error (info, xcf_seek_pos (info, saved_pos, &error));
-      xcf_write_int32_print_error (info, &offset, 1);
+      xcf_write_offset_print_error (info, &offset, 1);
 
       /* increment the location we are to write out the
        *  next offset.
@@ -385,7 +483,7 @@ xcf_save_image (XcfInfo   *info,
    */
   offset = 0;
   xcf_print_error (info, xcf_seek_pos (info, saved_pos, &error));
-  xcf_write_int32_print_error (info, &offset, 1);
+  xcf_write_offset_print_error (info, &offset, 1);
   saved_pos = info->cp;
   xcf_print_error (info, xcf_seek_end (info, &error));
 
@@ -419,7 +517,7 @@ xcf_save_image (XcfInfo   *info,
        *  channel offset and write it out.
        */
       xcf_print_error (info, xcf_seek_pos (info, saved_pos, &error));
-      xcf_write_int32_print_error (info, &offset, 1);
+      xcf_write_offset_print_error (info, &offset, 1);
 
       /* increment the location we are to write out the
        *  next offset.
@@ -437,7 +535,7 @@ xcf_save_image (XcfInfo   *info,
    */
   offset = 0;
   xcf_print_error (info, xcf_seek_pos (info, saved_pos, &error));
-  xcf_write_int32_print_error (info, &offset, 1);
+  xcf_write_offset_print_error (info, &offset, 1);
   saved_pos = info->cp;
 
   if (floating_layer)
@@ -690,15 +788,15 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_FLOATING_SELECTION:
       {
-        guint32 dummy;
+        guint64 dummy;
 
         dummy = 0;
-        size = 4;
+        size = info->bytes_per_offset;
 
         xcf_write_prop_type_check_error (info, prop_type);
         xcf_write_int32_check_error (info, &size, 1);
         info->floating_sel_offset = info->cp;
-        xcf_write_int32_check_error (info, &dummy, 1);
+        xcf_write_offset_check_error (info, &dummy, 1);
       }
       break;
 
@@ -966,8 +1064,8 @@ xcf_save_prop (XcfInfo    *info,
     case PROP_PARASITES:
       {
         GimpParasiteList *list;
-        guint32           base, length;
-        long              pos;
+        guint64           base, pos;
+        guint32           length;
 
         list = va_arg (args, GimpParasiteList *);
 
@@ -1015,8 +1113,8 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_PATHS:
       {
-        guint32 base, length;
-        glong   pos;
+        guint64 base, pos;
+        guint32 length;
 
         xcf_write_prop_type_check_error (info, prop_type);
 
@@ -1081,8 +1179,8 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_VECTORS:
       {
-        guint32 base, length;
-        glong   pos;
+        guint64 base, pos;
+        guint32 length;
 
         xcf_write_prop_type_check_error (info, prop_type);
 
@@ -1136,8 +1234,8 @@ xcf_save_layer (XcfInfo    *info,
                 GimpLayer  *layer,
                 GError    **error)
 {
-  guint32  saved_pos;
-  guint32  offset;
+  guint64  saved_pos;
+  guint64  offset;
   guint32  value;
   GError  *tmp_error = NULL;
 
@@ -1148,7 +1246,7 @@ xcf_save_layer (XcfInfo    *info,
     {
       saved_pos = info->cp;
       xcf_check_error (xcf_seek_pos (info, info->floating_sel_offset, error));
-      xcf_write_int32_check_error (info, &saved_pos, 1);
+      xcf_write_offset_check_error (info, &saved_pos, 1);
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
     }
 
@@ -1173,14 +1271,16 @@ xcf_save_layer (XcfInfo    *info,
   saved_pos = info->cp;
 
   /* write out the layer tile hierarchy */
-  xcf_check_error (xcf_seek_pos (info, info->cp + 8, error));
+  xcf_check_error (xcf_seek_pos (info, info->cp + 2 * info->bytes_per_offset,
+                                 error));
   offset = info->cp;
 
-  xcf_check_error (xcf_save_hierarchy (info,
-                                       GIMP_DRAWABLE(layer)->tiles, error));
+  xcf_check_error (xcf_save_hierarchy (info, GIMP_DRAWABLE (layer),
+                                       ! gimp_drawable_is_indexed (GIMP_DRAWABLE (layer)),
+                                       error));
 
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
   saved_pos = info->cp;
 
   /* write out the layer mask */
@@ -1197,7 +1297,7 @@ xcf_save_layer (XcfInfo    *info,
     offset = 0;
 
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
 
   return TRUE;
 }
@@ -1208,8 +1308,8 @@ xcf_save_channel (XcfInfo      *info,
                   GimpChannel  *channel,
                   GError      **error)
 {
-  guint32 saved_pos;
-  guint32 offset;
+  guint64 saved_pos;
+  guint64 offset;
 
   GError *tmp_error = NULL;
 
@@ -1220,7 +1320,7 @@ xcf_save_channel (XcfInfo      *info,
     {
       saved_pos = info->cp;
       xcf_check_error (xcf_seek_pos (info, info->floating_sel_offset, error));
-      xcf_write_int32_check_error (info, &saved_pos, 1);
+      xcf_write_offset_check_error (info, &saved_pos, 1);
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
     }
 
@@ -1242,14 +1342,16 @@ xcf_save_channel (XcfInfo      *info,
   saved_pos = info->cp;
 
   /* write out the channel tile hierarchy */
-  xcf_check_error (xcf_seek_pos (info, info->cp + 4, error));
+  xcf_check_error (xcf_seek_pos (info, info->cp + info->bytes_per_offset,
+                                 error));
   offset = info->cp;
 
-  xcf_check_error (xcf_save_hierarchy (info,
-                                       GIMP_DRAWABLE (channel)->tiles, error));
+  xcf_check_error (xcf_save_hierarchy (info, GIMP_DRAWABLE (channel),
+                                       channel != gimp_image_get_mask (image),
+                                       error));
 
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
   saved_pos = info->cp;
 
   return TRUE;
@@ -1274,17 +1376,20 @@ xcf_calc_levels (gint size,
 
 static gboolean
 xcf_save_hierarchy (XcfInfo      *info,
-                    TileManager  *tiles,
+                    GimpDrawable *drawable,
+                    gboolean      mipmaps,
                     GError      **error)
 {
-  guint32 saved_pos;
-  guint32 offset;
-  guint32 width;
-  guint32 height;
-  guint32 bpp;
-  gint    i;
-  gint    nlevels;
-  gint    tmp1, tmp2;
+  TileManager *tiles = gimp_drawable_get_tiles (drawable);
+  TileManager *level = NULL;
+  guint64      saved_pos;
+  guint64      offset;
+  guint32      width;
+  guint32      height;
+  guint32      bpp;
+  gint         i;
+  gint         nlevels;
+  gint         tmp1, tmp2;
 
   GError *tmp_error = NULL;
 
@@ -1302,7 +1407,10 @@ xcf_save_hierarchy (XcfInfo      *info,
   tmp2 = xcf_calc_levels (height, TILE_HEIGHT);
   nlevels = MAX (tmp1, tmp2);
 
-  xcf_check_error (xcf_seek_pos (info, info->cp + (1 + nlevels) * 4, error));
+  xcf_check_error (xcf_seek_pos (info,
+                                 info->cp +
+                                 (1 + nlevels) * info->bytes_per_offset,
+                                 error));
 
   for (i = 0; i < nlevels; i++)
     {
@@ -1311,24 +1419,75 @@ xcf_save_hierarchy (XcfInfo      *info,
       if (i == 0)
         {
           /* write out the level. */
-          xcf_check_error (xcf_save_level (info, tiles, error));
+          if (! xcf_save_level (info, tiles, error))
+            goto error;
+        }
+      else if (mipmaps && width > 1 && height > 1)
+        {
+          TileManager *below = level ? level : tiles;
+          TileManager *next;
+
+          width  /= 2;
+          height /= 2;
+
+          /* write out the level below scaled down, the way the
+           *  projection's pyramid does it, so that the image can be
+           *  shown zoomed out without compositing it at full size.
+           *  Levels that were loaded with the drawable are still
+           *  valid as long as it wasn't changed.
+           */
+          next = gimp_drawable_get_mipmap (drawable, i);
+
+          if (next                               &&
+              tile_manager_width (next)  == width &&
+              tile_manager_height (next) == height)
+            {
+              tile_manager_ref (next);
+            }
+          else
+            {
+              next = tile_manager_new (width, height, bpp);
+              tile_pyramid_write_level (below, next);
+            }
+
+          if (level)
+            tile_manager_unref (level);
+
+          level = next;
+
+          if (! xcf_save_level (info, level, error))
+            goto error;
         }
       else
         {
+          guint64 zero = 0;
+
+          if (level)
+            {
+              tile_manager_unref (level);
+              level = NULL;
+            }
+
           /* fake an empty level */
-          tmp1 = 0;
           width  /= 2;
           height /= 2;
           xcf_write_int32_check_error (info, (guint32 *) &width,  1);
           xcf_write_int32_check_error (info, (guint32 *) &height, 1);
-          xcf_write_int32_check_error (info, (guint32 *) &tmp1,   1);
+          xcf_write_offset_check_error (info, &zero, 1);
         }
 
       /* seek back to where we are to write out the next
        *  level offset and write it out.
        */
-      xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
+      if (! xcf_seek_pos (info, saved_pos, error))
+        goto error;
+
+      info->cp += xcf_write_offset (info, &offset, 1, &tmp_error);
+      if (tmp_error)
+        {
+          g_propagate_error (error, tmp_error);
+          goto error;
+        }
 
       /* increment the location we are to write out the
        *  next offset.
@@ -1338,17 +1497,27 @@ xcf_save_hierarchy (XcfInfo      *info,
       /* seek to the end of the file which is where
        *  we will write out the next level.
        */
-      xcf_check_error (xcf_seek_end (info, error));
+      if (! xcf_seek_end (info, error))
+        goto error;
     }
 
+  if (level)
+    tile_manager_unref (level);
+
   /* write out a '0' offset position to indicate the end
    *  of the level offsets.
    */
   offset = 0;
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
 
   return TRUE;
+
+ error:
+  if (level)
+    tile_manager_unref (level);
+
+  return FALSE;
 }
 
 static gboolean
@@ -1356,13 +1525,17 @@ xcf_save_level (XcfInfo      *info,
                 TileManager  *level,
                 GError      **error)
 {
-  guint32  saved_pos;
-  guint32  offset;
-  guint32  width;
-  guint32  height;
-  guint    ntiles;
-  gint     i;
-  guchar  *rlebuf;
+  XcfLevelData  data;
+  PixelRegion   region;
+  guint64       saved_pos;
+  guint64      *offsets;
+  guint32       width;
+  guint32       height;
+  guint         ntiles;
+  gint          n_cols;
+  gint          n_rows;
+  gint          row;
+  gint          i;
 
   GError *tmp_error = NULL;
 
@@ -1374,99 +1547,191 @@ xcf_save_level (XcfInfo      *info,
 
   saved_pos = info->cp;
 
-  /* allocate a temporary buffer to store the rle data before it is
-     written to disk */
-  rlebuf =
-    g_malloc (TILE_WIDTH * TILE_HEIGHT * tile_manager_bpp (level) * 1.5);
+  /* a level that was never touched is empty, unless its validate
+   *  proc provides the tiles, as for levels loaded lazily
+   */
+  if (! level->tiles && ! level->validate_proc)
+    {
+      guint64 offset = 0;
 
-  if (level->tiles)
+      /* write out a '0' offset position to indicate the end
+       *  of the level offsets.
+       */
+      xcf_write_offset_check_error (info, &offset, 1);
+
+      return TRUE;
+    }
+
+  switch (info->compression)
     {
-      ntiles = level->ntile_rows * level->ntile_cols;
-      xcf_check_error (xcf_seek_pos (info, info->cp + (ntiles + 1) * 4, error));
+    case COMPRESS_NONE:
+    case COMPRESS_RLE:
+    case COMPRESS_LZ:
+      break;
+    case COMPRESS_ZLIB:
+#ifndef HAVE_ZLIB
+      g_error ("xcf: zlib compression unavailable");
+#endif
+      break;
+    case COMPRESS_FRACTAL:
+      g_error ("xcf: fractal compression unimplemented");
+      break;
+    }
 
-      for (i = 0; i < ntiles; i++)
-        {
-          /* save the start offset of where we are writing
-           *  out the next tile.
-           */
-          offset = info->cp;
+  n_cols = level->ntile_cols;
+  ntiles = level->ntile_rows * level->ntile_cols;
+
+  /* the tile offsets are collected here and written out in one go
+   *  once all tiles are written, the table ends with a '0' offset.
+   */
+  offsets = g_new0 (guint64, ntiles + 1);
+
+  data.compression = info->compression;
+  data.n_cols      = n_cols;
+
+  /* leave room for the compressed data of a tile to grow, the same
+   *  as the loader allows for. This is more than zlib and LZ need.
+   */
+  data.max_size = TILE_WIDTH * TILE_HEIGHT * tile_manager_bpp (level) * 1.5;
+
+  n_rows = MAX (1, XCF_SAVE_BATCH_SIZE / (data.max_size * n_cols));
+  n_rows = MIN (n_rows, level->ntile_rows);
+
+  data.buffer  = g_malloc (n_rows * n_cols * data.max_size);
+  data.lengths = g_new (gint, n_rows * n_cols);
+
+  if (! xcf_seek_pos (info, info->cp + (ntiles + 1) * info->bytes_per_offset,
+                      &tmp_error))
+    goto error;
+
+  for (row = 0; row < level->ntile_rows; row += n_rows)
+    {
+      gint rows = MIN (n_rows, level->ntile_rows - row);
+
+      data.first_tile = row * n_cols;
+
+      pixel_region_init (&region, level,
+                         0, row * TILE_HEIGHT,
+                         width, MIN (rows * TILE_HEIGHT,
+                                     height - row * TILE_HEIGHT),
+                         FALSE);
 
-          /* write out the tile. */
-          switch (info->compression)
+      pixel_regions_process_parallel ((PixelProcessorFunc) xcf_save_level_region,
+                                      &data, 1, &region);
+
+      /* write out the compressed tiles of the batch in order.
+       */
+      for (i = 0; i < rows * n_cols; i++)
+        {
+          if (data.lengths[i] < 0)
             {
-            case COMPRESS_NONE:
-              xcf_check_error(xcf_save_tile (info, level->tiles[i], error));
-              break;
-            case COMPRESS_RLE:
-              xcf_check_error (xcf_save_tile_rle (info, level->tiles[i],
-                               rlebuf, error));
-              break;
-            case COMPRESS_ZLIB:
-              g_error ("xcf: zlib compression unimplemented");
-              break;
-            case COMPRESS_FRACTAL:
-              g_error ("xcf: fractal compression unimplemented");
-              break;
+              g_set_error (&tmp_error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("Error compressing tile data"));
+              goto error;
             }
 
-          /* seek back to where we are to write out the next
-           *  tile offset and write it out.
-           */
-          xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-          xcf_write_int32_check_error (info, &offset, 1);
-
-          /* increment the location we are to write out the
-           *  next offset.
-           */
-          saved_pos = info->cp;
+          offsets[data.first_tile + i] = info->cp;
 
-          /* seek to the end of the file which is where
-           *  we will write out the next tile.
-           */
-          xcf_check_error (xcf_seek_end (info, error));
+          info->cp += xcf_write_int8 (info->fp,
+                                      data.buffer + i * data.max_size,
+                                      data.lengths[i], &tmp_error);
+          if (tmp_error)
+            goto error;
         }
     }
 
-  g_free (rlebuf);
-
-  /* write out a '0' offset position to indicate the end
-   *  of the level offsets.
+  /* seek back once to write out the tile offsets, then seek to the
+   *  end of the file where the hierarchy continues.
    */
-  offset = 0;
-  xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  if (! xcf_seek_pos (info, saved_pos, &tmp_error))
+    goto error;
+
+  info->cp += xcf_write_offset (info, offsets, ntiles + 1, &tmp_error);
+  if (tmp_error)
+    goto error;
+
+  g_free (data.buffer);
+  g_free (data.lengths);
+  g_free (offsets);
+
+  xcf_check_error (xcf_seek_end (info, error));
 
   return TRUE;
 
+ error:
+  g_free (data.buffer);
+  g_free (data.lengths);
+  g_free (offsets);
+
+  g_propagate_error (error, tmp_error);
+
+  return FALSE;
 }
 
-static gboolean
-xcf_save_tile (XcfInfo  *info,
-               Tile     *tile,
-               GError  **error)
+/*  Called from the pixel processor threads with one tile of the batch
+ *  at a time, the compressed tile goes to the tile's slot of the batch
+ *  buffer. A negative length marks a tile that failed to compress.
+ */
+static void
+xcf_save_level_region (XcfLevelData *data,
+                       PixelRegion  *region)
 {
-  GError *tmp_error = NULL;
+  Tile   *tile = region->curtile;
+  guchar *buf;
+  gint    i;
 
-  tile_lock (tile);
-  xcf_write_int8_check_error (info, tile_data_pointer (tile, 0, 0),
-                              tile_size (tile));
-  tile_release (tile, FALSE);
+  i = ((region->y / TILE_HEIGHT) * data->n_cols +
+       region->x / TILE_WIDTH - data->first_tile);
 
-  return TRUE;
+  buf = data->buffer + i * data->max_size;
+
+  switch (data->compression)
+    {
+    case COMPRESS_NONE:
+      memcpy (buf, tile_data_pointer (tile, 0, 0), tile_size (tile));
+      data->lengths[i] = tile_size (tile);
+      break;
+
+    case COMPRESS_RLE:
+      data->lengths[i] = xcf_save_tile_rle (tile, buf);
+      break;
+
+#ifdef HAVE_ZLIB
+    case COMPRESS_ZLIB:
+      {
+        uLongf length = data->max_size;
+
+        if (compress2 (buf, &length,
+                       tile_data_pointer (tile, 0, 0), tile_size (tile),
+                       Z_DEFAULT_COMPRESSION) == Z_OK)
+          data->lengths[i] = length;
+        else
+          data->lengths[i] = -1;
+      }
+      break;
+#endif
+
+    case COMPRESS_LZ:
+      data->lengths[i] = xcf_lz_compress (tile_data_pointer (tile, 0, 0),
+                                          tile_size (tile), buf);
+      break;
+
+    default:
+      g_assert_not_reached ();
+      break;
+    }
 }
 
-static gboolean
-xcf_save_tile_rle (XcfInfo  *info,
-                   Tile     *tile,
-                   guchar   *rlebuf,
-                   GError  **error)
+/*  RLE-compresses the locked tile into rlebuf and returns the number
+ *  of bytes used. This is called from the pixel processor threads.
+ */
+static gint
+xcf_save_tile_rle (Tile   *tile,
+                   guchar *rlebuf)
 {
-  GError *tmp_error = NULL;
-  gint    len       = 0;
-  gint    bpp;
-  gint    i, j;
-
-  tile_lock (tile);
+  gint len = 0;
+  gint bpp;
+  gint i, j;
 
   bpp = tile_bpp (tile);
 
@@ -1567,10 +1832,51 @@ xcf_save_tile_rle (XcfInfo  *info,
         g_message ("xcf: uh oh! xcf rle tile saving error: %d", count);
     }
 
-  xcf_write_int8_check_error (info, rlebuf, len);
-  tile_release (tile, FALSE);
+  return len;
+}
 
-  return TRUE;
+/*  Writes count file offsets, 8 bytes each in version 4 files and
+ *  4 bytes in older ones. Returns the number of bytes written.
+ */
+static guint
+xcf_write_offset (XcfInfo        *info,
+                  const guint64  *data,
+                  gint            count,
+                  GError        **error)
+{
+  guint32 buf[256];
+  guint   total = 0;
+  gint    i;
+
+  if (info->bytes_per_offset == 8)
+    return xcf_write_int64 (info->fp, data, count, error);
+
+  while (count > 0)
+    {
+      gint n = MIN (count, (gint) G_N_ELEMENTS (buf));
+
+      for (i = 0; i < n; i++)
+        {
+          if (data[i] > G_MAXUINT32)
+            {
+              g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("The file is too large for this XCF version"));
+              return total;
+            }
+
+          buf[i] = data[i];
+        }
+
+      total += xcf_write_int32 (info->fp, buf, n, error);
+
+      if (error && *error)
+        return total;
+
+      data  += n;
+      count -= n;
+    }
+
+  return total;
 }
 
 static gboolean
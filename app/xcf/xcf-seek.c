@@ -30,15 +30,16 @@
 
 #include "gimp-intl.h"
 
+
 gboolean
 xcf_seek_pos (XcfInfo  *info,
-              guint     pos,
+              guint64   pos,
               GError  **error)
 {
   if (info->cp != pos)
     {
       info->cp = pos;
-      if (fseek (info->fp, info->cp, SEEK_SET) == -1)
+      if (xcf_fseek (info->fp, info->cp, SEEK_SET) == -1)
         {
           g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
                        _("Could not seek in XCF file: %s"),
@@ -55,7 +56,7 @@ gboolean
 xcf_seek_end (XcfInfo  *info,
               GError  **error)
 {
-  if (fseek (info->fp, 0, SEEK_END) == -1)
+  if (xcf_fseek (info->fp, 0, SEEK_END) == -1)
     {
       g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
                    _("Could not seek in XCF file: %s"),
@@ -64,9 +65,9 @@ xcf_seek_end (XcfInfo  *info,
       return FALSE;
     }
 
-  info->cp = ftell (info->fp);
+  info->cp = xcf_ftell (info->fp);
 
-  if (fseek (info->fp, 0, SEEK_END) == -1)
+  if (xcf_fseek (info->fp, 0, SEEK_END) == -1)
     {
       g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
                    _("Could not seek in XCF file: %s"),
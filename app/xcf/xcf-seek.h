@@ -21,7 +21,7 @@
 
 
 gboolean   xcf_seek_pos (XcfInfo *info,
-                         guint    pos,
+                         guint64  pos,
                          GError **error);
 gboolean   xcf_seek_end (XcfInfo *info,
                          GError **error);
@@ -58,6 +58,35 @@ xcf_write_int32 (FILE           *fp,
   return count * 4;
 }
 
+guint
+xcf_write_int64 (FILE           *fp,
+                 const guint64  *data,
+                 gint            count,
+                 GError        **error)
+{
+  GError  *tmp_error = NULL;
+  gint     i;
+
+  if (count > 0)
+    {
+      for (i = 0; i < count; i++)
+        {
+          guint64  tmp = GUINT64_TO_BE (data[i]);
+
+          xcf_write_int8 (fp, (const guint8 *) &tmp, 8, &tmp_error);
+
+          if (tmp_error)
+            {
+              g_propagate_error (error, tmp_error);
+
+              return i * 8;
+            }
+        }
+    }
+
+  return count * 8;
+}
+
 guint
 xcf_write_float (FILE           *fp,
                  const gfloat   *data,
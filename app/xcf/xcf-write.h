@@ -24,6 +24,10 @@ guint   xcf_write_int32  (FILE           *fp,
                           const guint32  *data,
                           gint            count,
                           GError        **error);
+guint   xcf_write_int64  (FILE           *fp,
+                          const guint64  *data,
+                          gint            count,
+                          GError        **error);
 guint   xcf_write_float  (FILE           *fp,
                           const gfloat   *data,
                           gint            count,
@@ -29,6 +29,8 @@
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpparamspecs.h"
@@ -39,6 +41,7 @@
 
 #include "xcf.h"
 #include "xcf-private.h"
+#include "xcf-file.h"
 #include "xcf-load.h"
 #include "xcf-read.h"
 #include "xcf-save.h"
@@ -66,7 +69,9 @@ static GimpXcfLoaderFunc * const xcf_loaders[] =
 {
   xcf_load_image,   /* version 0 */
   xcf_load_image,   /* version 1 */
-  xcf_load_image    /* version 2 */
+  xcf_load_image,   /* version 2 */
+  xcf_load_image,   /* version 3 */
+  xcf_load_image    /* version 4 */
 };
 
 
@@ -260,6 +265,9 @@ xcf_load_invoker (GimpProcedure     *procedure,
       info.swap_num              = 0;
       info.ref_count             = NULL;
       info.compression           = COMPRESS_NONE;
+      info.bytes_per_offset      = 4;
+      info.mipmaps               = NULL;
+      info.file                  = NULL;
 
       if (progress)
         {
@@ -272,6 +280,10 @@ xcf_load_invoker (GimpProcedure     *procedure,
           g_free (name);
         }
 
+      /*  keep the file open and read the tiles when they are needed  */
+      if (gimp->config->xcf_lazy_loading)
+        info.file = xcf_file_open (gimp, filename);
+
       success = TRUE;
 
       info.cp += xcf_read_int8 (info.fp, (guint8 *) id, 14);
@@ -295,6 +307,10 @@ xcf_load_invoker (GimpProcedure     *procedure,
 
       if (success)
         {
+          /* version 4 files use 64 bit offsets */
+          if (info.file_version >= 4)
+            info.bytes_per_offset = 8;
+
           if (info.file_version >= 0 &&
               info.file_version < G_N_ELEMENTS (xcf_loaders))
             {
@@ -314,6 +330,14 @@ xcf_load_invoker (GimpProcedure     *procedure,
 
       fclose (info.fp);
 
+      if (info.file)
+        {
+          if (image)
+            xcf_file_set_image (info.file, image);
+
+          xcf_file_unref (info.file);
+        }
+
       if (progress)
         gimp_progress_end (progress);
     }
@@ -346,13 +370,18 @@ xcf_save_invoker (GimpProcedure     *procedure,
   GimpImage   *image;
   const gchar *filename;
   gboolean     success = FALSE;
+  GError      *error   = NULL;
 
   gimp_set_busy (gimp);
 
   image    = gimp_value_get_image (&args->values[1], gimp);
   filename = g_value_get_string (&args->values[3]);
 
-  info.fp = g_fopen (filename, "wb");
+  /*  images loaded from the file may still read their tiles from it  */
+  if (xcf_file_detach (gimp, filename, &error))
+    info.fp = g_fopen (filename, "wb");
+  else
+    info.fp = NULL;
 
   if (info.fp)
     {
@@ -368,6 +397,25 @@ xcf_save_invoker (GimpProcedure     *procedure,
       info.swap_num              = 0;
       info.ref_count             = NULL;
       info.compression           = COMPRESS_RLE;
+      info.bytes_per_offset      = 4;
+      info.mipmaps               = NULL;
+      info.file                  = NULL;
+
+      switch (gimp->config->xcf_compression)
+        {
+        case GIMP_XCF_COMPRESSION_RLE:
+          break;
+
+        case GIMP_XCF_COMPRESSION_ZLIB:
+#ifdef HAVE_ZLIB
+          info.compression = COMPRESS_ZLIB;
+#endif
+          break;
+
+        case GIMP_XCF_COMPRESSION_LZ:
+          info.compression = COMPRESS_LZ;
+          break;
+        }
 
       if (progress)
         {
@@ -395,6 +443,12 @@ xcf_save_invoker (GimpProcedure     *procedure,
       if (progress)
         gimp_progress_end (progress);
     }
+  else if (error)
+    {
+      gimp_message (gimp, G_OBJECT (progress), GIMP_MESSAGE_ERROR,
+                    "%s", error->message);
+      g_clear_error (&error);
+    }
   else
     {
       gimp_message (gimp, G_OBJECT (progress), GIMP_MESSAGE_ERROR,
@@ -105,7 +105,7 @@
 #include "gimpunitcache.h"
 
 
-#define TILE_MAP_SIZE (_tile_width * _tile_height * 4)
+#define TILE_MAP_SIZE (_tile_width * _tile_height * 4 * GP_SHM_N_TILES)
 
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
@@ -127,6 +127,13 @@ typedef enum
 void gimp_read_expect_msg   (GimpWireMessage *msg,
                              gint             type);
 
+G_GNUC_INTERNAL guchar * _gimp_shm_attach (gint      shm_ID,
+                                           gint      serial,
+                                           gsize     size,
+                                           gboolean  writable);
+G_GNUC_INTERNAL void     _gimp_shm_detach (guchar   *addr,
+                                           gsize     size);
+
 
 static void       gimp_close                   (void);
 static void       gimp_debug_stop              (void);
@@ -155,6 +162,12 @@ static void       gimp_single_message          (void);
 static gboolean   gimp_extension_read          (GIOChannel      *channel,
                                                 GIOCondition     condition,
                                                 gpointer         data);
+#if defined(USE_WIN32_SHM) || defined(USE_POSIX_SHM)
+static void       gimp_shm_get_name            (gchar          *name,
+                                                gsize           len,
+                                                gint            shm_ID,
+                                                gint            serial);
+#endif
 
 
 static GIOChannel *_readchannel  = NULL;
@@ -179,6 +192,7 @@ static gint           _gdisp_ID          = -1;
 static gchar         *_wm_class          = NULL;
 static gchar         *_display_name      = NULL;
 static gint           _monitor_number    = 0;
+static gboolean       _persistent        = FALSE;
 static const gchar   *progname           = NULL;
 
 static gchar          write_buffer[WRITE_BUFFER_SIZE];
@@ -950,6 +964,11 @@ gimp_run_procedure2 (const gchar     *name,
   proc_run.nparams = n_params;
   proc_run.params  = (GPParam *) params;
 
+  /*  the procedure must see the pixels written so far. Tiles that
+   *  were only fetched ahead are kept, like those in the tile cache
+   */
+  _gimp_tile_put_idle ();
+
   if (! gp_proc_run_write (_writechannel, &proc_run, NULL))
     gimp_quit ();
 
@@ -1075,6 +1094,94 @@ gimp_shm_addr (void)
   return _shm_addr;
 }
 
+/*  Attaches to a segment the core exported with
+ *  app/plug-in/gimppluginshm.c:gimp_plug_in_shm_new_export(). If
+ *  @writable is TRUE the mapping is private to the plug-in, writing
+ *  to it never changes what the core sees.
+ */
+guchar *
+_gimp_shm_attach (gint     shm_ID,
+                  gint     serial,
+                  gsize    size,
+                  gboolean writable)
+{
+  guchar *addr = NULL;
+
+#if defined(USE_SYSV_SHM)
+
+  /* the core releases the segment right after we attached, so it's
+   * ours alone even when attached for writing
+   */
+  addr = (guchar *) shmat (shm_ID, NULL, writable ? 0 : SHM_RDONLY);
+
+  if (addr == (guchar *) -1)
+    addr = NULL;
+
+#elif defined(USE_WIN32_SHM)
+
+  gchar  fileMapName[128];
+  HANDLE handle;
+
+  gimp_shm_get_name (fileMapName, sizeof (fileMapName), shm_ID, serial);
+
+  handle = OpenFileMapping (FILE_MAP_READ, 0, fileMapName);
+
+  if (handle)
+    {
+      addr = (guchar *) MapViewOfFile (handle,
+                                       writable ? FILE_MAP_COPY : FILE_MAP_READ,
+                                       0, 0, size);
+
+      /* the view keeps the mapping alive */
+      CloseHandle (handle);
+    }
+
+#elif defined(USE_POSIX_SHM)
+
+  gchar map_file[32];
+  gint  shm_fd;
+
+  gimp_shm_get_name (map_file, sizeof (map_file), shm_ID, serial);
+
+  shm_fd = shm_open (map_file, O_RDONLY, 0600);
+
+  if (shm_fd != -1)
+    {
+      addr = (guchar *) mmap (NULL, size,
+                              writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                              writable ? MAP_PRIVATE : MAP_SHARED,
+                              shm_fd, 0);
+
+      if (addr == MAP_FAILED)
+        addr = NULL;
+
+      close (shm_fd);
+    }
+
+#endif
+
+  return addr;
+}
+
+void
+_gimp_shm_detach (guchar *addr,
+                  gsize   size)
+{
+#if defined(USE_SYSV_SHM)
+
+  shmdt ((char *) addr);
+
+#elif defined(USE_WIN32_SHM)
+
+  UnmapViewOfFile (addr);
+
+#elif defined(USE_POSIX_SHM)
+
+  munmap (addr, size);
+
+#endif
+}
+
 /**
  * gimp_gamma:
  *
@@ -1387,6 +1494,32 @@ gimp_extension_process (guint timeout)
 #endif
 }
 
+/**
+ * gimp_plugin_set_persistent:
+ * @persistent: whether the plug-in should keep running
+ *
+ * Tells GIMP whether the plug-in may keep running after the procedure
+ * it was called for returned, so it can serve the following calls to
+ * its procedures without being started again. This saves the cost of
+ * starting a new process for every call, which matters when a plug-in
+ * is called many times in a row, for example from a batch script.
+ *
+ * Only call this from plug-ins that can run their procedures any
+ * number of times in one process. Global variables keep their values
+ * from one call to the next. GIMP shuts down plug-ins that were not
+ * called for a while, and limits how many of them it keeps running,
+ * see the plug-in-pool-size and plug-in-pool-timeout gimprc options.
+ *
+ * This has no effect on extensions and temporary procedures.
+ *
+ * Since: GIMP 2.6
+ **/
+void
+gimp_plugin_set_persistent (gboolean persistent)
+{
+  _persistent = persistent ? TRUE : FALSE;
+}
+
 /**
  * gimp_attach_new_parasite:
  * @name: the name of the #GimpParasite to create and attach.
@@ -1648,6 +1781,11 @@ gimp_loop (void)
 
         case GP_PROC_RUN:
           gimp_proc_run (msg.data);
+
+          /*  a persistent plug-in waits for the next call  */
+          if (_persistent)
+            break;
+
           gimp_wire_destroy (&msg);
           gimp_close ();
           return;
@@ -1709,6 +1847,11 @@ gimp_config (GPConfig *config)
   _show_help_button = config->show_help_button ? TRUE : FALSE;
   _min_colors       = config->min_colors;
   _gdisp_ID         = config->gdisp_ID;
+
+  /*  a persistent plug-in is configured again for every call  */
+  g_free (_wm_class);
+  g_free (_display_name);
+
   _wm_class         = g_strdup (config->wm_class);
   _display_name     = g_strdup (config->display_name);
   _monitor_number   = config->monitor_number;
@@ -1718,7 +1861,7 @@ gimp_config (GPConfig *config)
 
   gimp_cpu_accel_set_use (config->use_cpu_accel);
 
-  if (_shm_ID != -1)
+  if (_shm_ID != -1 && ! _shm_addr)
     {
 #if defined(USE_SYSV_SHM)
 
@@ -1739,7 +1882,7 @@ gimp_config (GPConfig *config)
       gchar fileMapName[128];
 
       /* From the id, derive the file map name */
-      g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d.SHM", _shm_ID);
+      gimp_shm_get_name (fileMapName, sizeof (fileMapName), _shm_ID, 0);
 
       /* Open the file mapping */
       shm_handle = OpenFileMapping (FILE_MAP_ALL_ACCESS,
@@ -1772,7 +1915,7 @@ gimp_config (GPConfig *config)
       gint  shm_fd;
 
       /* From the id, derive the file map name */
-      g_snprintf (map_file, sizeof (map_file), "/gimp-shm-%d", _shm_ID);
+      gimp_shm_get_name (map_file, sizeof (map_file), _shm_ID, 0);
 
       /* Open the file mapping */
       shm_fd = shm_open (map_file, O_RDWR, 0600);
@@ -1803,6 +1946,31 @@ gimp_config (GPConfig *config)
     }
 }
 
+#if defined(USE_WIN32_SHM) || defined(USE_POSIX_SHM)
+
+/*  keep in sync with app/plug-in/gimppluginshm.c:gimp_plug_in_shm_get_name()
+ */
+static void
+gimp_shm_get_name (gchar *name,
+                   gsize  len,
+                   gint   shm_ID,
+                   gint   serial)
+{
+#if defined(USE_WIN32_SHM)
+  if (serial)
+    g_snprintf (name, len, "GIMP%d-%d.SHM", shm_ID, serial);
+  else
+    g_snprintf (name, len, "GIMP%d.SHM", shm_ID);
+#else
+  if (serial)
+    g_snprintf (name, len, "/gimp-shm-%d-%d", shm_ID, serial);
+  else
+    g_snprintf (name, len, "/gimp-shm-%d", shm_ID);
+#endif
+}
+
+#endif
+
 static void
 gimp_proc_run (GPProcRun *proc_run)
 {
@@ -1822,6 +1990,11 @@ gimp_proc_run (GPProcRun *proc_run)
       proc_return.nparams = n_return_vals;
       proc_return.params  = (GPParam *) return_vals;
 
+      _gimp_tile_flush_idle ();
+
+      if (_persistent && ! gp_persistent_write (_writechannel, NULL))
+        gimp_quit ();
+
       if (! gp_proc_return_write (_writechannel, &proc_return, NULL))
         gimp_quit ();
     }
@@ -1852,6 +2025,8 @@ gimp_temp_proc_run (GPProcRun *proc_run)
       proc_return.nparams = n_return_vals;
       proc_return.params  = (GPParam *) return_vals;
 
+      _gimp_tile_flush_idle ();
+
       if (! gp_temp_proc_return_write (_writechannel, &proc_return, NULL))
         gimp_quit ();
     }
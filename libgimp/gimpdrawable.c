@@ -21,6 +21,12 @@
 
 #include "config.h"
 
+#include <glib-object.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+#include "libgimpbase/gimpwire.h"
+
 #include "gimp.h"
 
 
@@ -28,6 +34,31 @@
 #define TILE_HEIGHT gimp_tile_height()
 
 
+typedef struct _GimpDrawableMapping GimpDrawableMapping;
+
+struct _GimpDrawableMapping
+{
+  guchar   **rows;
+  guchar    *addr;
+  gsize      size;
+  gboolean   shm;
+};
+
+
+void                     gimp_read_expect_msg (GimpWireMessage *msg,
+                                               gint             type);
+
+G_GNUC_INTERNAL guchar * _gimp_shm_attach     (gint             shm_ID,
+                                               gint             serial,
+                                               gsize            size,
+                                               gboolean         writable);
+G_GNUC_INTERNAL void     _gimp_shm_detach     (guchar          *addr,
+                                               gsize            size);
+
+
+static GSList *mappings = NULL;
+
+
 /**
  * gimp_drawable_get:
  * @drawable_ID: the ID of the drawable
@@ -120,6 +151,9 @@ gimp_drawable_flush (GimpDrawable *drawable)
 
   g_return_if_fail (drawable != NULL);
 
+  /*  nuke all references to this drawable from the cache  */
+  _gimp_tile_cache_flush_drawable (drawable);
+
   if (drawable->tiles)
     {
       tiles   = drawable->tiles;
@@ -140,8 +174,10 @@ gimp_drawable_flush (GimpDrawable *drawable)
           gimp_tile_flush (&tiles[i]);
     }
 
-  /*  nuke all references to this drawable from the cache  */
-  _gimp_tile_cache_flush_drawable (drawable);
+  /*  send back what the cache released, and drop tiles that were
+   *  fetched ahead of time
+   */
+  _gimp_tile_flush_idle ();
 }
 
 GimpTile *
@@ -226,6 +262,153 @@ gimp_drawable_get_tile2 (GimpDrawable *drawable,
   return gimp_drawable_get_tile (drawable, shadow, row, col);
 }
 
+/**
+ * gimp_drawable_map:
+ * @drawable: The #GimpDrawable to map
+ * @writable: whether the returned rows may be written to
+ *
+ * Maps the pixels of @drawable into the plug-in's memory in one go and
+ * returns a pointer to each of its rows, each row holding
+ * @drawable->width * @drawable->bpp bytes. This avoids requesting the
+ * drawable tile by tile and is meant for plug-ins that read the whole
+ * drawable, like histograms or color analysis.
+ *
+ * The rows are a snapshot of the drawable taken when this function is
+ * called, any data held in the tiles of @drawable is flushed to the
+ * core first. If @writable is %TRUE, the rows may be modified, but the
+ * changes only ever affect the plug-in's copy. Use a #GimpPixelRgn to
+ * write to the drawable.
+ *
+ * When shared memory is not available, the pixels are transferred
+ * using the tile protocol instead.
+ *
+ * Return value: an array of @drawable->height row pointers, release it
+ *               using gimp_drawable_unmap()
+ *
+ * Since: GIMP 2.6
+ **/
+guchar **
+gimp_drawable_map (GimpDrawable *drawable,
+                   gboolean      writable)
+{
+  extern GIOChannel   *_writechannel;
+
+  GimpDrawableMapping *mapping;
+  GPDrawableMap        drawable_map;
+  GPDrawableMap       *reply;
+  GimpWireMessage      msg;
+  gsize                rowstride;
+  guint                y;
+
+  g_return_val_if_fail (drawable != NULL, NULL);
+
+  gimp_drawable_flush (drawable);
+
+  drawable_map.drawable_ID = drawable->drawable_id;
+  drawable_map.shm_ID      = -1;
+  drawable_map.serial      = 0;
+  drawable_map.width       = 0;
+  drawable_map.height      = 0;
+  drawable_map.bpp         = 0;
+  drawable_map.rowstride   = 0;
+
+  if (! gp_drawable_map_write (_writechannel, &drawable_map, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_DRAWABLE_MAP);
+
+  reply = msg.data;
+
+  if (reply->drawable_ID != drawable->drawable_id ||
+      reply->width       != drawable->width       ||
+      reply->height      != drawable->height      ||
+      reply->bpp         != drawable->bpp)
+    {
+      g_message ("received mapping for wrong drawable");
+      gimp_quit ();
+    }
+
+  mapping = g_slice_new0 (GimpDrawableMapping);
+
+  rowstride     = reply->rowstride;
+  mapping->size = rowstride * reply->height;
+
+  if (reply->shm_ID != -1)
+    {
+      mapping->addr = _gimp_shm_attach (reply->shm_ID, reply->serial,
+                                        mapping->size, writable);
+      mapping->shm  = (mapping->addr != NULL);
+
+      /*  let the core release its side of the segment  */
+      if (! gp_tile_ack_write (_writechannel, NULL))
+        gimp_quit ();
+    }
+
+  gimp_wire_destroy (&msg);
+
+  if (! mapping->shm)
+    {
+      GimpPixelRgn rgn;
+
+      rowstride     = drawable->width * drawable->bpp;
+      mapping->addr = g_malloc (rowstride * drawable->height);
+
+      gimp_pixel_rgn_init (&rgn, drawable,
+                           0, 0, drawable->width, drawable->height,
+                           FALSE, FALSE);
+      gimp_pixel_rgn_get_rect (&rgn, mapping->addr,
+                               0, 0, drawable->width, drawable->height);
+    }
+
+  mapping->rows = g_new (guchar *, drawable->height);
+
+  for (y = 0; y < drawable->height; y++)
+    mapping->rows[y] = mapping->addr + y * rowstride;
+
+  mappings = g_slist_prepend (mappings, mapping);
+
+  return mapping->rows;
+}
+
+/**
+ * gimp_drawable_unmap:
+ * @rows: the row pointers returned by gimp_drawable_map()
+ *
+ * Releases the memory mapped by gimp_drawable_map(). You must not
+ * access the rows after having called this function.
+ *
+ * Since: GIMP 2.6
+ **/
+void
+gimp_drawable_unmap (guchar **rows)
+{
+  GSList *list;
+
+  g_return_if_fail (rows != NULL);
+
+  for (list = mappings; list; list = g_slist_next (list))
+    {
+      GimpDrawableMapping *mapping = list->data;
+
+      if (mapping->rows == rows)
+        {
+          mappings = g_slist_delete_link (mappings, list);
+
+          if (mapping->shm)
+            _gimp_shm_detach (mapping->addr, mapping->size);
+          else
+            g_free (mapping->addr);
+
+          g_free (mapping->rows);
+          g_slice_free (GimpDrawableMapping, mapping);
+
+          return;
+        }
+    }
+
+  g_return_if_reached ();
+}
+
 void
 gimp_drawable_get_color_uchar (gint32         drawable_ID,
                                const GimpRGB *color,
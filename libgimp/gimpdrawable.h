@@ -52,6 +52,10 @@ GimpTile     * gimp_drawable_get_tile2              (GimpDrawable  *drawable,
                                                      gint           x,
                                                      gint           y);
 
+guchar      ** gimp_drawable_map                    (GimpDrawable  *drawable,
+                                                     gboolean       writable);
+void           gimp_drawable_unmap                  (guchar       **rows);
+
 void           gimp_drawable_get_color_uchar        (gint32         drawable_ID,
                                                      const GimpRGB *color,
                                                      guchar        *color_uchar);
@@ -233,6 +233,8 @@ gimp_pixel_rgn_get_row (GimpPixelRgn *pr,
 
   end = x + width;
 
+  _gimp_tile_prefetch (pr->drawable, pr->shadow, x, y, width, 1);
+
   while (x < end)
     {
       GimpTile     *tile;
@@ -290,6 +292,8 @@ gimp_pixel_rgn_get_col (GimpPixelRgn *pr,
 
   end = y + height;
 
+  _gimp_tile_prefetch (pr->drawable, pr->shadow, x, y, 1, height);
+
   while (y < end)
     {
       GimpTile     *tile;
@@ -369,6 +373,9 @@ gimp_pixel_rgn_get_rect (GimpPixelRgn *pr,
     {
       x = xstart;
 
+      /*  fetch the whole row of tiles at once  */
+      _gimp_tile_prefetch (pr->drawable, pr->shadow, xstart, y, width, 1);
+
       while (x < xend)
         {
           GimpTile *tile;
@@ -472,6 +479,8 @@ gimp_pixel_rgn_set_row (GimpPixelRgn *pr,
 
   end = x + width;
 
+  _gimp_tile_prefetch (pr->drawable, pr->shadow, x, y, width, 1);
+
   while (x < end)
     {
       tile = gimp_drawable_get_tile2 (pr->drawable, pr->shadow, x, y);
@@ -523,6 +532,8 @@ gimp_pixel_rgn_set_col (GimpPixelRgn *pr,
 
   end = y + height;
 
+  _gimp_tile_prefetch (pr->drawable, pr->shadow, x, y, 1, height);
+
   while (y < end)
     {
       GimpTile *tile;
@@ -603,6 +614,8 @@ gimp_pixel_rgn_set_rect (GimpPixelRgn *pr,
     {
       x = xstart;
 
+      _gimp_tile_prefetch (pr->drawable, pr->shadow, xstart, y, width, 1);
+
       while (x < xend)
         {
           GimpTile *tile;
@@ -889,6 +902,9 @@ gimp_pixel_rgns_configure (GimpPixelRgnIterator *pri)
   if (pri->portion_width  == 0 ||
       pri->portion_height == 0)
     {
+      /*  send back the tiles that were written  */
+      _gimp_tile_flush_idle ();
+
       /*  free the pixel regions list  */
       for (list = pri->pixel_regions; list; list = list->next)
         g_slice_free (GimpPixelRgnHolder, list->data);
@@ -933,6 +949,13 @@ gimp_pixel_rgn_configure (GimpPixelRgnHolder   *prh,
                                       prh->pr->shadow,
                                       prh->pr->x,
                                       prh->pr->y);
+
+      /*  fetch the rest of the region's row of tiles along with it  */
+      if (! tile->data)
+        _gimp_tile_prefetch (prh->pr->drawable, prh->pr->shadow,
+                             prh->pr->x, prh->pr->y,
+                             prh->startx + pri->region_width - prh->pr->x, 1);
+
       gimp_tile_ref (tile);
 
       offx = prh->pr->x % TILE_WIDTH;
@@ -38,12 +38,22 @@
  */
 #define FREE_QUANTUM 0.1
 
+/*  The number of tiles that travel in one batch, half of the shared
+ *  memory ring.
+ */
+#define BATCH_SIZE   (GP_SHM_N_TILES / 2)
+
 
 void         gimp_read_expect_msg   (GimpWireMessage *msg,
                                      gint             type);
 
 static void  gimp_tile_get          (GimpTile        *tile);
-static void  gimp_tile_put          (GimpTile        *tile);
+static void  gimp_tile_get_tiles    (GimpDrawable    *drawable,
+                                     gboolean         shadow,
+                                     guint32         *tile_nums,
+                                     gint             n_tiles);
+static void  gimp_tile_put_tiles    (GimpTile       **tiles,
+                                     gint             n_tiles);
 static void  gimp_tile_cache_insert (GimpTile        *tile);
 static void  gimp_tile_cache_flush  (GimpTile        *tile);
 
@@ -57,6 +67,12 @@ static gulong       max_tile_size   = 0;
 static gulong       cur_cache_size  = 0;
 static gulong       max_cache_size  = 0;
 
+/*  unreferenced tiles that still have data, either fetched ahead of
+ *  time or dirty and waiting to be sent back in a batch
+ */
+static GList      * idle_tiles      = NULL;
+static gint         n_idle_dirty    = 0;
+
 
 /*  public functions  */
 
@@ -69,8 +85,18 @@ gimp_tile_ref (GimpTile *tile)
 
   if (tile->ref_count == 1)
     {
-      gimp_tile_get (tile);
-      tile->dirty = FALSE;
+      if (tile->data)
+        {
+          idle_tiles = g_list_remove (idle_tiles, tile);
+
+          if (tile->dirty)
+            n_idle_dirty--;
+        }
+      else
+        {
+          gimp_tile_get (tile);
+          tile->dirty = FALSE;
+        }
     }
 
   gimp_tile_cache_insert (tile);
@@ -84,7 +110,23 @@ gimp_tile_ref_zero (GimpTile *tile)
   tile->ref_count++;
 
   if (tile->ref_count == 1)
-    tile->data = g_new0 (guchar, tile->ewidth * tile->eheight * tile->bpp);
+    {
+      gsize size = tile->ewidth * tile->eheight * tile->bpp;
+
+      if (tile->data)
+        {
+          idle_tiles = g_list_remove (idle_tiles, tile);
+
+          if (tile->dirty)
+            n_idle_dirty--;
+
+          memset (tile->data, 0, size);
+        }
+      else
+        {
+          tile->data = g_new0 (guchar, size);
+        }
+    }
 
   gimp_tile_cache_insert (tile);
 }
@@ -101,9 +143,19 @@ gimp_tile_unref (GimpTile *tile,
 
   if (tile->ref_count == 0)
     {
-      gimp_tile_flush (tile);
-      g_free (tile->data);
-      tile->data = NULL;
+      if (tile->dirty)
+        {
+          /*  send it back later, together with others  */
+          idle_tiles = g_list_prepend (idle_tiles, tile);
+
+          if (++n_idle_dirty >= GP_SHM_N_TILES)
+            _gimp_tile_put_idle ();
+        }
+      else
+        {
+          g_free (tile->data);
+          tile->data = NULL;
+        }
     }
 }
 
@@ -114,8 +166,15 @@ gimp_tile_flush (GimpTile *tile)
 
   if (tile->data && tile->dirty)
     {
-      gimp_tile_put (tile);
-      tile->dirty = FALSE;
+      if (tile->ref_count == 0)
+        {
+          _gimp_tile_put_idle ();
+        }
+      else
+        {
+          gimp_tile_put_tiles (&tile, 1);
+          tile->dirty = FALSE;
+        }
     }
 }
 
@@ -174,6 +233,115 @@ _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
     }
 }
 
+/*  Fetches the tiles covering the given area that are not in memory
+ *  yet, all in one request. They are kept until they are referenced
+ *  or _gimp_tile_flush_idle() is called.
+ */
+void
+_gimp_tile_prefetch (GimpDrawable *drawable,
+                     gboolean      shadow,
+                     gint          x,
+                     gint          y,
+                     gint          width,
+                     gint          height)
+{
+  guint32 *tile_nums;
+  gint     col1, col2;
+  gint     row1, row2;
+  gint     row, col;
+  gint     n_tiles = 0;
+
+  g_return_if_fail (drawable != NULL);
+
+  if (width <= 0 || height <= 0)
+    return;
+
+  col1 = x / gimp_tile_width ();
+  col2 = (x + width - 1) / gimp_tile_width ();
+  row1 = y / gimp_tile_height ();
+  row2 = (y + height - 1) / gimp_tile_height ();
+
+  tile_nums = g_new (guint32, (col2 - col1 + 1) * (row2 - row1 + 1));
+
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      {
+        GimpTile *tile = gimp_drawable_get_tile (drawable, shadow, row, col);
+
+        if (! tile->data)
+          tile_nums[n_tiles++] = tile->tile_num;
+      }
+
+  /*  a single tile is fetched when it is referenced  */
+  if (n_tiles > 1)
+    gimp_tile_get_tiles (drawable, shadow, tile_nums, n_tiles);
+
+  g_free (tile_nums);
+}
+
+/*  Sends all dirty idle tiles back to the core and forgets the data
+ *  of the others, which may be outdated after this.
+ */
+void
+_gimp_tile_flush_idle (void)
+{
+  GList *list;
+
+  _gimp_tile_put_idle ();
+
+  for (list = idle_tiles; list; list = g_list_next (list))
+    {
+      GimpTile *tile = list->data;
+
+      g_free (tile->data);
+      tile->data = NULL;
+    }
+
+  g_list_free (idle_tiles);
+  idle_tiles = NULL;
+}
+
+/*  Sends the dirty idle tiles back to the core and frees them. The
+ *  clean ones are kept. This does nothing if no tile is dirty.
+ */
+void
+_gimp_tile_put_idle (void)
+{
+  GimpTile **tiles;
+  GList     *list;
+  gint       n_tiles = 0;
+
+  if (n_idle_dirty == 0)
+    return;
+
+  tiles = g_new (GimpTile *, n_idle_dirty);
+
+  for (list = idle_tiles; list; list = g_list_next (list))
+    {
+      GimpTile *tile = list->data;
+
+      if (tile->dirty)
+        tiles[n_tiles++] = tile;
+    }
+
+  gimp_tile_put_tiles (tiles, n_tiles);
+
+  while (n_tiles--)
+    {
+      GimpTile *tile = tiles[n_tiles];
+
+      idle_tiles = g_list_remove (idle_tiles, tile);
+
+      g_free (tile->data);
+      tile->data  = NULL;
+      tile->dirty = FALSE;
+    }
+
+  n_idle_dirty = 0;
+
+  g_free (tiles);
+}
+
 
 /*  private functions  */
 
@@ -224,50 +392,205 @@ gimp_tile_get (GimpTile *tile)
   gimp_wire_destroy (&msg);
 }
 
+/*  Fetches n_tiles tiles of a drawable. The core sends them in batches
+ *  and each batch is acknowledged as soon as it is copied out of the
+ *  shared memory.
+ */
 static void
-gimp_tile_put (GimpTile *tile)
+gimp_tile_get_tiles (GimpDrawable *drawable,
+                     gboolean      shadow,
+                     guint32      *tile_nums,
+                     gint          n_tiles)
 {
   extern GIOChannel *_writechannel;
 
-  GPTileReq        tile_req;
-  GPTileData       tile_data;
-  GPTileData      *tile_info;
-  GimpWireMessage  msg;
+  GPTilesReq  tiles_req;
+  gint        received = 0;
 
-  tile_req.drawable_ID = -1;
-  tile_req.tile_num    = 0;
-  tile_req.shadow      = 0;
+  tiles_req.drawable_ID = drawable->drawable_id;
+  tiles_req.shadow      = shadow;
+  tiles_req.n_tiles     = n_tiles;
+  tiles_req.tile_nums   = tile_nums;
 
-  if (! gp_tile_req_write (_writechannel, &tile_req, NULL))
+  if (! gp_tiles_req_write (_writechannel, &tiles_req, NULL))
     gimp_quit ();
 
-  gimp_read_expect_msg (&msg, GP_TILE_DATA);
+  while (received < n_tiles)
+    {
+      GimpWireMessage  msg;
+      GPTilesData     *tiles_data;
+      const guchar    *src;
+      gsize            length;
+      gint             i;
+
+      gimp_read_expect_msg (&msg, GP_TILES_DATA);
+
+      tiles_data = msg.data;
+      if (tiles_data->drawable_ID != drawable->drawable_id ||
+          tiles_data->shadow      != shadow                ||
+          tiles_data->n_tiles     == 0                     ||
+          tiles_data->n_tiles     >  n_tiles - received)
+        {
+          g_message ("received tile info did not match computed tile info");
+          gimp_quit ();
+        }
 
-  tile_info = msg.data;
-
-  tile_data.drawable_ID = tile->drawable->drawable_id;
-  tile_data.tile_num    = tile->tile_num;
-  tile_data.shadow      = tile->shadow;
-  tile_data.bpp         = tile->bpp;
-  tile_data.width       = tile->ewidth;
-  tile_data.height      = tile->eheight;
-  tile_data.use_shm     = tile_info->use_shm;
-  tile_data.data        = NULL;
-
-  if (tile_info->use_shm)
-    memcpy (gimp_shm_addr (),
-            tile->data,
-            tile->ewidth * tile->eheight * tile->bpp);
-  else
-    tile_data.data = tile->data;
+      if (tiles_data->use_shm)
+        src = gimp_shm_addr () + tiles_data->shm_offset;
+      else
+        src = tiles_data->data;
 
-  if (! gp_tile_data_write (_writechannel, &tile_data, NULL))
-    gimp_quit ();
+      length = tiles_data->length;
 
-  gimp_wire_destroy (&msg);
+      for (i = 0; i < tiles_data->n_tiles; i++, received++)
+        {
+          GimpTile *tile;
+          guint     num = tiles_data->tile_nums[i];
+          gsize     size;
+
+          if (num != tile_nums[received])
+            {
+              g_message ("received tile info did not match computed tile info");
+              gimp_quit ();
+            }
+
+          tile = gimp_drawable_get_tile (drawable, shadow,
+                                         num / drawable->ntile_cols,
+                                         num % drawable->ntile_cols);
+
+          size = tile->ewidth * tile->eheight * tile->bpp;
+
+          if (size > length)
+            {
+              g_message ("received tile info did not match computed tile info");
+              gimp_quit ();
+            }
+
+          if (! tile->data)
+            {
+              tile->data  = g_memdup (src, size);
+              tile->dirty = FALSE;
+
+              idle_tiles = g_list_prepend (idle_tiles, tile);
+            }
+
+          src    += size;
+          length -= size;
+        }
+
+      if (! gp_tile_ack_write (_writechannel, NULL))
+        gimp_quit ();
+
+      gimp_wire_destroy (&msg);
+    }
+}
+
+/*  Sends tiles back to the core. The core reserves the shared memory
+ *  for us first, then we fill one half of it while it copies the tiles
+ *  out of the other one.
+ */
+static void
+gimp_tile_put_tiles (GimpTile **tiles,
+                     gint       n_tiles)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTilesReq       tiles_req;
+  GPTilesData      tiles_data;
+  GimpWireMessage  msg;
+  guint32          tile_nums[BATCH_SIZE];
+  guchar          *buffer  = NULL;
+  gsize            half;
+  gint             pending = 0;
+  gint             part    = 0;
+  gint             i       = 0;
+
+  tiles_req.drawable_ID = -1;
+  tiles_req.shadow      = 0;
+  tiles_req.n_tiles     = 0;
+  tiles_req.tile_nums   = NULL;
+
+  if (! gp_tiles_req_write (_writechannel, &tiles_req, NULL))
+    gimp_quit ();
 
   gimp_read_expect_msg (&msg, GP_TILE_ACK);
   gimp_wire_destroy (&msg);
+
+  half = gimp_tile_width () * gimp_tile_height () * 4 * BATCH_SIZE;
+
+  if (! gimp_shm_addr ())
+    buffer = g_malloc (half);
+
+  while (i < n_tiles)
+    {
+      GimpTile *first  = tiles[i];
+      guchar   *dest;
+      gsize     length = 0;
+      gint      n      = 0;
+
+      /*  wait until the core is done with this half  */
+      if (pending == 2)
+        {
+          gimp_read_expect_msg (&msg, GP_TILE_ACK);
+          gimp_wire_destroy (&msg);
+
+          pending--;
+        }
+
+      if (buffer)
+        dest = buffer;
+      else
+        dest = gimp_shm_addr () + part * half;
+
+      while (i < n_tiles && n < BATCH_SIZE             &&
+             tiles[i]->drawable == first->drawable    &&
+             tiles[i]->shadow   == first->shadow)
+        {
+          GimpTile *tile = tiles[i++];
+          gsize     size = tile->ewidth * tile->eheight * tile->bpp;
+
+          memcpy (dest + length, tile->data, size);
+          length += size;
+
+          tile_nums[n++] = tile->tile_num;
+        }
+
+      tiles_data.drawable_ID = first->drawable->drawable_id;
+      tiles_data.shadow      = first->shadow;
+      tiles_data.n_tiles     = n;
+      tiles_data.tile_nums   = tile_nums;
+      tiles_data.use_shm     = (buffer == NULL);
+      tiles_data.shm_offset  = buffer ? 0 : part * half;
+      tiles_data.length      = length;
+      tiles_data.data        = buffer;
+
+      if (! gp_tiles_data_write (_writechannel, &tiles_data, NULL))
+        gimp_quit ();
+
+      pending++;
+      part = 1 - part;
+    }
+
+  /*  an empty batch ends the transfer  */
+  tiles_data.drawable_ID = -1;
+  tiles_data.shadow      = 0;
+  tiles_data.n_tiles     = 0;
+  tiles_data.tile_nums   = NULL;
+  tiles_data.use_shm     = (buffer == NULL);
+  tiles_data.shm_offset  = 0;
+  tiles_data.length      = 0;
+  tiles_data.data        = NULL;
+
+  if (! gp_tiles_data_write (_writechannel, &tiles_data, NULL))
+    gimp_quit ();
+
+  while (pending--)
+    {
+      gimp_read_expect_msg (&msg, GP_TILE_ACK);
+      gimp_wire_destroy (&msg);
+    }
+
+  g_free (buffer);
 }
 
 /* This function is nearly identical to the function 'tile_cache_insert'
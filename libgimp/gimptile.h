@@ -54,6 +54,14 @@ void    gimp_tile_cache_ntiles (gulong     ntiles);
 /*  private function  */
 
 G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable (GimpDrawable *drawable);
+G_GNUC_INTERNAL void _gimp_tile_prefetch             (GimpDrawable *drawable,
+                                                      gboolean      shadow,
+                                                      gint          x,
+                                                      gint          y,
+                                                      gint          width,
+                                                      gint          height);
+G_GNUC_INTERNAL void _gimp_tile_put_idle             (void);
+G_GNUC_INTERNAL void _gimp_tile_flush_idle           (void);
 
 
 G_END_DECLS
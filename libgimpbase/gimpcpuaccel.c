@@ -115,9 +115,20 @@ enum
 
 enum
 {
-  ARCH_X86_INTEL_FEATURE_PNI      = 1 << 0
+  ARCH_X86_INTEL_FEATURE_PNI      = 1 << 0,
+  ARCH_X86_INTEL_FEATURE_OSXSAVE  = 1 << 27,
+  ARCH_X86_INTEL_FEATURE_AVX      = 1 << 28
 };
 
+/* extended features, cpuid leaf 7 subleaf 0, %ebx */
+enum
+{
+  ARCH_X86_INTEL_FEATURE_AVX2     = 1 << 5
+};
+
+/* the SSE and AVX state bits of XCR0 */
+#define ARCH_X86_XCR0_YMM_STATE (0x6)
+
 #if !defined(ARCH_X86_64) && (defined(PIC) || defined(__PIC__))
 #define cpuid(op,eax,ebx,ecx,edx)  \
   __asm__ ("movl %%ebx, %%esi\n\t" \
@@ -128,6 +139,15 @@ enum
              "=c" (ecx),           \
              "=d" (edx)            \
            : "0" (op))
+#define cpuid_count(op,count,eax,ebx,ecx,edx) \
+  __asm__ ("movl %%ebx, %%esi\n\t" \
+           "cpuid\n\t"             \
+           "xchgl %%ebx,%%esi"     \
+           : "=a" (eax),           \
+             "=S" (ebx),           \
+             "=c" (ecx),           \
+             "=d" (edx)            \
+           : "0" (op), "2" (count))
 #else
 #define cpuid(op,eax,ebx,ecx,edx)  \
   __asm__ ("cpuid"                 \
@@ -136,6 +156,13 @@ enum
              "=c" (ecx),           \
              "=d" (edx)            \
            : "0" (op))
+#define cpuid_count(op,count,eax,ebx,ecx,edx) \
+  __asm__ ("cpuid"                 \
+           : "=a" (eax),           \
+             "=b" (ebx),           \
+             "=c" (ecx),           \
+             "=d" (edx)            \
+           : "0" (op), "2" (count))
 #endif
 
 
@@ -209,6 +236,37 @@ arch_get_vendor (void)
   return ARCH_X86_VENDOR_UNKNOWN;
 }
 
+#ifdef USE_AVX2
+static gboolean
+arch_accel_avx2 (guint32 ecx1)
+{
+  guint32 eax, ebx, ecx, edx;
+
+  /* the OS has to save the YMM registers on context switches */
+  if ((ecx1 & ARCH_X86_INTEL_FEATURE_OSXSAVE) == 0 ||
+      (ecx1 & ARCH_X86_INTEL_FEATURE_AVX) == 0)
+    return FALSE;
+
+  /* xgetbv, spelled out for assemblers that don't know it */
+  __asm__ (".byte 0x0f, 0x01, 0xd0"
+           : "=a" (eax),
+             "=d" (edx)
+           : "c" (0));
+
+  if ((eax & ARCH_X86_XCR0_YMM_STATE) != ARCH_X86_XCR0_YMM_STATE)
+    return FALSE;
+
+  cpuid (0, eax, ebx, ecx, edx);
+
+  if (eax < 7)
+    return FALSE;
+
+  cpuid_count (7, 0, eax, ebx, ecx, edx);
+
+  return (ebx & ARCH_X86_INTEL_FEATURE_AVX2) != 0;
+}
+#endif /* USE_AVX2 */
+
 static guint32
 arch_accel_intel (void)
 {
@@ -234,6 +292,11 @@ arch_accel_intel (void)
 
     if (ecx & ARCH_X86_INTEL_FEATURE_PNI)
       caps |= GIMP_CPU_ACCEL_X86_SSE3;
+
+#ifdef USE_AVX2
+    if (arch_accel_avx2 (ecx))
+      caps |= GIMP_CPU_ACCEL_X86_AVX2;
+#endif /* USE_AVX2 */
 #endif /* USE_SSE */
   }
 #endif /* USE_MMX */
@@ -399,7 +462,9 @@ arch_accel (void)
 
 #ifdef USE_SSE
   if ((caps & GIMP_CPU_ACCEL_X86_SSE) && !arch_accel_sse_os_support ())
-    caps &= ~(GIMP_CPU_ACCEL_X86_SSE | GIMP_CPU_ACCEL_X86_SSE2);
+    caps &= ~(GIMP_CPU_ACCEL_X86_SSE  |
+              GIMP_CPU_ACCEL_X86_SSE2 |
+              GIMP_CPU_ACCEL_X86_AVX2);
 #endif
 
   return caps;
@@ -141,6 +141,38 @@ static void _gp_has_init_write           (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_has_init_destroy         (GimpWireMessage  *msg);
 
+static void _gp_tiles_req_read           (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tiles_req_write          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tiles_req_destroy        (GimpWireMessage  *msg);
+
+static void _gp_tiles_data_read          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tiles_data_write         (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tiles_data_destroy       (GimpWireMessage  *msg);
+
+static void _gp_drawable_map_read        (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_map_write       (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_map_destroy     (GimpWireMessage  *msg);
+
+static void _gp_persistent_read          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_persistent_write         (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_persistent_destroy       (GimpWireMessage  *msg);
+
 
 
 void
@@ -198,6 +230,22 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_TILES_REQ,
+                      _gp_tiles_req_read,
+                      _gp_tiles_req_write,
+                      _gp_tiles_req_destroy);
+  gimp_wire_register (GP_TILES_DATA,
+                      _gp_tiles_data_read,
+                      _gp_tiles_data_write,
+                      _gp_tiles_data_destroy);
+  gimp_wire_register (GP_DRAWABLE_MAP,
+                      _gp_drawable_map_read,
+                      _gp_drawable_map_write,
+                      _gp_drawable_map_destroy);
+  gimp_wire_register (GP_PERSISTENT,
+                      _gp_persistent_read,
+                      _gp_persistent_write,
+                      _gp_persistent_destroy);
 }
 
 gboolean
@@ -293,6 +341,63 @@ gp_tile_data_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_tiles_req_write (GIOChannel *channel,
+                    GPTilesReq *tiles_req,
+                    gpointer    user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILES_REQ;
+  msg.data = tiles_req;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_tiles_data_write (GIOChannel  *channel,
+                     GPTilesData *tiles_data,
+                     gpointer     user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILES_DATA;
+  msg.data = tiles_data;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_drawable_map_write (GIOChannel    *channel,
+                       GPDrawableMap *drawable_map,
+                       gpointer       user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_DRAWABLE_MAP;
+  msg.data = drawable_map;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 gboolean
 gp_proc_run_write (GIOChannel *channel,
                    GPProcRun  *proc_run,
@@ -443,6 +548,24 @@ gp_has_init_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_persistent_write (GIOChannel *channel,
+                     gpointer    user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_PERSISTENT;
+  msg.data = NULL;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 /*  quit  */
 
 static void
@@ -1812,3 +1935,296 @@ static void
 _gp_has_init_destroy (GimpWireMessage *msg)
 {
 }
+
+/*  tiles_req  */
+
+static void
+_gp_tiles_req_read (GIOChannel      *channel,
+                    GimpWireMessage *msg,
+                    gpointer         user_data)
+{
+  GPTilesReq *tiles_req = g_slice_new0 (GPTilesReq);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tiles_req->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_req->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_req->n_tiles, 1, user_data))
+    goto cleanup;
+
+  if (tiles_req->n_tiles > 0)
+    {
+      tiles_req->tile_nums = g_new (guint32, tiles_req->n_tiles);
+
+      if (! _gimp_wire_read_int32 (channel,
+                                   tiles_req->tile_nums, tiles_req->n_tiles,
+                                   user_data))
+        goto cleanup;
+    }
+
+  msg->data = tiles_req;
+  return;
+
+ cleanup:
+  g_free (tiles_req->tile_nums);
+  g_slice_free (GPTilesReq, tiles_req);
+}
+
+static void
+_gp_tiles_req_write (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+  GPTilesReq *tiles_req = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tiles_req->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_req->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_req->n_tiles, 1, user_data))
+    return;
+
+  if (tiles_req->n_tiles > 0)
+    {
+      if (! _gimp_wire_write_int32 (channel,
+                                    tiles_req->tile_nums, tiles_req->n_tiles,
+                                    user_data))
+        return;
+    }
+}
+
+static void
+_gp_tiles_req_destroy (GimpWireMessage *msg)
+{
+  GPTilesReq *tiles_req = msg->data;
+
+  g_free (tiles_req->tile_nums);
+  g_slice_free (GPTilesReq, tiles_req);
+}
+
+/*  tiles_data  */
+
+static void
+_gp_tiles_data_read (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+  GPTilesData *tiles_data = g_slice_new0 (GPTilesData);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tiles_data->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_data->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_data->n_tiles, 1, user_data))
+    goto cleanup;
+
+  if (tiles_data->n_tiles > 0)
+    {
+      tiles_data->tile_nums = g_new (guint32, tiles_data->n_tiles);
+
+      if (! _gimp_wire_read_int32 (channel,
+                                   tiles_data->tile_nums, tiles_data->n_tiles,
+                                   user_data))
+        goto cleanup;
+    }
+
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_data->use_shm, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_data->shm_offset, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tiles_data->length, 1, user_data))
+    goto cleanup;
+
+  if (! tiles_data->use_shm && tiles_data->length > 0)
+    {
+      tiles_data->data = g_try_malloc (tiles_data->length);
+
+      if (! tiles_data->data)
+        goto cleanup;
+
+      if (! _gimp_wire_read_int8 (channel,
+                                  (guint8 *) tiles_data->data,
+                                  tiles_data->length,
+                                  user_data))
+        goto cleanup;
+    }
+
+  msg->data = tiles_data;
+  return;
+
+ cleanup:
+  g_free (tiles_data->tile_nums);
+  g_free (tiles_data->data);
+  g_slice_free (GPTilesData, tiles_data);
+}
+
+static void
+_gp_tiles_data_write (GIOChannel      *channel,
+                      GimpWireMessage *msg,
+                      gpointer         user_data)
+{
+  GPTilesData *tiles_data = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tiles_data->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_data->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_data->n_tiles, 1, user_data))
+    return;
+
+  if (tiles_data->n_tiles > 0)
+    {
+      if (! _gimp_wire_write_int32 (channel,
+                                    tiles_data->tile_nums,
+                                    tiles_data->n_tiles,
+                                    user_data))
+        return;
+    }
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_data->use_shm, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_data->shm_offset, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tiles_data->length, 1, user_data))
+    return;
+
+  if (! tiles_data->use_shm && tiles_data->length > 0)
+    {
+      if (! _gimp_wire_write_int8 (channel,
+                                   (const guint8 *) tiles_data->data,
+                                   tiles_data->length,
+                                   user_data))
+        return;
+    }
+}
+
+static void
+_gp_tiles_data_destroy (GimpWireMessage *msg)
+{
+  GPTilesData *tiles_data = msg->data;
+
+  g_free (tiles_data->tile_nums);
+  g_free (tiles_data->data);
+  g_slice_free (GPTilesData, tiles_data);
+}
+
+/*  drawable_map  */
+
+static void
+_gp_drawable_map_read (GIOChannel      *channel,
+                       GimpWireMessage *msg,
+                       gpointer         user_data)
+{
+  GPDrawableMap *drawable_map = g_slice_new0 (GPDrawableMap);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_map->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_map->shm_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->serial, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->width, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->height, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->bpp, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->rowstride, 1, user_data))
+    goto cleanup;
+
+  msg->data = drawable_map;
+  return;
+
+ cleanup:
+  g_slice_free (GPDrawableMap, drawable_map);
+}
+
+static void
+_gp_drawable_map_write (GIOChannel      *channel,
+                        GimpWireMessage *msg,
+                        gpointer         user_data)
+{
+  GPDrawableMap *drawable_map = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_map->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_map->shm_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->serial, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->width, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->height, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->bpp, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->rowstride, 1, user_data))
+    return;
+}
+
+static void
+_gp_drawable_map_destroy (GimpWireMessage *msg)
+{
+  g_slice_free (GPDrawableMap, msg->data);
+}
+
+/*  persistent  */
+
+static void
+_gp_persistent_read (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+}
+
+static void
+_gp_persistent_write (GIOChannel      *channel,
+                      GimpWireMessage *msg,
+                      gpointer         user_data)
+{
+}
+
+static void
+_gp_persistent_destroy (GimpWireMessage *msg)
+{
+}
@@ -27,7 +27,13 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0011
+#define GIMP_PROTOCOL_VERSION  0x0014
+
+/* The shared memory used for transferring tiles holds this many tiles
+ * of 4 bytes per pixel. Batched transfers use it as a ring of two
+ * halves, so that one half can be filled while the other is read.
+ */
+#define GP_SHM_N_TILES  128
 
 
 enum
@@ -44,7 +50,11 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_TILES_REQ,
+  GP_TILES_DATA,
+  GP_DRAWABLE_MAP,
+  GP_PERSISTENT
 };
 
 
@@ -52,6 +62,9 @@ typedef struct _GPConfig        GPConfig;
 typedef struct _GPTileReq       GPTileReq;
 typedef struct _GPTileAck       GPTileAck;
 typedef struct _GPTileData      GPTileData;
+typedef struct _GPTilesReq      GPTilesReq;
+typedef struct _GPTilesData     GPTilesData;
+typedef struct _GPDrawableMap   GPDrawableMap;
 typedef struct _GPParam         GPParam;
 typedef struct _GPParamDef      GPParamDef;
 typedef struct _GPProcRun       GPProcRun;
@@ -103,6 +116,37 @@ struct _GPTileData
   guchar  *data;
 };
 
+struct _GPTilesReq
+{
+  gint32   drawable_ID;  /* -1 to start sending tiles to the core */
+  guint32  shadow;
+  guint32  n_tiles;
+  guint32 *tile_nums;
+};
+
+struct _GPTilesData
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  n_tiles;      /* 0 ends a transfer to the core */
+  guint32 *tile_nums;
+  guint32  use_shm;
+  guint32  shm_offset;   /* where the tiles start in shared memory */
+  guint32  length;       /* the size of all the tiles' data */
+  guchar  *data;
+};
+
+struct _GPDrawableMap
+{
+  gint32   drawable_ID;
+  gint32   shm_ID;       /* -1 if the core could not export the drawable */
+  guint32  serial;       /* distinguishes the segments of one process */
+  guint32  width;
+  guint32  height;
+  guint32  bpp;
+  guint32  rowstride;
+};
+
 struct _GPParam
 {
   guint32 type;
@@ -200,6 +244,15 @@ gboolean  gp_tile_ack_write         (GIOChannel      *channel,
 gboolean  gp_tile_data_write        (GIOChannel      *channel,
                                      GPTileData      *tile_data,
                                      gpointer         user_data);
+gboolean  gp_tiles_req_write        (GIOChannel      *channel,
+                                     GPTilesReq      *tiles_req,
+                                     gpointer         user_data);
+gboolean  gp_tiles_data_write       (GIOChannel      *channel,
+                                     GPTilesData     *tiles_data,
+                                     gpointer         user_data);
+gboolean  gp_drawable_map_write     (GIOChannel      *channel,
+                                     GPDrawableMap   *drawable_map,
+                                     gpointer         user_data);
 gboolean  gp_proc_run_write         (GIOChannel      *channel,
                                      GPProcRun       *proc_run,
                                      gpointer         user_data);
@@ -222,6 +275,8 @@ gboolean  gp_extension_ack_write    (GIOChannel      *channel,
                                      gpointer         user_data);
 gboolean  gp_has_init_write         (GIOChannel      *channel,
                                      gpointer         user_data);
+gboolean  gp_persistent_write       (GIOChannel      *channel,
+                                     gpointer         user_data);
 
 void      gp_params_destroy         (GPParam         *params,
                                      gint             nparams);
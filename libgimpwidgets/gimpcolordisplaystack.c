@@ -25,6 +25,7 @@
 #include <gtk/gtk.h>
 
 #include "libgimpcolor/gimpcolor.h"
+#include "libgimpmath/gimpmath.h"
 
 #include "gimpwidgetstypes.h"
 
@@ -43,7 +44,25 @@ enum
 };
 
 
+/*  The enabled filters are folded into a color lookup table of
+ *  CLUT_SIZE^3 grid points, which is sampled with tetrahedral
+ *  interpolation instead of running each filter on every pixel.
+ *  The grid points are spaced quadratically, so that the dark end
+ *  where gamma curves are steepest gets the most of them.
+ */
+#define CLUT_SIZE  33
+
+typedef struct
+{
+  guchar   *clut;
+  gboolean  clut_valid;
+} GimpColorDisplayStackPrivate;
+
+#define GIMP_COLOR_DISPLAY_STACK_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GIMP_TYPE_COLOR_DISPLAY_STACK, GimpColorDisplayStackPrivate))
+
+
 static void   gimp_color_display_stack_dispose         (GObject               *object);
+static void   gimp_color_display_stack_finalize        (GObject               *object);
 
 static void   gimp_color_display_stack_display_changed (GimpColorDisplay      *display,
                                                         GimpColorDisplayStack *stack);
@@ -53,6 +72,15 @@ static void   gimp_color_display_stack_display_enabled (GimpColorDisplay      *d
 static void   gimp_color_display_stack_disconnect      (GimpColorDisplayStack *stack,
                                                         GimpColorDisplay      *display);
 
+static const guchar *
+              gimp_color_display_stack_get_clut        (GimpColorDisplayStack *stack);
+static void   gimp_color_display_stack_apply_clut      (const guchar          *clut,
+                                                        guchar                *buf,
+                                                        gint                   width,
+                                                        gint                   height,
+                                                        gint                   bpp,
+                                                        gint                   bpl);
+
 
 G_DEFINE_TYPE (GimpColorDisplayStack, gimp_color_display_stack, G_TYPE_OBJECT)
 
@@ -60,11 +88,16 @@ G_DEFINE_TYPE (GimpColorDisplayStack, gimp_color_display_stack, G_TYPE_OBJECT)
 
 static guint stack_signals[LAST_SIGNAL] = { 0 };
 
+static guchar clut_grid[CLUT_SIZE];   /*  value of each grid point         */
+static guchar clut_index[256];        /*  grid cell each value falls in    */
+static guchar clut_frac[256];         /*  position in that cell, 0 .. 255  */
+
 
 static void
 gimp_color_display_stack_class_init (GimpColorDisplayStackClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  gint          i, j;
 
   stack_signals[CHANGED] =
     g_signal_new ("changed",
@@ -107,18 +140,49 @@ gimp_color_display_stack_class_init (GimpColorDisplayStackClass *klass)
                   GIMP_TYPE_COLOR_DISPLAY,
                   G_TYPE_INT);
 
-  object_class->dispose = gimp_color_display_stack_dispose;
+  object_class->dispose  = gimp_color_display_stack_dispose;
+  object_class->finalize = gimp_color_display_stack_finalize;
+
+  klass->changed         = NULL;
+  klass->added           = NULL;
+  klass->removed         = NULL;
+  klass->reordered       = NULL;
+
+  g_type_class_add_private (object_class,
+                            sizeof (GimpColorDisplayStackPrivate));
 
-  klass->changed        = NULL;
-  klass->added          = NULL;
-  klass->removed        = NULL;
-  klass->reordered      = NULL;
+  for (i = 0; i < CLUT_SIZE; i++)
+    {
+      gdouble t = (gdouble) i / (CLUT_SIZE - 1);
+
+      clut_grid[i] = ROUND (255.0 * t * t);
+
+      if (i > 0 && clut_grid[i] <= clut_grid[i - 1])
+        clut_grid[i] = clut_grid[i - 1] + 1;
+    }
+
+  for (i = 0, j = 0; i < 256; i++)
+    {
+      while (j < CLUT_SIZE - 2 && clut_grid[j + 1] <= i)
+        j++;
+
+      clut_index[i] = j;
+      clut_frac[i]  = ((i - clut_grid[j]) * 255 /
+                       (clut_grid[j + 1] - clut_grid[j]));
+    }
 }
 
 static void
 gimp_color_display_stack_init (GimpColorDisplayStack *stack)
 {
+  GimpColorDisplayStackPrivate *private;
+
+  private = GIMP_COLOR_DISPLAY_STACK_GET_PRIVATE (stack);
+
   stack->filters = NULL;
+
+  private->clut       = NULL;
+  private->clut_valid = FALSE;
 }
 
 static void
@@ -145,6 +209,22 @@ gimp_color_display_stack_dispose (GObject *object)
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
+static void
+gimp_color_display_stack_finalize (GObject *object)
+{
+  GimpColorDisplayStackPrivate *private;
+
+  private = GIMP_COLOR_DISPLAY_STACK_GET_PRIVATE (object);
+
+  if (private->clut)
+    {
+      g_free (private->clut);
+      private->clut = NULL;
+    }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 GimpColorDisplayStack *
 gimp_color_display_stack_new (void)
 {
@@ -179,6 +259,8 @@ gimp_color_display_stack_changed (GimpColorDisplayStack *stack)
 {
   g_return_if_fail (GIMP_IS_COLOR_DISPLAY_STACK (stack));
 
+  GIMP_COLOR_DISPLAY_STACK_GET_PRIVATE (stack)->clut_valid = FALSE;
+
   g_signal_emit (stack, stack_signals[CHANGED], 0);
 }
 
@@ -282,10 +364,20 @@ gimp_color_display_stack_convert (GimpColorDisplayStack *stack,
                                   gint                   bpp,
                                   gint                   bpl)
 {
-  GList *list;
+  const guchar *clut;
+  GList        *list;
 
   g_return_if_fail (GIMP_IS_COLOR_DISPLAY_STACK (stack));
 
+  /*  the lookup table only covers RGB  */
+  clut = (bpp >= 3) ? gimp_color_display_stack_get_clut (stack) : NULL;
+
+  if (clut)
+    {
+      gimp_color_display_stack_apply_clut (clut, buf, width, height, bpp, bpl);
+      return;
+    }
+
   for (list = stack->filters; list; list = g_list_next (list))
     {
       GimpColorDisplay *display = list->data;
@@ -324,3 +416,153 @@ gimp_color_display_stack_disconnect (GimpColorDisplayStack *stack,
                                         gimp_color_display_stack_display_enabled,
                                         stack);
 }
+
+/*  Returns the lookup table for the enabled filters, building it if
+ *  the stack changed since it was last used, or NULL if no filter is
+ *  enabled.
+ */
+static const guchar *
+gimp_color_display_stack_get_clut (GimpColorDisplayStack *stack)
+{
+  GimpColorDisplayStackPrivate *private;
+  GList                        *list;
+  guchar                       *p;
+  gint                          r, g, b;
+
+  private = GIMP_COLOR_DISPLAY_STACK_GET_PRIVATE (stack);
+
+  if (private->clut_valid)
+    return private->clut;
+
+  for (list = stack->filters; list; list = g_list_next (list))
+    {
+      GimpColorDisplay *display = list->data;
+
+      if (display->enabled)
+        break;
+    }
+
+  if (! list)
+    {
+      g_free (private->clut);
+      private->clut = NULL;
+
+      private->clut_valid = TRUE;
+
+      return NULL;
+    }
+
+  if (! private->clut)
+    private->clut = g_new (guchar, CLUT_SIZE * CLUT_SIZE * CLUT_SIZE * 3);
+
+  /*  lay out the grid points as an image with one row per (r, g) pair
+   *  and let the filters convert it
+   */
+  p = private->clut;
+
+  for (r = 0; r < CLUT_SIZE; r++)
+    for (g = 0; g < CLUT_SIZE; g++)
+      for (b = 0; b < CLUT_SIZE; b++)
+        {
+          *p++ = clut_grid[r];
+          *p++ = clut_grid[g];
+          *p++ = clut_grid[b];
+        }
+
+  for (list = stack->filters; list; list = g_list_next (list))
+    {
+      GimpColorDisplay *display = list->data;
+
+      gimp_color_display_convert (display, private->clut,
+                                  CLUT_SIZE, CLUT_SIZE * CLUT_SIZE,
+                                  3, CLUT_SIZE * 3);
+    }
+
+  private->clut_valid = TRUE;
+
+  return private->clut;
+}
+
+static void
+gimp_color_display_stack_apply_clut (const guchar *clut,
+                                     guchar       *buf,
+                                     gint          width,
+                                     gint          height,
+                                     gint          bpp,
+                                     gint          bpl)
+{
+  const gint stride_b = 3;
+  const gint stride_g = 3 * CLUT_SIZE;
+  const gint stride_r = 3 * CLUT_SIZE * CLUT_SIZE;
+  gint       x, y;
+
+  for (y = 0; y < height; y++)
+    {
+      guchar *p = buf + y * bpl;
+
+      for (x = 0; x < width; x++, p += bpp)
+        {
+          const gint    fr = clut_frac[p[0]];
+          const gint    fg = clut_frac[p[1]];
+          const gint    fb = clut_frac[p[2]];
+          const guchar *c0 = clut + (clut_index[p[0]] * stride_r +
+                                     clut_index[p[1]] * stride_g +
+                                     clut_index[p[2]] * stride_b);
+          const guchar *c1;
+          const guchar *c2;
+          const guchar *c3 = c0 + stride_r + stride_g + stride_b;
+          gint          w0, w1, w2, w3;
+          gint          c;
+
+          /*  pick the tetrahedron of the grid cell the color falls in  */
+          if (fr >= fg)
+            {
+              if (fg >= fb)
+                {
+                  c1 = c0 + stride_r;
+                  c2 = c0 + stride_r + stride_g;
+                  w1 = fr - fg;  w2 = fg - fb;  w3 = fb;
+                }
+              else if (fr >= fb)
+                {
+                  c1 = c0 + stride_r;
+                  c2 = c0 + stride_r + stride_b;
+                  w1 = fr - fb;  w2 = fb - fg;  w3 = fg;
+                }
+              else
+                {
+                  c1 = c0 + stride_b;
+                  c2 = c0 + stride_r + stride_b;
+                  w1 = fb - fr;  w2 = fr - fg;  w3 = fg;
+                }
+            }
+          else
+            {
+              if (fb >= fg)
+                {
+                  c1 = c0 + stride_b;
+                  c2 = c0 + stride_g + stride_b;
+                  w1 = fb - fg;  w2 = fg - fr;  w3 = fr;
+                }
+              else if (fb >= fr)
+                {
+                  c1 = c0 + stride_g;
+                  c2 = c0 + stride_g + stride_b;
+                  w1 = fg - fb;  w2 = fb - fr;  w3 = fr;
+                }
+              else
+                {
+                  c1 = c0 + stride_g;
+                  c2 = c0 + stride_r + stride_g;
+                  w1 = fg - fr;  w2 = fr - fb;  w3 = fb;
+                }
+            }
+
+          w0 = 255 - w1 - w2 - w3;
+
+          for (c = 0; c < 3; c++)
+            p[c] = (c0[c] * w0 + c1[c] * w1 + c2[c] * w2 + c3[c] * w3 +
+                    127) / 255;
+        }
+    }
+}
@@ -200,30 +200,6 @@ run (const gchar      *name,
   gimp_drawable_detach (drawable);
 }
 
-typedef struct {
-  gint x1, x2, y1, y2;
-  gint bucket_expo;
-  gint *cube;
-} BorderAverageParam_t;
-
-static void
-borderaverage_func (gint x,
-                    gint y,
-                    const guchar *src,
-                    gint bpp,
-                    gpointer data)
-{
-  BorderAverageParam_t *param = (BorderAverageParam_t*) data;
-
-  if (x <  param->x1 + borderaverage_thickness ||
-      x >= param->x2 - borderaverage_thickness ||
-      y <  param->y1 + borderaverage_thickness ||
-      y >= param->y2 - borderaverage_thickness)
-    {
-      add_new_color (bpp, src, param->cube, param->bucket_expo);
-    }
-}
-
 static void
 borderaverage (GimpDrawable *drawable,
                GimpRGB      *result)
@@ -234,18 +210,16 @@ borderaverage (GimpDrawable *drawable,
   gint    bytes;
   gint    max;
   guchar  r, g, b;
-  guchar *buffer;
+  guchar **rows;
   gint    bucket_num, bucket_expo, bucket_rexpo;
   gint   *cube;
   gint    i, j, k; /* index variables */
-  GimpRgnIterator *iter;
-
-  BorderAverageParam_t     param;
+  gint    x, y;
 
   /* allocate and clear the cube before */
   bucket_expo = borderaverage_bucket_exponent;
   bucket_rexpo = 8 - bucket_expo;
-  param.cube = cube = g_new (gint, 1 << (bucket_rexpo * 3));
+  cube = g_new (gint, 1 << (bucket_rexpo * 3));
   bucket_num = 1 << bucket_rexpo;
 
   for (i = 0; i < bucket_num; i++)
@@ -260,11 +234,6 @@ borderaverage (GimpDrawable *drawable,
     }
 
   gimp_drawable_mask_bounds (drawable->drawable_id, &x1, &y1, &x2, &y2);
-  param.x1 = x1;
-  param.y1 = y1;
-  param.x2 = x2;
-  param.y2 = y2;
-  param.bucket_expo = bucket_expo;
 
   /*  Get the size of the input image. (This will/must be the same
    *  as the size of the output image.
@@ -273,14 +242,31 @@ borderaverage (GimpDrawable *drawable,
   height = drawable->height;
   bytes = drawable->bpp;
 
-  gimp_tile_cache_ntiles (2 * ((x2 - x1) / gimp_tile_width () + 1));
+  /*  map the drawable and only look at the pixels of the border  */
+  rows = gimp_drawable_map (drawable, FALSE);
 
-  /*  allocate row buffer  */
-  buffer = g_new (guchar, (x2 - x1) * bytes);
+  for (y = y1; y < y2; y++)
+    {
+      const guchar *row = rows[y];
+
+      if (y <  y1 + borderaverage_thickness ||
+          y >= y2 - borderaverage_thickness)
+        {
+          for (x = x1; x < x2; x++)
+            add_new_color (bytes, row + x * bytes, cube, bucket_expo);
+        }
+      else
+        {
+          for (x = x1; x < MIN (x1 + borderaverage_thickness, x2); x++)
+            add_new_color (bytes, row + x * bytes, cube, bucket_expo);
+
+          for (x = MAX (x2 - borderaverage_thickness,
+                        x1 + borderaverage_thickness); x < x2; x++)
+            add_new_color (bytes, row + x * bytes, cube, bucket_expo);
+        }
+    }
 
-  iter = gimp_rgn_iterator_new (drawable, 0);
-  gimp_rgn_iterator_src (iter, borderaverage_func, &param);
-  gimp_rgn_iterator_free (iter);
+  gimp_drawable_unmap (rows);
 
   max = 0; r = 0; g = 0; b = 0;
 
@@ -307,7 +293,6 @@ borderaverage (GimpDrawable *drawable,
   /* return the color */
   gimp_rgb_set_uchar (result, r, g, b);
 
-  g_free (buffer);
   g_free (cube);
 }
 
@@ -157,9 +157,6 @@ run (const gchar      *name,
           memset (hist_green, 0, sizeof (hist_green));
           memset (hist_blue, 0, sizeof (hist_blue));
 
-          gimp_tile_cache_ntiles (2 *
-                                  (drawable->width / gimp_tile_width () + 1));
-
           analyze (drawable);
 
           /* show dialog after we analyzed image */
@@ -182,7 +179,7 @@ run (const gchar      *name,
 static void
 analyze (GimpDrawable *drawable)
 {
-  GimpPixelRgn  srcPR;
+  guchar      **src_rows;
   guchar       *src_row, *cmap;
   gint          x, y, numcol;
   gint          x1, y1, x2, y2;
@@ -192,8 +189,8 @@ analyze (GimpDrawable *drawable)
   gboolean      gray;
   gboolean      has_alpha;
   gboolean      has_sel;
-  guchar       *sel;
-  GimpPixelRgn  selPR;
+  guchar      **sel_rows = NULL;
+  guchar       *sel      = NULL;
   gint          ofsx, ofsy;
   GimpDrawable *selDrawable;
 
@@ -212,8 +209,8 @@ analyze (GimpDrawable *drawable)
   has_sel = !gimp_selection_is_empty (imageID);
   gimp_drawable_offsets (drawable->drawable_id, &ofsx, &ofsy);
 
-  /* initialize the pixel region */
-  gimp_pixel_rgn_init (&srcPR, drawable, 0, 0, width, height, FALSE, FALSE);
+  /* map the whole drawable, we only read from it */
+  src_rows = gimp_drawable_map (drawable, FALSE);
 
   cmap = gimp_image_get_colormap (imageID, &numcol);
   gray = (gimp_drawable_is_gray (drawable->drawable_id)
@@ -221,19 +218,23 @@ analyze (GimpDrawable *drawable)
   has_alpha = gimp_drawable_has_alpha (drawable->drawable_id);
 
   selDrawable = gimp_drawable_get (gimp_image_get_selection (imageID));
-  gimp_pixel_rgn_init (&selPR,
-                       selDrawable,
-                       0, 0, width, height, FALSE, FALSE);
 
-  /* allocate row buffer */
-  src_row = g_new (guchar, (x2 - x1) * bpp);
-  sel = g_new (guchar, x2 - x1);
+  if (has_sel)
+    {
+      sel_rows = gimp_drawable_map (selDrawable, FALSE);
+
+      /* pixels of the layer outside of the mask are not selected */
+      x1 = MAX (x1, - ofsx);
+      y1 = MAX (y1, - ofsy);
+      x2 = MIN (x2, selDrawable->width - ofsx);
+      y2 = MIN (y2, selDrawable->height - ofsy);
+    }
 
   for (y = y1; y < y2; y++)
     {
-      gimp_pixel_rgn_get_row (&srcPR, src_row, x1, y, (x2 - x1));
+      src_row = src_rows[y] + x1 * bpp;
       if (has_sel)
-        gimp_pixel_rgn_get_row (&selPR, sel, x1 + ofsx, y + ofsy, (x2 - x1));
+        sel = sel_rows[y + ofsy] + x1 + ofsx;
 
       for (x = 0; x < x2 - x1; x++)
         {
@@ -286,9 +287,10 @@ analyze (GimpDrawable *drawable)
   gimp_progress_update (1.0);
 
   /* clean up */
+  if (sel_rows)
+    gimp_drawable_unmap (sel_rows);
+  gimp_drawable_unmap (src_rows);
   gimp_drawable_detach (selDrawable);
-  g_free (src_row);
-  g_free (sel);
 }
 
 static void
@@ -276,6 +276,9 @@ run (const gchar      *name,
 
   INIT_I18N ();
 
+  /*  batch scripts call us over and over, stay around for them  */
+  gimp_plugin_set_persistent (run_mode == GIMP_RUN_NONINTERACTIVE);
+
   *nreturn_vals = 1;
   *return_vals  = values;
 